@@ -0,0 +1,75 @@
+#version 450
+
+// GridVertex: see geometry/vertex.h
+layout(location = 0) in uvec2 inGrid; // Column and row within the shared grid
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+} camera;
+
+// Heightfield samples, row-major
+layout(std430, set = 0, binding = 1) readonly buffer Heights {
+    float heights[];
+};
+
+// CdlodPushConstants: see renderer/vk_pipeline.h
+layout(push_constant) uniform CdlodNode {
+    vec2  origin;      // Sample of the node's corner
+    float spacing;     // Samples per grid cell
+    float morphStart;
+    float morphEnd;
+    float cellSize;
+    vec2  terrainOrigin;
+    uvec2 terrainSize;
+} node;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) flat out uint fragMaterial;
+
+float sampleAt(ivec2 p) {
+    ivec2 size = ivec2(node.terrainSize);
+    p          = clamp(p, ivec2(0), size - 1);
+    return heights[p.y * size.x + p.x];
+}
+
+// Bilinear, so morphed vertices between samples land on the coarser LOD's surface
+float heightAt(vec2 p) {
+    vec2  base = floor(p);
+    vec2  f    = p - base;
+    ivec2 i    = ivec2(base);
+    float h0   = mix(sampleAt(i), sampleAt(i + ivec2(1, 0)), f.x);
+    float h1   = mix(sampleAt(i + ivec2(0, 1)), sampleAt(i + ivec2(1, 1)), f.x);
+    return mix(h0, h1, f.y);
+}
+
+vec3 worldAt(vec2 p) {
+    return vec3(node.terrainOrigin.x + p.x * node.cellSize,
+                heightAt(p),
+                node.terrainOrigin.y + p.y * node.cellSize);
+}
+
+void main() {
+    vec2 grid  = vec2(inGrid);
+    vec2 limit  = vec2(node.terrainSize - 1u);
+    vec2 pos   = min(node.origin + grid * node.spacing, limit);
+
+    // Slide odd vertices onto the next LOD's grid as the node nears the end of its range
+    float morph = clamp((distance(worldAt(pos), camera.cameraPos.xyz) - node.morphStart)
+                          / (node.morphEnd - node.morphStart),
+                        0.0,
+                        1.0);
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    pos   = min(node.origin + grid * node.spacing, limit);
+
+    vec3  position = worldAt(pos);
+    float hl       = heightAt(pos - vec2(1.0, 0.0));
+    float hr       = heightAt(pos + vec2(1.0, 0.0));
+    float hd       = heightAt(pos - vec2(0.0, 1.0));
+    float hu       = heightAt(pos + vec2(0.0, 1.0));
+
+    gl_Position  = camera.proj * camera.view * vec4(position, 1.0);
+    fragNormal   = normalize(vec3(hl - hr, 2.0 * node.cellSize, hd - hu));
+    fragMaterial = 0u;
+}
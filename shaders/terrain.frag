@@ -0,0 +1,26 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) flat in uint fragMaterial;
+
+layout(location = 0) out vec4 outColor;
+
+// Matches TerrainMaterial in geometry/terrain_mesh.h
+const uint MATERIAL_WET = 1u;
+
+const vec3  LIGHT_DIR  = vec3(0.37, 0.86, 0.35);
+const float AMBIENT    = 0.25;
+const vec3  GRASS      = vec3(0.32, 0.46, 0.22);
+const vec3  ROCK       = vec3(0.50, 0.47, 0.43);
+const vec3  WATER      = vec3(0.16, 0.30, 0.45);
+const float ROCK_SCALE = 4.0; // Fully rock once the normal tilts ~40 degrees
+
+void main() {
+    vec3  n      = normalize(fragNormal);
+    float light  = AMBIENT + (1.0 - AMBIENT) * max(dot(n, LIGHT_DIR), 0.0);
+    vec3  albedo = mix(GRASS, ROCK, min((1.0 - n.y) * ROCK_SCALE, 1.0));
+    if(fragMaterial == MATERIAL_WET) {
+        albedo = mix(albedo, WATER, 0.7);
+    }
+    outColor = vec4(albedo * light, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 450
+
+// TerrainVertex: see geometry/vertex.h
+layout(location = 0) in float inHeight;   // Unorm16 over the tile's height range
+layout(location = 1) in vec2  inNormal;   // Octahedral (x, z), y up
+layout(location = 2) in uvec2 inGrid;     // Column and row within the tile
+layout(location = 3) in uint  inMaterial;
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+} camera;
+
+// TerrainPushConstants: see renderer/vk_pipeline.h
+layout(push_constant) uniform TerrainTile {
+    vec2  origin;
+    float cellSize;
+    float heightMin;
+    float heightRange;
+} tile;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) flat out uint fragMaterial;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if(n.y < 0.0) {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+        n.xz   = (1.0 - abs(n.zx)) * s;
+    }
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = vec3(tile.origin.x + float(inGrid.x) * tile.cellSize,
+                         tile.heightMin + inHeight * tile.heightRange,
+                         tile.origin.y + float(inGrid.y) * tile.cellSize);
+
+    gl_Position  = camera.proj * camera.view * vec4(position, 1.0);
+    fragNormal   = octDecode(inNormal);
+    fragMaterial = inMaterial;
+}
@@ -32,6 +32,20 @@ inline void camera_update_vectors(Camera &c) {
 
 inline glm::mat4 view_matrix(const Camera &c) { return glm::lookAt(c.position, c.position + c.front, c.up); }
 
+// Vulkan projection: clip-space y points down
+inline glm::mat4 projection_matrix(const Camera &c, f32 aspect) {
+  glm::mat4 proj = glm::perspective(glm::radians(c.zoom), aspect, 0.1f, 100.0f);
+  proj[1][1] *= -1.0f;
+  return proj;
+}
+
+// World-space direction through a point of the view; x and y run from -1 to 1, left to right
+// and top to bottom, matching the renderer's projection
+inline glm::vec3 camera_view_ray(const Camera &c, f32 aspect, f32 x, f32 y) {
+  f32 tan_half = tan(glm::radians(c.zoom) * 0.5f);
+  return glm::normalize(c.front + c.right * (x * tan_half * aspect) - c.up * (y * tan_half));
+}
+
 inline Camera camera_default() {
   Camera c{};
   c.position = {0.f, 0.f, 3.f};
@@ -0,0 +1,121 @@
+#include "frustum.h"
+#include "math/simd.h"
+#include <math.h>
+
+void frustum_from_matrix(Frustum *frustum, const f32 view_proj[16]) {
+  // Row i of the matrix is (m[i], m[4 + i], m[8 + i], m[12 + i])
+  const f32 *m = view_proj;
+  for(u32 c = 0; c < 4; ++c) {
+    f32 row0 = m[c * 4 + 0];
+    f32 row1 = m[c * 4 + 1];
+    f32 row2 = m[c * 4 + 2];
+    f32 row3 = m[c * 4 + 3];
+
+    frustum->planes[FRUSTUM_PLANE_LEFT][c]   = row3 + row0;
+    frustum->planes[FRUSTUM_PLANE_RIGHT][c]  = row3 - row0;
+    frustum->planes[FRUSTUM_PLANE_BOTTOM][c] = row3 + row1;
+    frustum->planes[FRUSTUM_PLANE_TOP][c]    = row3 - row1;
+    frustum->planes[FRUSTUM_PLANE_NEAR][c]   = row2;
+    frustum->planes[FRUSTUM_PLANE_FAR][c]    = row3 - row2;
+  }
+
+  // Normalize so plane distances are in world units
+  for(u32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+    f32 *plane  = frustum->planes[p];
+    f32  length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    if(length > 0.0f) {
+      for(u32 c = 0; c < 4; ++c) {
+        plane[c] /= length;
+      }
+    }
+  }
+}
+
+bool frustum_test_aabb(const Frustum *frustum, const f32 min[3], const f32 max[3]) {
+  for(u32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+    const f32 *plane = frustum->planes[p];
+
+    // Corner furthest along the plane normal
+    f32 x = plane[0] >= 0.0f ? max[0] : min[0];
+    f32 y = plane[1] >= 0.0f ? max[1] : min[1];
+    f32 z = plane[2] >= 0.0f ? max[2] : min[2];
+    if(plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool frustum_test_sphere(const Frustum *frustum, const f32 center[3], f32 radius) {
+  for(u32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+    const f32 *plane = frustum->planes[p];
+    if(plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether box i of boxes may intersect the frustum, as frustum_cull_boxes decides it
+static bool frustum_test_box(const Frustum *frustum, const FrustumBoxes *boxes, u32 i) {
+  for(u32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+    const f32 *plane = frustum->planes[p];
+    f32        distance =
+      plane[0] * boxes->center[0][i] + plane[1] * boxes->center[1][i] + plane[2] * boxes->center[2][i] + plane[3];
+    f32 reach = fabsf(plane[0]) * boxes->extent[0][i] + fabsf(plane[1]) * boxes->extent[1][i]
+              + fabsf(plane[2]) * boxes->extent[2][i];
+    if(distance < -fminf(reach, boxes->radius[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Movemask of the lanes outside the frustum, for the four boxes starting at first
+static u32 frustum_cull_lanes(const Frustum *frustum, const FrustumBoxes *boxes, u32 first) {
+  F32x4 cx     = f32x4_load(boxes->center[0] + first);
+  F32x4 cy     = f32x4_load(boxes->center[1] + first);
+  F32x4 cz     = f32x4_load(boxes->center[2] + first);
+  F32x4 ex     = f32x4_load(boxes->extent[0] + first);
+  F32x4 ey     = f32x4_load(boxes->extent[1] + first);
+  F32x4 ez     = f32x4_load(boxes->extent[2] + first);
+  F32x4 radius = f32x4_load(boxes->radius + first);
+  F32x4 zero   = f32x4_set1(0.0f);
+
+  U32x4 outside = u32x4_set1(0);
+  for(u32 p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+    const f32 *plane = frustum->planes[p];
+    F32x4      nx    = f32x4_set1(plane[0]);
+    F32x4      ny    = f32x4_set1(plane[1]);
+    F32x4      nz    = f32x4_set1(plane[2]);
+    F32x4      d     = f32x4_set1(plane[3]);
+    F32x4      ax    = f32x4_set1(fabsf(plane[0]));
+    F32x4      ay    = f32x4_set1(fabsf(plane[1]));
+    F32x4      az    = f32x4_set1(fabsf(plane[2]));
+
+    // Signed distance of the center, against how far the box or sphere reaches towards the plane
+    F32x4 distance = f32x4_add(f32x4_add(f32x4_mul(cx, nx), f32x4_mul(cy, ny)), f32x4_add(f32x4_mul(cz, nz), d));
+    F32x4 reach    = f32x4_add(f32x4_add(f32x4_mul(ex, ax), f32x4_mul(ey, ay)), f32x4_mul(ez, az));
+    outside        = u32x4_or(outside, f32x4_lt(distance, f32x4_sub(zero, f32x4_min(reach, radius))));
+  }
+  return u32x4_movemask(outside);
+}
+
+u32 frustum_cull_boxes(const Frustum *frustum, const FrustumBoxes *boxes, u32 count, u8 *visible) {
+  // Two SIMD_WIDTH halves per batch
+  u32 visible_count = 0;
+  u32 i             = 0;
+  for(; i + FRUSTUM_CULL_BATCH <= count; i += FRUSTUM_CULL_BATCH) {
+    u32 outside = frustum_cull_lanes(frustum, boxes, i) | (frustum_cull_lanes(frustum, boxes, i + SIMD_WIDTH) << 4);
+    for(u32 lane = 0; lane < FRUSTUM_CULL_BATCH; ++lane) {
+      visible[i + lane] = (u8)(~outside >> lane & 1);
+      visible_count += visible[i + lane];
+    }
+  }
+
+  for(; i < count; ++i) {
+    visible[i] = frustum_test_box(frustum, boxes, i) ? 1 : 0;
+    visible_count += visible[i];
+  }
+  return visible_count;
+}
@@ -0,0 +1,50 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "utils/types.h"
+
+// View frustum as six inward-facing planes (a, b, c, d): a point p is inside a plane when
+// a * p.x + b * p.y + c * p.z + d >= 0. Extracted from a view-projection matrix with
+// clip-space depth in [0, 1], as the renderer uses.
+
+typedef enum FrustumPlane {
+  FRUSTUM_PLANE_LEFT = 0,
+  FRUSTUM_PLANE_RIGHT,
+  FRUSTUM_PLANE_BOTTOM,
+  FRUSTUM_PLANE_TOP,
+  FRUSTUM_PLANE_NEAR,
+  FRUSTUM_PLANE_FAR,
+  FRUSTUM_PLANE_COUNT
+} FrustumPlane;
+
+typedef struct Frustum {
+  f32 planes[FRUSTUM_PLANE_COUNT][4];
+} Frustum;
+
+// view_proj is column-major, as stored by glm
+void frustum_from_matrix(Frustum *frustum, const f32 view_proj[16]);
+
+// Whether the box [min, max] may intersect the frustum. Conservative: boxes near a frustum
+// corner can pass while lying outside.
+bool frustum_test_aabb(const Frustum *frustum, const f32 min[3], const f32 max[3]);
+
+// Whether the sphere may intersect the frustum, with the same caveat
+bool frustum_test_sphere(const Frustum *frustum, const f32 center[3], f32 radius);
+
+// Boxes tested in bulk
+#define FRUSTUM_CULL_BATCH 8
+
+// Many boxes as one array per component: centers, half extents and the radius of a sphere
+// around each center holding its contents. A box is rejected when either the box or the
+// sphere lies outside a plane, so long diagonal boxes the box test keeps can still go.
+typedef struct FrustumBoxes {
+  const f32 *center[3];
+  const f32 *extent[3];
+  const f32 *radius;
+} FrustumBoxes;
+
+// Test count boxes, FRUSTUM_CULL_BATCH at a time, setting visible[i] to 1 when box i may
+// intersect the frustum and 0 otherwise. Returns how many may.
+u32 frustum_cull_boxes(const Frustum *frustum, const FrustumBoxes *boxes, u32 count, u8 *visible);
+
+#endif // FRUSTUM_H
@@ -1,13 +1,17 @@
 #include "app.h"
 #include "camera/camera.h"
+#include "camera/frustum.h"
+#include "core/job.h"
 #include "core/log.h"
-#include "geometry/quad.h"
+#include "geometry/cdlod.h"
+#include "geometry/terrain_mesh.h"
 #include "memory/memory.h"
 #include "platform/input.h"
 #include "renderer/renderer.h"
 #include "utils/macros.h"
 
 #include <SDL3/SDL_timer.h>
+#include <string.h>
 
 AppConfig app_config_default(void) {
   return AppConfig{
@@ -28,8 +32,10 @@ Result app_init(AppContext *app, const AppConfig *config) {
   app->delta_time  = 0.0;
   app->total_time  = 0.0;
   app->frame_count = 0;
-  app->camera       = camera_default();
-  app->entity_count = 0;
+  app->camera           = camera_default();
+  app->entity_count     = 0;
+  app->pick_hit         = false;
+  app->cull_report_time = 0.0;
 
   // Initialize window system
   Result result = window_system_init();
@@ -74,9 +80,21 @@ Result app_init(AppContext *app, const AppConfig *config) {
     return RESULT_ERROR_OUT_OF_MEMORY;
   }
 
-  result = simulation_init(&app->simulation, memory_arena(&app->memory, MEMORY_ARENA_PERMANENT));
+  // Worker threads for simulation and meshing, one per spare core
+  if(!job_system_init(0, MEGABYTES(8))) {
+    LOG_ERROR("Failed to initialize job system");
+    memory_shutdown(&app->memory);
+    window_destroy(&app->window);
+    window_system_shutdown();
+    return RESULT_ERROR_GENERIC;
+  }
+
+  SimulationConfig simulation_config = simulation_config_default();
+
+  result = simulation_init(&app->simulation, &simulation_config, memory_arena(&app->memory, MEMORY_ARENA_PERMANENT));
   if(result != RESULT_SUCCESS) {
     LOG_ERROR("Failed to initialize simulation");
+    job_system_shutdown();
     memory_shutdown(&app->memory);
     window_destroy(&app->window);
     window_system_shutdown();
@@ -92,47 +110,126 @@ Result app_init(AppContext *app, const AppConfig *config) {
   if(result != RESULT_SUCCESS) {
     LOG_ERROR("Failed to initialize renderer");
     simulation_shutdown(&app->simulation);
+    job_system_shutdown();
     memory_shutdown(&app->memory);
     window_destroy(&app->window);
     window_system_shutdown();
     return result;
   }
 
-  // Create quad entity
-  Arena *perm_arena = permanent_memory(&app->memory);
-
-  Mesh *quad_mesh = ARENA_PUSH_STRUCT(perm_arena, Mesh);
-  if(!quad_mesh) {
-    LOG_ERROR("Failed to allocate quad mesh");
+  // Mesh the generated terrain in the background, one entity per tile. The tiles are uploaded
+  // from the frame loop as they finish, so the window opens before the terrain is complete.
+  Arena               *perm_arena = permanent_memory(&app->memory);
+  HeightfieldPlacement placement  = simulation_placement(&app->simulation);
+
+  SDL_SetAtomicInt(&app->terrain_jobs.pending, 0);
+  app->terrain_uploaded = 0;
+  app->terrain_pending  = NULL;
+
+  bool mesh_ok = terrain_mesh_create_async(&app->terrain,
+                                           &app->simulation.heightfield,
+                                           &placement,
+                                           perm_arena,
+                                           &app->terrain_ready,
+                                           &app->terrain_jobs);
+  app->terrain_tiles_sent = mesh_ok ? ARENA_PUSH_ARRAY(perm_arena, u64, app->terrain.tile_count) : NULL;
+  app->terrain_remeshed   = app->simulation.heightfield.version;
+  if(!mesh_ok || !app->terrain_tiles_sent || app->terrain.tile_count > (u32)MAX_ENTITIES) {
+    LOG_ERROR("Failed to create terrain mesh");
+    job_wait(&app->terrain_jobs);
     renderer_destroy(app->renderer);
     simulation_shutdown(&app->simulation);
+    job_system_shutdown();
     memory_shutdown(&app->memory);
     window_destroy(&app->window);
     window_system_shutdown();
     return RESULT_ERROR_OUT_OF_MEMORY;
   }
 
-  quad_create_arena(quad_mesh, perm_arena);
+  for(u32 tile = 0; tile < app->terrain.tile_count; ++tile) {
+    MeshHandle tile_handle = 0;
+    result                 = renderer_reserve_mesh(app->renderer, &tile_handle);
+    if(result != RESULT_SUCCESS) {
+      LOG_ERROR("Failed to reserve terrain tile %u", tile);
+      job_wait(&app->terrain_jobs);
+      renderer_destroy(app->renderer);
+      simulation_shutdown(&app->simulation);
+      job_system_shutdown();
+      memory_shutdown(&app->memory);
+      window_destroy(&app->window);
+      window_system_shutdown();
+      return result;
+    }
 
-  MeshHandle quad_handle = 0;
-  result = renderer_upload_mesh(app->renderer, quad_mesh, &quad_handle);
-  if(result != RESULT_SUCCESS) {
-    LOG_ERROR("Failed to upload quad mesh");
+    app->entities[app->entity_count++] = Entity{
+      .position    = {0.0f, 0.0f, 0.0f},
+      .scale       = {1.0f, 1.0f, 1.0f},
+      .mesh        = NULL,
+      .mesh_handle = tile_handle,
+    };
+  }
+  app->terrain_entity_count = app->entity_count;
+
+  // Index ranges for every tile LOD and stitched edge combination, built once
+  bool stitch_ok = terrain_stitch_create(&app->terrain_stitch, &app->terrain, APP_TERRAIN_TILE_LOD0_RANGE, perm_arena);
+  if(stitch_ok) {
+    result = renderer_upload_terrain_stitch(app->renderer, &app->terrain_stitch);
+  }
+  if(!stitch_ok || result != RESULT_SUCCESS) {
+    LOG_ERROR("Failed to create terrain tile LODs");
+    job_wait(&app->terrain_jobs);
     renderer_destroy(app->renderer);
     simulation_shutdown(&app->simulation);
+    job_system_shutdown();
     memory_shutdown(&app->memory);
     window_destroy(&app->window);
     window_system_shutdown();
-    return result;
+    return stitch_ok ? result : RESULT_ERROR_OUT_OF_MEMORY;
   }
 
-  app->entities[0] = Entity{
-    .position    = {0.0f, 0.0f, 0.0f},
-    .scale       = {1.0f, 1.0f, 1.0f},
-    .mesh        = quad_mesh,
-    .mesh_handle = quad_handle,
-  };
-  app->entity_count = 1;
+  // The same heightfield drawn with distance-based LOD, on by default
+  const Heightfield *heightfield = &app->simulation.heightfield;
+  CdlodGrid          lod_grid    = {};
+
+  bool lod_ok = cdlod_create(&app->terrain_lod,
+                             &app->simulation.pyramid,
+                             &placement,
+                             APP_TERRAIN_LOD0_RANGE,
+                             APP_TERRAIN_MAX_NODES,
+                             perm_arena)
+             && cdlod_grid_create(&lod_grid, perm_arena);
+  app->terrain_heights_tiles = ARENA_PUSH_ARRAY(perm_arena, u64, heightfield_tile_count(heightfield));
+  lod_ok                     = lod_ok && app->terrain_heights_tiles != NULL;
+  if(lod_ok) {
+    result = renderer_upload_cdlod_grid(app->renderer, &lod_grid);
+  }
+  if(lod_ok && result == RESULT_SUCCESS) {
+    result = renderer_upload_terrain_heights(app->renderer,
+                                             heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT),
+                                             heightfield->width,
+                                             heightfield->height);
+  }
+  if(!lod_ok || result != RESULT_SUCCESS) {
+    LOG_ERROR("Failed to create LOD terrain");
+    job_wait(&app->terrain_jobs);
+    renderer_destroy(app->renderer);
+    simulation_shutdown(&app->simulation);
+    job_system_shutdown();
+    memory_shutdown(&app->memory);
+    window_destroy(&app->window);
+    window_system_shutdown();
+    return lod_ok ? result : RESULT_ERROR_OUT_OF_MEMORY;
+  }
+  app->terrain_lod_enabled     = true;
+  app->terrain_heights_version = heightfield->layer_version[HEIGHTFIELD_LAYER_HEIGHT];
+  memcpy(app->terrain_heights_tiles,
+         heightfield->tile_version[HEIGHTFIELD_LAYER_HEIGHT],
+         heightfield_tile_count(heightfield) * sizeof(u64));
+
+  // Start above the terrain looking down at its center
+  app->camera.position = glm::vec3(0.0f, 48.0f, 96.0f);
+  app->camera.pitch    = -25.0f;
+  camera_update_vectors(app->camera);
 
   app->state = APP_STATE_RUNNING;
   LOG_INFO("Application initialized successfully");
@@ -148,7 +245,10 @@ void app_shutdown(AppContext *app) {
     app->renderer = NULL;
   }
 
+  // Tiles still meshing read the heightfield and write into the permanent arena
+  job_wait(&app->terrain_jobs);
   simulation_shutdown(&app->simulation);
+  job_system_shutdown();
 
   // Destroy arenas (frees all app-lifetime allocations)
   memory_shutdown(&app->memory);
@@ -159,6 +259,222 @@ void app_shutdown(AppContext *app) {
   LOG_INFO("Application shutdown complete");
 }
 
+// Send the height tiles that changed since their last upload, each run of neighbouring tiles
+// in a row as one rectangle. Runs that no longer fit this frame's staging memory wait for the
+// next frame.
+static Result app_upload_terrain_heights(AppContext *app) {
+  const Heightfield *heightfield = &app->simulation.heightfield;
+  const u64          version     = heightfield->layer_version[HEIGHTFIELD_LAYER_HEIGHT];
+  if(version == app->terrain_heights_version) {
+    return RESULT_SUCCESS;
+  }
+
+  const f32 *heights  = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  bool       complete = true;
+  for(u32 ty = 0; ty < heightfield->tiles_y && complete; ++ty) {
+    const u64 *changed  = heightfield->tile_version[HEIGHTFIELD_LAYER_HEIGHT] + ty * heightfield->tiles_x;
+    u64       *uploaded = app->terrain_heights_tiles + ty * heightfield->tiles_x;
+    u32        y0       = ty * HEIGHTFIELD_TILE_SIZE;
+    u32        y1       = MIN(y0 + HEIGHTFIELD_TILE_SIZE, heightfield->height);
+
+    for(u32 tx = 0; tx < heightfield->tiles_x;) {
+      if(changed[tx] == uploaded[tx]) {
+        tx++;
+        continue;
+      }
+      u32 end = tx + 1;
+      while(end < heightfield->tiles_x && changed[end] != uploaded[end]) {
+        end++;
+      }
+
+      Result result = renderer_update_terrain_heights(app->renderer,
+                                                      heights,
+                                                      tx * HEIGHTFIELD_TILE_SIZE,
+                                                      y0,
+                                                      MIN(end * HEIGHTFIELD_TILE_SIZE, heightfield->width),
+                                                      y1);
+      if(result == RESULT_ERROR_OUT_OF_MEMORY) {
+        complete = false;
+        break;
+      }
+      if(result != RESULT_SUCCESS) {
+        return result;
+      }
+      memcpy(uploaded + tx, changed + tx, (end - tx) * sizeof(u64));
+      tx = end;
+    }
+  }
+
+  if(complete) {
+    app->terrain_heights_version = version;
+  }
+  return RESULT_SUCCESS;
+}
+
+// Send changed heights and select the LOD terrain's nodes for this frame
+static Result app_update_terrain_lod(AppContext *app) {
+  Result result = app_upload_terrain_heights(app);
+  if(result != RESULT_SUCCESS) {
+    return result;
+  }
+
+  u32 width  = 0;
+  u32 height = 0;
+  window_get_size(&app->window, &width, &height);
+  const f32 aspect = height > 0 ? (f32)width / (f32)height : 1.0f;
+
+  glm::mat4 view_proj = projection_matrix(app->camera, aspect) * view_matrix(app->camera);
+  f32       eye[3]    = {app->camera.position.x, app->camera.position.y, app->camera.position.z};
+  Frustum   frustum   = {};
+  frustum_from_matrix(&frustum, &view_proj[0][0]);
+  cdlod_select(&app->terrain_lod, &frustum, eye);
+  return RESULT_SUCCESS;
+}
+
+// Pick the tiles' LODs for this frame and hand them to the renderer
+static void app_update_terrain_tiles(AppContext *app) {
+  f32 eye[3] = {app->camera.position.x, app->camera.position.y, app->camera.position.z};
+  terrain_stitch_select(&app->terrain_stitch, &app->terrain, eye);
+
+  const TerrainStitch *stitch = &app->terrain_stitch;
+  for(u32 tile = 0; tile < app->terrain_entity_count; ++tile) {
+    renderer_set_terrain_tile_lod(app->renderer,
+                                  app->entities[tile].mesh_handle,
+                                  stitch->tile_set[tile],
+                                  stitch->tile_lod[tile],
+                                  stitch->tile_stitch[tile]);
+  }
+}
+
+// Upload the tiles the meshing jobs have finished, up to the frame's byte budget. A tile that
+// does not fit the frame's staging memory waits for the next frame.
+static Result app_stream_terrain(AppContext *app) {
+  u64 uploaded_bytes = 0;
+  while(uploaded_bytes < APP_TERRAIN_UPLOAD_BUDGET) {
+    void *value = app->terrain_pending;
+    if(!value && !mpsc_queue_pop(&app->terrain_ready, &value)) {
+      break;
+    }
+    TerrainTile *tile  = (TerrainTile *)value;
+    u32          index = (u32)(tile - app->terrain.tiles);
+
+    Result result = renderer_upload_terrain_tile_to(app->renderer, tile, app->entities[index].mesh_handle);
+    if(result == RESULT_ERROR_OUT_OF_MEMORY) {
+      app->terrain_pending = tile;
+      break;
+    }
+    if(result != RESULT_SUCCESS) {
+      LOG_ERROR("Failed to upload terrain tile %u", index);
+      return result;
+    }
+    app->terrain_pending           = NULL;
+    app->terrain_tiles_sent[index] = tile->version;
+    uploaded_bytes += (u64)tile->vertex_count * sizeof(TerrainVertex)
+                    + (u64)tile->index_count * mesh_index_size(tile->index_type);
+    app->terrain_uploaded++;
+  }
+
+  if(app->terrain_uploaded == app->terrain.tile_count) {
+    LOG_INFO("Terrain streamed in: %u tiles", app->terrain_uploaded);
+  }
+  return RESULT_SUCCESS;
+}
+
+// Re-mesh the tiles whose heights or water the simulation changed, a batch within the upload
+// budget at a time, and send the rebuilt vertices. The next batch waits until the last one
+// has been sent, so the cluster bounds the tiles share with the renderer stay at most a
+// frame ahead of the vertices it draws.
+static Result app_refresh_terrain_tiles(AppContext *app) {
+  const Heightfield *heightfield = &app->simulation.heightfield;
+  TerrainMesh       *terrain     = &app->terrain;
+
+  bool sending = false;
+  for(u32 tile = 0; tile < terrain->tile_count && !sending; ++tile) {
+    sending = app->terrain_tiles_sent[tile] != terrain->tiles[tile].version;
+  }
+
+  u64 changed = MAX(heightfield->layer_version[HEIGHTFIELD_LAYER_HEIGHT],
+                    heightfield->layer_version[HEIGHTFIELD_LAYER_WATER]);
+  if(!sending && changed > app->terrain_remeshed) {
+    ArenaTemp scratch = arena_scratch_begin();
+    u32      *stale   = ARENA_PUSH_ARRAY(scratch.arena, u32, terrain->tile_count);
+    if(!stale) {
+      LOG_ERROR("Failed to allocate the stale terrain tile list");
+      arena_temp_end(scratch);
+      return RESULT_ERROR_OUT_OF_MEMORY;
+    }
+
+    u32  count    = 0;
+    u64  bytes    = 0;
+    bool complete = true;
+    for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+      if(!terrain_mesh_tile_stale(terrain, heightfield, tile)) {
+        continue;
+      }
+      if(bytes >= APP_TERRAIN_UPLOAD_BUDGET) {
+        complete = false;
+        break;
+      }
+      stale[count++] = tile;
+      bytes += (u64)terrain->tiles[tile].vertex_count * sizeof(TerrainVertex);
+    }
+
+    // A widened height range re-quantizes every tile, including the ones whose source is unchanged
+    HeightfieldPlacement placement = simulation_placement(&app->simulation);
+    if(terrain_mesh_update_tiles(terrain, heightfield, &placement, stale, count)) {
+      memset(app->terrain_tiles_sent, 0xff, terrain->tile_count * sizeof(u64));
+      complete = true;
+    }
+    arena_temp_end(scratch);
+    if(complete) {
+      app->terrain_remeshed = changed;
+    }
+  }
+
+  // As many rebuilt tiles as fit this frame's staging memory, the rest in later frames
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    if(app->terrain_tiles_sent[tile] == terrain->tiles[tile].version) {
+      continue;
+    }
+    Result result = renderer_update_terrain_tile(app->renderer, &terrain->tiles[tile], app->entities[tile].mesh_handle);
+    if(result == RESULT_ERROR_OUT_OF_MEMORY) {
+      break;
+    }
+    if(result != RESULT_SUCCESS) {
+      LOG_ERROR("Failed to update terrain tile %u", tile);
+      return result;
+    }
+    app->terrain_tiles_sent[tile] = terrain->tiles[tile].version;
+  }
+  return RESULT_SUCCESS;
+}
+
+// Cast a ray from the camera through the cursor at the terrain
+static void app_pick_terrain(AppContext *app) {
+  f64 mouse_x = 0.0;
+  f64 mouse_y = 0.0;
+  u32 width   = 0;
+  u32 height  = 0;
+  input_get_mouse_position(&mouse_x, &mouse_y);
+  window_get_size(&app->window, &width, &height);
+  if(width == 0 || height == 0) {
+    return;
+  }
+
+  f32       x         = 2.0f * (f32)mouse_x / (f32)width - 1.0f;
+  f32       y         = 2.0f * (f32)mouse_y / (f32)height - 1.0f;
+  glm::vec3 direction = camera_view_ray(app->camera, (f32)width / (f32)height, x, y);
+  f32       origin[3] = {app->camera.position.x, app->camera.position.y, app->camera.position.z};
+  f32       dir[3]    = {direction.x, direction.y, direction.z};
+  f32       hit[3]    = {};
+
+  app->pick_hit = simulation_pick(&app->simulation, origin, dir, APP_PICK_DISTANCE, hit);
+  if(app->pick_hit) {
+    app->pick_position = glm::vec3(hit[0], hit[1], hit[2]);
+    LOG_DEBUG("Picked terrain at (%.2f, %.2f, %.2f)", hit[0], hit[1], hit[2]);
+  }
+}
+
 void app_run(AppContext *app) {
   LOG_INFO("Starting main loop");
 
@@ -233,10 +549,54 @@ void app_run(AppContext *app) {
 
     camera_update_vectors(app->camera);
 
-    // simulation_update(&app->simulation, app->delta_time);
+    // The simulation changes the heights the meshing jobs read, so it waits for the last tile
+    bool terrain_streaming = app->terrain_uploaded < app->terrain.tile_count;
+    if(terrain_streaming) {
+      result = app_stream_terrain(app);
+      if(result != RESULT_SUCCESS) {
+        app_request_shutdown(app);
+        continue;
+      }
+    } else {
+      simulation_update(&app->simulation, app->delta_time);
+    }
+
+    // Picking runs after the update so it sees this frame's terrain
+    if(input_mouse_pressed(MOUSE_BUTTON_LEFT)) {
+      app_pick_terrain(app);
+    }
+
+    // F2 switches between the CDLOD terrain and the stitched tiles
+    if(input_key_pressed(KEY_F2)) {
+      app->terrain_lod_enabled = !app->terrain_lod_enabled;
+      LOG_INFO("Terrain LOD %s", app->terrain_lod_enabled ? "enabled" : "disabled");
+    }
+
+    const CdlodTree *terrain_lod  = NULL;
+    const Entity    *entities     = app->entities;
+    u32              entity_count = app->entity_count;
+    if(app->terrain_lod_enabled) {
+      result = app_update_terrain_lod(app);
+      if(result != RESULT_SUCCESS) {
+        LOG_ERROR("Terrain LOD update failed: %d", result);
+        app_request_shutdown(app);
+        continue;
+      }
+      terrain_lod = &app->terrain_lod;
+      entities += app->terrain_entity_count;
+      entity_count -= app->terrain_entity_count;
+    } else if(!terrain_streaming) {
+      result = app_refresh_terrain_tiles(app);
+      if(result != RESULT_SUCCESS) {
+        LOG_ERROR("Terrain tile refresh failed: %d", result);
+        app_request_shutdown(app);
+        continue;
+      }
+      app_update_terrain_tiles(app);
+    }
 
     // Render frame
-    result = renderer_draw(app->renderer, &app->camera, app->entities, app->entity_count);
+    result = renderer_draw(app->renderer, &app->camera, terrain_lod, entities, entity_count);
     if(result != RESULT_SUCCESS) {
       LOG_ERROR("Renderer frame failed: %d", result);
       app_request_shutdown(app);
@@ -245,6 +605,24 @@ void app_run(AppContext *app) {
 
     app->frame_count++;
 
+    // Report culling for what was drawn: CDLOD nodes replace the terrain entities
+    if(app->total_time >= app->cull_report_time) {
+      if(terrain_lod) {
+        LOG_DEBUG("Culled %u of %u terrain nodes (%.0f%%)",
+                  terrain_lod->culled,
+                  terrain_lod->visited,
+                  terrain_lod->visited > 0 ? 100.0 * terrain_lod->culled / terrain_lod->visited : 0.0);
+      }
+      RendererCullStats cull = renderer_cull_stats(app->renderer);
+      if(cull.entity_count > 0) {
+        LOG_DEBUG("Culled %u of %u entities (%.0f%%)",
+                  cull.culled_count,
+                  cull.entity_count,
+                  100.0 * cull.culled_count / cull.entity_count);
+      }
+      app->cull_report_time = app->total_time + APP_CULL_REPORT_INTERVAL;
+    }
+
     // Reset scroll
     input_reset_scroll();
   }
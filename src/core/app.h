@@ -5,12 +5,34 @@
 #include "platform/window.h"
 #include "foundation/result.h"
 #include "simulation/simulation.h"
+#include "utils/macros.h"
 #include "utils/types.h"
 #include "camera/camera.h"
 #include "core/entity.h"
+#include "core/job.h"
+#include "core/mpsc_queue.h"
+#include "geometry/cdlod.h"
+#include "geometry/terrain_mesh.h"
+#include "geometry/terrain_stitch.h"
 
 const i32 MAX_ENTITIES = 1024;
 
+// Picks reach as far as the renderer's far plane
+const f32 APP_PICK_DISTANCE = 100.0f;
+
+// World distance drawn at full resolution by the CDLOD terrain, and its node budget
+const f32 APP_TERRAIN_LOD0_RANGE = 128.0f;
+const u32 APP_TERRAIN_MAX_NODES  = 4096;
+
+// World distance drawn at full resolution by the terrain tiles
+const f32 APP_TERRAIN_TILE_LOD0_RANGE = 96.0f;
+
+// Terrain tile bytes uploaded per frame while the tiles stream in; at least one tile always goes
+const u64 APP_TERRAIN_UPLOAD_BUDGET = MEGABYTES(1);
+
+// Seconds between reports of how many entities the renderer culled
+const f64 APP_CULL_REPORT_INTERVAL = 1.0;
+
 // Forward declarations
 typedef struct Renderer Renderer;
 
@@ -40,10 +62,26 @@ typedef struct AppContext {
   Camera          camera;
   Entity          entities[MAX_ENTITIES];
   u32             entity_count;
+  TerrainMesh     terrain;              // Tile meshes of the generated heightfield, the first entities
+  u32             terrain_entity_count; // Entities holding terrain tiles
+  TerrainStitch   terrain_stitch;       // LODs of the tiles
+  MpscQueue       terrain_ready;        // Tiles meshed by jobs, waiting for upload
+  TerrainTile    *terrain_pending;      // Taken from terrain_ready but not yet uploaded
+  JobCounter      terrain_jobs;         // Tile meshing jobs still running
+  u32             terrain_uploaded;     // Tiles uploaded so far; all of them before the simulation runs
+  u64            *terrain_tiles_sent;   // Version of each tile's vertices last sent to the renderer
+  u64             terrain_remeshed;     // Heightfield version every tile has been rebuilt for
+  CdlodTree       terrain_lod;          // Drawn instead of the tiles while terrain_lod_enabled
+  bool            terrain_lod_enabled;
+  u64             terrain_heights_version; // Height layer version fully uploaded for terrain_lod
+  u64            *terrain_heights_tiles;   // Height tile versions uploaded for terrain_lod
   SimulationState simulation;
+  glm::vec3       pick_position; // Terrain point under the cursor at the last left click
+  bool            pick_hit;
   f64             delta_time;
   f64             total_time;
   u64             frame_count;
+  f64             cull_report_time; // total_time of the next cull report
 } AppContext;
 
 // Create default app config
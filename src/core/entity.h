@@ -10,7 +10,7 @@ typedef u32 MeshHandle;
 struct Entity {
   glm::vec3  position{0.0f, 0.0f, 0.0f};
   glm::vec3  scale{1.0f, 1.0f, 1.0f};
-  Mesh      *mesh;
+  Mesh      *mesh; // CPU-side geometry, NULL for terrain tiles
   MeshHandle mesh_handle;
 };
 
@@ -0,0 +1,227 @@
+#include "job.h"
+#include "core/log.h"
+#include "utils/macros.h"
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+typedef struct Job {
+  JobFn       fn;
+  void       *user;
+  u32         begin;
+  u32         end;
+  JobCounter *counter;
+} Job;
+
+typedef struct JobSystem {
+  SDL_Thread    *threads[JOB_MAX_WORKERS];
+  Arena          scratch[JOB_MAX_WORKERS + 1]; // Index 0 belongs to the initializing thread
+  u32            scratch_count;
+  u32            worker_count;
+  SDL_Mutex     *mutex;
+  SDL_Condition *work_available;
+  SDL_Condition *work_finished;
+  Job            queue[JOB_QUEUE_SIZE]; // Ring buffer guarded by mutex
+  u32            head;
+  u32            count;
+  bool           quit;
+  bool           running;
+} JobSystem;
+
+static JobSystem g_jobs = {};
+
+// 0 on the initializing thread, 1..worker_count on workers
+static thread_local u32 g_job_worker_index = 0;
+
+// Pop one job; the mutex must be held
+static bool job_pop_locked(Job *out) {
+  if(g_jobs.count == 0) {
+    return false;
+  }
+  *out        = g_jobs.queue[g_jobs.head];
+  g_jobs.head = (g_jobs.head + 1) % JOB_QUEUE_SIZE;
+  g_jobs.count--;
+  return true;
+}
+
+static void job_execute(const Job *job) {
+  job->fn(job->user, job->begin, job->end, g_job_worker_index);
+  if(job->counter && SDL_AddAtomicInt(&job->counter->pending, -1) == 1) {
+    // Wake waiters; taking the lock orders this against a waiter about to sleep
+    SDL_LockMutex(g_jobs.mutex);
+    SDL_BroadcastCondition(g_jobs.work_finished);
+    SDL_UnlockMutex(g_jobs.mutex);
+  }
+}
+
+static int job_worker_main(void *data) {
+  g_job_worker_index = (u32)(uintptr_t)data;
+
+  for(;;) {
+    SDL_LockMutex(g_jobs.mutex);
+    while(g_jobs.count == 0 && !g_jobs.quit) {
+      SDL_WaitCondition(g_jobs.work_available, g_jobs.mutex);
+    }
+    if(g_jobs.quit) {
+      SDL_UnlockMutex(g_jobs.mutex);
+      break;
+    }
+
+    Job job;
+    job_pop_locked(&job);
+    SDL_UnlockMutex(g_jobs.mutex);
+
+    job_execute(&job);
+  }
+
+  return 0;
+}
+
+bool job_system_init(u32 worker_count, size_t scratch_size) {
+  if(g_jobs.running) {
+    LOG_WARN("Job system already initialized");
+    return true;
+  }
+
+  g_jobs = JobSystem{};
+  if(worker_count == 0) {
+    i32 cores    = SDL_GetNumLogicalCPUCores();
+    worker_count = cores > 1 ? (u32)(cores - 1) : 0;
+  }
+  worker_count = MIN(worker_count, (u32)JOB_MAX_WORKERS);
+
+  g_jobs.mutex          = SDL_CreateMutex();
+  g_jobs.work_available = SDL_CreateCondition();
+  g_jobs.work_finished  = SDL_CreateCondition();
+  if(!g_jobs.mutex || !g_jobs.work_available || !g_jobs.work_finished) {
+    LOG_ERROR("Failed to create job system synchronization primitives");
+    job_system_shutdown();
+    return false;
+  }
+
+  for(u32 i = 0; i <= worker_count; ++i) {
+    g_jobs.scratch[i] = arena_create(scratch_size);
+    if(!g_jobs.scratch[i].base) {
+      LOG_ERROR("Failed to create scratch arena for worker %u", i);
+      job_system_shutdown();
+      return false;
+    }
+    g_jobs.scratch_count++;
+  }
+
+  g_jobs.running     = true;
+  g_job_worker_index = 0;
+  for(u32 i = 0; i < worker_count; ++i) {
+    g_jobs.threads[i] = SDL_CreateThread(job_worker_main, "job_worker", (void *)(uintptr_t)(i + 1));
+    if(!g_jobs.threads[i]) {
+      LOG_WARN("Failed to start job worker %u, continuing with %u", i + 1, i);
+      break;
+    }
+    g_jobs.worker_count++;
+  }
+
+  LOG_INFO("Job system initialized: %u workers", g_jobs.worker_count);
+  return true;
+}
+
+void job_system_shutdown(void) {
+  if(g_jobs.mutex) {
+    SDL_LockMutex(g_jobs.mutex);
+    g_jobs.quit = true;
+    SDL_BroadcastCondition(g_jobs.work_available);
+    SDL_UnlockMutex(g_jobs.mutex);
+  }
+
+  for(u32 i = 0; i < g_jobs.worker_count; ++i) {
+    SDL_WaitThread(g_jobs.threads[i], NULL);
+  }
+
+  for(u32 i = 0; i < g_jobs.scratch_count; ++i) {
+    arena_destroy(&g_jobs.scratch[i]);
+  }
+
+  if(g_jobs.work_finished) {
+    SDL_DestroyCondition(g_jobs.work_finished);
+  }
+  if(g_jobs.work_available) {
+    SDL_DestroyCondition(g_jobs.work_available);
+  }
+  if(g_jobs.mutex) {
+    SDL_DestroyMutex(g_jobs.mutex);
+  }
+
+  g_jobs = JobSystem{};
+}
+
+u32 job_thread_count(void) { return g_jobs.running ? g_jobs.worker_count + 1 : 1; }
+
+u32 job_current_worker(void) { return g_job_worker_index; }
+
+Arena *job_worker_scratch(u32 worker) {
+  if(!g_jobs.running || worker >= g_jobs.scratch_count) {
+    return arena_scratch_get();
+  }
+  return &g_jobs.scratch[worker];
+}
+
+void job_submit(JobFn fn, void *user, u32 begin, u32 end, JobCounter *counter) {
+  Job job = {fn, user, begin, end, counter};
+  if(counter) {
+    SDL_AddAtomicInt(&counter->pending, 1);
+  }
+
+  if(g_jobs.running && g_jobs.worker_count > 0) {
+    SDL_LockMutex(g_jobs.mutex);
+    if(g_jobs.count < JOB_QUEUE_SIZE) {
+      g_jobs.queue[(g_jobs.head + g_jobs.count) % JOB_QUEUE_SIZE] = job;
+      g_jobs.count++;
+      SDL_SignalCondition(g_jobs.work_available);
+      SDL_UnlockMutex(g_jobs.mutex);
+      return;
+    }
+    SDL_UnlockMutex(g_jobs.mutex);
+  }
+
+  job_execute(&job);
+}
+
+void job_wait(JobCounter *counter) {
+  while(SDL_GetAtomicInt(&counter->pending) > 0) {
+    if(!g_jobs.running) {
+      // Every job ran inline, so nothing can still be pending
+      break;
+    }
+
+    SDL_LockMutex(g_jobs.mutex);
+    Job job;
+    if(job_pop_locked(&job)) {
+      SDL_UnlockMutex(g_jobs.mutex);
+      job_execute(&job);
+      continue;
+    }
+
+    // Nothing left to help with: sleep until some job of any batch finishes
+    if(SDL_GetAtomicInt(&counter->pending) > 0) {
+      SDL_WaitCondition(g_jobs.work_finished, g_jobs.mutex);
+    }
+    SDL_UnlockMutex(g_jobs.mutex);
+  }
+}
+
+void job_parallel_for(u32 count, u32 grain, JobFn fn, void *user) {
+  if(count == 0) {
+    return;
+  }
+
+  grain = MAX(grain, 1u);
+  if(job_thread_count() == 1 || count <= grain) {
+    fn(user, 0, count, g_job_worker_index);
+    return;
+  }
+
+  JobCounter counter = {};
+  for(u32 begin = 0; begin < count; begin += grain) {
+    job_submit(fn, user, begin, MIN(begin + grain, count), &counter);
+  }
+  job_wait(&counter);
+}
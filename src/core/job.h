@@ -0,0 +1,48 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "memory/arena.h"
+#include "utils/types.h"
+#include <SDL3/SDL_atomic.h>
+
+// Worker-thread pool for data-parallel simulation and meshing work.
+// Jobs are ranges [begin, end) of a caller-defined index space. The calling thread
+// helps execute jobs while it waits, so nesting a wait inside a job is safe.
+
+#define JOB_MAX_WORKERS 32
+#define JOB_QUEUE_SIZE  1024
+
+// worker identifies the executing thread (0 is the thread that called job_system_init)
+// and selects its scratch arena
+typedef void (*JobFn)(void *user, u32 begin, u32 end, u32 worker);
+
+// Number of outstanding jobs of a batch; zero once everything has finished
+typedef struct JobCounter {
+  SDL_AtomicInt pending;
+} JobCounter;
+
+// Start worker_count background threads (0 picks one per logical core minus the caller).
+// Each thread, including the caller, gets a scratch arena of scratch_size bytes.
+bool job_system_init(u32 worker_count, size_t scratch_size);
+void job_system_shutdown(void);
+
+// Threads that execute jobs, counting the caller; 1 when the system is not running
+u32 job_thread_count(void);
+
+// Index of the current thread as passed to JobFn
+u32 job_current_worker(void);
+
+// Scratch arena owned by a worker. Falls back to the global scratch arena when the
+// system is not running.
+Arena *job_worker_scratch(u32 worker);
+
+// Queue fn over [begin, end). Runs inline when the system is not running or the queue is full.
+void job_submit(JobFn fn, void *user, u32 begin, u32 end, JobCounter *counter);
+
+// Block until the counter reaches zero, running queued jobs in the meantime
+void job_wait(JobCounter *counter);
+
+// Split [0, count) into chunks of `grain` indices, run them across all threads and wait
+void job_parallel_for(u32 count, u32 grain, JobFn fn, void *user);
+
+#endif // JOB_H
@@ -0,0 +1,58 @@
+#include "mpsc_queue.h"
+#include "core/log.h"
+
+bool mpsc_queue_create(MpscQueue *queue, u32 capacity, Arena *arena) {
+  *queue      = MpscQueue{};
+  u32 rounded = 1;
+  while(rounded < capacity) {
+    rounded <<= 1;
+  }
+
+  queue->slots = ARENA_PUSH_ARRAY(arena, MpscQueueSlot, rounded);
+  if(!queue->slots) {
+    LOG_ERROR("Failed to allocate queue of %u entries", rounded);
+    return false;
+  }
+
+  // A slot is free for the producer whose position equals its sequence, and readable once
+  // the sequence has moved one past it
+  for(u32 i = 0; i < rounded; ++i) {
+    SDL_SetAtomicU32(&queue->slots[i].sequence, i);
+    queue->slots[i].value = NULL;
+  }
+  queue->capacity = rounded;
+  SDL_SetAtomicU32(&queue->tail, 0);
+  queue->head = 0;
+  return true;
+}
+
+bool mpsc_queue_push(MpscQueue *queue, void *value) {
+  u32 mask = queue->capacity - 1;
+  for(;;) {
+    u32            position = SDL_GetAtomicU32(&queue->tail);
+    MpscQueueSlot *slot     = &queue->slots[position & mask];
+    i32            lag      = (i32)(SDL_GetAtomicU32(&slot->sequence) - position);
+    if(lag < 0) {
+      // The consumer has not read this slot since the last lap
+      return false;
+    }
+    if(lag == 0 && SDL_CompareAndSwapAtomicU32(&queue->tail, position, position + 1)) {
+      slot->value = value;
+      SDL_SetAtomicU32(&slot->sequence, position + 1);
+      return true;
+    }
+    // Another producer claimed the slot first; retry at the new tail
+  }
+}
+
+bool mpsc_queue_pop(MpscQueue *queue, void **out_value) {
+  MpscQueueSlot *slot = &queue->slots[queue->head & (queue->capacity - 1)];
+  if(SDL_GetAtomicU32(&slot->sequence) != queue->head + 1) {
+    return false;
+  }
+
+  *out_value = slot->value;
+  SDL_SetAtomicU32(&slot->sequence, queue->head + queue->capacity);
+  queue->head++;
+  return true;
+}
@@ -0,0 +1,35 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include "memory/arena.h"
+#include "utils/types.h"
+#include <SDL3/SDL_atomic.h>
+
+// Bounded lock-free queue of pointers with any number of producer threads and a single
+// consumer, for handing finished work from jobs back to the main thread. Every slot carries
+// a sequence number: producers claim a slot by advancing the shared tail, fill it and then
+// publish it by bumping its sequence; the consumer only reads slots published that way.
+// Neither side ever blocks or takes a lock.
+
+typedef struct MpscQueueSlot {
+  SDL_AtomicU32 sequence;
+  void         *value;
+} MpscQueueSlot;
+
+typedef struct MpscQueue {
+  MpscQueueSlot *slots;
+  u32            capacity; // Power of two
+  SDL_AtomicU32  tail;     // Next slot for producers to claim
+  u32            head;     // Next slot for the consumer to read; consumer thread only
+} MpscQueue;
+
+// Allocate room for at least capacity entries, rounded up to a power of two
+bool mpsc_queue_create(MpscQueue *queue, u32 capacity, Arena *arena);
+
+// Any thread. Returns false, without waiting, when the queue is full.
+bool mpsc_queue_push(MpscQueue *queue, void *value);
+
+// Consumer thread only. Returns false when nothing has been published yet.
+bool mpsc_queue_pop(MpscQueue *queue, void **out_value);
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,239 @@
+#include "cdlod.h"
+#include "core/log.h"
+#include "geometry/mesh_optimize.h"
+#include "utils/macros.h"
+
+typedef struct CdlodBox {
+  f32 min[3];
+  f32 max[3];
+} CdlodBox;
+
+// Heightfield cells per side of a node
+static u32 cdlod_node_cells(u32 lod) { return (u32)CDLOD_GRID_CELLS << lod; }
+
+// World bounds of a node, clipped to the heightfield. False when the node lies outside it.
+static bool cdlod_node_box(const CdlodTree *tree, u32 x, u32 y, u32 lod, CdlodBox *out) {
+  if(x >= tree->width - 1 || y >= tree->height - 1) {
+    return false;
+  }
+
+  u32 x1 = MIN(x + cdlod_node_cells(lod), tree->width - 1);
+  u32 y1 = MIN(y + cdlod_node_cells(lod), tree->height - 1);
+  f32 lo = 0.0f;
+  f32 hi = 0.0f;
+  height_pyramid_bounds(tree->pyramid, x, y, x1, y1, &lo, &hi);
+
+  const HeightfieldPlacement *placement = &tree->placement;
+  f32                         cell      = placement->cell_size;
+
+  *out = CdlodBox{
+    .min = {placement->origin_x + (f32)x * cell, lo, placement->origin_z + (f32)y * cell},
+    .max = {placement->origin_x + (f32)x1 * cell, hi, placement->origin_z + (f32)y1 * cell},
+  };
+  return true;
+}
+
+static bool cdlod_box_in_sphere(const CdlodBox *box, const f32 eye[3], f32 radius) {
+  f32 distance_2 = 0.0f;
+  for(u32 c = 0; c < 3; ++c) {
+    f32 d = 0.0f;
+    if(eye[c] < box->min[c]) {
+      d = box->min[c] - eye[c];
+    } else if(eye[c] > box->max[c]) {
+      d = eye[c] - box->max[c];
+    }
+    distance_2 += d * d;
+  }
+  return distance_2 <= radius * radius;
+}
+
+static void cdlod_add(CdlodTree *tree, u32 x, u32 y, u32 lod, u32 quadrants) {
+  if(tree->node_count < tree->node_capacity) {
+    tree->nodes[tree->node_count++] = CdlodNode{
+      .x         = x,
+      .y         = y,
+      .lod       = lod,
+      .quadrants = quadrants,
+    };
+  }
+}
+
+// Select a node already known to be in the frustum. Children still within the finer LOD's
+// range are refined; the quadrants of the others are drawn at this node's LOD.
+static void cdlod_select_node(CdlodTree      *tree,
+                              const Frustum  *frustum,
+                              const f32       eye[3],
+                              u32             x,
+                              u32             y,
+                              u32             lod,
+                              const CdlodBox *box) {
+  if(lod == 0 || !cdlod_box_in_sphere(box, eye, tree->ranges[lod - 1])) {
+    cdlod_add(tree, x, y, lod, CDLOD_QUADRANTS_ALL);
+    return;
+  }
+
+  u32 half      = cdlod_node_cells(lod - 1);
+  u32 quadrants = 0;
+  for(u32 q = 0; q < 4; ++q) {
+    u32      cx = x + (q & 1) * half;
+    u32      cy = y + (q >> 1) * half;
+    CdlodBox child;
+    if(!cdlod_node_box(tree, cx, cy, lod - 1, &child)) {
+      continue;
+    }
+
+    tree->visited++;
+    if(!frustum_test_aabb(frustum, child.min, child.max)) {
+      tree->culled++;
+      continue;
+    }
+    if(cdlod_box_in_sphere(&child, eye, tree->ranges[lod - 1])) {
+      cdlod_select_node(tree, frustum, eye, cx, cy, lod - 1, &child);
+    } else {
+      quadrants |= 1u << q;
+    }
+  }
+
+  if(quadrants) {
+    cdlod_add(tree, x, y, lod, quadrants);
+  }
+}
+
+bool cdlod_create(CdlodTree                  *tree,
+                  const HeightPyramid        *pyramid,
+                  const HeightfieldPlacement *placement,
+                  f32                         lod0_range,
+                  u32                         node_capacity,
+                  Arena                      *arena) {
+  *tree = CdlodTree{};
+  if(pyramid->width < 2 || pyramid->height < 2 || lod0_range <= 0.0f) {
+    LOG_ERROR("Invalid CDLOD setup (%ux%u samples, LOD 0 range %.2f)", pyramid->width, pyramid->height, lod0_range);
+    return false;
+  }
+
+  tree->nodes = ARENA_PUSH_ARRAY(arena, CdlodNode, node_capacity);
+  if(!tree->nodes) {
+    LOG_ERROR("Failed to allocate CDLOD selection (%u nodes)", node_capacity);
+    return false;
+  }
+
+  tree->pyramid       = pyramid;
+  tree->placement     = *placement;
+  tree->width         = pyramid->width;
+  tree->height        = pyramid->height;
+  tree->node_capacity = node_capacity;
+
+  // Enough LODs for a single root to cover the heightfield
+  u32 cells       = MAX(tree->width, tree->height) - 1;
+  tree->lod_count = 1;
+  while(tree->lod_count < CDLOD_MAX_LODS && cdlod_node_cells(tree->lod_count - 1) < cells) {
+    tree->lod_count++;
+  }
+  u32 root_cells = cdlod_node_cells(tree->lod_count - 1);
+  tree->roots_x  = (tree->width - 2) / root_cells + 1;
+  tree->roots_y  = (tree->height - 2) / root_cells + 1;
+
+  f32 previous = 0.0f;
+  for(u32 lod = 0; lod < tree->lod_count; ++lod) {
+    tree->ranges[lod]      = lod0_range * (f32)(1u << lod);
+    tree->morph_start[lod] = previous + (tree->ranges[lod] - previous) * CDLOD_MORPH_START;
+    previous               = tree->ranges[lod];
+  }
+
+  LOG_DEBUG("CDLOD tree: %u LODs, %ux%u roots, LOD 0 range %.2f", tree->lod_count, tree->roots_x, tree->roots_y,
+            lod0_range);
+  return true;
+}
+
+u32 cdlod_select(CdlodTree *tree, const Frustum *frustum, const f32 eye[3]) {
+  tree->node_count = 0;
+  tree->visited    = 0;
+  tree->culled     = 0;
+
+  u32 root_lod   = tree->lod_count - 1;
+  u32 root_cells = cdlod_node_cells(root_lod);
+  for(u32 ry = 0; ry < tree->roots_y; ++ry) {
+    for(u32 rx = 0; rx < tree->roots_x; ++rx) {
+      CdlodBox box;
+      if(!cdlod_node_box(tree, rx * root_cells, ry * root_cells, root_lod, &box)) {
+        continue;
+      }
+
+      tree->visited++;
+      if(frustum_test_aabb(frustum, box.min, box.max)) {
+        cdlod_select_node(tree, frustum, eye, rx * root_cells, ry * root_cells, root_lod, &box);
+      } else {
+        tree->culled++;
+      }
+    }
+  }
+  return tree->node_count;
+}
+
+bool cdlod_grid_create(CdlodGrid *grid, Arena *arena) {
+  const u32 side = CDLOD_GRID_CELLS + 1;
+  const u32 half = CDLOD_GRID_CELLS / 2;
+
+  *grid                = CdlodGrid{};
+  grid->vertex_count   = side * side;
+  grid->quadrant_count = half * half * 6;
+  grid->index_count    = grid->quadrant_count * 4;
+  grid->vertices       = ARENA_PUSH_ARRAY(arena, GridVertex, grid->vertex_count);
+  grid->indices        = ARENA_PUSH_ARRAY(arena, u16, grid->index_count);
+  if(!grid->vertices || !grid->indices) {
+    LOG_ERROR("Failed to allocate CDLOD grid");
+    return false;
+  }
+
+  for(u32 y = 0; y < side; ++y) {
+    for(u32 x = 0; x < side; ++x) {
+      grid->vertices[y * side + x] = GridVertex{
+        .grid = {(u16)x, (u16)y},
+      };
+    }
+  }
+
+  // Same split and winding as the heightfield's cells, one quadrant after another
+  u16 *out = grid->indices;
+  for(u32 q = 0; q < 4; ++q) {
+    grid->quadrant_first[q] = (u32)(out - grid->indices);
+    u32 x0                  = (q & 1) * half;
+    u32 y0                  = (q >> 1) * half;
+    for(u32 y = y0; y < y0 + half; ++y) {
+      for(u32 x = x0; x < x0 + half; ++x) {
+        u16 v00 = (u16)(y * side + x);
+        u16 v10 = (u16)(v00 + 1);
+        u16 v01 = (u16)(v00 + side);
+        u16 v11 = (u16)(v01 + 1);
+        out[0]  = v00;
+        out[1]  = v11;
+        out[2]  = v10;
+        out[3]  = v00;
+        out[4]  = v01;
+        out[5]  = v11;
+        out += 6;
+      }
+    }
+  }
+
+  // Each quadrant is drawn on its own, so each is ordered for the vertex cache on its own
+  ArenaTemp scratch = arena_scratch_begin();
+  for(u32 q = 0; q < 4; ++q) {
+    mesh_optimize_vertex_cache(grid->indices + grid->quadrant_first[q],
+                               INDEX_TYPE_U16,
+                               grid->quadrant_count,
+                               grid->vertex_count,
+                               scratch.arena);
+  }
+  u32 vertex_count = grid->vertex_count;
+  mesh_optimize_vertex_fetch(grid->vertices,
+                             sizeof(GridVertex),
+                             grid->vertex_count,
+                             grid->indices,
+                             INDEX_TYPE_U16,
+                             grid->index_count,
+                             &vertex_count,
+                             scratch.arena);
+  arena_temp_end(scratch);
+  return true;
+}
@@ -0,0 +1,83 @@
+#ifndef CDLOD_H
+#define CDLOD_H
+
+#include "camera/frustum.h"
+#include "geometry/vertex.h"
+#include "memory/arena.h"
+#include "simulation/height_pyramid.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Continuous distance-dependent LOD (CDLOD) for drawing the heightfield. A quadtree over
+// the samples picks, per frame, nodes whose detail falls off with distance from the eye:
+// LOD k is drawn up to ranges[k], and each LOD is twice as coarse and its range twice as
+// far as the one before. Every selected node is drawn with the same shared grid mesh,
+// scaled to the node and displaced by the heightfield in the vertex shader. Over the last
+// part of its range a node's odd vertices slide onto the next LOD's grid, so LOD changes
+// morph instead of popping and neighbouring LODs meet without cracks.
+//
+// Node height bounds come from the height pyramid, which must be kept up to date.
+
+// Cells per side of the shared grid, and of a LOD 0 node
+#define CDLOD_GRID_CELLS 32
+
+#define CDLOD_MAX_LODS 16
+
+// Where morphing starts, as a fraction of the way from the previous LOD's range to this one's
+#define CDLOD_MORPH_START 0.7f
+
+// Quadrants of a node, as bits of CdlodNode::quadrants. Quadrant (qx, qy) is bit qy * 2 + qx.
+#define CDLOD_QUADRANTS_ALL 0xfu
+
+typedef struct CdlodNode {
+  u32 x; // Sample coordinates of the node's corner
+  u32 y;
+  u32 lod;
+  u32 quadrants; // Parts of the node drawn at this LOD; the others are covered by children
+} CdlodNode;
+
+typedef struct CdlodTree {
+  const HeightPyramid *pyramid;
+  HeightfieldPlacement placement;
+  u32                  width; // Heightfield samples
+  u32                  height;
+  u32                  lod_count;
+  u32                  roots_x;
+  u32                  roots_y;
+  f32                  ranges[CDLOD_MAX_LODS];      // World distance up to which each LOD is drawn
+  f32                  morph_start[CDLOD_MAX_LODS]; // World distance where each LOD starts morphing
+  CdlodNode           *nodes;                       // Last selection
+  u32                  node_count;
+  u32                  node_capacity;
+  u32                  visited; // Nodes tested by the last selection
+  u32                  culled;  // ... and of those, the ones outside the frustum
+} CdlodTree;
+
+// Shared grid of CDLOD_GRID_CELLS x CDLOD_GRID_CELLS cells, split like the heightfield's
+// cells. Indices are grouped by quadrant so part of a node draws as one index range, and
+// ordered for the vertex caches within each quadrant.
+typedef struct CdlodGrid {
+  GridVertex *vertices;
+  u32         vertex_count;
+  u16        *indices;
+  u32         index_count;
+  u32         quadrant_first[4]; // First index of each quadrant
+  u32         quadrant_count;    // Indices per quadrant
+} CdlodGrid;
+
+// lod0_range is the world distance covered by full-resolution nodes. It must comfortably
+// exceed a LOD 0 node's diagonal for neighbouring nodes to differ by at most one LOD.
+bool cdlod_create(CdlodTree                  *tree,
+                  const HeightPyramid        *pyramid,
+                  const HeightfieldPlacement *placement,
+                  f32                         lod0_range,
+                  u32                         node_capacity,
+                  Arena                      *arena);
+
+// Select the nodes to draw for an eye position and frustum into tree->nodes. Returns the
+// number selected; selection stops early once node_capacity is reached.
+u32 cdlod_select(CdlodTree *tree, const Frustum *frustum, const f32 eye[3]);
+
+bool cdlod_grid_create(CdlodGrid *grid, Arena *arena);
+
+#endif // CDLOD_H
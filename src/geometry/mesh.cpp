@@ -1,5 +1,7 @@
 #include "mesh.h"
 #include "core/log.h"
+#include "utils/macros.h"
+#include <math.h>
 #include <string.h>
 
 void mesh_init(Mesh *mesh) { memset(mesh, 0, sizeof(Mesh)); }
@@ -13,7 +15,8 @@ bool mesh_allocate(Mesh *mesh, u32 vertex_count, u32 index_count, Arena *arena)
     return false;
   }
 
-  mesh->indices = ARENA_PUSH_ARRAY(arena, u32, index_count);
+  mesh->index_type = mesh_index_type_for(vertex_count);
+  mesh->indices    = arena_alloc_aligned(arena, (size_t)index_count * mesh_index_size(mesh->index_type), sizeof(u32));
   if(!mesh->indices) {
     LOG_ERROR("Failed to allocate indices");
     return false;
@@ -24,3 +27,37 @@ bool mesh_allocate(Mesh *mesh, u32 vertex_count, u32 index_count, Arena *arena)
 
   return true;
 }
+
+void mesh_bounds_compute(MeshBounds *bounds, const f32 *positions, size_t position_stride, u32 count) {
+  *bounds = MeshBounds{};
+  if(count == 0) {
+    return;
+  }
+
+  const u8 *bytes = (const u8 *)positions;
+  for(u32 c = 0; c < 3; ++c) {
+    bounds->min[c] = positions[c];
+    bounds->max[c] = positions[c];
+  }
+  for(u32 v = 1; v < count; ++v) {
+    const f32 *p = (const f32 *)(bytes + v * position_stride);
+    for(u32 c = 0; c < 3; ++c) {
+      bounds->min[c] = MIN(bounds->min[c], p[c]);
+      bounds->max[c] = MAX(bounds->max[c], p[c]);
+    }
+  }
+  for(u32 c = 0; c < 3; ++c) {
+    bounds->center[c] = (bounds->min[c] + bounds->max[c]) * 0.5f;
+  }
+
+  // Usually well inside the box's corners, which is what makes the sphere worth testing
+  f32 radius_sq = 0.0f;
+  for(u32 v = 0; v < count; ++v) {
+    const f32 *p  = (const f32 *)(bytes + v * position_stride);
+    f32        dx = p[0] - bounds->center[0];
+    f32        dy = p[1] - bounds->center[1];
+    f32        dz = p[2] - bounds->center[2];
+    radius_sq     = MAX(radius_sq, dx * dx + dy * dy + dz * dz);
+  }
+  bounds->radius = sqrtf(radius_sq);
+}
@@ -4,18 +4,60 @@
 #include "memory/arena.h"
 #include "geometry/vertex.h"
 
+// Width of the entries of an index buffer
+typedef enum IndexType {
+  INDEX_TYPE_U32 = 0,
+  INDEX_TYPE_U16, // Meshes of up to MESH_U16_MAX_VERTICES vertices
+} IndexType;
+
+#define MESH_U16_MAX_VERTICES 65536u
+
+// Box around a mesh's vertices, and the sphere around the box center that holds them all
+typedef struct MeshBounds {
+  f32 min[3];
+  f32 max[3];
+  f32 center[3];
+  f32 radius;
+} MeshBounds;
+
 // Mesh structure
 typedef struct Mesh {
-  Vertex *vertices;
-  u32     vertex_count;
-  u32    *indices;
-  u32     index_count;
+  Vertex    *vertices;
+  u32        vertex_count;
+  void      *indices; // u16 or u32 entries, per index_type
+  u32        index_count;
+  IndexType  index_type;
+  MeshBounds bounds; // Set once the vertices are filled in, see mesh_bounds_compute
 } Mesh;
 
+// Narrowest index type that can address vertex_count vertices
+static inline IndexType mesh_index_type_for(u32 vertex_count) {
+  return vertex_count <= MESH_U16_MAX_VERTICES ? INDEX_TYPE_U16 : INDEX_TYPE_U32;
+}
+
+static inline size_t mesh_index_size(IndexType type) { return type == INDEX_TYPE_U16 ? sizeof(u16) : sizeof(u32); }
+
+// Read and write entry i of an index buffer of the given type
+static inline u32 mesh_index_get(const void *indices, IndexType type, u32 i) {
+  return type == INDEX_TYPE_U16 ? ((const u16 *)indices)[i] : ((const u32 *)indices)[i];
+}
+
+static inline void mesh_index_set(void *indices, IndexType type, u32 i, u32 value) {
+  if(type == INDEX_TYPE_U16) {
+    ((u16 *)indices)[i] = (u16)value;
+  } else {
+    ((u32 *)indices)[i] = value;
+  }
+}
+
 // Initialize an empty mesh
 void mesh_init(Mesh *mesh);
 
-// Allocate mesh data from arena
+// Allocate mesh data from arena, with the narrowest index type for vertex_count
 bool mesh_allocate(Mesh *mesh, u32 vertex_count, u32 index_count, Arena *arena);
 
+// Bounds of count xyz positions position_stride bytes apart; no positions give an empty
+// box at the origin
+void mesh_bounds_compute(MeshBounds *bounds, const f32 *positions, size_t position_stride, u32 count);
+
 #endif // MESH_H
@@ -0,0 +1,276 @@
+#include "mesh_optimize.h"
+#include "core/log.h"
+#include "utils/macros.h"
+
+#include <math.h>
+#include <string.h>
+
+// Valence boosts beyond this many remaining triangles are all the same
+#define MESH_OPTIMIZE_MAX_VALENCE 32
+
+#define MESH_OPTIMIZE_NONE 0xffffffffu
+
+// Vertex scores from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+typedef struct MeshOptimizeScores {
+  f32 cache[MESH_OPTIMIZE_CACHE_SIZE];        // By LRU position
+  f32 valence[MESH_OPTIMIZE_MAX_VALENCE + 1]; // By remaining triangle count
+} MeshOptimizeScores;
+
+static void mesh_optimize_score_tables(MeshOptimizeScores *scores) {
+  const f32 range = (f32)(MESH_OPTIMIZE_CACHE_SIZE - 3);
+
+  // The last triangle's three vertices score the same, so it is not simply re-emitted
+  for(u32 i = 0; i < MESH_OPTIMIZE_CACHE_SIZE; ++i) {
+    scores->cache[i] = i < 3 ? 0.75f : powf(1.0f - (f32)(i - 3) / range, 1.5f);
+  }
+  // Favour vertices with few triangles left so they leave the cache finished
+  scores->valence[0] = 0.0f;
+  for(u32 i = 1; i <= MESH_OPTIMIZE_MAX_VALENCE; ++i) {
+    scores->valence[i] = 2.0f / sqrtf((f32)i);
+  }
+}
+
+static f32 mesh_optimize_vertex_score(const MeshOptimizeScores *scores, i32 cache_position, u32 live) {
+  if(live == 0) {
+    return -1.0f;
+  }
+  f32 score = cache_position >= 0 ? scores->cache[cache_position] : 0.0f;
+  return score + scores->valence[MIN(live, (u32)MESH_OPTIMIZE_MAX_VALENCE)];
+}
+
+bool mesh_optimize_vertex_cache(void *indices, IndexType index_type, u32 index_count, u32 vertex_count, Arena *scratch) {
+  u32 tri_count = index_count / 3;
+  if(tri_count == 0) {
+    return true;
+  }
+
+  ArenaTemp temp      = arena_temp_begin(scratch);
+  u32      *tris      = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  u32      *order     = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  f32      *tri_score = ARENA_PUSH_ARRAY(scratch, f32, tri_count);
+  u8       *emitted   = ARENA_PUSH_ARRAY(scratch, u8, tri_count);
+  u32      *live      = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+  u32      *first     = ARENA_PUSH_ARRAY(scratch, u32, vertex_count + 1);
+  u32      *adjacent  = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  i32      *position  = ARENA_PUSH_ARRAY(scratch, i32, vertex_count);
+  f32      *score     = ARENA_PUSH_ARRAY(scratch, f32, vertex_count);
+  if(!tris || !order || !tri_score || !emitted || !live || !first || !adjacent || !position || !score) {
+    LOG_ERROR("Failed to allocate vertex cache optimization scratch for %u triangles", tri_count);
+    arena_temp_end(temp);
+    return false;
+  }
+
+  MeshOptimizeScores scores;
+  mesh_optimize_score_tables(&scores);
+
+  // Triangles around each vertex; live[v] of them, at the front of v's range, are not emitted
+  memset(live, 0, vertex_count * sizeof(u32));
+  for(u32 i = 0; i < tri_count * 3; ++i) {
+    tris[i] = mesh_index_get(indices, index_type, i);
+    live[tris[i]]++;
+  }
+  first[0] = 0;
+  for(u32 v = 0; v < vertex_count; ++v) {
+    first[v + 1] = first[v] + live[v];
+    live[v]      = 0;
+  }
+  for(u32 t = 0; t < tri_count; ++t) {
+    for(u32 corner = 0; corner < 3; ++corner) {
+      u32 v                          = tris[3 * t + corner];
+      adjacent[first[v] + live[v]++] = t;
+    }
+  }
+
+  for(u32 v = 0; v < vertex_count; ++v) {
+    position[v] = -1;
+    score[v]    = mesh_optimize_vertex_score(&scores, -1, live[v]);
+  }
+
+  u32 best       = 0;
+  f32 best_score = -1.0f;
+  for(u32 t = 0; t < tri_count; ++t) {
+    const u32 *tri = tris + 3 * t;
+    tri_score[t]   = score[tri[0]] + score[tri[1]] + score[tri[2]];
+    if(tri_score[t] > best_score) {
+      best       = t;
+      best_score = tri_score[t];
+    }
+  }
+  memset(emitted, 0, tri_count);
+
+  u32 cache[MESH_OPTIMIZE_CACHE_SIZE + 3];
+  u32 cache_count = 0;
+  u32 cursor      = 0; // Every triangle before it has been emitted
+  for(u32 emit = 0; emit < tri_count; ++emit) {
+    // Dead end: nothing in the cache has triangles left, so restart from the first unemitted
+    if(best == MESH_OPTIMIZE_NONE) {
+      while(emitted[cursor]) {
+        cursor++;
+      }
+      best = cursor;
+    }
+
+    const u32 *tri = tris + 3 * best;
+    memcpy(order + 3 * emit, tri, 3 * sizeof(u32));
+    emitted[best] = 1;
+
+    for(u32 corner = 0; corner < 3; ++corner) {
+      u32  v     = tri[corner];
+      u32 *list  = adjacent + first[v];
+      u32  count = live[v];
+      for(u32 i = 0; i < count; ++i) {
+        if(list[i] == best) {
+          list[i]         = list[count - 1];
+          list[count - 1] = best;
+          break;
+        }
+      }
+      live[v]--;
+    }
+
+    // The triangle's vertices move to the front of the LRU cache, pushing the rest back
+    u32 next[MESH_OPTIMIZE_CACHE_SIZE + 3] = {tri[0], tri[1], tri[2]};
+    u32 next_count                         = 3;
+    for(u32 i = 0; i < cache_count; ++i) {
+      u32 v = cache[i];
+      if(v != tri[0] && v != tri[1] && v != tri[2]) {
+        next[next_count++] = v;
+      }
+    }
+
+    for(u32 i = 0; i < next_count; ++i) {
+      u32 v       = next[i];
+      position[v] = i < MESH_OPTIMIZE_CACHE_SIZE ? (i32)i : -1;
+      score[v]    = mesh_optimize_vertex_score(&scores, position[v], live[v]);
+    }
+
+    // Rescore the triangles around every vertex whose score changed, including those just
+    // evicted, and continue with the best one still touching the cache
+    best       = MESH_OPTIMIZE_NONE;
+    best_score = -1.0f;
+    for(u32 i = 0; i < next_count; ++i) {
+      u32 v = next[i];
+      for(u32 k = first[v]; k < first[v] + live[v]; ++k) {
+        u32        t     = adjacent[k];
+        const u32 *other = tris + 3 * t;
+        tri_score[t]     = score[other[0]] + score[other[1]] + score[other[2]];
+        if(tri_score[t] > best_score) {
+          best       = t;
+          best_score = tri_score[t];
+        }
+      }
+    }
+
+    cache_count = MIN(next_count, (u32)MESH_OPTIMIZE_CACHE_SIZE);
+    memcpy(cache, next, cache_count * sizeof(u32));
+  }
+
+  for(u32 i = 0; i < tri_count * 3; ++i) {
+    mesh_index_set(indices, index_type, i, order[i]);
+  }
+
+  arena_temp_end(temp);
+  return true;
+}
+
+bool mesh_optimize_vertex_fetch(void     *vertices,
+                                size_t    vertex_size,
+                                u32       vertex_count,
+                                void     *indices,
+                                IndexType index_type,
+                                u32       index_count,
+                                u32      *out_vertex_count,
+                                Arena    *scratch) {
+  ArenaTemp temp  = arena_temp_begin(scratch);
+  u32      *remap = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+  u8       *copy  = (u8 *)arena_alloc_aligned(scratch, vertex_count * vertex_size, 16);
+  if(!remap || !copy) {
+    LOG_ERROR("Failed to allocate vertex fetch optimization scratch for %u vertices", vertex_count);
+    arena_temp_end(temp);
+    return false;
+  }
+
+  memset(remap, 0xff, vertex_count * sizeof(u32));
+  u32 used = 0;
+  for(u32 i = 0; i < index_count; ++i) {
+    u32 v = mesh_index_get(indices, index_type, i);
+    if(remap[v] == MESH_OPTIMIZE_NONE) {
+      remap[v] = used++;
+    }
+    mesh_index_set(indices, index_type, i, remap[v]);
+  }
+
+  memcpy(copy, vertices, vertex_count * vertex_size);
+  for(u32 v = 0; v < vertex_count; ++v) {
+    if(remap[v] != MESH_OPTIMIZE_NONE) {
+      memcpy((u8 *)vertices + remap[v] * vertex_size, copy + v * vertex_size, vertex_size);
+    }
+  }
+
+  *out_vertex_count = used;
+  arena_temp_end(temp);
+  return true;
+}
+
+VertexCacheStats
+mesh_analyze_vertex_cache(const void *indices, IndexType index_type, u32 index_count, u32 vertex_count, Arena *scratch) {
+  VertexCacheStats stats = {};
+  if(index_count < 3) {
+    return stats;
+  }
+
+  ArenaTemp temp  = arena_temp_begin(scratch);
+  u32      *stamp = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+  if(!stamp) {
+    arena_temp_end(temp);
+    return stats;
+  }
+  memset(stamp, 0, vertex_count * sizeof(u32));
+
+  // A vertex is cached while fewer than MESH_ANALYZE_CACHE_SIZE misses followed its own
+  u32 time   = MESH_ANALYZE_CACHE_SIZE + 1;
+  u32 misses = 0;
+  u32 unique = 0;
+  for(u32 i = 0; i < index_count; ++i) {
+    u32 v = mesh_index_get(indices, index_type, i);
+    if(time - stamp[v] > MESH_ANALYZE_CACHE_SIZE) {
+      unique += stamp[v] == 0;
+      stamp[v] = time++;
+      misses++;
+    }
+  }
+
+  stats.acmr = (f32)misses / (f32)(index_count / 3);
+  stats.atvr = (f32)misses / (f32)unique;
+  arena_temp_end(temp);
+  return stats;
+}
+
+bool mesh_optimize(Mesh *mesh, Arena *scratch) {
+  VertexCacheStats before
+    = mesh_analyze_vertex_cache(mesh->indices, mesh->index_type, mesh->index_count, mesh->vertex_count, scratch);
+
+  u32 vertex_count = 0;
+  if(!mesh_optimize_vertex_cache(mesh->indices, mesh->index_type, mesh->index_count, mesh->vertex_count, scratch)
+     || !mesh_optimize_vertex_fetch(mesh->vertices,
+                                    sizeof(Vertex),
+                                    mesh->vertex_count,
+                                    mesh->indices,
+                                    mesh->index_type,
+                                    mesh->index_count,
+                                    &vertex_count,
+                                    scratch)) {
+    return false;
+  }
+  mesh->vertex_count = vertex_count;
+
+  VertexCacheStats after
+    = mesh_analyze_vertex_cache(mesh->indices, mesh->index_type, mesh->index_count, mesh->vertex_count, scratch);
+  LOG_INFO("Optimized mesh of %u triangles: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+           mesh->index_count / 3,
+           before.acmr,
+           after.acmr,
+           before.atvr,
+           after.atvr);
+  return true;
+}
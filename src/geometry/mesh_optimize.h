@@ -0,0 +1,50 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "geometry/mesh.h"
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Reordering passes that cut vertex shader work without changing what is drawn.
+// Triangles are reordered with Forsyth's linear-speed vertex cache optimization: each step
+// emits the triangle whose vertices score best, where a vertex scores higher the more
+// recently it was used and the fewer triangles it has left. Vertices are then renumbered in
+// order of first use, so the pre-transform fetches walk memory forward.
+//
+// Both passes take index buffers of either type and allocate only from the scratch arena.
+
+// LRU cache size Forsyth's scores are tuned for
+#define MESH_OPTIMIZE_CACHE_SIZE 32
+
+// FIFO cache size the statistics model, typical of the smallest post-transform caches
+#define MESH_ANALYZE_CACHE_SIZE 16
+
+// Post-transform cache behaviour of an index buffer
+typedef struct VertexCacheStats {
+  f32 acmr; // Average cache miss ratio: transformed vertices per triangle, 0.5 - 3
+  f32 atvr; // Average transformed vertex ratio: transformed vertices per vertex used, 1 at best
+} VertexCacheStats;
+
+// Reorder triangles for the post-transform cache. Each triangle keeps its winding.
+bool mesh_optimize_vertex_cache(void *indices, IndexType index_type, u32 index_count, u32 vertex_count, Arena *scratch);
+
+// Renumber vertices in order of first use and move them to match. Unused vertices are
+// dropped; out_vertex_count receives how many remain.
+bool mesh_optimize_vertex_fetch(void     *vertices,
+                                size_t    vertex_size,
+                                u32       vertex_count,
+                                void     *indices,
+                                IndexType index_type,
+                                u32       index_count,
+                                u32      *out_vertex_count,
+                                Arena    *scratch);
+
+// Simulate a MESH_ANALYZE_CACHE_SIZE entry FIFO cache over the index buffer. Returns zeros
+// if scratch memory runs out.
+VertexCacheStats
+mesh_analyze_vertex_cache(const void *indices, IndexType index_type, u32 index_count, u32 vertex_count, Arena *scratch);
+
+// Run both passes on a mesh and log its cache statistics before and after
+bool mesh_optimize(Mesh *mesh, Arena *scratch);
+
+#endif // MESH_OPTIMIZE_H
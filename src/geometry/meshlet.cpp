@@ -0,0 +1,288 @@
+#include "meshlet.h"
+#include "core/log.h"
+#include "utils/macros.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MESHLET_NONE      0xffffffffu
+#define MESHLET_NO_SLOT   0xff
+#define MESHLET_MIN_AXIS  1e-6f // Shorter summed normals point nowhere in particular
+#define MESHLET_MIN_COS   0.1f  // Cones wider than ~84 degrees are never all back-facing
+
+static_assert(MESHLET_MAX_VERTICES < MESHLET_NO_SLOT, "local vertex indices must fit u8");
+
+static const f32 *meshlet_position(const f32 *positions, size_t stride, u32 v) {
+  return (const f32 *)((const u8 *)positions + v * stride);
+}
+
+static void meshlet_compute_bounds(MeshletBounds *bounds,
+                                   const u32     *vertices,
+                                   u32            vertex_count,
+                                   const u32     *indices,
+                                   u32            triangle_count,
+                                   const f32     *positions,
+                                   size_t         stride) {
+  // Sphere around the center of the box
+  f32 min[3] = {INFINITY, INFINITY, INFINITY};
+  f32 max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for(u32 i = 0; i < vertex_count; ++i) {
+    const f32 *p = meshlet_position(positions, stride, vertices[i]);
+    for(u32 c = 0; c < 3; ++c) {
+      min[c] = MIN(min[c], p[c]);
+      max[c] = MAX(max[c], p[c]);
+    }
+  }
+  f32 radius_sq = 0.0f;
+  for(u32 c = 0; c < 3; ++c) {
+    bounds->center[c] = 0.5f * (min[c] + max[c]);
+  }
+  for(u32 i = 0; i < vertex_count; ++i) {
+    const f32 *p  = meshlet_position(positions, stride, vertices[i]);
+    f32        dx = p[0] - bounds->center[0];
+    f32        dy = p[1] - bounds->center[1];
+    f32        dz = p[2] - bounds->center[2];
+    radius_sq     = MAX(radius_sq, dx * dx + dy * dy + dz * dz);
+  }
+  bounds->radius = sqrtf(radius_sq);
+
+  // Normal cone: the axis is the area-weighted average normal, the half angle reaches the
+  // normal furthest from it
+  f32 normals[MESHLET_MAX_TRIANGLES][3];
+  f32 axis[3] = {0.0f, 0.0f, 0.0f};
+  for(u32 t = 0; t < triangle_count; ++t) {
+    const f32 *p0 = meshlet_position(positions, stride, indices[3 * t + 0]);
+    const f32 *p1 = meshlet_position(positions, stride, indices[3 * t + 1]);
+    const f32 *p2 = meshlet_position(positions, stride, indices[3 * t + 2]);
+    f32        u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    f32        v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    f32       *n    = normals[t];
+    n[0]            = u[1] * v[2] - u[2] * v[1];
+    n[1]            = u[2] * v[0] - u[0] * v[2];
+    n[2]            = u[0] * v[1] - u[1] * v[0];
+    for(u32 c = 0; c < 3; ++c) {
+      axis[c] += n[c];
+    }
+  }
+
+  bounds->cone_axis[0] = 0.0f;
+  bounds->cone_axis[1] = 0.0f;
+  bounds->cone_axis[2] = 0.0f;
+  bounds->cone_cutoff  = 1.0f;
+
+  f32 axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if(axis_length < MESHLET_MIN_AXIS) {
+    return;
+  }
+  for(u32 c = 0; c < 3; ++c) {
+    axis[c] /= axis_length;
+  }
+
+  f32 min_cos = 1.0f;
+  for(u32 t = 0; t < triangle_count; ++t) {
+    const f32 *n      = normals[t];
+    f32        length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if(length > 0.0f) {
+      min_cos = MIN(min_cos, (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) / length);
+    }
+  }
+  memcpy(bounds->cone_axis, axis, sizeof(axis));
+  if(min_cos >= MESHLET_MIN_COS) {
+    bounds->cone_cutoff = sqrtf(1.0f - min_cos * min_cos);
+  }
+}
+
+bool meshlet_build(MeshletSet *set,
+                   void       *indices,
+                   IndexType   index_type,
+                   u32         index_count,
+                   const f32  *positions,
+                   size_t      position_stride,
+                   u32         vertex_count,
+                   Arena      *arena,
+                   Arena      *scratch) {
+  *set          = MeshletSet{};
+  u32 tri_count = index_count / 3;
+  if(tri_count == 0) {
+    return true;
+  }
+
+  ArenaTemp temp      = arena_temp_begin(scratch);
+  u32      *tris      = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  u32      *live      = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+  u32      *first     = ARENA_PUSH_ARRAY(scratch, u32, vertex_count + 1);
+  u32      *adjacent  = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  u8       *slot      = ARENA_PUSH_ARRAY(scratch, u8, vertex_count);
+  u8       *emitted   = ARENA_PUSH_ARRAY(scratch, u8, tri_count);
+  u32      *order     = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  Meshlet  *meshlets  = ARENA_PUSH_ARRAY(scratch, Meshlet, tri_count);
+  u32      *vertices  = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3);
+  u8       *triangles = ARENA_PUSH_ARRAY(scratch, u8, tri_count * 3);
+  if(!tris || !live || !first || !adjacent || !slot || !emitted || !order || !meshlets || !vertices || !triangles) {
+    LOG_ERROR("Failed to allocate meshlet scratch for %u triangles", tri_count);
+    arena_temp_end(temp);
+    return false;
+  }
+
+  // Triangles around each vertex; live[v] of them, at the front of v's range, are unassigned
+  memset(live, 0, vertex_count * sizeof(u32));
+  for(u32 i = 0; i < tri_count * 3; ++i) {
+    tris[i] = mesh_index_get(indices, index_type, i);
+    live[tris[i]]++;
+  }
+  first[0] = 0;
+  for(u32 v = 0; v < vertex_count; ++v) {
+    first[v + 1] = first[v] + live[v];
+    live[v]      = 0;
+  }
+  for(u32 t = 0; t < tri_count; ++t) {
+    for(u32 corner = 0; corner < 3; ++corner) {
+      u32 v                          = tris[3 * t + corner];
+      adjacent[first[v] + live[v]++] = t;
+    }
+  }
+  memset(slot, MESHLET_NO_SLOT, vertex_count);
+  memset(emitted, 0, tri_count);
+
+  u32 meshlet_count  = 0;
+  u32 vertex_total   = 0;
+  u32 triangle_total = 0;
+  u32 cursor         = 0; // Every triangle before it is in a meshlet
+  while(triangle_total < tri_count) {
+    while(emitted[cursor]) {
+      cursor++;
+    }
+
+    Meshlet *meshlet         = &meshlets[meshlet_count++];
+    meshlet->vertex_offset   = vertex_total;
+    meshlet->triangle_offset = triangle_total;
+    meshlet->vertex_count    = 0;
+    meshlet->triangle_count  = 0;
+
+    for(u32 next = cursor; next != MESHLET_NONE;) {
+      const u32 *tri = tris + 3 * next;
+      for(u32 corner = 0; corner < 3; ++corner) {
+        u32 v = tri[corner];
+        if(slot[v] == MESHLET_NO_SLOT) {
+          slot[v]                  = (u8)meshlet->vertex_count++;
+          vertices[vertex_total++] = v;
+        }
+        triangles[3 * triangle_total + corner] = slot[v];
+        order[3 * triangle_total + corner]     = v;
+
+        u32 *list  = adjacent + first[v];
+        u32  count = live[v];
+        for(u32 i = 0; i < count; ++i) {
+          if(list[i] == next) {
+            list[i]         = list[count - 1];
+            list[count - 1] = next;
+            break;
+          }
+        }
+        live[v]--;
+      }
+      emitted[next] = 1;
+      triangle_total++;
+      if(++meshlet->triangle_count == MESHLET_MAX_TRIANGLES) {
+        break;
+      }
+
+      // Continue with the unassigned neighbour that brings in the fewest new vertices
+      next         = MESHLET_NONE;
+      u32 best_new = 3;
+      u32 room     = MESHLET_MAX_VERTICES - meshlet->vertex_count;
+      for(u32 i = 0; i < meshlet->vertex_count && best_new > 0; ++i) {
+        u32 v = vertices[meshlet->vertex_offset + i];
+        for(u32 k = first[v]; k < first[v] + live[v]; ++k) {
+          u32        t         = adjacent[k];
+          const u32 *candidate = tris + 3 * t;
+          u32        added     = (slot[candidate[0]] == MESHLET_NO_SLOT) + (slot[candidate[1]] == MESHLET_NO_SLOT)
+                       + (slot[candidate[2]] == MESHLET_NO_SLOT);
+          if(added <= room && (next == MESHLET_NONE || added < best_new)) {
+            next     = t;
+            best_new = added;
+          }
+        }
+      }
+    }
+
+    for(u32 i = 0; i < meshlet->vertex_count; ++i) {
+      slot[vertices[meshlet->vertex_offset + i]] = MESHLET_NO_SLOT;
+    }
+  }
+
+  set->meshlets  = ARENA_PUSH_ARRAY(arena, Meshlet, meshlet_count);
+  set->bounds    = ARENA_PUSH_ARRAY(arena, MeshletBounds, meshlet_count);
+  set->vertices  = ARENA_PUSH_ARRAY(arena, u32, vertex_total);
+  set->triangles = ARENA_PUSH_ARRAY(arena, u8, triangle_total * 3);
+  if(!set->meshlets || !set->bounds || !set->vertices || !set->triangles) {
+    LOG_ERROR("Failed to allocate %u meshlets", meshlet_count);
+    *set = MeshletSet{};
+    arena_temp_end(temp);
+    return false;
+  }
+  memcpy(set->meshlets, meshlets, meshlet_count * sizeof(Meshlet));
+  memcpy(set->vertices, vertices, vertex_total * sizeof(u32));
+  memcpy(set->triangles, triangles, triangle_total * 3);
+  set->meshlet_count  = meshlet_count;
+  set->vertex_count   = vertex_total;
+  set->triangle_count = triangle_total;
+
+  for(u32 m = 0; m < meshlet_count; ++m) {
+    const Meshlet *meshlet = &meshlets[m];
+    meshlet_compute_bounds(&set->bounds[m],
+                           vertices + meshlet->vertex_offset,
+                           meshlet->vertex_count,
+                           order + 3 * meshlet->triangle_offset,
+                           meshlet->triangle_count,
+                           positions,
+                           position_stride);
+  }
+
+  for(u32 i = 0; i < tri_count * 3; ++i) {
+    mesh_index_set(indices, index_type, i, order[i]);
+  }
+
+  arena_temp_end(temp);
+  return true;
+}
+
+void meshlet_update_bounds(const MeshletSet *set, const f32 *positions, size_t position_stride, MeshletBounds *bounds) {
+  u32 corners[MESHLET_MAX_TRIANGLES * 3];
+  for(u32 m = 0; m < set->meshlet_count; ++m) {
+    const Meshlet *meshlet  = &set->meshlets[m];
+    const u32     *vertices = set->vertices + meshlet->vertex_offset;
+    const u8      *local    = set->triangles + 3 * meshlet->triangle_offset;
+    for(u32 i = 0; i < meshlet->triangle_count * 3; ++i) {
+      corners[i] = vertices[local[i]];
+    }
+    meshlet_compute_bounds(
+      &bounds[m], vertices, meshlet->vertex_count, corners, meshlet->triangle_count, positions, position_stride);
+  }
+}
+
+bool meshlet_visible(const MeshletBounds *bounds, const Frustum *frustum, const f32 eye[3]) {
+  if(!frustum_test_sphere(frustum, bounds->center, bounds->radius)) {
+    return false;
+  }
+  if(bounds->cone_cutoff >= 1.0f) {
+    return true;
+  }
+
+  // Every normal is within the cone's half angle a of the axis. All triangles face away
+  // when every direction from the eye into the sphere is within 90 - a degrees of the axis.
+  f32 d[3]     = {bounds->center[0] - eye[0], bounds->center[1] - eye[1], bounds->center[2] - eye[2]};
+  f32 distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  f32 along    = d[0] * bounds->cone_axis[0] + d[1] * bounds->cone_axis[1] + d[2] * bounds->cone_axis[2];
+  return along < bounds->cone_cutoff * distance + bounds->radius * (1.0f + bounds->cone_cutoff);
+}
+
+u32 meshlet_cull(const MeshletBounds *bounds, u32 count, const Frustum *frustum, const f32 eye[3], u32 *out_visible) {
+  u32 visible = 0;
+  for(u32 m = 0; m < count; ++m) {
+    if(meshlet_visible(&bounds[m], frustum, eye)) {
+      out_visible[visible++] = m;
+    }
+  }
+  return visible;
+}
@@ -0,0 +1,68 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "camera/frustum.h"
+#include "geometry/mesh.h"
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Meshlets: small clusters of neighbouring triangles that can be culled on their own,
+// below the level of whole meshes. Each carries a bounding sphere for frustum culling and
+// a cone bounding its triangles' normals, so a cluster seen only from behind is skipped.
+//
+// Building rewrites the mesh's index buffer so each meshlet's triangles are one contiguous
+// range, drawable with a single indexed draw. The flat arrays also hold meshlet-local
+// vertex and triangle lists in the layout mesh shaders expect.
+
+// Limits matching common mesh shader output sizes (124 keeps triangle data 4-byte sized)
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef struct Meshlet {
+  u32 vertex_offset;   // First entry in MeshletSet::vertices
+  u32 triangle_offset; // First triangle in MeshletSet::triangles and in the rewritten index buffer
+  u32 vertex_count;
+  u32 triangle_count;
+} Meshlet;
+
+typedef struct MeshletBounds {
+  f32 center[3];
+  f32 radius;
+  f32 cone_axis[3]; // Average front-face normal
+  f32 cone_cutoff;  // Sine of the normal cone's half angle; 1 when it cannot be back-facing
+} MeshletBounds;
+
+typedef struct MeshletSet {
+  Meshlet       *meshlets;
+  MeshletBounds *bounds;
+  u32           *vertices;  // Mesh vertex index of every meshlet-local vertex
+  u8            *triangles; // Meshlet-local vertex indices, three per triangle
+  u32            meshlet_count;
+  u32            vertex_count;
+  u32            triangle_count;
+} MeshletSet;
+
+// Split the triangles of an index buffer into meshlets, growing each from a seed triangle
+// through the neighbours that add the fewest new vertices. Positions are xyz triples
+// position_stride bytes apart. The set is allocated from arena, working memory from scratch.
+bool meshlet_build(MeshletSet *set,
+                   void       *indices,
+                   IndexType   index_type,
+                   u32         index_count,
+                   const f32  *positions,
+                   size_t      position_stride,
+                   u32         vertex_count,
+                   Arena      *arena,
+                   Arena      *scratch);
+
+// Recompute the bounds of set's meshlets into bounds (meshlet_count entries) for other
+// positions: vertices that moved, or another mesh with the same triangles and vertex order
+void meshlet_update_bounds(const MeshletSet *set, const f32 *positions, size_t position_stride, MeshletBounds *bounds);
+
+// Whether a meshlet may be visible: inside the frustum and with some triangle facing eye
+bool meshlet_visible(const MeshletBounds *bounds, const Frustum *frustum, const f32 eye[3]);
+
+// Write the indices of the meshlets that may be visible to out_visible and return how many
+u32 meshlet_cull(const MeshletBounds *bounds, u32 count, const Frustum *frustum, const f32 eye[3], u32 *out_visible);
+
+#endif // MESHLET_H
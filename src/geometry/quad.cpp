@@ -47,13 +47,14 @@ void quad_create_colored_arena(Mesh *mesh, const f32 colors[4][3], Arena *arena)
   };
 
   // Define indices (two triangles, clockwise winding)
-  mesh->indices[0] = 0;
-  mesh->indices[1] = 1;
-  mesh->indices[2] = 2;
-
-  mesh->indices[3] = 2;
-  mesh->indices[4] = 3;
-  mesh->indices[5] = 0;
+  mesh_index_set(mesh->indices, mesh->index_type, 0, 0);
+  mesh_index_set(mesh->indices, mesh->index_type, 1, 1);
+  mesh_index_set(mesh->indices, mesh->index_type, 2, 2);
+
+  mesh_index_set(mesh->indices, mesh->index_type, 3, 2);
+  mesh_index_set(mesh->indices, mesh->index_type, 4, 3);
+  mesh_index_set(mesh->indices, mesh->index_type, 5, 0);
+  mesh_bounds_compute(&mesh->bounds, mesh->vertices[0].position, sizeof(Vertex), mesh->vertex_count);
 
   LOG_DEBUG("Quad mesh created: %u vertices, %u indices", mesh->vertex_count, mesh->index_count);
 }
@@ -0,0 +1,415 @@
+#include "simplify.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "utils/macros.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMPLIFY_LOCKED  0x1 // On the border: never collapsed
+#define SIMPLIFY_REMOVED 0x2 // Collapsed into another vertex
+#define SIMPLIFY_TARGET  0x4 // Absorbed a vertex this pass, so its triangle list is stale
+
+// Largest rotation a surviving triangle's normal may accumulate from its original, as a squared
+// cosine (cos 60 degrees); larger turns tend to fold thin triangles over their neighbours
+#define SIMPLIFY_MIN_NORMAL_COS2 0.25f
+
+// Symmetric 4x4 quadric of summed weighted planes, Q(p) = sum of w * (n . p + d)^2
+typedef struct SimplifyQuadric {
+  f64 m[10];     // xx xy xz xd yy yz yd zz zd dd
+  f64 weight;    // Summed area of the planes' triangles
+  f64 normal[3]; // Summed area-weighted normals, keeping the facing the planes lose
+} SimplifyQuadric;
+
+typedef struct SimplifyCollapse {
+  f32 cost;
+  u32 from;
+  u32 to;
+} SimplifyCollapse;
+
+typedef struct SimplifyState {
+  const Vertex     *vertices;
+  u32               vertex_count;
+  u32              *indices;   // Working triangles as u32, whatever the mesh's index type
+  u32               tri_count; // Live triangles, kept at the front of indices
+  f32              *normals;   // Unnormalized normal of each live triangle before any collapse
+  SimplifyQuadric  *quadrics;
+  u8               *flags;
+  u32              *adjacency_first; // vertex_count + 1 offsets into adjacency
+  u32              *adjacency;       // Live triangles around each vertex
+  SimplifyCollapse *collapses;
+} SimplifyState;
+
+typedef struct SimplifyJob {
+  Mesh                 *meshes;
+  const SimplifyParams *params;
+  f32                  *errors;
+  SDL_AtomicInt         failed;
+} SimplifyJob;
+
+static bool simplify_degenerate(const u32 *tri) { return tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]; }
+
+static void simplify_cross(const f32 *p0, const f32 *p1, const f32 *p2, f32 out[3]) {
+  f32 u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  f32 v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  out[0]   = u[1] * v[2] - u[2] * v[1];
+  out[1]   = u[2] * v[0] - u[0] * v[2];
+  out[2]   = u[0] * v[1] - u[1] * v[0];
+}
+
+// Add each triangle's plane, weighted by its area, to the quadrics of its corners
+static void simplify_plane_quadrics(SimplifyState *state) {
+  memset(state->quadrics, 0, state->vertex_count * sizeof(SimplifyQuadric));
+  for(u32 t = 0; t < state->tri_count; ++t) {
+    const u32 *tri = state->indices + 3 * t;
+    const f32 *p0  = state->vertices[tri[0]].position;
+    f32        n[3];
+    simplify_cross(p0, state->vertices[tri[1]].position, state->vertices[tri[2]].position, n);
+
+    f64 length = sqrt((f64)n[0] * n[0] + (f64)n[1] * n[1] + (f64)n[2] * n[2]);
+    if(length <= 0.0) {
+      continue;
+    }
+    f64 a    = n[0] / length;
+    f64 b    = n[1] / length;
+    f64 c    = n[2] / length;
+    f64 d    = -(a * p0[0] + b * p0[1] + c * p0[2]);
+    f64 area = 0.5 * length;
+
+    f64 plane[10] = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+    for(u32 corner = 0; corner < 3; ++corner) {
+      SimplifyQuadric *q = &state->quadrics[tri[corner]];
+      for(u32 i = 0; i < 10; ++i) {
+        q->m[i] += area * plane[i];
+      }
+      q->weight += area;
+      q->normal[0] += area * a;
+      q->normal[1] += area * b;
+      q->normal[2] += area * c;
+    }
+  }
+}
+
+// Mean squared distance of `to` from the planes absorbed by both endpoints
+static f32 simplify_cost(const SimplifyState *state, u32 from, u32 to) {
+  const SimplifyQuadric *qa = &state->quadrics[from];
+  const SimplifyQuadric *qb = &state->quadrics[to];
+  const f32             *p  = state->vertices[to].position;
+
+  f64 m[10];
+  for(u32 i = 0; i < 10; ++i) {
+    m[i] = qa->m[i] + qb->m[i];
+  }
+  f64 x      = p[0];
+  f64 y      = p[1];
+  f64 z      = p[2];
+  f64 error  = m[0] * x * x + m[4] * y * y + m[7] * z * z + m[9]
+               + 2.0 * (m[1] * x * y + m[2] * x * z + m[3] * x + m[5] * y * z + m[6] * y + m[8] * z);
+  f64 weight = qa->weight + qb->weight;
+  return weight > 0.0 ? (f32)(MAX(error, 0.0) / weight) : 0.0f;
+}
+
+// Rebuild the triangle lists of every vertex from the live triangles
+static void simplify_build_adjacency(SimplifyState *state) {
+  u32 *first = state->adjacency_first;
+  memset(first, 0, (state->vertex_count + 1) * sizeof(u32));
+  for(u32 i = 0; i < state->tri_count * 3; ++i) {
+    first[state->indices[i] + 1]++;
+  }
+  for(u32 v = 0; v < state->vertex_count; ++v) {
+    first[v + 1] += first[v];
+  }
+  for(u32 t = 0; t < state->tri_count; ++t) {
+    for(u32 corner = 0; corner < 3; ++corner) {
+      state->adjacency[first[state->indices[3 * t + corner]]++] = t;
+    }
+  }
+  // The fill advanced every offset to the next vertex's start
+  for(u32 v = state->vertex_count; v > 0; --v) {
+    first[v] = first[v - 1];
+  }
+  first[0] = 0;
+}
+
+// Lock both ends of every edge not shared by exactly two triangles
+static void simplify_lock_border(SimplifyState *state) {
+  for(u32 v = 0; v < state->vertex_count; ++v) {
+    for(u32 k = state->adjacency_first[v]; k < state->adjacency_first[v + 1]; ++k) {
+      const u32 *tri = state->indices + 3 * state->adjacency[k];
+      for(u32 corner = 0; corner < 3; ++corner) {
+        u32 other = tri[corner];
+        if(other <= v) {
+          continue;
+        }
+
+        u32 uses = 0;
+        for(u32 j = state->adjacency_first[v]; j < state->adjacency_first[v + 1]; ++j) {
+          const u32 *shared = state->indices + 3 * state->adjacency[j];
+          uses += shared[0] == other || shared[1] == other || shared[2] == other;
+        }
+        if(uses != 2) {
+          state->flags[v] |= SIMPLIFY_LOCKED;
+          state->flags[other] |= SIMPLIFY_LOCKED;
+        }
+      }
+    }
+  }
+}
+
+// A collapse must not turn any triangle that survives it too far, nor remove a border edge
+// along with a triangle that disappears
+static bool simplify_collapse_valid(const SimplifyState *state, u32 from, u32 to) {
+  const f32             *p_to   = state->vertices[to].position;
+  const SimplifyQuadric *q_from = &state->quadrics[from];
+  const SimplifyQuadric *q_to   = &state->quadrics[to];
+  f64                    facing[3];
+  for(u32 axis = 0; axis < 3; ++axis) {
+    facing[axis] = q_from->normal[axis] + q_to->normal[axis];
+  }
+
+  for(u32 k = state->adjacency_first[from]; k < state->adjacency_first[from + 1]; ++k) {
+    const u32 *tri = state->indices + 3 * state->adjacency[k];
+    if(simplify_degenerate(tri)) {
+      continue;
+    }
+
+    u32 corner = tri[0] == from ? 0 : tri[1] == from ? 1 : 2;
+    u32 a      = tri[(corner + 1) % 3];
+    u32 b      = tri[(corner + 2) % 3];
+    if(a == to || b == to) {
+      u32 other = a == to ? b : a;
+      if((state->flags[to] & SIMPLIFY_LOCKED) && (state->flags[other] & SIMPLIFY_LOCKED)) {
+        return false;
+      }
+      continue;
+    }
+
+    // Compared against the original normal, so small turns cannot add up to a fold
+    const f32 *original = state->normals + 3 * state->adjacency[k];
+    f32        after[3];
+    simplify_cross(p_to, state->vertices[a].position, state->vertices[b].position, after);
+    f32 dot          = original[0] * after[0] + original[1] * after[1] + original[2] * after[2];
+    f32 len_original = original[0] * original[0] + original[1] * original[1] + original[2] * original[2];
+    f32 len_after    = after[0] * after[0] + after[1] * after[1] + after[2] * after[2];
+    if(dot <= 0.0f || dot * dot < SIMPLIFY_MIN_NORMAL_COS2 * len_original * len_after) {
+      return false;
+    }
+    // Nor may it face away from the original triangles the merged vertex stands for
+    if(facing[0] * after[0] + facing[1] * after[1] + facing[2] * after[2] <= 0.0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int simplify_compare_collapses(const void *a, const void *b) {
+  f32 ca = ((const SimplifyCollapse *)a)->cost;
+  f32 cb = ((const SimplifyCollapse *)b)->cost;
+  return (ca > cb) - (ca < cb);
+}
+
+// One round of collapses, cheapest first. Vertices that absorb another sit out the rest of
+// the pass, since their triangle lists no longer match the mesh.
+// Returns the number of collapses made.
+static u32 simplify_pass(SimplifyState *state, u32 target_tris, f32 max_cost, f32 *max_reached) {
+  simplify_build_adjacency(state);
+
+  // Each unlocked vertex proposes its cheapest collapse
+  u32 candidate_count = 0;
+  for(u32 v = 0; v < state->vertex_count; ++v) {
+    state->flags[v] &= ~SIMPLIFY_TARGET;
+    if(state->flags[v] & (SIMPLIFY_LOCKED | SIMPLIFY_REMOVED)) {
+      continue;
+    }
+
+    SimplifyCollapse best = {.cost = max_cost, .from = v, .to = v};
+    for(u32 k = state->adjacency_first[v]; k < state->adjacency_first[v + 1]; ++k) {
+      const u32 *tri = state->indices + 3 * state->adjacency[k];
+      for(u32 corner = 0; corner < 3; ++corner) {
+        u32 to = tri[corner];
+        if(to == v) {
+          continue;
+        }
+        f32 cost = simplify_cost(state, v, to);
+        if(cost <= best.cost) {
+          best.cost = cost;
+          best.to   = to;
+        }
+      }
+    }
+    if(best.to != v) {
+      state->collapses[candidate_count++] = best;
+    }
+  }
+  qsort(state->collapses, candidate_count, sizeof(SimplifyCollapse), simplify_compare_collapses);
+
+  // Most collapses remove two triangles
+  u32 budget  = (state->tri_count - target_tris) / 2 + 1;
+  u32 applied = 0;
+  for(u32 i = 0; i < candidate_count && applied < budget; ++i) {
+    u32 from = state->collapses[i].from;
+    u32 to   = state->collapses[i].to;
+    if((state->flags[from] & (SIMPLIFY_REMOVED | SIMPLIFY_TARGET)) || (state->flags[to] & SIMPLIFY_REMOVED)) {
+      continue;
+    }
+
+    // Earlier collapses this pass may have grown the target's quadric
+    f32 cost = simplify_cost(state, from, to);
+    if(cost > max_cost || !simplify_collapse_valid(state, from, to)) {
+      continue;
+    }
+
+    for(u32 k = state->adjacency_first[from]; k < state->adjacency_first[from + 1]; ++k) {
+      u32 *tri = state->indices + 3 * state->adjacency[k];
+      for(u32 corner = 0; corner < 3; ++corner) {
+        tri[corner] = tri[corner] == from ? to : tri[corner];
+      }
+    }
+
+    SimplifyQuadric *q_to   = &state->quadrics[to];
+    SimplifyQuadric *q_from = &state->quadrics[from];
+    for(u32 m = 0; m < 10; ++m) {
+      q_to->m[m] += q_from->m[m];
+    }
+    q_to->weight += q_from->weight;
+    for(u32 axis = 0; axis < 3; ++axis) {
+      q_to->normal[axis] += q_from->normal[axis];
+    }
+
+    state->flags[from] |= SIMPLIFY_REMOVED;
+    state->flags[to] |= SIMPLIFY_TARGET;
+    *max_reached = MAX(*max_reached, cost);
+    applied++;
+  }
+
+  // Drop the triangles that collapsed
+  u32 live = 0;
+  for(u32 t = 0; t < state->tri_count; ++t) {
+    const u32 *tri = state->indices + 3 * t;
+    if(!simplify_degenerate(tri)) {
+      memmove(state->indices + 3 * live, tri, 3 * sizeof(u32));
+      memmove(state->normals + 3 * live, state->normals + 3 * t, 3 * sizeof(f32));
+      live++;
+    }
+  }
+  state->tri_count = live;
+  return applied;
+}
+
+bool mesh_simplify(Mesh *mesh, const SimplifyParams *params, Arena *scratch, f32 *out_error) {
+  if(out_error) {
+    *out_error = 0.0f;
+  }
+  u32 tri_count   = mesh->index_count / 3;
+  u32 target_tris = params->target_index_count / 3;
+  if(tri_count <= target_tris || mesh->vertex_count == 0) {
+    return true;
+  }
+
+  ArenaTemp     temp  = arena_temp_begin(scratch);
+  SimplifyState state = {
+    .vertices        = mesh->vertices,
+    .vertex_count    = mesh->vertex_count,
+    .indices         = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3),
+    .tri_count       = tri_count,
+    .normals         = ARENA_PUSH_ARRAY(scratch, f32, tri_count * 3),
+    .quadrics        = ARENA_PUSH_ARRAY(scratch, SimplifyQuadric, mesh->vertex_count),
+    .flags           = ARENA_PUSH_ARRAY(scratch, u8, mesh->vertex_count),
+    .adjacency_first = ARENA_PUSH_ARRAY(scratch, u32, mesh->vertex_count + 1),
+    .adjacency       = ARENA_PUSH_ARRAY(scratch, u32, tri_count * 3),
+    .collapses       = ARENA_PUSH_ARRAY(scratch, SimplifyCollapse, mesh->vertex_count),
+  };
+  if(!state.indices || !state.normals || !state.quadrics || !state.flags || !state.adjacency_first
+     || !state.adjacency || !state.collapses) {
+    LOG_ERROR("Failed to allocate simplification scratch for %u vertices", mesh->vertex_count);
+    arena_temp_end(temp);
+    return false;
+  }
+
+  for(u32 i = 0; i < tri_count * 3; ++i) {
+    state.indices[i] = mesh_index_get(mesh->indices, mesh->index_type, i);
+  }
+  for(u32 t = 0; t < tri_count; ++t) {
+    const u32 *tri = state.indices + 3 * t;
+    simplify_cross(mesh->vertices[tri[0]].position,
+                   mesh->vertices[tri[1]].position,
+                   mesh->vertices[tri[2]].position,
+                   state.normals + 3 * t);
+  }
+  memset(state.flags, 0, mesh->vertex_count);
+  simplify_plane_quadrics(&state);
+  simplify_build_adjacency(&state);
+  simplify_lock_border(&state);
+
+  f32 max_cost    = params->max_error > 0.0f ? params->max_error * params->max_error : FLT_MAX;
+  f32 max_reached = 0.0f;
+  while(state.tri_count > target_tris) {
+    if(simplify_pass(&state, target_tris, max_cost, &max_reached) == 0) {
+      break;
+    }
+  }
+
+  // Compact the surviving vertices in place, keeping their order
+  u32 *remap = state.adjacency_first;
+  memset(remap, 0xff, mesh->vertex_count * sizeof(u32));
+  for(u32 i = 0; i < state.tri_count * 3; ++i) {
+    remap[state.indices[i]] = 0;
+  }
+  u32 vertex_count = 0;
+  for(u32 v = 0; v < mesh->vertex_count; ++v) {
+    if(remap[v] == 0) {
+      remap[v]                       = vertex_count;
+      mesh->vertices[vertex_count++] = mesh->vertices[v];
+    }
+  }
+
+  IndexType index_type = mesh->index_type == INDEX_TYPE_U32 ? mesh_index_type_for(vertex_count) : mesh->index_type;
+  for(u32 i = 0; i < state.tri_count * 3; ++i) {
+    mesh_index_set(mesh->indices, index_type, i, remap[state.indices[i]]);
+  }
+
+  LOG_DEBUG("Simplified mesh from %u to %u triangles, %u to %u vertices, error %.4f",
+            tri_count,
+            state.tri_count,
+            mesh->vertex_count,
+            vertex_count,
+            sqrtf(max_reached));
+  mesh->vertex_count = vertex_count;
+  mesh->index_count  = state.tri_count * 3;
+  mesh->index_type   = index_type;
+  mesh_bounds_compute(&mesh->bounds, mesh->vertices[0].position, sizeof(Vertex), vertex_count);
+  if(out_error) {
+    *out_error = sqrtf(max_reached);
+  }
+
+  arena_temp_end(temp);
+  return true;
+}
+
+static void simplify_meshes(void *user, u32 begin, u32 end, u32 worker) {
+  SimplifyJob *job     = (SimplifyJob *)user;
+  Arena       *scratch = job_worker_scratch(worker);
+
+  for(u32 i = begin; i < end; ++i) {
+    f32 error = 0.0f;
+    if(!mesh_simplify(&job->meshes[i], job->params, scratch, &error)) {
+      SDL_SetAtomicInt(&job->failed, 1);
+    }
+    if(job->errors) {
+      job->errors[i] = error;
+    }
+  }
+}
+
+bool mesh_simplify_batch(Mesh *meshes, u32 count, const SimplifyParams *params, f32 *out_errors) {
+  SimplifyJob job;
+  job.meshes = meshes;
+  job.params = params;
+  job.errors = out_errors;
+  SDL_SetAtomicInt(&job.failed, 0);
+
+  job_parallel_for(count, 1, simplify_meshes, &job);
+  return SDL_GetAtomicInt(&job.failed) == 0;
+}
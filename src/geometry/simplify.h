@@ -0,0 +1,34 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "geometry/mesh.h"
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Quadric error metric (QEM) simplification of indexed triangle meshes. Terrain does not go
+// through here: distant terrain is coarsened by the CDLOD quadtree (see cdlod.h).
+// Edges collapse one endpoint onto the other, cheapest first.
+// The cost of a collapse is the area-weighted mean squared distance of the surviving vertex
+// to the planes of all triangles both endpoints have absorbed so far. Vertices are never
+// moved or created, so surviving vertices keep their exact position and color.
+//
+// Border vertices, on edges used by a single triangle, are locked along with the border
+// edges themselves: a mesh split into chunks and simplified chunk by chunk stays watertight.
+
+// Simplification stops at whichever limit is hit first; a zero disables that limit
+typedef struct SimplifyParams {
+  u32 target_index_count; // Stop once the mesh has at most this many indices
+  f32 max_error;          // Largest RMS distance from the absorbed triangles a collapse may reach
+} SimplifyParams;
+
+// Simplify a mesh in place: indices are rewritten, unused vertices compacted away and u32
+// indices narrowed when the remaining vertices allow it. Scratch memory comes from the
+// arena and is released before returning. out_error, if given, receives the largest error
+// reached. Returns false if scratch memory runs out, leaving the mesh untouched.
+bool mesh_simplify(Mesh *mesh, const SimplifyParams *params, Arena *scratch, f32 *out_error);
+
+// Simplify independent meshes in parallel, one job per mesh, each using its worker's
+// scratch arena. out_errors may be NULL. Returns false if any mesh failed.
+bool mesh_simplify_batch(Mesh *meshes, u32 count, const SimplifyParams *params, f32 *out_errors);
+
+#endif // SIMPLIFY_H
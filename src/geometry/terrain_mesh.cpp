@@ -0,0 +1,524 @@
+#include "terrain_mesh.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "geometry/mesh_optimize.h"
+#include "math/pack16.h"
+#include "math/simd.h"
+#include "utils/macros.h"
+
+#include <string.h>
+
+static_assert(TERRAIN_MESH_TILE_CELLS < 256, "grid positions must fit TerrainVertex's u8 grid");
+
+typedef struct TerrainMeshJob {
+  TerrainMesh          *terrain;
+  const Heightfield    *heightfield;
+  HeightfieldPlacement  placement;
+  bool                  indices; // Also write the index buffers
+  MpscQueue            *ready;   // Receives each finished tile, if set
+  const u32            *list;    // Tiles the job's range indexes; all tiles in order when NULL
+} TerrainMeshJob;
+
+// Central-difference inputs for up to four vertices of one row
+typedef struct TerrainMeshLanes {
+  F32x4 height;
+  F32x4 left;
+  F32x4 right;
+  F32x4 up;     // Row before
+  F32x4 down;   // Row after
+  F32x4 inv_dx; // 1 / world distance between left and right
+} TerrainMeshLanes;
+
+static size_t terrain_mesh_align(size_t bytes) { return (bytes + 15) & ~(size_t)15; }
+
+// Quantization range shared by every tile: the layer's range plus headroom for the
+// simulation to move heights without leaving it
+static void terrain_mesh_height_range(TerrainMesh *terrain, const Heightfield *heightfield) {
+  const f32 *height = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  f32        lo     = 0.0f;
+  f32        hi     = 0.0f;
+  unorm16_range(height, heightfield_cell_count(heightfield), &lo, &hi);
+  f32 margin            = MAX((hi - lo) * TERRAIN_MESH_HEIGHT_HEADROOM, 1.0f);
+  terrain->height_min   = lo - margin;
+  terrain->height_scale = unorm16_scale(lo - margin, hi + margin);
+}
+
+// Vertices per side of a tile; the last row and column of tiles may be narrower
+static void
+terrain_mesh_tile_size(const TerrainMesh *terrain, const Heightfield *heightfield, u32 tile, u32 *out_w, u32 *out_h) {
+  u32 x0 = (tile % terrain->tiles_x) * TERRAIN_MESH_TILE_CELLS;
+  u32 y0 = (tile / terrain->tiles_x) * TERRAIN_MESH_TILE_CELLS;
+  *out_w = MIN((u32)TERRAIN_MESH_TILE_CELLS, heightfield->width - 1 - x0) + 1;
+  *out_h = MIN((u32)TERRAIN_MESH_TILE_CELLS, heightfield->height - 1 - y0) + 1;
+}
+
+// Newest stamp of the height and water tiles a mesh tile reads. Its samples and their
+// neighbours reach one sample past its cells on every side, so into the heightfield tiles
+// around the one it is aligned with.
+static u64 terrain_mesh_source_version(const TerrainMesh *terrain, const Heightfield *heightfield, u32 tile) {
+  u32 tx      = tile % terrain->tiles_x;
+  u32 ty      = tile / terrain->tiles_x;
+  u32 x_last  = MIN(tx + 1, heightfield->tiles_x - 1);
+  u32 y_last  = MIN(ty + 1, heightfield->tiles_y - 1);
+  u64 version = 0;
+  for(u32 y = ty > 0 ? ty - 1 : 0; y <= y_last; ++y) {
+    for(u32 x = tx > 0 ? tx - 1 : 0; x <= x_last; ++x) {
+      u32 source = y * heightfield->tiles_x + x;
+      version    = MAX(version, heightfield->tile_version[HEIGHTFIELD_LAYER_HEIGHT][source]);
+      version    = MAX(version, heightfield->tile_version[HEIGHTFIELD_LAYER_WATER][source]);
+    }
+  }
+  return version;
+}
+
+// Encode and write count (<= 4) vertices starting at tile column c of row r
+static void terrain_mesh_write(TerrainVertex          *out,
+                               const TerrainMeshLanes *lanes,
+                               F32x4                   inv_dz,
+                               const TerrainTile      *tile,
+                               const f32              *water,
+                               u32                     c,
+                               u32                     r,
+                               u32                     count) {
+  F32x4 grad_x = f32x4_mul(f32x4_sub(lanes->right, lanes->left), lanes->inv_dx);
+  F32x4 grad_z = f32x4_mul(f32x4_sub(lanes->down, lanes->up), inv_dz);
+  F32x4 zero   = f32x4_set1(0.0f);
+
+  // Octahedral projection of the normal (-dh/dx, 1, -dh/dz): divide by its L1 norm. The
+  // normal of a heightfield always points up, so the lower hemisphere fold is never needed.
+  F32x4 abs_x  = f32x4_max(grad_x, f32x4_sub(zero, grad_x));
+  F32x4 abs_z  = f32x4_max(grad_z, f32x4_sub(zero, grad_z));
+  F32x4 inv_l1 = f32x4_div(f32x4_set1(-127.0f), f32x4_add(f32x4_add(abs_x, abs_z), f32x4_set1(1.0f)));
+
+  // Round to snorm8, biased by 128 so the truncating conversion sees positive lanes
+  F32x4 bias = f32x4_set1(128.5f);
+  u32   oct_x[4];
+  u32   oct_z[4];
+  u32   height[4];
+  u32x4_store(oct_x, u32x4_from_f32x4(f32x4_add(f32x4_mul(grad_x, inv_l1), bias)));
+  u32x4_store(oct_z, u32x4_from_f32x4(f32x4_add(f32x4_mul(grad_z, inv_l1), bias)));
+
+  F32x4 inv_scale = f32x4_set1(tile->height_scale > 0.0f ? 1.0f / tile->height_scale : 0.0f);
+  F32x4 quantized = f32x4_mul(f32x4_sub(lanes->height, f32x4_set1(tile->height_min)), inv_scale);
+  F32x4 rounded   = f32x4_max(f32x4_add(quantized, f32x4_set1(0.5f)), f32x4_set1(0.0f));
+  u32x4_store(height, u32x4_from_f32x4(f32x4_min(rounded, f32x4_set1(65535.0f))));
+
+  for(u32 i = 0; i < count; ++i) {
+    out[i] = TerrainVertex{
+      .height   = (u16)height[i],
+      .normal   = {(u8)(oct_x[i] ^ 0x80), (u8)(oct_z[i] ^ 0x80)},
+      .grid     = {(u8)(c + i), (u8)r},
+      .material = (u8)(water[i] > TERRAIN_MESH_WATER_DEPTH ? TERRAIN_MATERIAL_WET : TERRAIN_MATERIAL_GROUND),
+      .reserved = 0,
+    };
+  }
+}
+
+// Bound the tile and its clusters by the positions the shader decodes from its vertices
+static void terrain_mesh_tile_bounds(TerrainTile *tile, Arena *scratch) {
+  ArenaTemp temp      = arena_temp_begin(scratch);
+  f32      *positions = ARENA_PUSH_ARRAY(scratch, f32, (size_t)tile->vertex_count * 3);
+  if(!positions) {
+    // Fall back to the box the quantization range allows, with the tile drawn whole
+    u32 rows       = tile->vertex_count / tile->columns;
+    f32 corners[6] = {
+      tile->origin[0],
+      tile->height_min,
+      tile->origin[1],
+      tile->origin[0] + (f32)(tile->columns - 1) * tile->cell_size,
+      tile->height_min + 65535.0f * tile->height_scale,
+      tile->origin[1] + (f32)(rows - 1) * tile->cell_size,
+    };
+    LOG_WARN("Failed to allocate terrain tile bounds scratch, drawing the tile whole");
+    mesh_bounds_compute(&tile->bounds, corners, 3 * sizeof(f32), 2);
+    tile->clusters.meshlet_count = 0;
+    arena_temp_end(temp);
+    return;
+  }
+
+  for(u32 v = 0; v < tile->vertex_count; ++v) {
+    const TerrainVertex *vertex = &tile->vertices[v];
+    positions[3 * v + 0]        = tile->origin[0] + (f32)vertex->grid[0] * tile->cell_size;
+    positions[3 * v + 1]        = tile->height_min + (f32)vertex->height * tile->height_scale;
+    positions[3 * v + 2]        = tile->origin[1] + (f32)vertex->grid[1] * tile->cell_size;
+  }
+  mesh_bounds_compute(&tile->bounds, positions, 3 * sizeof(f32), tile->vertex_count);
+  meshlet_update_bounds(&tile->clusters, positions, 3 * sizeof(f32), tile->clusters.bounds);
+  arena_temp_end(temp);
+}
+
+static void terrain_mesh_tile_vertices(const TerrainMeshJob *job, u32 tile_index, Arena *scratch) {
+  const Heightfield          *heightfield = job->heightfield;
+  const HeightfieldPlacement *placement   = &job->placement;
+  const f32                  *height      = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  const f32                  *water       = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_WATER);
+  TerrainTile                *tile        = &job->terrain->tiles[tile_index];
+
+  u32 width  = heightfield->width;
+  u32 x0     = (tile_index % job->terrain->tiles_x) * TERRAIN_MESH_TILE_CELLS;
+  u32 y0     = (tile_index / job->terrain->tiles_x) * TERRAIN_MESH_TILE_CELLS;
+  u32 tile_w = 0;
+  u32 tile_h = 0;
+  terrain_mesh_tile_size(job->terrain, heightfield, tile_index, &tile_w, &tile_h);
+
+  tile->origin[0]    = placement->origin_x + (f32)x0 * placement->cell_size;
+  tile->origin[1]    = placement->origin_z + (f32)y0 * placement->cell_size;
+  tile->cell_size    = placement->cell_size;
+  tile->height_min   = job->terrain->height_min;
+  tile->height_scale = job->terrain->height_scale;
+  tile->version      = terrain_mesh_source_version(job->terrain, heightfield, tile_index);
+
+  // Border samples fall back to one-sided differences over their single neighbour
+  F32x4 interior_dx = f32x4_set1(0.5f / placement->cell_size);
+  for(u32 r = 0; r < tile_h; ++r) {
+    u32            y      = y0 + r;
+    u32            above  = y > 0 ? y - 1 : y;
+    u32            below  = MIN(y + 1, heightfield->height - 1);
+    const f32     *row    = height + (size_t)y * width;
+    const f32     *up     = height + (size_t)above * width;
+    const f32     *down   = height + (size_t)below * width;
+    const f32     *wet    = water + (size_t)y * width;
+    F32x4          inv_dz = f32x4_set1(1.0f / ((f32)(below - above) * placement->cell_size));
+    TerrainVertex *out    = tile->vertices + (size_t)r * tile_w;
+
+    for(u32 c = 0; c < tile_w; c += SIMD_WIDTH) {
+      u32              x     = x0 + c;
+      u32              count = MIN(tile_w - c, (u32)SIMD_WIDTH);
+      TerrainMeshLanes lanes;
+      if(x > 0 && x + SIMD_WIDTH < width) {
+        lanes = TerrainMeshLanes{
+          .height = f32x4_load(row + x),
+          .left   = f32x4_load(row + x - 1),
+          .right  = f32x4_load(row + x + 1),
+          .up     = f32x4_load(up + x),
+          .down   = f32x4_load(down + x),
+          .inv_dx = interior_dx,
+        };
+      } else {
+        f32 h[4], l[4], rt[4], u[4], d[4], inv[4];
+        for(u32 i = 0; i < SIMD_WIDTH; ++i) {
+          u32 sx    = MIN(x + i, width - 1);
+          u32 left  = sx > 0 ? sx - 1 : sx;
+          u32 right = MIN(sx + 1, width - 1);
+          h[i]      = row[sx];
+          l[i]      = row[left];
+          rt[i]     = row[right];
+          u[i]      = up[sx];
+          d[i]      = down[sx];
+          inv[i]    = 1.0f / ((f32)(right - left) * placement->cell_size);
+        }
+        lanes = TerrainMeshLanes{
+          .height = f32x4_load(h),
+          .left   = f32x4_load(l),
+          .right  = f32x4_load(rt),
+          .up     = f32x4_load(u),
+          .down   = f32x4_load(d),
+          .inv_dx = f32x4_load(inv),
+        };
+      }
+      terrain_mesh_write(out + c, &lanes, inv_dz, tile, wet + x, c, r, count);
+    }
+  }
+
+  terrain_mesh_tile_bounds(tile, scratch);
+}
+
+static void terrain_mesh_tile_indices(const TerrainMeshJob *job, u32 tile_index, Arena *scratch) {
+  TerrainTile *tile   = &job->terrain->tiles[tile_index];
+  u32          tile_w = 0;
+  u32          tile_h = 0;
+  terrain_mesh_tile_size(job->terrain, job->heightfield, tile_index, &tile_w, &tile_h);
+
+  u32 n = 0;
+  for(u32 cy = 0; cy + 1 < tile_h; ++cy) {
+    for(u32 cx = 0; cx + 1 < tile_w; ++cx) {
+      u32 v00       = cy * tile_w + cx;
+      u32 v10       = v00 + 1;
+      u32 v01       = v00 + tile_w;
+      u32 v11       = v01 + 1;
+      u32 corner[6] = {v00, v11, v10, v00, v01, v11};
+      for(u32 k = 0; k < 6; ++k) {
+        mesh_index_set(tile->indices, tile->index_type, n++, corner[k]);
+      }
+    }
+  }
+
+  // Row order reuses little of the post-transform cache. Vertices stay in row order, which
+  // terrain_mesh_update relies on; the reordered triangles still fetch them nearly in order.
+  // The first tile reports how much the reorder saves.
+  VertexCacheStats before = {};
+  if(tile_index == 0) {
+    before = mesh_analyze_vertex_cache(tile->indices, tile->index_type, tile->index_count, tile->vertex_count, scratch);
+  }
+  if(!mesh_optimize_vertex_cache(tile->indices, tile->index_type, tile->index_count, tile->vertex_count, scratch)) {
+    return;
+  }
+  if(tile_index == 0) {
+    VertexCacheStats after
+      = mesh_analyze_vertex_cache(tile->indices, tile->index_type, tile->index_count, tile->vertex_count, scratch);
+    LOG_INFO("Terrain tile indices: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+             before.acmr,
+             after.acmr,
+             before.atvr,
+             after.atvr);
+  }
+}
+
+// Split a template's triangles into the clusters every tile of its size shares, rewriting its
+// indices in their order. The partition only depends on the triangles, so a flat grid stands
+// in for the positions until each tile's job bounds the clusters by its own vertices.
+static void terrain_mesh_tile_clusters(TerrainTile *tile, Arena *arena, Arena *scratch) {
+  ArenaTemp temp  = arena_temp_begin(scratch);
+  f32      *flat  = ARENA_PUSH_ARRAY(scratch, f32, (size_t)tile->vertex_count * 3);
+  bool      built = false;
+  if(flat) {
+    for(u32 v = 0; v < tile->vertex_count; ++v) {
+      flat[3 * v + 0] = (f32)(v % tile->columns);
+      flat[3 * v + 1] = 0.0f;
+      flat[3 * v + 2] = (f32)(v / tile->columns);
+    }
+    built = meshlet_build(&tile->clusters,
+                          tile->indices,
+                          tile->index_type,
+                          tile->index_count,
+                          flat,
+                          3 * sizeof(f32),
+                          tile->vertex_count,
+                          arena,
+                          scratch);
+  }
+  arena_temp_end(temp);
+
+  if(!built) {
+    LOG_WARN("Failed to build clusters for %u-column terrain tiles, drawing them whole", tile->columns);
+    tile->clusters = MeshletSet{};
+  }
+}
+
+// Tiles of the same size have the same triangles, so only the first of each size (at most
+// four: full, last column, last row and the corner) builds them and the rest copy
+static u32 terrain_mesh_index_template(const TerrainMesh *terrain, u32 tile) {
+  u32 tx = tile % terrain->tiles_x;
+  u32 ty = tile / terrain->tiles_x;
+  return (ty + 1 == terrain->tiles_y ? ty : 0) * terrain->tiles_x + (tx + 1 == terrain->tiles_x ? tx : 0);
+}
+
+static void terrain_mesh_tiles(void *user, u32 begin, u32 end, u32 worker) {
+  const TerrainMeshJob *job     = (const TerrainMeshJob *)user;
+  Arena                *scratch = job_worker_scratch(worker);
+
+  for(u32 i = begin; i < end; ++i) {
+    u32 tile = job->list ? job->list[i] : i;
+    terrain_mesh_tile_vertices(job, tile, scratch);
+
+    u32 source = terrain_mesh_index_template(job->terrain, tile);
+    if(job->indices && source != tile) {
+      const TerrainTile *from = &job->terrain->tiles[source];
+      TerrainTile       *to   = &job->terrain->tiles[tile];
+      memcpy(to->indices, from->indices, to->index_count * mesh_index_size(to->index_type));
+    }
+
+    if(job->ready && !mpsc_queue_push(job->ready, &job->terrain->tiles[tile])) {
+      LOG_ERROR("Terrain tile queue full, tile %u is lost", tile);
+    }
+  }
+}
+
+// Lay out the tiles in one allocation and build the index and cluster templates, leaving the
+// vertices, bounds and the other tiles' indices to terrain_mesh_tiles
+static bool terrain_mesh_allocate(const TerrainMeshJob *job, Arena *arena) {
+  TerrainMesh       *terrain     = job->terrain;
+  const Heightfield *heightfield = job->heightfield;
+  *terrain                       = TerrainMesh{};
+  if(heightfield->width < 2 || heightfield->height < 2) {
+    LOG_ERROR("Cannot mesh a %ux%u heightfield", heightfield->width, heightfield->height);
+    return false;
+  }
+
+  terrain_mesh_height_range(terrain, heightfield);
+
+  terrain->tiles_x    = (heightfield->width - 2) / TERRAIN_MESH_TILE_CELLS + 1;
+  terrain->tiles_y    = (heightfield->height - 2) / TERRAIN_MESH_TILE_CELLS + 1;
+  terrain->tile_count = terrain->tiles_x * terrain->tiles_y;
+
+  size_t vertex_total = 0;
+  size_t index_total  = 0;
+  size_t index_bytes  = 0;
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    u32 tile_w = 0;
+    u32 tile_h = 0;
+    terrain_mesh_tile_size(terrain, heightfield, tile, &tile_w, &tile_h);
+    size_t tile_indices = (size_t)(tile_w - 1) * (tile_h - 1) * 6;
+    vertex_total += (size_t)tile_w * tile_h;
+    index_total += tile_indices;
+    index_bytes += terrain_mesh_align(tile_indices * mesh_index_size(mesh_index_type_for(tile_w * tile_h)));
+  }
+  if(index_total > 0xffffffffu) {
+    LOG_ERROR("Terrain mesh of %ux%u has too many indices", heightfield->width, heightfield->height);
+    return false;
+  }
+
+  // Tile headers, vertices and indices share one block
+  size_t tiles_bytes  = terrain_mesh_align(terrain->tile_count * sizeof(TerrainTile));
+  size_t vertex_bytes = terrain_mesh_align(vertex_total * sizeof(TerrainVertex));
+  u8    *block        = (u8 *)arena_alloc_aligned(arena, tiles_bytes + vertex_bytes + index_bytes, 16);
+  if(!block) {
+    LOG_ERROR("Failed to allocate terrain mesh (%zu vertices, %zu indices)", vertex_total, index_total);
+    return false;
+  }
+  terrain->tiles        = (TerrainTile *)block;
+  terrain->vertices     = (TerrainVertex *)(block + tiles_bytes);
+  terrain->indices      = block + tiles_bytes + vertex_bytes;
+  terrain->vertex_count = (u32)vertex_total;
+  terrain->index_count  = (u32)index_total;
+
+  TerrainVertex *vertices = terrain->vertices;
+  u8            *indices  = (u8 *)terrain->indices;
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    u32 tile_w = 0;
+    u32 tile_h = 0;
+    terrain_mesh_tile_size(terrain, heightfield, tile, &tile_w, &tile_h);
+
+    TerrainTile *mesh  = &terrain->tiles[tile];
+    *mesh              = TerrainTile{};
+    mesh->vertices     = vertices;
+    mesh->vertex_count = tile_w * tile_h;
+    mesh->indices      = indices;
+    mesh->index_count  = (tile_w - 1) * (tile_h - 1) * 6;
+    mesh->index_type   = mesh_index_type_for(mesh->vertex_count);
+    mesh->columns      = tile_w;
+    vertices += mesh->vertex_count;
+    indices += terrain_mesh_align(mesh->index_count * mesh_index_size(mesh->index_type));
+  }
+
+  Arena *scratch = job_worker_scratch(job_current_worker());
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    if(terrain_mesh_index_template(terrain, tile) == tile) {
+      terrain_mesh_tile_indices(job, tile, scratch);
+      terrain_mesh_tile_clusters(&terrain->tiles[tile], arena, scratch);
+    }
+  }
+
+  // The other tiles share their template's partition with bounds of their own
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    u32 source = terrain_mesh_index_template(terrain, tile);
+    if(source == tile || terrain->tiles[source].clusters.meshlet_count == 0) {
+      continue;
+    }
+    TerrainTile *mesh     = &terrain->tiles[tile];
+    mesh->clusters        = terrain->tiles[source].clusters;
+    mesh->clusters.bounds = ARENA_PUSH_ARRAY(arena, MeshletBounds, mesh->clusters.meshlet_count);
+    if(!mesh->clusters.bounds) {
+      LOG_ERROR("Failed to allocate cluster bounds for terrain tile %u", tile);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool terrain_mesh_create(TerrainMesh                *terrain,
+                         const Heightfield          *heightfield,
+                         const HeightfieldPlacement *placement,
+                         Arena                      *arena) {
+  TerrainMeshJob job = {
+    .terrain     = terrain,
+    .heightfield = heightfield,
+    .placement   = *placement,
+    .indices     = true,
+    .ready       = NULL,
+    .list        = NULL,
+  };
+  if(!terrain_mesh_allocate(&job, arena)) {
+    return false;
+  }
+  job_parallel_for(terrain->tile_count, 1, terrain_mesh_tiles, &job);
+
+  LOG_DEBUG("Terrain mesh created: %u tiles, %u vertices, %u indices", terrain->tile_count, terrain->vertex_count,
+            terrain->index_count);
+  return true;
+}
+
+bool terrain_mesh_create_async(TerrainMesh                *terrain,
+                               const Heightfield          *heightfield,
+                               const HeightfieldPlacement *placement,
+                               Arena                      *arena,
+                               MpscQueue                  *ready,
+                               JobCounter                 *counter) {
+  // The jobs outlive this call, so their parameters live in the arena
+  TerrainMeshJob *job = ARENA_PUSH_STRUCT(arena, TerrainMeshJob);
+  if(!job) {
+    LOG_ERROR("Failed to allocate terrain mesh job");
+    return false;
+  }
+  *job = TerrainMeshJob{
+    .terrain     = terrain,
+    .heightfield = heightfield,
+    .placement   = *placement,
+    .indices     = true,
+    .ready       = ready,
+    .list        = NULL,
+  };
+  if(!terrain_mesh_allocate(job, arena) || !mpsc_queue_create(ready, terrain->tile_count, arena)) {
+    return false;
+  }
+
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    job_submit(terrain_mesh_tiles, job, tile, tile + 1, counter);
+  }
+  LOG_DEBUG("Terrain mesh streaming: %u tiles, %u vertices, %u indices", terrain->tile_count, terrain->vertex_count,
+            terrain->index_count);
+  return true;
+}
+
+void terrain_mesh_update(TerrainMesh *terrain, const Heightfield *heightfield, const HeightfieldPlacement *placement) {
+  if(!terrain->tiles) {
+    return;
+  }
+
+  TerrainMeshJob job = {
+    .terrain     = terrain,
+    .heightfield = heightfield,
+    .placement   = *placement,
+    .indices     = false,
+    .ready       = NULL,
+    .list        = NULL,
+  };
+  terrain_mesh_height_range(terrain, heightfield);
+  job_parallel_for(terrain->tile_count, 1, terrain_mesh_tiles, &job);
+}
+
+bool terrain_mesh_tile_stale(const TerrainMesh *terrain, const Heightfield *heightfield, u32 tile) {
+  return tile < terrain->tile_count
+         && terrain->tiles[tile].version < terrain_mesh_source_version(terrain, heightfield, tile);
+}
+
+bool terrain_mesh_update_tiles(TerrainMesh                *terrain,
+                               const Heightfield          *heightfield,
+                               const HeightfieldPlacement *placement,
+                               const u32                  *tiles,
+                               u32                         count) {
+  if(!terrain->tiles || count == 0) {
+    return false;
+  }
+
+  // Heights outside the shared range would clamp, so leaving it re-quantizes every tile
+  const f32 *height = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  f32        lo     = 0.0f;
+  f32        hi     = 0.0f;
+  unorm16_range(height, heightfield_cell_count(heightfield), &lo, &hi);
+  if(lo < terrain->height_min || hi > terrain->height_min + 65535.0f * terrain->height_scale) {
+    terrain_mesh_update(terrain, heightfield, placement);
+    return true;
+  }
+
+  TerrainMeshJob job = {
+    .terrain     = terrain,
+    .heightfield = heightfield,
+    .placement   = *placement,
+    .indices     = false,
+    .ready       = NULL,
+    .list        = tiles,
+  };
+  job_parallel_for(count, 1, terrain_mesh_tiles, &job);
+  return false;
+}
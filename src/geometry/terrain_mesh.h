@@ -0,0 +1,106 @@
+#ifndef TERRAIN_MESH_H
+#define TERRAIN_MESH_H
+
+#include "core/job.h"
+#include "core/mpsc_queue.h"
+#include "geometry/mesh.h"
+#include "geometry/meshlet.h"
+#include "geometry/vertex.h"
+#include "memory/arena.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Heightfield meshing: one mesh per block of TERRAIN_MESH_TILE_CELLS x TERRAIN_MESH_TILE_CELLS
+// cells, aligned with the heightfield's tiles and built in parallel, one job per tile.
+// Vertices sit on the samples at the heightfield's world placement. Each cell is two
+// triangles split along the diagonal from sample (x, y) to (x + 1, y + 1), counter-clockwise
+// seen from above, and the triangles of each tile are ordered for the post-transform vertex
+// cache. Normals come from central differences of the height layer.
+//
+// The jobs also decode the positions they wrote to bound each tile and its clusters, so a
+// finished tile only has to be copied to the GPU. Tiles of the same size share one cluster
+// partition, built with their indices, and keep their own cluster bounds.
+//
+// Tiles use the compact TerrainVertex: a third of the size of Vertex, with everything the
+// shader needs to rebuild position and color from the tile's decode parameters. Heights are
+// quantized over one range shared by every tile, so the samples on an edge two tiles share
+// decode to the same height in both and the tiles meet without cracks.
+
+#define TERRAIN_MESH_TILE_CELLS HEIGHTFIELD_TILE_SIZE
+
+// Headroom above and below the heights when the shared quantization range is picked, as a
+// fraction of their span
+#define TERRAIN_MESH_HEIGHT_HEADROOM 0.25f
+
+// Water deeper than this marks a vertex as wet
+#define TERRAIN_MESH_WATER_DEPTH 1e-3f
+
+typedef enum TerrainMaterial {
+  TERRAIN_MATERIAL_GROUND = 0, // Grass blending into rock with slope
+  TERRAIN_MATERIAL_WET,        // Under standing or flowing water
+} TerrainMaterial;
+
+typedef struct TerrainTile {
+  TerrainVertex *vertices;
+  u32            vertex_count;
+  void          *indices; // u16 whenever the tile's vertices allow it
+  u32            index_count;
+  IndexType      index_type;
+  u32            columns;      // Vertices per row
+  f32            origin[2];    // World XZ of grid position (0, 0)
+  f32            cell_size;    // World distance between neighbouring vertices
+  f32            height_min;   // height = height_min + vertex.height * height_scale
+  f32            height_scale;
+  MeshBounds     bounds;       // World-space bounds of the decoded vertices
+  MeshletSet     clusters;     // In index order; empty when the tile is drawn whole
+  u64            version;      // Newest heightfield tile stamp the vertices were built from
+} TerrainTile;
+
+typedef struct TerrainMesh {
+  TerrainTile   *tiles; // Row-major, tiles_x * tiles_y
+  u32            tiles_x;
+  u32            tiles_y;
+  u32            tile_count;
+  u32            vertex_count; // Totals over all tiles
+  u32            index_count;
+  TerrainVertex *vertices; // Storage the tiles point into, from a single allocation
+  void          *indices;
+  f32            height_min;   // Quantization range of every tile, picked when the tiles are
+  f32            height_scale; // created or all rebuilt
+} TerrainMesh;
+
+// Allocate and build the meshes for the whole heightfield (at least 2x2 samples)
+bool terrain_mesh_create(TerrainMesh                *terrain,
+                         const Heightfield          *heightfield,
+                         const HeightfieldPlacement *placement,
+                         Arena                      *arena);
+
+// Allocate the meshes and build them in the background instead, one job per tile on counter.
+// Each finished tile is pushed to ready, created here with room for every tile; until then
+// only its layout (columns, vertex and index counts) is valid. The heightfield must not
+// change before the last tile arrives.
+bool terrain_mesh_create_async(TerrainMesh                *terrain,
+                               const Heightfield          *heightfield,
+                               const HeightfieldPlacement *placement,
+                               Arena                      *arena,
+                               MpscQueue                  *ready,
+                               JobCounter                 *counter);
+
+// Rebuild the vertices and decode parameters of every tile from the current height and
+// water layers, over a new shared range. Indices never change.
+void terrain_mesh_update(TerrainMesh *terrain, const Heightfield *heightfield, const HeightfieldPlacement *placement);
+
+// Whether the height or water samples a tile reads (its own and the neighbouring ones its
+// normals use) changed after the tile was built
+bool terrain_mesh_tile_stale(const TerrainMesh *terrain, const Heightfield *heightfield, u32 tile);
+
+// Rebuild the vertices, bounds and cluster bounds of count tiles, in parallel. When the
+// heights have left the shared range it is widened and every tile is rebuilt instead, which
+// is reported by returning true.
+bool terrain_mesh_update_tiles(TerrainMesh                *terrain,
+                               const Heightfield          *heightfield,
+                               const HeightfieldPlacement *placement,
+                               const u32                  *tiles,
+                               u32                         count);
+
+#endif // TERRAIN_MESH_H
@@ -0,0 +1,304 @@
+#include "terrain_stitch.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "geometry/mesh_optimize.h"
+#include "utils/macros.h"
+
+#include <math.h>
+#include <string.h>
+
+static_assert((TERRAIN_MESH_TILE_CELLS + 1) * (TERRAIN_MESH_TILE_CELLS + 1) <= MESH_U16_MAX_VERTICES,
+              "tile vertices must be addressable with u16 indices");
+static_assert(TERRAIN_STITCH_VARIANTS == 16, "one variant per combination of the four edges");
+
+#define TERRAIN_STITCH_MAX_LINES (TERRAIN_MESH_TILE_CELLS + 1)
+
+// Triangles of one variant are written to out, or only counted when it is NULL
+typedef struct TerrainStitchWriter {
+  u16 *out;
+  u32  count;
+  u32  columns;
+} TerrainStitchWriter;
+
+// One side of the border ring: vertex at position `along` of the side lies at
+// (along, fixed), or (fixed, along) for vertical sides
+typedef struct TerrainStitchSide {
+  u32  fixed;
+  bool vertical;
+} TerrainStitchSide;
+
+// Grid lines every stride cells from 0, always ending on the last one
+static u32 terrain_stitch_lines(u32 cells, u32 stride, u32 *out) {
+  u32 count = 0;
+  for(u32 p = 0; p < cells; p += stride) {
+    out[count++] = p;
+  }
+  out[count++] = cells;
+  return count;
+}
+
+// Emit a triangle counter-clockwise seen from above, like the tile's own: clockwise in
+// (column, row) coordinates, where rows run towards +Z
+static void terrain_stitch_emit(TerrainStitchWriter *writer, u32 a, u32 b, u32 c) {
+  i32 ax    = (i32)(a % writer->columns);
+  i32 ay    = (i32)(a / writer->columns);
+  i32 bx    = (i32)(b % writer->columns);
+  i32 by    = (i32)(b / writer->columns);
+  i32 cx    = (i32)(c % writer->columns);
+  i32 cy    = (i32)(c / writer->columns);
+  i32 cross = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+  if(cross == 0) {
+    return;
+  }
+  if(cross > 0) {
+    u32 swap = b;
+    b        = c;
+    c        = swap;
+  }
+  if(writer->out) {
+    writer->out[writer->count + 0] = (u16)a;
+    writer->out[writer->count + 1] = (u16)b;
+    writer->out[writer->count + 2] = (u16)c;
+  }
+  writer->count += 3;
+}
+
+static u32 terrain_stitch_vertex(const TerrainStitchWriter *writer, TerrainStitchSide side, u32 along) {
+  return side.vertical ? along * writer->columns + side.fixed : side.fixed * writer->columns + along;
+}
+
+// Triangulate the strip between a tile edge and the first grid line inside it, walking both
+// in step so each triangle spans neighbouring vertices of the two
+static void terrain_stitch_zip(TerrainStitchWriter *writer,
+                               TerrainStitchSide    outer_side,
+                               const u32           *outer,
+                               u32                  outer_count,
+                               TerrainStitchSide    inner_side,
+                               const u32           *inner,
+                               u32                  inner_count) {
+  u32 i = 0;
+  u32 j = 0;
+  while(i + 1 < outer_count || j + 1 < inner_count) {
+    u32 o = terrain_stitch_vertex(writer, outer_side, outer[i]);
+    u32 n = terrain_stitch_vertex(writer, inner_side, inner[j]);
+    if(j + 1 == inner_count || (i + 1 < outer_count && outer[i + 1] <= inner[j + 1])) {
+      terrain_stitch_emit(writer, o, terrain_stitch_vertex(writer, outer_side, outer[++i]), n);
+    } else {
+      terrain_stitch_emit(writer, o, n, terrain_stitch_vertex(writer, inner_side, inner[++j]));
+    }
+  }
+}
+
+// Build (or count) one variant: a regular grid at the LOD's stride inside a one-cell ring,
+// and the ring zipped to edges at the same stride or, where stitched, twice it. Needs at
+// least two cells per side at the stride.
+static u32 terrain_stitch_build(u16 *out, u32 columns, u32 rows, u32 lod, u32 mask) {
+  u32 xs[TERRAIN_STITCH_MAX_LINES];
+  u32 ys[TERRAIN_STITCH_MAX_LINES];
+  u32 stride = 1u << lod;
+  u32 nx     = terrain_stitch_lines(columns - 1, stride, xs);
+  u32 ny     = terrain_stitch_lines(rows - 1, stride, ys);
+
+  TerrainStitchWriter writer = {
+    .out     = out,
+    .count   = 0,
+    .columns = columns,
+  };
+
+  for(u32 j = 1; j + 2 < ny; ++j) {
+    for(u32 i = 1; i + 2 < nx; ++i) {
+      u32 v00 = ys[j] * columns + xs[i];
+      u32 v10 = ys[j] * columns + xs[i + 1];
+      u32 v01 = ys[j + 1] * columns + xs[i];
+      u32 v11 = ys[j + 1] * columns + xs[i + 1];
+      terrain_stitch_emit(&writer, v00, v11, v10);
+      terrain_stitch_emit(&writer, v00, v01, v11);
+    }
+  }
+
+  u32 coarse_xs[TERRAIN_STITCH_MAX_LINES];
+  u32 coarse_ys[TERRAIN_STITCH_MAX_LINES];
+  u32 coarse_nx = terrain_stitch_lines(columns - 1, stride * 2, coarse_xs);
+  u32 coarse_ny = terrain_stitch_lines(rows - 1, stride * 2, coarse_ys);
+
+  // Each side's edge runs corner to corner; the line inside it stops at the inner corners
+  struct {
+    u32               mask;
+    TerrainStitchSide outer;
+    TerrainStitchSide inner;
+  } sides[4] = {
+    {TERRAIN_STITCH_WEST, {0, true}, {xs[1], true}},
+    {TERRAIN_STITCH_EAST, {xs[nx - 1], true}, {xs[nx - 2], true}},
+    {TERRAIN_STITCH_NORTH, {0, false}, {ys[1], false}},
+    {TERRAIN_STITCH_SOUTH, {ys[ny - 1], false}, {ys[ny - 2], false}},
+  };
+  for(u32 s = 0; s < 4; ++s) {
+    bool       vertical    = sides[s].outer.vertical;
+    bool       coarse      = (mask & sides[s].mask) != 0;
+    const u32 *fine        = vertical ? ys : xs;
+    u32        fine_count  = vertical ? ny : nx;
+    const u32 *outer       = coarse ? (vertical ? coarse_ys : coarse_xs) : fine;
+    u32        outer_count = coarse ? (vertical ? coarse_ny : coarse_nx) : fine_count;
+    terrain_stitch_zip(&writer, sides[s].outer, outer, outer_count, sides[s].inner, fine + 1, fine_count - 2);
+  }
+  return writer.count;
+}
+
+static void terrain_stitch_variants(void *user, u32 begin, u32 end, u32 worker) {
+  TerrainStitch *stitch  = (TerrainStitch *)user;
+  Arena         *scratch = job_worker_scratch(worker);
+  const u32      per_set = TERRAIN_STITCH_LOD_COUNT * TERRAIN_STITCH_VARIANTS;
+
+  for(u32 v = begin; v < end; ++v) {
+    const TerrainStitchSet *set  = &stitch->sets[v / per_set];
+    u32                     lod  = v % per_set / TERRAIN_STITCH_VARIANTS;
+    u32                     mask = v % TERRAIN_STITCH_VARIANTS;
+    if(lod >= set->lod_count) {
+      continue;
+    }
+
+    u16 *out = stitch->indices + set->first[lod][mask];
+    terrain_stitch_build(out, set->columns, set->rows, lod, mask);
+
+    // Unoptimized indices still draw correctly, so a failure here is not fatal
+    mesh_optimize_vertex_cache(out, INDEX_TYPE_U16, set->count[lod][mask], set->columns * set->rows, scratch);
+  }
+}
+
+bool terrain_stitch_create(TerrainStitch *stitch, const TerrainMesh *terrain, f32 lod0_range, Arena *arena) {
+  *stitch             = TerrainStitch{};
+  stitch->tiles_x     = terrain->tiles_x;
+  stitch->tiles_y     = terrain->tiles_y;
+  stitch->tile_count  = terrain->tile_count;
+  stitch->lod0_range  = lod0_range;
+  stitch->tile_set    = ARENA_PUSH_ARRAY(arena, u8, terrain->tile_count);
+  stitch->tile_lod    = ARENA_PUSH_ARRAY(arena, u8, terrain->tile_count);
+  stitch->tile_stitch = ARENA_PUSH_ARRAY(arena, u8, terrain->tile_count);
+  if(!stitch->tile_set || !stitch->tile_lod || !stitch->tile_stitch) {
+    LOG_ERROR("Failed to allocate terrain stitch state for %u tiles", terrain->tile_count);
+    return false;
+  }
+  memset(stitch->tile_lod, 0, terrain->tile_count);
+  memset(stitch->tile_stitch, 0, terrain->tile_count);
+
+  // One set per distinct tile size, with every range counted before anything is built
+  u64 index_total = 0;
+  for(u32 tile = 0; tile < terrain->tile_count; ++tile) {
+    const TerrainTile *mesh = &terrain->tiles[tile];
+    u32                rows = mesh->vertex_count / mesh->columns;
+    u32                s    = 0;
+    while(s < stitch->set_count && (stitch->sets[s].columns != mesh->columns || stitch->sets[s].rows != rows)) {
+      s++;
+    }
+    stitch->tile_set[tile] = (u8)s;
+    if(s < stitch->set_count) {
+      continue;
+    }
+    if(s == TERRAIN_STITCH_MAX_SETS) {
+      LOG_ERROR("Terrain has more than %d tile sizes", TERRAIN_STITCH_MAX_SETS);
+      return false;
+    }
+
+    TerrainStitchSet *set = &stitch->sets[stitch->set_count++];
+    *set                  = TerrainStitchSet{};
+    set->columns          = mesh->columns;
+    set->rows             = rows;
+    while(set->lod_count < TERRAIN_STITCH_LOD_COUNT && MIN(set->columns, set->rows) - 1 > (1u << set->lod_count)) {
+      set->lod_count++;
+    }
+    for(u32 lod = 0; lod < set->lod_count; ++lod) {
+      for(u32 mask = 0; mask < TERRAIN_STITCH_VARIANTS; ++mask) {
+        set->first[lod][mask] = (u32)index_total;
+        set->count[lod][mask] = terrain_stitch_build(NULL, set->columns, set->rows, lod, mask);
+        index_total += set->count[lod][mask];
+      }
+    }
+  }
+
+  stitch->indices = ARENA_PUSH_ARRAY(arena, u16, index_total);
+  if(!stitch->indices) {
+    LOG_ERROR("Failed to allocate %llu terrain stitch indices", (unsigned long long)index_total);
+    return false;
+  }
+  stitch->index_count = (u32)index_total;
+
+  u32 variant_count = stitch->set_count * TERRAIN_STITCH_LOD_COUNT * TERRAIN_STITCH_VARIANTS;
+  job_parallel_for(variant_count, 1, terrain_stitch_variants, stitch);
+
+  LOG_DEBUG("Terrain stitch created: %u tile sizes, %u indices", stitch->set_count, stitch->index_count);
+  return true;
+}
+
+// Distance from the eye to a tile's bounding box
+static f32 terrain_stitch_distance(const TerrainTile *tile, const f32 eye[3]) {
+  u32 rows   = tile->vertex_count / tile->columns;
+  f32 min[3] = {tile->origin[0], tile->height_min, tile->origin[1]};
+  f32 max[3] = {
+    tile->origin[0] + (f32)(tile->columns - 1) * tile->cell_size,
+    tile->height_min + tile->height_scale * 65535.0f,
+    tile->origin[1] + (f32)(rows - 1) * tile->cell_size,
+  };
+
+  f32 distance_sq = 0.0f;
+  for(u32 c = 0; c < 3; ++c) {
+    f32 d = MAX(MAX(min[c] - eye[c], eye[c] - max[c]), 0.0f);
+    distance_sq += d * d;
+  }
+  return sqrtf(distance_sq);
+}
+
+void terrain_stitch_select(TerrainStitch *stitch, const TerrainMesh *terrain, const f32 eye[3]) {
+  for(u32 tile = 0; tile < stitch->tile_count; ++tile) {
+    const TerrainStitchSet *set      = &stitch->sets[stitch->tile_set[tile]];
+    f32                     distance = terrain_stitch_distance(&terrain->tiles[tile], eye);
+    u32                     lod      = 0;
+    f32                     range    = stitch->lod0_range;
+    while(lod + 1 < set->lod_count && distance > range) {
+      lod++;
+      range *= 2.0f;
+    }
+    stitch->tile_lod[tile] = (u8)lod;
+  }
+
+  // Neighbours may differ by one LOD, which the finer one stitches. Tiles too small to
+  // stitch hold their neighbours at their own LOD. Only lowering, so this settles.
+  const i32 offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for(bool changed = true; changed;) {
+    changed = false;
+    for(u32 tile = 0; tile < stitch->tile_count; ++tile) {
+      i32 tx = (i32)(tile % stitch->tiles_x);
+      i32 ty = (i32)(tile / stitch->tiles_x);
+      for(u32 n = 0; n < 4; ++n) {
+        i32 nx = tx + offsets[n][0];
+        i32 ny = ty + offsets[n][1];
+        if(nx < 0 || ny < 0 || nx >= (i32)stitch->tiles_x || ny >= (i32)stitch->tiles_y) {
+          continue;
+        }
+        u32 neighbour = (u32)ny * stitch->tiles_x + (u32)nx;
+        u32 limit     = stitch->tile_lod[neighbour] + (stitch->sets[stitch->tile_set[neighbour]].lod_count > 0 ? 1 : 0);
+        if(stitch->tile_lod[tile] > limit) {
+          stitch->tile_lod[tile] = (u8)limit;
+          changed                = true;
+        }
+      }
+    }
+  }
+
+  // Edge bits in the same order as the offsets
+  for(u32 tile = 0; tile < stitch->tile_count; ++tile) {
+    i32 tx   = (i32)(tile % stitch->tiles_x);
+    i32 ty   = (i32)(tile / stitch->tiles_x);
+    u32 mask = 0;
+    for(u32 n = 0; n < 4; ++n) {
+      i32 nx = tx + offsets[n][0];
+      i32 ny = ty + offsets[n][1];
+      if(nx < 0 || ny < 0 || nx >= (i32)stitch->tiles_x || ny >= (i32)stitch->tiles_y) {
+        continue;
+      }
+      if(stitch->tile_lod[(u32)ny * stitch->tiles_x + (u32)nx] > stitch->tile_lod[tile]) {
+        mask |= 1u << n;
+      }
+    }
+    stitch->tile_stitch[tile] = (u8)mask;
+  }
+}
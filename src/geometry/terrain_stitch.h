@@ -0,0 +1,57 @@
+#ifndef TERRAIN_STITCH_H
+#define TERRAIN_STITCH_H
+
+#include "geometry/terrain_mesh.h"
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Level of detail for the terrain tiles without remeshing them. LOD k draws every 2^k-th
+// row and column of a tile's own vertex buffer through a shared index buffer. Where a tile
+// meets a neighbour one LOD coarser, its border row drops every other vertex to match, so
+// the two meet without cracks or T-junctions.
+//
+// All 16 combinations of stitched edges are built for every LOD and tile size once, at
+// creation, and ordered for the vertex caches. A LOD change only picks another index range.
+
+#define TERRAIN_STITCH_LOD_COUNT 4  // Strides 1 to 8
+#define TERRAIN_STITCH_VARIANTS  16 // Every combination of stitched edges
+#define TERRAIN_STITCH_MAX_SETS  4  // Full tiles, the last column, the last row and the corner
+
+// Tile edges, as bits of a stitch mask
+#define TERRAIN_STITCH_WEST  0x1u // Column 0
+#define TERRAIN_STITCH_EAST  0x2u // Last column
+#define TERRAIN_STITCH_NORTH 0x4u // Row 0
+#define TERRAIN_STITCH_SOUTH 0x8u // Last row
+
+// Index ranges for the tiles of one size. Indices are u16, into a tile's own vertices.
+typedef struct TerrainStitchSet {
+  u32 columns;   // Vertices per row of the tiles using this set
+  u32 rows;
+  u32 lod_count; // LODs leaving at least two cells per side; 0 if the tiles are always drawn whole
+  u32 first[TERRAIN_STITCH_LOD_COUNT][TERRAIN_STITCH_VARIANTS]; // Into TerrainStitch::indices
+  u32 count[TERRAIN_STITCH_LOD_COUNT][TERRAIN_STITCH_VARIANTS];
+} TerrainStitchSet;
+
+typedef struct TerrainStitch {
+  TerrainStitchSet sets[TERRAIN_STITCH_MAX_SETS];
+  u32              set_count;
+  u16             *indices; // Every range of every set
+  u32              index_count;
+  u32              tiles_x;
+  u32              tiles_y;
+  u32              tile_count;
+  f32              lod0_range;  // World distance drawn at full resolution
+  u8              *tile_set;    // Set of each tile
+  u8              *tile_lod;    // Last selection: LOD of each tile
+  u8              *tile_stitch; // Last selection: edges of each tile that meet a coarser neighbour
+} TerrainStitch;
+
+// Build the index ranges for every tile size of the terrain. LOD k is drawn up to
+// lod0_range * 2^k from the eye.
+bool terrain_stitch_create(TerrainStitch *stitch, const TerrainMesh *terrain, f32 lod0_range, Arena *arena);
+
+// Pick each tile's LOD from its distance to the eye, coarsening no tile more than one LOD
+// past its neighbours, and the edges each tile must stitch
+void terrain_stitch_select(TerrainStitch *stitch, const TerrainMesh *terrain, const f32 eye[3]);
+
+#endif // TERRAIN_STITCH_H
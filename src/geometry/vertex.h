@@ -3,9 +3,31 @@
 
 #include "utils/types.h"
 
+// Vertex layouts understood by the renderer
+typedef enum VertexFormat {
+  VERTEX_FORMAT_STANDARD = 0, // Vertex
+  VERTEX_FORMAT_TERRAIN,      // TerrainVertex, decoded with its tile's placement
+  VERTEX_FORMAT_GRID,         // GridVertex, displaced by the heightfield in the vertex shader
+} VertexFormat;
+
 typedef struct Vertex {
   f32 position[3];
   f32 color[3];
 } Vertex;
 
+// Compact terrain vertex. World XZ follows from the grid position and the tile's placement,
+// height is quantized to the tile's range and color is derived from normal and material.
+typedef struct TerrainVertex {
+  u16 height;    // Unorm16 over the tile's height range
+  u8  normal[2]; // Octahedral-encoded unit normal as snorm8 (x, z), y up
+  u8  grid[2];   // Column and row within the tile
+  u8  material;  // TerrainMaterial
+  u8  reserved;
+} TerrainVertex;
+
+// Vertex of a flat grid shared by many draws; each draw places, scales and displaces it
+typedef struct GridVertex {
+  u16 grid[2]; // Column and row
+} GridVertex;
+
 #endif // VERTEX_H
@@ -0,0 +1,213 @@
+#include "pack16.h"
+#include "math/simd.h"
+#include <string.h>
+
+// The F16C kernels are built with a function target attribute, so the rest of the binary
+// keeps the baseline ISA, and only run once the CPU reports F16C and AVX
+#if PACK16_ENABLE_F16C && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PACK16_F16C        1
+#define PACK16_F16C_TARGET __attribute__((target("avx,f16c")))
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define PACK16_NEON 1
+#endif
+
+static inline u32 pack16_f32_bits(f32 value) {
+  u32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline f32 pack16_bits_f32(u32 bits) {
+  f32 value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Round-to-nearest-even conversion; overflow saturates to infinity, NaN stays NaN
+u16 f16_from_f32(f32 value) {
+  const u32 f32_infinity = 255u << 23;
+  const u32 f16_overflow = (127u + 16u) << 23;
+  const u32 denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+  u32 bits = pack16_f32_bits(value);
+  u32 sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  u16 result;
+  if(bits >= f16_overflow) {
+    result = bits > f32_infinity ? 0x7e00 : 0x7c00;
+  } else if(bits < (113u << 23)) {
+    // Subnormal or zero: let the FPU round the mantissa into place
+    f32 shifted = pack16_bits_f32(bits) + pack16_bits_f32(denorm_magic);
+    result      = (u16)(pack16_f32_bits(shifted) - denorm_magic);
+  } else {
+    u32 mantissa_odd = (bits >> 13) & 1;
+    bits += ((15u - 127u) << 23) + 0xfff;
+    bits += mantissa_odd;
+    result = (u16)(bits >> 13);
+  }
+
+  return (u16)(result | (sign >> 16));
+}
+
+f32 f16_to_f32(u16 value) {
+  const u32 shifted_exponent = 0x7c00u << 13;
+
+  u32 bits     = (u32)(value & 0x7fff) << 13;
+  u32 exponent = bits & shifted_exponent;
+  bits += (127u - 15u) << 23;
+
+  if(exponent == shifted_exponent) {
+    bits += (128u - 16u) << 23; // Infinity or NaN
+  } else if(exponent == 0) {
+    bits += 1u << 23; // Subnormal: renormalize
+    bits = pack16_f32_bits(pack16_bits_f32(bits) - pack16_bits_f32(113u << 23));
+  }
+
+  return pack16_bits_f32(bits | ((u32)(value & 0x8000) << 16));
+}
+
+#if PACK16_F16C
+static bool pack16_has_f16c(void) {
+  static const bool has_f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has_f16c;
+}
+
+// Convert whole groups of 8 and return how many values were converted
+PACK16_F16C_TARGET static size_t f16_encode_f16c(const f32 *src, u16 *dst, size_t count) {
+  size_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256  v = _mm256_loadu_ps(src + i);
+    __m128i h = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128((__m128i *)(dst + i), h);
+  }
+  return i;
+}
+
+PACK16_F16C_TARGET static size_t f16_decode_f16c(const u16 *src, f32 *dst, size_t count) {
+  size_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+#endif
+
+void f16_encode(const f32 *src, u16 *dst, size_t count) {
+  size_t i = 0;
+#if PACK16_F16C
+  if(pack16_has_f16c()) {
+    i = f16_encode_f16c(src, dst, count);
+  }
+#elif PACK16_NEON
+  for(; i + 4 <= count; i += 4) {
+    float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+    vst1_u16(dst + i, vreinterpret_u16_f16(h));
+  }
+#endif
+  for(; i < count; ++i) {
+    dst[i] = f16_from_f32(src[i]);
+  }
+}
+
+void f16_decode(const u16 *src, f32 *dst, size_t count) {
+  size_t i = 0;
+#if PACK16_F16C
+  if(pack16_has_f16c()) {
+    i = f16_decode_f16c(src, dst, count);
+  }
+#elif PACK16_NEON
+  for(; i + 4 <= count; i += 4) {
+    float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+    vst1q_f32(dst + i, vcvt_f32_f16(h));
+  }
+#endif
+  for(; i < count; ++i) {
+    dst[i] = f16_to_f32(src[i]);
+  }
+}
+
+void unorm16_range(const f32 *src, size_t count, f32 *out_min, f32 *out_max) {
+  if(count == 0) {
+    *out_min = 0.0f;
+    *out_max = 0.0f;
+    return;
+  }
+
+  f32    lo = src[0];
+  f32    hi = src[0];
+  size_t i  = 0;
+  if(count >= 4) {
+    F32x4 lo4 = f32x4_load(src);
+    F32x4 hi4 = lo4;
+    for(i = 4; i + 4 <= count; i += 4) {
+      F32x4 v = f32x4_load(src + i);
+      lo4     = f32x4_min(lo4, v);
+      hi4     = f32x4_max(hi4, v);
+    }
+
+    f32 lanes_lo[4];
+    f32 lanes_hi[4];
+    f32x4_store(lanes_lo, lo4);
+    f32x4_store(lanes_hi, hi4);
+    for(u32 lane = 0; lane < 4; ++lane) {
+      lo = lanes_lo[lane] < lo ? lanes_lo[lane] : lo;
+      hi = lanes_hi[lane] > hi ? lanes_hi[lane] : hi;
+    }
+  }
+
+  for(; i < count; ++i) {
+    lo = src[i] < lo ? src[i] : lo;
+    hi = src[i] > hi ? src[i] : hi;
+  }
+
+  *out_min = lo;
+  *out_max = hi;
+}
+
+f32 unorm16_scale(f32 min, f32 max) { return max > min ? (max - min) / 65535.0f : 0.0f; }
+
+void unorm16_encode(const f32 *src, u16 *dst, size_t count, f32 offset, f32 scale) {
+  f32    inv_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+  size_t i         = 0;
+
+  F32x4 offset4 = f32x4_set1(offset);
+  F32x4 inv4    = f32x4_set1(inv_scale);
+  F32x4 half4   = f32x4_set1(0.5f);
+  F32x4 zero4   = f32x4_set1(0.0f);
+  F32x4 max4    = f32x4_set1(65535.0f);
+  for(; i + 4 <= count; i += 4) {
+    F32x4 q = f32x4_add(f32x4_mul(f32x4_sub(f32x4_load(src + i), offset4), inv4), half4);
+    q       = f32x4_min(f32x4_max(q, zero4), max4);
+
+    u32 lanes[4];
+    u32x4_store(lanes, u32x4_from_f32x4(q));
+    for(u32 lane = 0; lane < 4; ++lane) {
+      dst[i + lane] = (u16)lanes[lane];
+    }
+  }
+
+  for(; i < count; ++i) {
+    f32 q  = (src[i] - offset) * inv_scale + 0.5f;
+    q      = q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q);
+    dst[i] = (u16)q;
+  }
+}
+
+void unorm16_decode(const u16 *src, f32 *dst, size_t count, f32 offset, f32 scale) {
+  size_t i = 0;
+
+  F32x4 offset4 = f32x4_set1(offset);
+  F32x4 scale4  = f32x4_set1(scale);
+  for(; i + 4 <= count; i += 4) {
+    U32x4 q = u32x4_set(src[i], src[i + 1], src[i + 2], src[i + 3]);
+    f32x4_store(dst + i, f32x4_add(f32x4_mul(f32x4_from_u32x4(q), scale4), offset4));
+  }
+
+  for(; i < count; ++i) {
+    dst[i] = offset + (f32)src[i] * scale;
+  }
+}
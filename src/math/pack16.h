@@ -0,0 +1,26 @@
+#ifndef PACK16_H
+#define PACK16_H
+
+#include "utils/types.h"
+
+// 16-bit storage formats for f32 data: IEEE half floats and unorm16 with a caller-supplied
+// offset and scale (value = offset + q * scale). Bulk conversions use F16C when built with
+// PACK16_ENABLE_F16C and the CPU supports it, NEON on AArch64 and a scalar bit-exact path
+// elsewhere.
+
+u16 f16_from_f32(f32 value);
+f32 f16_to_f32(u16 value);
+
+void f16_encode(const f32 *src, u16 *dst, size_t count);
+void f16_decode(const u16 *src, f32 *dst, size_t count);
+
+// Range of src, used to pick a unorm16 offset and scale
+void unorm16_range(const f32 *src, size_t count, f32 *out_min, f32 *out_max);
+
+// Scale that maps [min, max] onto the full unorm16 range (0 for a constant range)
+f32 unorm16_scale(f32 min, f32 max);
+
+void unorm16_encode(const f32 *src, u16 *dst, size_t count, f32 offset, f32 scale);
+void unorm16_decode(const u16 *src, f32 *dst, size_t count, f32 offset, f32 scale);
+
+#endif // PACK16_H
@@ -0,0 +1,127 @@
+#include "rng.h"
+#include "math/simd.h"
+
+// Philox4x32 round and key schedule constants
+static const u32 PHILOX_M0     = 0xD2511F53u;
+static const u32 PHILOX_M1     = 0xCD9E8D57u;
+static const u32 PHILOX_W0     = 0x9E3779B9u;
+static const u32 PHILOX_W1     = 0xBB67AE85u;
+static const u32 PHILOX_ROUNDS = 10;
+
+// Counter layout: (index low, index high, stage, block); key: the 64-bit seed
+
+void rng_philox4(RngKey key, u64 index, u32 block, u32 out[RNG_WORDS_PER_ELEMENT]) {
+  u32 c0 = (u32)index;
+  u32 c1 = (u32)(index >> 32);
+  u32 c2 = key.stage;
+  u32 c3 = block;
+  u32 k0 = (u32)key.seed;
+  u32 k1 = (u32)(key.seed >> 32);
+
+  for(u32 round = 0; round < PHILOX_ROUNDS; ++round) {
+    u64 p0 = (u64)PHILOX_M0 * c0;
+    u64 p1 = (u64)PHILOX_M1 * c2;
+
+    c0 = (u32)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (u32)p1;
+    c2 = (u32)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (u32)p0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// Four Philox streams side by side: lane i carries the counter of element first_index + i
+static void rng_philox_lanes(RngKey key, u64 first_index, u32 block, U32x4 *w0, U32x4 *w1, U32x4 *w2, U32x4 *w3) {
+  u32 lo[4];
+  u32 hi[4];
+  for(u32 i = 0; i < 4; ++i) {
+    u64 index = first_index + i;
+    lo[i]     = (u32)index;
+    hi[i]     = (u32)(index >> 32);
+  }
+
+  U32x4 c0 = u32x4_load(lo);
+  U32x4 c1 = u32x4_load(hi);
+  U32x4 c2 = u32x4_set1(key.stage);
+  U32x4 c3 = u32x4_set1(block);
+  U32x4 m0 = u32x4_set1(PHILOX_M0);
+  U32x4 m1 = u32x4_set1(PHILOX_M1);
+  u32   k0 = (u32)key.seed;
+  u32   k1 = (u32)(key.seed >> 32);
+
+  for(u32 round = 0; round < PHILOX_ROUNDS; ++round) {
+    U32x4 hi0;
+    U32x4 lo0;
+    U32x4 hi1;
+    U32x4 lo1;
+    u32x4_mul_wide(m0, c0, &hi0, &lo0);
+    u32x4_mul_wide(m1, c2, &hi1, &lo1);
+
+    c0 = u32x4_xor(u32x4_xor(hi1, c1), u32x4_set1(k0));
+    c1 = lo1;
+    c2 = u32x4_xor(u32x4_xor(hi0, c3), u32x4_set1(k1));
+    c3 = lo0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  // Lanes hold elements, rows hold words: transpose to element-major
+  u32x4_transpose(&c0, &c1, &c2, &c3);
+  *w0 = c0;
+  *w1 = c1;
+  *w2 = c2;
+  *w3 = c3;
+}
+
+void rng_philox16(RngKey key, u64 first_index, u32 block, u32 out[RNG_BATCH_ELEMENTS * RNG_WORDS_PER_ELEMENT]) {
+  U32x4 e0;
+  U32x4 e1;
+  U32x4 e2;
+  U32x4 e3;
+  rng_philox_lanes(key, first_index, block, &e0, &e1, &e2, &e3);
+
+  u32x4_store(out + 0, e0);
+  u32x4_store(out + 4, e1);
+  u32x4_store(out + 8, e2);
+  u32x4_store(out + 12, e3);
+}
+
+static inline F32x4 rng_unit4(U32x4 bits) {
+  return f32x4_mul(f32x4_from_u32x4(u32x4_shr(bits, 8)), f32x4_set1(1.0f / 16777216.0f));
+}
+
+void rng_uniform16(RngKey key, u64 first_index, u32 block, f32 out[RNG_BATCH_ELEMENTS * RNG_WORDS_PER_ELEMENT]) {
+  U32x4 e0;
+  U32x4 e1;
+  U32x4 e2;
+  U32x4 e3;
+  rng_philox_lanes(key, first_index, block, &e0, &e1, &e2, &e3);
+
+  f32x4_store(out + 0, rng_unit4(e0));
+  f32x4_store(out + 4, rng_unit4(e1));
+  f32x4_store(out + 8, rng_unit4(e2));
+  f32x4_store(out + 12, rng_unit4(e3));
+}
+
+void rng_uniform_fill(RngKey key, u64 first_index, u32 block, u64 count, f32 *out) {
+  u64 i = 0;
+  for(; i + RNG_BATCH_ELEMENTS <= count; i += RNG_BATCH_ELEMENTS) {
+    rng_uniform16(key, first_index + i, block, out + i * RNG_WORDS_PER_ELEMENT);
+  }
+
+  for(; i < count; ++i) {
+    u32 words[RNG_WORDS_PER_ELEMENT];
+    rng_philox4(key, first_index + i, block, words);
+    for(u32 w = 0; w < RNG_WORDS_PER_ELEMENT; ++w) {
+      out[i * RNG_WORDS_PER_ELEMENT + w] = rng_u32_to_unit(words[w]);
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "utils/types.h"
+
+// Counter-based random numbers (Philox4x32-10). Every value is a pure function of
+// (seed, stage, index, block), so any element's randomness can be recomputed in O(1)
+// from any thread without shared generator state.
+
+// Number of 32-bit words produced per element and block
+#define RNG_WORDS_PER_ELEMENT 4
+
+// Elements generated per batched call (one per SIMD lane)
+#define RNG_BATCH_ELEMENTS 4
+
+// Consumers of the generator; each stage draws from an independent stream
+typedef enum RngStage {
+  RNG_STAGE_NOISE_OCTAVES = 1, // Lattice seeds of the noise octaves
+} RngStage;
+
+typedef struct RngKey {
+  u64 seed;  // Run-wide seed
+  u32 stage; // Distinguishes independent consumers (erosion droplets, scatter, ...)
+} RngKey;
+
+// Four random words for element `index`. `block` selects further words for elements
+// that need more than four.
+void rng_philox4(RngKey key, u64 index, u32 block, u32 out[RNG_WORDS_PER_ELEMENT]);
+
+// 16 random words for elements first_index .. first_index + 3, element-major:
+// out[4 * i + w] equals word w of rng_philox4(key, first_index + i, block)
+void rng_philox16(RngKey key, u64 first_index, u32 block, u32 out[RNG_BATCH_ELEMENTS * RNG_WORDS_PER_ELEMENT]);
+
+// Same layout as rng_philox16, mapped to uniform floats in [0, 1)
+void rng_uniform16(RngKey key, u64 first_index, u32 block, f32 out[RNG_BATCH_ELEMENTS * RNG_WORDS_PER_ELEMENT]);
+
+// Fill `count` elements' worth of uniform floats (4 per element, element-major)
+void rng_uniform_fill(RngKey key, u64 first_index, u32 block, u64 count, f32 *out);
+
+// Map a random word to [0, 1) using its top 24 bits
+static inline f32 rng_u32_to_unit(u32 x) { return (f32)(x >> 8) * (1.0f / 16777216.0f); }
+
+#endif // RNG_H
@@ -0,0 +1,481 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "utils/types.h"
+
+// Minimal 4-wide SIMD layer. SSE2 and NEON are baseline on x86-64 and AArch64, so no
+// extra compiler flags are needed; other targets get a scalar fallback with the same API.
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMD_SCALAR 1
+#include <math.h>
+#include <string.h>
+#endif
+
+#define SIMD_WIDTH 4
+
+#if SIMD_SSE2
+typedef struct F32x4 {
+  __m128 v;
+} F32x4;
+typedef struct U32x4 {
+  __m128i v;
+} U32x4;
+#elif SIMD_NEON
+typedef struct F32x4 {
+  float32x4_t v;
+} F32x4;
+typedef struct U32x4 {
+  uint32x4_t v;
+} U32x4;
+#else
+typedef struct F32x4 {
+  f32 v[4];
+} F32x4;
+typedef struct U32x4 {
+  u32 v[4];
+} U32x4;
+#endif
+
+// Load / store (unaligned)
+
+static inline F32x4 f32x4_load(const f32 *p) {
+#if SIMD_SSE2
+  return F32x4{_mm_loadu_ps(p)};
+#elif SIMD_NEON
+  return F32x4{vld1q_f32(p)};
+#else
+  return F32x4{{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+static inline void f32x4_store(f32 *p, F32x4 a) {
+#if SIMD_SSE2
+  _mm_storeu_ps(p, a.v);
+#elif SIMD_NEON
+  vst1q_f32(p, a.v);
+#else
+  for(u32 i = 0; i < 4; ++i) {
+    p[i] = a.v[i];
+  }
+#endif
+}
+
+static inline U32x4 u32x4_load(const u32 *p) {
+#if SIMD_SSE2
+  return U32x4{_mm_loadu_si128((const __m128i *)p)};
+#elif SIMD_NEON
+  return U32x4{vld1q_u32(p)};
+#else
+  return U32x4{{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+static inline void u32x4_store(u32 *p, U32x4 a) {
+#if SIMD_SSE2
+  _mm_storeu_si128((__m128i *)p, a.v);
+#elif SIMD_NEON
+  vst1q_u32(p, a.v);
+#else
+  for(u32 i = 0; i < 4; ++i) {
+    p[i] = a.v[i];
+  }
+#endif
+}
+
+static inline F32x4 f32x4_set1(f32 x) {
+#if SIMD_SSE2
+  return F32x4{_mm_set1_ps(x)};
+#elif SIMD_NEON
+  return F32x4{vdupq_n_f32(x)};
+#else
+  return F32x4{{x, x, x, x}};
+#endif
+}
+
+static inline F32x4 f32x4_set(f32 a, f32 b, f32 c, f32 d) {
+  const f32 lanes[4] = {a, b, c, d};
+  return f32x4_load(lanes);
+}
+
+static inline U32x4 u32x4_set1(u32 x) {
+#if SIMD_SSE2
+  return U32x4{_mm_set1_epi32((i32)x)};
+#elif SIMD_NEON
+  return U32x4{vdupq_n_u32(x)};
+#else
+  return U32x4{{x, x, x, x}};
+#endif
+}
+
+static inline U32x4 u32x4_set(u32 a, u32 b, u32 c, u32 d) {
+  const u32 lanes[4] = {a, b, c, d};
+  return u32x4_load(lanes);
+}
+
+// f32 arithmetic
+
+static inline F32x4 f32x4_add(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_add_ps(a.v, b.v)};
+#elif SIMD_NEON
+  return F32x4{vaddq_f32(a.v, b.v)};
+#else
+  return F32x4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+static inline F32x4 f32x4_sub(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_sub_ps(a.v, b.v)};
+#elif SIMD_NEON
+  return F32x4{vsubq_f32(a.v, b.v)};
+#else
+  return F32x4{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+#endif
+}
+
+static inline F32x4 f32x4_mul(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_mul_ps(a.v, b.v)};
+#elif SIMD_NEON
+  return F32x4{vmulq_f32(a.v, b.v)};
+#else
+  return F32x4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+#endif
+}
+
+static inline F32x4 f32x4_min(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_min_ps(a.v, b.v)};
+#elif SIMD_NEON
+  return F32x4{vminq_f32(a.v, b.v)};
+#else
+  F32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+  }
+  return r;
+#endif
+}
+
+static inline F32x4 f32x4_max(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_max_ps(a.v, b.v)};
+#elif SIMD_NEON
+  return F32x4{vmaxq_f32(a.v, b.v)};
+#else
+  F32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+  }
+  return r;
+#endif
+}
+
+// Division is exact on SSE and AArch64; 32-bit NEON refines the reciprocal estimate twice
+static inline F32x4 f32x4_div(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return F32x4{_mm_div_ps(a.v, b.v)};
+#elif SIMD_NEON && defined(__aarch64__)
+  return F32x4{vdivq_f32(a.v, b.v)};
+#elif SIMD_NEON
+  float32x4_t r = vrecpeq_f32(b.v);
+  r             = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  r             = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  return F32x4{vmulq_f32(a.v, r)};
+#else
+  return F32x4{{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}};
+#endif
+}
+
+static inline F32x4 f32x4_sqrt(F32x4 a) {
+#if SIMD_SSE2
+  return F32x4{_mm_sqrt_ps(a.v)};
+#elif SIMD_NEON && defined(__aarch64__)
+  return F32x4{vsqrtq_f32(a.v)};
+#elif SIMD_NEON
+  // a * 1/sqrt(a) from a refined estimate; zero lanes would give 0 * inf
+  float32x4_t r = vrsqrteq_f32(a.v);
+  r             = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+  r             = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+  return F32x4{vbslq_f32(vceqq_f32(a.v, vdupq_n_f32(0.0f)), a.v, vmulq_f32(a.v, r))};
+#else
+  F32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = sqrtf(a.v[i]);
+  }
+  return r;
+#endif
+}
+
+// Comparisons yield all ones in lanes where they hold; NaN lanes compare false
+
+static inline U32x4 f32x4_lt(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_castps_si128(_mm_cmplt_ps(a.v, b.v))};
+#elif SIMD_NEON
+  return U32x4{vcltq_f32(a.v, b.v)};
+#else
+  U32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = a.v[i] < b.v[i] ? 0xffffffffu : 0u;
+  }
+  return r;
+#endif
+}
+
+static inline U32x4 f32x4_le(F32x4 a, F32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_castps_si128(_mm_cmple_ps(a.v, b.v))};
+#elif SIMD_NEON
+  return U32x4{vcleq_f32(a.v, b.v)};
+#else
+  U32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = a.v[i] <= b.v[i] ? 0xffffffffu : 0u;
+  }
+  return r;
+#endif
+}
+
+// Split the eight lanes of a followed by b into their even and odd positions
+static inline void f32x4_deinterleave(F32x4 a, F32x4 b, F32x4 *even, F32x4 *odd) {
+#if SIMD_SSE2
+  even->v = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(2, 0, 2, 0));
+  odd->v  = _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(3, 1, 3, 1));
+#elif SIMD_NEON
+  float32x4x2_t split = vuzpq_f32(a.v, b.v);
+  even->v             = split.val[0];
+  odd->v              = split.val[1];
+#else
+  *even = F32x4{{a.v[0], a.v[2], b.v[0], b.v[2]}};
+  *odd  = F32x4{{a.v[1], a.v[3], b.v[1], b.v[3]}};
+#endif
+}
+
+// u32 arithmetic
+
+static inline U32x4 u32x4_add(U32x4 a, U32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_add_epi32(a.v, b.v)};
+#elif SIMD_NEON
+  return U32x4{vaddq_u32(a.v, b.v)};
+#else
+  return U32x4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+static inline U32x4 u32x4_and(U32x4 a, U32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_and_si128(a.v, b.v)};
+#elif SIMD_NEON
+  return U32x4{vandq_u32(a.v, b.v)};
+#else
+  return U32x4{{a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3]}};
+#endif
+}
+
+static inline U32x4 u32x4_or(U32x4 a, U32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_or_si128(a.v, b.v)};
+#elif SIMD_NEON
+  return U32x4{vorrq_u32(a.v, b.v)};
+#else
+  return U32x4{{a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3]}};
+#endif
+}
+
+static inline U32x4 u32x4_xor(U32x4 a, U32x4 b) {
+#if SIMD_SSE2
+  return U32x4{_mm_xor_si128(a.v, b.v)};
+#elif SIMD_NEON
+  return U32x4{veorq_u32(a.v, b.v)};
+#else
+  return U32x4{{a.v[0] ^ b.v[0], a.v[1] ^ b.v[1], a.v[2] ^ b.v[2], a.v[3] ^ b.v[3]}};
+#endif
+}
+
+static inline U32x4 u32x4_shr(U32x4 a, i32 bits) {
+#if SIMD_SSE2
+  return U32x4{_mm_srli_epi32(a.v, bits)};
+#elif SIMD_NEON
+  return U32x4{vshlq_u32(a.v, vdupq_n_s32(-bits))};
+#else
+  return U32x4{{a.v[0] >> bits, a.v[1] >> bits, a.v[2] >> bits, a.v[3] >> bits}};
+#endif
+}
+
+static inline U32x4 u32x4_shl(U32x4 a, i32 bits) {
+#if SIMD_SSE2
+  return U32x4{_mm_slli_epi32(a.v, bits)};
+#elif SIMD_NEON
+  return U32x4{vshlq_u32(a.v, vdupq_n_s32(bits))};
+#else
+  return U32x4{{a.v[0] << bits, a.v[1] << bits, a.v[2] << bits, a.v[3] << bits}};
+#endif
+}
+
+// Lanes whose top bit is set become all ones, the rest zero
+static inline U32x4 u32x4_sign_mask(U32x4 a) {
+#if SIMD_SSE2
+  return U32x4{_mm_srai_epi32(a.v, 31)};
+#elif SIMD_NEON
+  return U32x4{vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(a.v), 31))};
+#else
+  U32x4 r;
+  for(u32 i = 0; i < 4; ++i) {
+    r.v[i] = (a.v[i] & 0x80000000u) ? 0xffffffffu : 0u;
+  }
+  return r;
+#endif
+}
+
+// Per-bit select: mask ? a : b
+static inline U32x4 u32x4_select(U32x4 mask, U32x4 a, U32x4 b) {
+  return u32x4_or(u32x4_and(mask, a), u32x4_and(u32x4_xor(mask, u32x4_set1(0xffffffffu)), b));
+}
+
+// Top bit of each lane gathered into bits 0..3
+static inline u32 u32x4_movemask(U32x4 a) {
+#if SIMD_SSE2
+  return (u32)_mm_movemask_ps(_mm_castsi128_ps(a.v));
+#elif SIMD_NEON
+  uint32x4_t bits = vshrq_n_u32(a.v, 31);
+  return vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2)
+         | (vgetq_lane_u32(bits, 3) << 3);
+#else
+  return (a.v[0] >> 31) | ((a.v[1] >> 31) << 1) | ((a.v[2] >> 31) << 2) | ((a.v[3] >> 31) << 3);
+#endif
+}
+
+// Reinterpret lane bits between float and integer views
+static inline U32x4 f32x4_as_u32x4(F32x4 a) {
+#if SIMD_SSE2
+  return U32x4{_mm_castps_si128(a.v)};
+#elif SIMD_NEON
+  return U32x4{vreinterpretq_u32_f32(a.v)};
+#else
+  U32x4 r;
+  memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+#endif
+}
+
+static inline F32x4 u32x4_as_f32x4(U32x4 a) {
+#if SIMD_SSE2
+  return F32x4{_mm_castsi128_ps(a.v)};
+#elif SIMD_NEON
+  return F32x4{vreinterpretq_f32_u32(a.v)};
+#else
+  F32x4 r;
+  memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+#endif
+}
+
+// Full 32x32 -> 64 bit products, split into high and low words
+static inline void u32x4_mul_wide(U32x4 a, U32x4 b, U32x4 *hi, U32x4 *lo) {
+#if SIMD_SSE2
+  __m128i p02  = _mm_mul_epu32(a.v, b.v);
+  __m128i p13  = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+  __m128i lo02 = _mm_shuffle_epi32(p02, _MM_SHUFFLE(0, 0, 2, 0));
+  __m128i lo13 = _mm_shuffle_epi32(p13, _MM_SHUFFLE(0, 0, 2, 0));
+  __m128i hi02 = _mm_shuffle_epi32(p02, _MM_SHUFFLE(0, 0, 3, 1));
+  __m128i hi13 = _mm_shuffle_epi32(p13, _MM_SHUFFLE(0, 0, 3, 1));
+  lo->v        = _mm_unpacklo_epi32(lo02, lo13);
+  hi->v        = _mm_unpacklo_epi32(hi02, hi13);
+#elif SIMD_NEON
+  uint64x2_t p01 = vmull_u32(vget_low_u32(a.v), vget_low_u32(b.v));
+  uint64x2_t p23 = vmull_u32(vget_high_u32(a.v), vget_high_u32(b.v));
+  lo->v          = vcombine_u32(vmovn_u64(p01), vmovn_u64(p23));
+  hi->v          = vcombine_u32(vshrn_n_u64(p01, 32), vshrn_n_u64(p23, 32));
+#else
+  for(u32 i = 0; i < 4; ++i) {
+    u64 p    = (u64)a.v[i] * b.v[i];
+    lo->v[i] = (u32)p;
+    hi->v[i] = (u32)(p >> 32);
+  }
+#endif
+}
+
+// Low 32 bits of the lane-wise product
+static inline U32x4 u32x4_mul_lo(U32x4 a, U32x4 b) {
+#if SIMD_SSE2 && defined(__SSE4_1__)
+  return U32x4{_mm_mullo_epi32(a.v, b.v)};
+#elif SIMD_SSE2
+  __m128i even = _mm_mul_epu32(a.v, b.v);
+  __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+  return U32x4{_mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)))};
+#elif SIMD_NEON
+  return U32x4{vmulq_u32(a.v, b.v)};
+#else
+  U32x4 hi;
+  U32x4 lo;
+  u32x4_mul_wide(a, b, &hi, &lo);
+  return lo;
+#endif
+}
+
+// Convert lanes to f32; lanes must be below 2^31
+static inline F32x4 f32x4_from_u32x4(U32x4 a) {
+#if SIMD_SSE2
+  return F32x4{_mm_cvtepi32_ps(a.v)};
+#elif SIMD_NEON
+  return F32x4{vcvtq_f32_u32(a.v)};
+#else
+  return F32x4{{(f32)a.v[0], (f32)a.v[1], (f32)a.v[2], (f32)a.v[3]}};
+#endif
+}
+
+// Convert lanes to u32, truncating toward zero; lanes must lie in [0, 2^31)
+static inline U32x4 u32x4_from_f32x4(F32x4 a) {
+#if SIMD_SSE2
+  return U32x4{_mm_cvttps_epi32(a.v)};
+#elif SIMD_NEON
+  return U32x4{vcvtq_u32_f32(a.v)};
+#else
+  return U32x4{{(u32)a.v[0], (u32)a.v[1], (u32)a.v[2], (u32)a.v[3]}};
+#endif
+}
+
+// Transpose a 4x4 block held in four rows
+static inline void u32x4_transpose(U32x4 *r0, U32x4 *r1, U32x4 *r2, U32x4 *r3) {
+#if SIMD_SSE2
+  __m128i t0 = _mm_unpacklo_epi32(r0->v, r1->v);
+  __m128i t1 = _mm_unpacklo_epi32(r2->v, r3->v);
+  __m128i t2 = _mm_unpackhi_epi32(r0->v, r1->v);
+  __m128i t3 = _mm_unpackhi_epi32(r2->v, r3->v);
+  r0->v      = _mm_unpacklo_epi64(t0, t1);
+  r1->v      = _mm_unpackhi_epi64(t0, t1);
+  r2->v      = _mm_unpacklo_epi64(t2, t3);
+  r3->v      = _mm_unpackhi_epi64(t2, t3);
+#elif SIMD_NEON
+  uint32x4x2_t a = vtrnq_u32(r0->v, r1->v);
+  uint32x4x2_t b = vtrnq_u32(r2->v, r3->v);
+  r0->v          = vcombine_u32(vget_low_u32(a.val[0]), vget_low_u32(b.val[0]));
+  r1->v          = vcombine_u32(vget_low_u32(a.val[1]), vget_low_u32(b.val[1]));
+  r2->v          = vcombine_u32(vget_high_u32(a.val[0]), vget_high_u32(b.val[0]));
+  r3->v          = vcombine_u32(vget_high_u32(a.val[1]), vget_high_u32(b.val[1]));
+#else
+  U32x4 *rows[4] = {r0, r1, r2, r3};
+  for(u32 i = 0; i < 4; ++i) {
+    for(u32 j = i + 1; j < 4; ++j) {
+      u32 t         = rows[i]->v[j];
+      rows[i]->v[j] = rows[j]->v[i];
+      rows[j]->v[i] = t;
+    }
+  }
+#endif
+}
+
+#endif // SIMD_H
@@ -5,8 +5,7 @@
 #include <string.h>
 
 // Global scratch arena (single-thread only; do not use concurrently).
-// TODO (multi-thread): use thread-local scratch arenas or add locking to avoid
-// races/corruption.
+// Job workers use their own arenas via job_worker_scratch.
 static Arena  g_scratch_storage = {};
 static Arena *g_scratch_arena   = NULL;
 
@@ -0,0 +1,39 @@
+#include "pool.h"
+#include "core/log.h"
+#include "utils/macros.h"
+
+void pool_init(Pool *pool, Arena *arena, size_t block_size, size_t alignment) {
+  *pool = Pool{};
+
+  // Free blocks store the next pointer in place
+  pool->arena      = arena;
+  pool->block_size = MAX(block_size, sizeof(void *));
+  pool->alignment  = MAX(alignment, ALIGNOF_TYPE(void *));
+}
+
+void *pool_alloc(Pool *pool) {
+  void *block = pool->free_list;
+  if(block) {
+    pool->free_list = *(void **)block;
+  } else {
+    block = arena_alloc_aligned(pool->arena, pool->block_size, pool->alignment);
+    if(!block) {
+      LOG_ERROR("Pool out of memory after %u blocks of %zu bytes", pool->allocated, pool->block_size);
+      return NULL;
+    }
+    pool->allocated++;
+  }
+
+  pool->in_use++;
+  return block;
+}
+
+void pool_free(Pool *pool, void *block) {
+  if(!block) {
+    return;
+  }
+
+  *(void **)block = pool->free_list;
+  pool->free_list = block;
+  pool->in_use--;
+}
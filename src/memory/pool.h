@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Fixed-size block pool on top of an arena. Freed blocks go onto a free list and are
+// handed out again before the arena grows; the arena still owns all memory.
+typedef struct Pool {
+  Arena *arena;
+  size_t block_size;
+  size_t alignment;
+  void  *free_list;
+  u32    allocated; // Blocks carved from the arena so far
+  u32    in_use;
+} Pool;
+
+void  pool_init(Pool *pool, Arena *arena, size_t block_size, size_t alignment);
+void *pool_alloc(Pool *pool);
+void  pool_free(Pool *pool, void *block);
+
+#endif // POOL_H
@@ -143,6 +143,17 @@ void window_get_framebuffer_size(WindowContext *ctx, u32 *width, u32 *height) {
   }
 }
 
+void window_get_size(WindowContext *ctx, u32 *width, u32 *height) {
+  int w, h;
+  SDL_GetWindowSize(ctx->handle, &w, &h);
+  if(width) {
+    *width = (u32)w;
+  }
+  if(height) {
+    *height = (u32)h;
+  }
+}
+
 VkResult window_create_surface(WindowContext *ctx, VkInstance instance, VkSurfaceKHR *surface) {
   if(!SDL_Vulkan_CreateSurface(ctx->handle, instance, NULL, surface)) {
     LOG_ERROR("Failed to create Vulkan surface: %s", SDL_GetError());
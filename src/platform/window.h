@@ -56,6 +56,9 @@ bool window_wait_event(WindowContext *ctx, SDL_Event *event);
 // Get framebuffer size (may differ from window size on HiDPI)
 void window_get_framebuffer_size(WindowContext *ctx, u32 *width, u32 *height);
 
+// Get window size in the coordinates mouse positions are reported in
+void window_get_size(WindowContext *ctx, u32 *width, u32 *height);
+
 // Create Vulkan surface for window
 VkResult window_create_surface(WindowContext *ctx, VkInstance instance, VkSurfaceKHR *surface);
 
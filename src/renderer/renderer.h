@@ -8,8 +8,12 @@
 typedef struct Renderer Renderer;
 typedef u32 MeshHandle;
 struct Camera;
+struct CdlodGrid;
+struct CdlodTree;
 struct Entity;
 struct Mesh;
+struct TerrainStitch;
+struct TerrainTile;
 
 typedef struct RendererConfig {
   const char *app_name;
@@ -20,7 +24,49 @@ Result renderer_create(Renderer **out_renderer, WindowContext *window, const Ren
 void   renderer_destroy(Renderer *renderer);
 
 Result renderer_upload_mesh(Renderer *renderer, const struct Mesh *mesh, MeshHandle *out_handle);
-Result renderer_draw(Renderer *renderer, const Camera *camera, const struct Entity *entities, u32 entity_count);
+Result renderer_upload_terrain_tile(Renderer *renderer, const struct TerrainTile *tile, MeshHandle *out_handle);
+
+// Meshes built off the main thread take their handle up front and are uploaded into it once
+// ready; until then the handle draws nothing. Terrain tiles are copied through the next frame's
+// staging memory: when that is full RESULT_ERROR_OUT_OF_MEMORY is returned with nothing
+// changed, and the tile goes in a later frame. The tile's clusters are kept, not copied.
+Result renderer_reserve_mesh(Renderer *renderer, MeshHandle *out_handle);
+Result renderer_upload_terrain_tile_to(Renderer *renderer, const struct TerrainTile *tile, MeshHandle handle);
+
+// Send the rebuilt vertices, bounds and decode parameters of an uploaded terrain tile the same
+// way, replacing the old ones from the next frame on
+Result renderer_update_terrain_tile(Renderer *renderer, const struct TerrainTile *tile, MeshHandle handle);
+
+// CDLOD terrain. The heights are uploaded whole once; uploading another size later waits for
+// the GPU to go idle.
+Result renderer_upload_cdlod_grid(Renderer *renderer, const struct CdlodGrid *grid);
+Result renderer_upload_terrain_heights(Renderer *renderer, const f32 *heights, u32 width, u32 height);
+
+// Send the cells [x0, x1) x [y0, y1) of heights, laid out as uploaded, through the next frame's
+// staging memory. When that is full nothing is queued and RESULT_ERROR_OUT_OF_MEMORY returned;
+// the rectangle goes in a later frame.
+Result renderer_update_terrain_heights(Renderer *renderer, const f32 *heights, u32 x0, u32 y0, u32 x1, u32 y1);
+
+// Terrain tile LODs. The stitch indices are uploaded once; each tile's LOD and stitched
+// edges then pick which of them it draws, until they are set again.
+Result renderer_upload_terrain_stitch(Renderer *renderer, const struct TerrainStitch *stitch);
+void   renderer_set_terrain_tile_lod(Renderer *renderer, MeshHandle handle, u32 stitch_set, u32 lod, u32 stitch);
+
+// Entities handed to the last renderer_draw, and how many of them were outside the view
+typedef struct RendererCullStats {
+  u32 entity_count;
+  u32 culled_count;
+} RendererCullStats;
+
+RendererCullStats renderer_cull_stats(const Renderer *renderer);
+
+// terrain may be NULL; otherwise its last selection is drawn before the entities. Entities
+// whose mesh bounds lie outside the view are skipped.
+Result renderer_draw(Renderer               *renderer,
+                     const Camera           *camera,
+                     const struct CdlodTree *terrain,
+                     const struct Entity    *entities,
+                     u32                     entity_count);
 Result renderer_resize(Renderer *renderer);
 void   renderer_wait_idle(Renderer *renderer);
 
@@ -2,14 +2,97 @@
 #include "renderer_internal.h"
 
 #include "camera/camera.h"
+#include "camera/frustum.h"
 #include "core/entity.h"
 #include "core/log.h"
+#include "geometry/cdlod.h"
+#include "geometry/meshlet.h"
 #include "utils/macros.h"
 #include <string.h>
 
 const i32 ONE_SECOND = 1000000000;
 
-Result renderer_draw(Renderer *renderer, const Camera *camera, const Entity *entities, u32 entity_count) {
+// Morph distances that keep the coarsest LOD, which has nothing to morph into, unmorphed
+#define CDLOD_NO_MORPH_START 1e30f
+#define CDLOD_NO_MORPH_END   2e30f
+
+// Draw the last CDLOD selection with the shared grid, one draw per node or node quadrant
+static void renderer_internal_draw_cdlod(Renderer *renderer, VkCommandBuffer cmd, const CdlodTree *tree) {
+  const MeshGPU *grid = &renderer->cdlod_grid;
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline->cdlod_pipeline);
+
+  VkBuffer     vertex_buffers[] = {grid->vertex_buffer.buffer};
+  VkDeviceSize offsets[]        = {0};
+  vkCmdBindVertexBuffers(cmd, 0, 1, vertex_buffers, offsets);
+  vkCmdBindIndexBuffer(cmd, grid->index_buffer.buffer, 0, grid->index_type);
+
+  CdlodPushConstants constants = {
+    .node_origin    = {0.0f, 0.0f},
+    .node_spacing   = 1.0f,
+    .morph_start    = 0.0f,
+    .morph_end      = 0.0f,
+    .cell_size      = tree->placement.cell_size,
+    .terrain_origin = {tree->placement.origin_x, tree->placement.origin_z},
+    .terrain_size   = {renderer->terrain_width, renderer->terrain_height},
+  };
+
+  for(u32 i = 0; i < tree->node_count; ++i) {
+    const CdlodNode *node = &tree->nodes[i];
+    const bool       top  = node->lod + 1 == tree->lod_count;
+
+    constants.node_origin[0] = (f32)node->x;
+    constants.node_origin[1] = (f32)node->y;
+    constants.node_spacing   = (f32)(1u << node->lod);
+    constants.morph_start    = top ? CDLOD_NO_MORPH_START : tree->morph_start[node->lod];
+    constants.morph_end      = top ? CDLOD_NO_MORPH_END : tree->ranges[node->lod];
+    vkCmdPushConstants(
+      cmd, renderer->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(CdlodPushConstants), &constants);
+
+    if(node->quadrants == CDLOD_QUADRANTS_ALL) {
+      vkCmdDrawIndexed(cmd, grid->index_count, 1, 0, 0, 0);
+      continue;
+    }
+    for(u32 q = 0; q < 4; ++q) {
+      if(node->quadrants & (1u << q)) {
+        vkCmdDrawIndexed(cmd, renderer->cdlod_quadrant_count, 1, renderer->cdlod_quadrant_first[q], 0, 0);
+      }
+    }
+  }
+}
+
+// Draw the clusters of a mesh that pass the frustum and back-face cone tests. Clusters are
+// contiguous in the index buffer, so each run of visible neighbours is one draw.
+static void renderer_internal_draw_clusters(VkCommandBuffer cmd,
+                                            const MeshGPU  *mesh_gpu,
+                                            const Frustum  *frustum,
+                                            const f32       eye[3]) {
+  const MeshletSet *clusters = &mesh_gpu->clusters;
+  ArenaTemp         scratch  = arena_scratch_begin();
+  u32              *visible  = ARENA_PUSH_ARRAY(scratch.arena, u32, clusters->meshlet_count);
+  if(!visible) {
+    vkCmdDrawIndexed(cmd, mesh_gpu->index_count, 1, 0, 0, 0);
+    arena_temp_end(scratch);
+    return;
+  }
+
+  u32 visible_count = meshlet_cull(clusters->bounds, clusters->meshlet_count, frustum, eye, visible);
+  for(u32 i = 0; i < visible_count;) {
+    const Meshlet *first          = &clusters->meshlets[visible[i]];
+    u32            triangle_count = first->triangle_count;
+    for(++i; i < visible_count && visible[i] == visible[i - 1] + 1; ++i) {
+      triangle_count += clusters->meshlets[visible[i]].triangle_count;
+    }
+    vkCmdDrawIndexed(cmd, triangle_count * 3, 1, first->triangle_offset * 3, 0, 0);
+  }
+  arena_temp_end(scratch);
+}
+
+Result renderer_draw(Renderer        *renderer,
+                     const Camera    *camera,
+                     const CdlodTree *terrain,
+                     const Entity    *entities,
+                     u32              entity_count) {
   if(!renderer || !camera) {
     return RESULT_ERROR_GENERIC;
   }
@@ -65,17 +148,41 @@ Result renderer_draw(Renderer *renderer, const Camera *camera, const Entity *ent
 
   CameraUniformData uniform_data = {};
   uniform_data.view              = view_matrix(*camera);
-  uniform_data.proj              = glm::perspective(glm::radians(camera->zoom), aspect, 0.1f, 100.0f);
-  uniform_data.proj[1][1] *= -1.0f;
-  uniform_data.camera_pos = glm::vec4(camera->position, 1.0f);
+  uniform_data.proj              = projection_matrix(*camera, aspect);
+  uniform_data.camera_pos        = glm::vec4(camera->position, 1.0f);
 
   memcpy(renderer->camera_uniform_mapped[frame_index], &uniform_data, sizeof(uniform_data));
 
+  glm::mat4 view_proj = uniform_data.proj * uniform_data.view;
+  f32       eye[3]    = {camera->position.x, camera->position.y, camera->position.z};
+  Frustum   frustum   = {};
+  frustum_from_matrix(&frustum, &view_proj[0][0]);
+
+  // Mesh space is world space, so an entity's bounds are its mesh's. Every mesh is tested
+  // once up front and the entities only look up their mesh's result.
+  FrustumBoxes mesh_boxes = {
+    .center = {renderer->mesh_center[0], renderer->mesh_center[1], renderer->mesh_center[2]},
+    .extent = {renderer->mesh_extent[0], renderer->mesh_extent[1], renderer->mesh_extent[2]},
+    .radius = renderer->mesh_radius,
+  };
+  frustum_cull_boxes(&frustum, &mesh_boxes, renderer->mesh_count, renderer->mesh_visible);
+  renderer->cull_stats = RendererCullStats{
+    .entity_count = entity_count,
+    .culled_count = 0,
+  };
+
   VkCommandBuffer cmd = vk_command_get_buffer(&renderer->command, frame_index);
 
   VK_CHECK_RETURN(vk_command_begin(cmd, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT), RESULT_ERROR_VULKAN);
 
-  VkClearValue clear_color = {{{0.1f, 0.1f, 0.15f, 1.0f}}};
+  // Uploads staged since the last frame land before anything draws. Their region is busy
+  // until this submission completes, so the next write waits for its fence again.
+  vk_staging_record(&renderer->staging, cmd);
+  renderer->staging_ready = false;
+
+  VkClearValue clear_values[2] = {};
+  clear_values[0].color        = {{0.1f, 0.1f, 0.15f, 1.0f}};
+  clear_values[1].depthStencil = {1.0f, 0};
 
   VkRenderPassBeginInfo render_pass_info = {
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -86,8 +193,8 @@ Result renderer_draw(Renderer *renderer, const Camera *camera, const Entity *ent
               .offset = {0, 0},
               .extent = renderer->swapchain.extent,
           },
-      .clearValueCount = 1,
-      .pClearValues = &clear_color,
+      .clearValueCount = 2,
+      .pClearValues = clear_values,
   };
 
   vkCmdBeginRenderPass(cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
@@ -117,17 +224,62 @@ Result renderer_draw(Renderer *renderer, const Camera *camera, const Entity *ent
   };
   vkCmdSetScissor(cmd, 0, 1, &scissor);
 
+  const bool draw_terrain = terrain && terrain->node_count > 0 && renderer->terrain_heights.buffer != VK_NULL_HANDLE
+                         && renderer->cdlod_grid.vertex_buffer.buffer != VK_NULL_HANDLE;
+  if(draw_terrain) {
+    renderer_internal_draw_cdlod(renderer, cmd, terrain);
+  }
+
+  // All pipelines share the layout, so only the pipeline changes between formats
+  VkPipeline bound_pipeline = draw_terrain ? renderer->pipeline->cdlod_pipeline : renderer->pipeline->pipeline;
   for(u32 i = 0; i < entity_count; ++i) {
-    MeshHandle   handle = entities[i].mesh_handle;
+    MeshHandle handle = entities[i].mesh_handle;
     if(handle >= renderer->mesh_count) {
       continue;
     }
-    const MeshGPU *mesh_gpu        = &renderer->meshes[handle];
-    VkBuffer       vertex_buffers[] = {mesh_gpu->vertex_buffer.buffer};
-    VkDeviceSize   offsets[]        = {0};
+    const MeshGPU *mesh_gpu = &renderer->meshes[handle];
+    if(!mesh_gpu->ready) {
+      continue;
+    }
+    if(!renderer->mesh_visible[handle]) {
+      renderer->cull_stats.culled_count++;
+      continue;
+    }
+    VkPipeline pipeline = mesh_gpu->format == VERTEX_FORMAT_TERRAIN ? renderer->pipeline->terrain_pipeline
+                                                                    : renderer->pipeline->pipeline;
+    if(pipeline != bound_pipeline) {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+      bound_pipeline = pipeline;
+    }
+    if(mesh_gpu->format == VERTEX_FORMAT_TERRAIN) {
+      vkCmdPushConstants(cmd,
+                         renderer->pipeline->layout,
+                         VK_SHADER_STAGE_VERTEX_BIT,
+                         0,
+                         sizeof(TerrainPushConstants),
+                         &mesh_gpu->terrain);
+    }
+
+    VkBuffer     vertex_buffers[] = {mesh_gpu->vertex_buffer.buffer};
+    VkDeviceSize offsets[]        = {0};
     vkCmdBindVertexBuffers(cmd, 0, 1, vertex_buffers, offsets);
-    vkCmdBindIndexBuffer(cmd, mesh_gpu->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmd, mesh_gpu->index_count, 1, 0, 0, 0);
+
+    // Coarser or stitched tiles draw a range of the shared indices over their own vertices
+    if(mesh_gpu->format == VERTEX_FORMAT_TERRAIN && (mesh_gpu->lod > 0 || mesh_gpu->stitch != 0)
+       && renderer->terrain_stitch_indices.buffer != VK_NULL_HANDLE) {
+      const TerrainStitchSet *set = &renderer->terrain_stitch_sets[mesh_gpu->stitch_set];
+      vkCmdBindIndexBuffer(cmd, renderer->terrain_stitch_indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+      vkCmdDrawIndexed(
+        cmd, set->count[mesh_gpu->lod][mesh_gpu->stitch], 1, set->first[mesh_gpu->lod][mesh_gpu->stitch], 0, 0);
+      continue;
+    }
+
+    vkCmdBindIndexBuffer(cmd, mesh_gpu->index_buffer.buffer, 0, mesh_gpu->index_type);
+    if(mesh_gpu->clusters.meshlet_count > 0) {
+      renderer_internal_draw_clusters(cmd, mesh_gpu, &frustum, eye);
+    } else {
+      vkCmdDrawIndexed(cmd, mesh_gpu->index_count, 1, 0, 0, 0);
+    }
   }
 
   vkCmdEndRenderPass(cmd);
@@ -209,6 +361,13 @@ Result renderer_resize(Renderer *renderer) {
   return RESULT_SUCCESS;
 }
 
+RendererCullStats renderer_cull_stats(const Renderer *renderer) {
+  if(!renderer) {
+    return RendererCullStats{};
+  }
+  return renderer->cull_stats;
+}
+
 void renderer_wait_idle(Renderer *renderer) {
   if(!renderer) {
     return;
@@ -1,7 +1,12 @@
 #include "renderer_internal.h"
 
 #include "core/log.h"
+#include "geometry/cdlod.h"
 #include "geometry/mesh.h"
+#include "geometry/mesh_optimize.h"
+#include "geometry/meshlet.h"
+#include "geometry/terrain_mesh.h"
+#include "geometry/terrain_stitch.h"
 
 #include <string.h>
 
@@ -52,15 +57,21 @@ static VkResult renderer_internal_create_camera_uniforms(Renderer *renderer) {
     }
   }
 
-  VkDescriptorPoolSize pool_size = {
-    .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = MAX_FRAMES_IN_FLIGHT,
+  VkDescriptorPoolSize pool_sizes[] = {
+    {
+      .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount = MAX_FRAMES_IN_FLIGHT,
+    },
+    {
+      .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = MAX_FRAMES_IN_FLIGHT,
+    },
   };
 
   VkDescriptorPoolCreateInfo pool_info = {
     .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-    .poolSizeCount = 1,
-    .pPoolSizes    = &pool_size,
+    .poolSizeCount = 2,
+    .pPoolSizes    = pool_sizes,
     .maxSets       = MAX_FRAMES_IN_FLIGHT,
   };
 
@@ -113,24 +124,65 @@ static VkResult renderer_internal_create_camera_uniforms(Renderer *renderer) {
   return VK_SUCCESS;
 }
 
-Result renderer_upload_mesh(Renderer *renderer, const Mesh *mesh, MeshHandle *out_handle) {
-  if(!renderer || !mesh || !out_handle) {
-    return RESULT_ERROR_GENERIC;
+bool renderer_internal_stage(
+  Renderer *renderer, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size) {
+  // The frame's staging region was last copied from by the submission behind its fence,
+  // which renderer_draw waits for next anyway, so this only moves the wait earlier
+  if(!renderer->staging_ready) {
+    VkResult vk_result = vk_sync_wait_for_fence(renderer->device.device, &renderer->sync);
+    if(vk_result != VK_SUCCESS) {
+      LOG_ERROR("Failed waiting for in-flight fence before staging: %d", vk_result);
+      return false;
+    }
+    vk_staging_begin(&renderer->staging, renderer->sync.current_frame);
+    renderer->staging_ready = true;
   }
+  return vk_staging_write(&renderer->staging, dst, dst_offset, data, size);
+}
 
-  if(renderer->mesh_count >= MAX_MESHES) {
-    LOG_ERROR("Maximum mesh count (%d) reached", MAX_MESHES);
-    return RESULT_ERROR_GENERIC;
+// Record a mesh's bounds for the batched frustum test
+static void renderer_internal_set_bounds(Renderer *renderer, MeshHandle slot, const MeshBounds *bounds) {
+  for(u32 c = 0; c < 3; ++c) {
+    renderer->mesh_center[c][slot] = bounds->center[c];
+    renderer->mesh_extent[c][slot] = (bounds->max[c] - bounds->min[c]) * 0.5f;
   }
+  renderer->mesh_radius[slot] = bounds->radius;
+}
 
-  u32      slot      = renderer->mesh_count;
+// Upload vertex and index data into a reserved mesh slot. With positions (xyz, position_stride
+// bytes apart) the triangles are first split into clusters, rewriting indices in their order.
+static Result renderer_internal_upload(Renderer         *renderer,
+                                       MeshHandle        slot,
+                                       const void       *vertices,
+                                       u32               vertex_count,
+                                       size_t            vertex_size,
+                                       void             *indices,
+                                       u32               index_count,
+                                       IndexType         index_type,
+                                       const f32        *positions,
+                                       size_t            position_stride,
+                                       const MeshBounds *bounds) {
   MeshGPU *mesh_gpu  = &renderer->meshes[slot];
   VkResult vk_result = VK_SUCCESS;
 
+  mesh_gpu->clusters = MeshletSet{};
+  if(positions
+     && !meshlet_build(&mesh_gpu->clusters,
+                       indices,
+                       index_type,
+                       index_count,
+                       positions,
+                       position_stride,
+                       vertex_count,
+                       renderer->arena,
+                       arena_scratch_get())) {
+    LOG_WARN("Failed to build clusters for mesh %u, drawing it whole", slot);
+  }
+
   vk_result = vk_buffer_create_vertex(&renderer->device,
                                       renderer->command.pool,
-                                      mesh->vertices,
-                                      mesh->vertex_count * sizeof(Vertex),
+                                      vertices,
+                                      vertex_count * vertex_size,
                                       &mesh_gpu->vertex_buffer);
   if(vk_result != VK_SUCCESS) {
     LOG_ERROR("Failed to create vertex buffer for mesh %u: %d", slot, vk_result);
@@ -139,8 +191,8 @@ Result renderer_upload_mesh(Renderer *renderer, const Mesh *mesh, MeshHandle *ou
 
   vk_result = vk_buffer_create_index(&renderer->device,
                                      renderer->command.pool,
-                                     mesh->indices,
-                                     mesh->index_count * sizeof(u32),
+                                     indices,
+                                     index_count * mesh_index_size(index_type),
                                      &mesh_gpu->index_buffer);
   if(vk_result != VK_SUCCESS) {
     LOG_ERROR("Failed to create index buffer for mesh %u: %d", slot, vk_result);
@@ -148,11 +200,352 @@ Result renderer_upload_mesh(Renderer *renderer, const Mesh *mesh, MeshHandle *ou
     return RESULT_ERROR_VULKAN;
   }
 
-  mesh_gpu->index_count = mesh->index_count;
-  renderer->mesh_count++;
-  *out_handle = slot;
+  mesh_gpu->index_count = index_count;
+  mesh_gpu->index_type  = index_type == INDEX_TYPE_U16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  renderer_internal_set_bounds(renderer, slot, bounds);
 
-  LOG_INFO("Uploaded mesh %u (%u vertices, %u indices)", slot, mesh->vertex_count, mesh->index_count);
+  LOG_INFO("Uploaded mesh %u (%u vertices, %u %s indices, %u clusters)",
+           slot,
+           vertex_count,
+           index_count,
+           index_type == INDEX_TYPE_U16 ? "u16" : "u32",
+           mesh_gpu->clusters.meshlet_count);
+  return RESULT_SUCCESS;
+}
+
+Result renderer_reserve_mesh(Renderer *renderer, MeshHandle *out_handle) {
+  if(!renderer || !out_handle) {
+    return RESULT_ERROR_GENERIC;
+  }
+  if(renderer->mesh_count >= MAX_MESHES) {
+    LOG_ERROR("Maximum mesh count (%d) reached", MAX_MESHES);
+    return RESULT_ERROR_GENERIC;
+  }
+
+  renderer->meshes[renderer->mesh_count] = MeshGPU{};
+  *out_handle                            = renderer->mesh_count++;
+  return RESULT_SUCCESS;
+}
+
+Result renderer_upload_mesh(Renderer *renderer, const Mesh *mesh, MeshHandle *out_handle) {
+  if(!renderer || !mesh || !out_handle) {
+    return RESULT_ERROR_GENERIC;
+  }
+
+  MeshHandle handle = 0;
+  Result     result = renderer_reserve_mesh(renderer, &handle);
+  if(result != RESULT_SUCCESS) {
+    return result;
+  }
+
+  // Upload a copy reordered for the vertex caches and split into clusters; the mesh itself is
+  // left as it is. A copy that could not be optimized still holds the same triangles.
+  ArenaTemp scratch   = arena_scratch_begin();
+  Mesh      optimized = *mesh;
+  optimized.vertices  = ARENA_PUSH_ARRAY(scratch.arena, Vertex, mesh->vertex_count);
+  optimized.indices   = arena_alloc_aligned(
+    scratch.arena, (size_t)mesh->index_count * mesh_index_size(mesh->index_type), sizeof(u32));
+  if(!optimized.vertices || !optimized.indices) {
+    LOG_ERROR("Failed to allocate mesh optimization scratch");
+    arena_temp_end(scratch);
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+  memcpy(optimized.vertices, mesh->vertices, mesh->vertex_count * sizeof(Vertex));
+  memcpy(optimized.indices, mesh->indices, (size_t)mesh->index_count * mesh_index_size(mesh->index_type));
+  if(!mesh_optimize(&optimized, scratch.arena)) {
+    LOG_WARN("Failed to optimize mesh, uploading it in its original order");
+  }
+  // Culling bounds come from what is uploaded, whatever the caller left in mesh->bounds
+  MeshBounds bounds;
+  mesh_bounds_compute(&bounds, optimized.vertices[0].position, sizeof(Vertex), optimized.vertex_count);
+
+  result = renderer_internal_upload(renderer,
+                                    handle,
+                                    optimized.vertices,
+                                    optimized.vertex_count,
+                                    sizeof(Vertex),
+                                    optimized.indices,
+                                    optimized.index_count,
+                                    optimized.index_type,
+                                    optimized.vertices[0].position,
+                                    sizeof(Vertex),
+                                    &bounds);
+  arena_temp_end(scratch);
+  if(result != RESULT_SUCCESS) {
+    return result;
+  }
+
+  renderer->meshes[handle].format = VERTEX_FORMAT_STANDARD;
+  renderer->meshes[handle].ready  = true;
+  *out_handle                     = handle;
+  return RESULT_SUCCESS;
+}
+
+Result renderer_upload_terrain_tile(Renderer *renderer, const TerrainTile *tile, MeshHandle *out_handle) {
+  if(!renderer || !tile || !out_handle) {
+    return RESULT_ERROR_GENERIC;
+  }
+
+  MeshHandle handle = 0;
+  Result     result = renderer_reserve_mesh(renderer, &handle);
+  if(result == RESULT_SUCCESS) {
+    result = renderer_upload_terrain_tile_to(renderer, tile, handle);
+  }
+  if(result == RESULT_SUCCESS) {
+    *out_handle = handle;
+  }
+  return result;
+}
+
+Result renderer_upload_terrain_tile_to(Renderer *renderer, const TerrainTile *tile, MeshHandle handle) {
+  if(!renderer || !tile || handle >= renderer->mesh_count) {
+    return RESULT_ERROR_GENERIC;
+  }
+  if(renderer->meshes[handle].ready) {
+    LOG_ERROR("Mesh %u already uploaded", handle);
+    return RESULT_ERROR_GENERIC;
+  }
+
+  // The meshing job already bounded the tile and its clusters; only the copies are left, and
+  // they go through the next frame's staging memory whole or not at all
+  VkDeviceSize vertex_size = (VkDeviceSize)tile->vertex_count * sizeof(TerrainVertex);
+  VkDeviceSize index_size  = (VkDeviceSize)tile->index_count * mesh_index_size(tile->index_type);
+  if(vk_staging_room(&renderer->staging) < vertex_size + index_size + 2 * VK_STAGING_ALIGNMENT
+     || renderer->staging.copy_count + 2 > VK_STAGING_MAX_COPIES) {
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  MeshGPU *mesh_gpu  = &renderer->meshes[handle];
+  VkResult vk_result = vk_buffer_create(&renderer->device,
+                                        vertex_size,
+                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        &mesh_gpu->vertex_buffer);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create vertex buffer for terrain tile %u: %d", handle, vk_result);
+    return RESULT_ERROR_VULKAN;
+  }
+  vk_result = vk_buffer_create(&renderer->device,
+                               index_size,
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &mesh_gpu->index_buffer);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create index buffer for terrain tile %u: %d", handle, vk_result);
+    vk_buffer_destroy(renderer->device.device, &mesh_gpu->vertex_buffer);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  // Draws are recorded after the frame's copies in the same command buffer, so the tile can be
+  // drawn from this frame on, and the frame's fence tells when the staging memory is free again
+  if(!renderer_internal_stage(renderer, mesh_gpu->vertex_buffer.buffer, 0, tile->vertices, vertex_size)
+     || !renderer_internal_stage(renderer, mesh_gpu->index_buffer.buffer, 0, tile->indices, index_size)) {
+    LOG_ERROR("Failed to stage terrain tile %u", handle);
+    vk_buffer_destroy(renderer->device.device, &mesh_gpu->index_buffer);
+    vk_buffer_destroy(renderer->device.device, &mesh_gpu->vertex_buffer);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  mesh_gpu->index_count = tile->index_count;
+  mesh_gpu->index_type  = tile->index_type == INDEX_TYPE_U16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  mesh_gpu->clusters    = tile->clusters;
+  renderer_internal_set_bounds(renderer, handle, &tile->bounds);
+
+  mesh_gpu->format  = VERTEX_FORMAT_TERRAIN;
+  mesh_gpu->terrain = TerrainPushConstants{
+    .origin       = {tile->origin[0], tile->origin[1]},
+    .cell_size    = tile->cell_size,
+    .height_min   = tile->height_min,
+    .height_range = tile->height_scale * 65535.0f,
+  };
+  mesh_gpu->ready = true;
+  return RESULT_SUCCESS;
+}
+
+Result renderer_update_terrain_tile(Renderer *renderer, const TerrainTile *tile, MeshHandle handle) {
+  if(!renderer || !tile || handle >= renderer->mesh_count) {
+    return RESULT_ERROR_GENERIC;
+  }
+  MeshGPU     *mesh_gpu    = &renderer->meshes[handle];
+  VkDeviceSize vertex_size = (VkDeviceSize)tile->vertex_count * sizeof(TerrainVertex);
+  if(!mesh_gpu->ready || mesh_gpu->format != VERTEX_FORMAT_TERRAIN || mesh_gpu->vertex_buffer.size != vertex_size) {
+    LOG_ERROR("Mesh %u is not an uploaded terrain tile of %u vertices", handle, tile->vertex_count);
+    return RESULT_ERROR_GENERIC;
+  }
+
+  // Overwritten in place: the copy is ordered after earlier frames' reads and before this
+  // frame's draws, which take the new decode parameters with it
+  if(vk_staging_room(&renderer->staging) < vertex_size + VK_STAGING_ALIGNMENT
+     || renderer->staging.copy_count + 1 > VK_STAGING_MAX_COPIES) {
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+  if(!renderer_internal_stage(renderer, mesh_gpu->vertex_buffer.buffer, 0, tile->vertices, vertex_size)) {
+    LOG_ERROR("Failed to stage terrain tile %u", handle);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  mesh_gpu->clusters = tile->clusters;
+  renderer_internal_set_bounds(renderer, handle, &tile->bounds);
+  mesh_gpu->terrain.height_min   = tile->height_min;
+  mesh_gpu->terrain.height_range = tile->height_scale * 65535.0f;
+  return RESULT_SUCCESS;
+}
+
+Result renderer_upload_cdlod_grid(Renderer *renderer, const CdlodGrid *grid) {
+  if(!renderer || !grid) {
+    return RESULT_ERROR_GENERIC;
+  }
+  if(renderer->cdlod_grid.vertex_buffer.buffer != VK_NULL_HANDLE) {
+    LOG_ERROR("CDLOD grid already uploaded");
+    return RESULT_ERROR_GENERIC;
+  }
+
+  MeshGPU *mesh_gpu  = &renderer->cdlod_grid;
+  VkResult vk_result = vk_buffer_create_vertex(&renderer->device,
+                                               renderer->command.pool,
+                                               grid->vertices,
+                                               grid->vertex_count * sizeof(GridVertex),
+                                               &mesh_gpu->vertex_buffer);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create CDLOD grid vertex buffer: %d", vk_result);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  vk_result = vk_buffer_create_index(&renderer->device,
+                                     renderer->command.pool,
+                                     grid->indices,
+                                     grid->index_count * sizeof(u16),
+                                     &mesh_gpu->index_buffer);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create CDLOD grid index buffer: %d", vk_result);
+    vk_buffer_destroy(renderer->device.device, &mesh_gpu->vertex_buffer);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  mesh_gpu->index_count = grid->index_count;
+  mesh_gpu->index_type  = VK_INDEX_TYPE_UINT16;
+  mesh_gpu->format      = VERTEX_FORMAT_GRID;
+  memcpy(renderer->cdlod_quadrant_first, grid->quadrant_first, sizeof(renderer->cdlod_quadrant_first));
+  renderer->cdlod_quadrant_count = grid->quadrant_count;
+  return RESULT_SUCCESS;
+}
+
+Result renderer_upload_terrain_stitch(Renderer *renderer, const TerrainStitch *stitch) {
+  if(!renderer || !stitch || stitch->index_count == 0) {
+    return RESULT_ERROR_GENERIC;
+  }
+  if(renderer->terrain_stitch_indices.buffer != VK_NULL_HANDLE) {
+    LOG_ERROR("Terrain stitch indices already uploaded");
+    return RESULT_ERROR_GENERIC;
+  }
+
+  VkResult vk_result = vk_buffer_create_index(&renderer->device,
+                                              renderer->command.pool,
+                                              stitch->indices,
+                                              stitch->index_count * sizeof(u16),
+                                              &renderer->terrain_stitch_indices);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create terrain stitch index buffer: %d", vk_result);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  memcpy(renderer->terrain_stitch_sets, stitch->sets, sizeof(renderer->terrain_stitch_sets));
+  renderer->terrain_stitch_set_count = stitch->set_count;
+  LOG_INFO("Uploaded terrain stitch indices (%u tile sizes, %u indices)", stitch->set_count, stitch->index_count);
+  return RESULT_SUCCESS;
+}
+
+void renderer_set_terrain_tile_lod(Renderer *renderer, MeshHandle handle, u32 stitch_set, u32 lod, u32 stitch) {
+  if(!renderer || handle >= renderer->mesh_count || stitch_set >= renderer->terrain_stitch_set_count
+     || lod >= renderer->terrain_stitch_sets[stitch_set].lod_count || stitch >= TERRAIN_STITCH_VARIANTS) {
+    return;
+  }
+
+  MeshGPU *mesh_gpu = &renderer->meshes[handle];
+  if(mesh_gpu->format != VERTEX_FORMAT_TERRAIN) {
+    return;
+  }
+  mesh_gpu->stitch_set = stitch_set;
+  mesh_gpu->lod        = lod;
+  mesh_gpu->stitch     = stitch;
+}
+
+Result renderer_upload_terrain_heights(Renderer *renderer, const f32 *heights, u32 width, u32 height) {
+  if(!renderer || !heights || width < 2 || height < 2) {
+    return RESULT_ERROR_GENERIC;
+  }
+  if(renderer->terrain_heights.buffer != VK_NULL_HANDLE && renderer->terrain_width == width
+     && renderer->terrain_height == height) {
+    return renderer_update_terrain_heights(renderer, heights, 0, 0, width, height);
+  }
+
+  VkDeviceSize size = (VkDeviceSize)width * height * sizeof(f32);
+
+  // The old buffer is read by frames in flight and bound in every frame's descriptor set
+  if(renderer->terrain_heights.buffer != VK_NULL_HANDLE) {
+    vk_device_wait_idle(&renderer->device);
+  }
+  vk_buffer_destroy(renderer->device.device, &renderer->terrain_heights);
+  renderer->terrain_width  = 0;
+  renderer->terrain_height = 0;
+
+  VkResult vk_result
+    = vk_buffer_create_storage(&renderer->device, renderer->command.pool, heights, size, &renderer->terrain_heights);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create terrain height buffer: %d", vk_result);
+    return RESULT_ERROR_VULKAN;
+  }
+
+  for(u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkDescriptorBufferInfo buffer_info = {
+      .buffer = renderer->terrain_heights.buffer,
+      .offset = 0,
+      .range  = size,
+    };
+
+    VkWriteDescriptorSet descriptor_write = {
+      .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet          = renderer->camera_descriptor_sets[i],
+      .dstBinding      = VK_PIPELINE_TERRAIN_HEIGHTS_BINDING,
+      .dstArrayElement = 0,
+      .descriptorCount = 1,
+      .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pBufferInfo     = &buffer_info,
+    };
+
+    vkUpdateDescriptorSets(renderer->device.device, 1, &descriptor_write, 0, NULL);
+  }
+
+  renderer->terrain_width  = width;
+  renderer->terrain_height = height;
+  LOG_INFO("Uploaded terrain heights (%ux%u)", width, height);
+  return RESULT_SUCCESS;
+}
+
+Result renderer_update_terrain_heights(Renderer *renderer, const f32 *heights, u32 x0, u32 y0, u32 x1, u32 y1) {
+  if(!renderer || !heights || renderer->terrain_heights.buffer == VK_NULL_HANDLE || x0 >= x1 || y0 >= y1
+     || x1 > renderer->terrain_width || y1 > renderer->terrain_height) {
+    return RESULT_ERROR_GENERIC;
+  }
+
+  // Whole rows are contiguous on both sides and go as one copy, anything narrower row by row
+  const u32    width     = renderer->terrain_width;
+  const bool   full_rows = x0 == 0 && x1 == width;
+  const u32    copies    = full_rows ? 1 : y1 - y0;
+  VkDeviceSize copy_size = (VkDeviceSize)(x1 - x0) * (full_rows ? y1 - y0 : 1) * sizeof(f32);
+
+  // Leave nothing half queued: the caller sends the whole rectangle again later
+  if(vk_staging_room(&renderer->staging) < copies * (copy_size + VK_STAGING_ALIGNMENT)
+     || renderer->staging.copy_count + copies > VK_STAGING_MAX_COPIES) {
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+  for(u32 i = 0; i < copies; ++i) {
+    VkDeviceSize offset = ((VkDeviceSize)(y0 + i) * width + x0) * sizeof(f32);
+    if(!renderer_internal_stage(
+         renderer, renderer->terrain_heights.buffer, offset, (const u8 *)heights + offset, copy_size)) {
+      return RESULT_ERROR_VULKAN;
+    }
+  }
   return RESULT_SUCCESS;
 }
 
@@ -170,6 +563,7 @@ Result renderer_create(Renderer **out_renderer, WindowContext *window, const Ren
   }
 
   memset(renderer, 0, sizeof(*renderer));
+  renderer->arena  = arena;
   renderer->window = window;
 
   LOG_INFO("Initializing renderer");
@@ -241,6 +635,13 @@ Result renderer_create(Renderer **out_renderer, WindowContext *window, const Ren
     goto fail;
   }
 
+  vk_result = vk_staging_create(&renderer->device, RENDERER_STAGING_FRAME_SIZE, &renderer->staging);
+  if(vk_result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create staging buffer");
+    error = RESULT_ERROR_VULKAN;
+    goto fail;
+  }
+
   renderer->render_pass = ARENA_PUSH_STRUCT(arena, VkRenderPassContext);
   if(!renderer->render_pass) {
     LOG_ERROR("Failed to allocate render pass context");
@@ -248,7 +649,8 @@ Result renderer_create(Renderer **out_renderer, WindowContext *window, const Ren
     goto fail;
   }
 
-  vk_result = vk_renderpass_create(renderer->device.device, renderer->swapchain.format, renderer->render_pass);
+  vk_result = vk_renderpass_create(
+    renderer->device.device, renderer->swapchain.format, RENDERER_DEPTH_FORMAT, renderer->render_pass);
   if(vk_result != VK_SUCCESS) {
     LOG_ERROR("Failed to create render pass");
     error = RESULT_ERROR_VULKAN;
@@ -314,6 +716,11 @@ void renderer_destroy(Renderer *renderer) {
       vk_buffer_destroy(renderer->device.device, &renderer->meshes[i].vertex_buffer);
     }
     renderer->mesh_count = 0;
+
+    vk_buffer_destroy(renderer->device.device, &renderer->cdlod_grid.index_buffer);
+    vk_buffer_destroy(renderer->device.device, &renderer->cdlod_grid.vertex_buffer);
+    vk_buffer_destroy(renderer->device.device, &renderer->terrain_heights);
+    vk_buffer_destroy(renderer->device.device, &renderer->terrain_stitch_indices);
   }
   if(has_device) {
     renderer_internal_destroy_camera_uniforms(renderer);
@@ -332,6 +739,7 @@ void renderer_destroy(Renderer *renderer) {
   }
 
   if(has_device) {
+    vk_staging_destroy(renderer->device.device, &renderer->staging);
     vk_command_destroy(renderer->device.device, &renderer->command);
     vk_sync_destroy(renderer->device.device, &renderer->sync);
     renderer_internal_destroy_render_finished(renderer);
@@ -5,21 +5,41 @@
 #include "renderer/vk_buffer.h"
 #include "renderer/vk_command.h"
 #include "renderer/vk_device.h"
+#include "renderer/vk_image.h"
 #include "renderer/vk_instance.h"
 #include "renderer/vk_pipeline.h"
 #include "renderer/vk_renderpass.h"
+#include "renderer/vk_staging.h"
 #include "renderer/vk_swapchain.h"
 #include "renderer/vk_sync.h"
+#include "geometry/meshlet.h"
+#include "geometry/terrain_stitch.h"
+#include "geometry/vertex.h"
+#include "utils/macros.h"
 #include "glm/glm.hpp"
 
-#define MAX_MESHES 64
+#define MAX_MESHES 1024
+
+// Depth attachment shared by all framebuffers
+#define RENDERER_DEPTH_FORMAT VK_FORMAT_D32_SFLOAT
+
+// Staging memory per frame in flight for uploads recorded into the frames
+#define RENDERER_STAGING_FRAME_SIZE MEGABYTES(4)
 
 typedef u32 MeshHandle;
 
 typedef struct MeshGPU {
-  VkBufferContext vertex_buffer;
-  VkBufferContext index_buffer;
-  u32             index_count;
+  VkBufferContext      vertex_buffer;
+  VkBufferContext      index_buffer;
+  u32                  index_count;
+  VkIndexType          index_type;
+  VertexFormat         format;
+  TerrainPushConstants terrain;    // VERTEX_FORMAT_TERRAIN only
+  MeshletSet           clusters;   // Index buffer order; empty when the mesh is drawn whole
+  u32                  stitch_set; // Terrain tiles: set of the tile's size in the stitch indices
+  u32                  lod;        // Terrain tiles at a LOD or with stitched edges draw the stitch indices
+  u32                  stitch;     // TERRAIN_STITCH_* edges meeting a coarser neighbour
+  bool                 ready;      // Reserved slots draw nothing until uploaded
 } MeshGPU;
 
 typedef struct CameraUniformData {
@@ -35,10 +55,13 @@ struct Renderer {
   VkSwapchainContext swapchain;
   VkSyncContext      sync;
   VkCommandContext   command;
+  VkStagingContext   staging;
+  bool               staging_ready; // The current frame's staging region is free to fill
 
   VkRenderPassContext *render_pass;
   VkPipelineContext   *pipeline;
 
+  VkImageContext   depth; // Sized with the swapchain, recreated with the framebuffers
   VkFramebuffer    framebuffers[MAX_SWAPCHAIN_IMAGES];
   u32              framebuffer_count;
   VkFence          images_in_flight[MAX_SWAPCHAIN_IMAGES];
@@ -51,14 +74,43 @@ struct Renderer {
   MeshGPU meshes[MAX_MESHES];
   u32     mesh_count;
 
+  // Bounds of the meshes by handle, one array per component for the batched frustum test
+  f32 mesh_center[3][MAX_MESHES];
+  f32 mesh_extent[3][MAX_MESHES]; // Half the box size
+  f32 mesh_radius[MAX_MESHES];    // Sphere around the center
+  u8  mesh_visible[MAX_MESHES];   // Result of the last renderer_draw's test
+
+  // Entities drawn and culled by the last renderer_draw
+  RendererCullStats cull_stats;
+
+  // CDLOD terrain: heightfield samples read by the vertex shader, drawn with one shared grid
+  VkBufferContext terrain_heights;
+  u32             terrain_width;
+  u32             terrain_height;
+  MeshGPU         cdlod_grid;
+  u32             cdlod_quadrant_first[4];
+  u32             cdlod_quadrant_count;
+
+  // Terrain tile LODs: every stitch variant of every tile size in one index buffer
+  VkBufferContext  terrain_stitch_indices;
+  TerrainStitchSet terrain_stitch_sets[TERRAIN_STITCH_MAX_SETS];
+  u32              terrain_stitch_set_count;
+
+  Arena         *arena; // Lifetime storage, e.g. mesh clusters
   WindowContext *window;
   bool           swapchain_needs_recreation;
 };
 
+// Framebuffers also own the depth image they share
 VkResult renderer_internal_create_framebuffers(Renderer *renderer);
 void     renderer_internal_destroy_framebuffers(Renderer *renderer);
 VkResult renderer_internal_recreate_swapchain(Renderer *renderer, u32 width, u32 height);
 
+// Stage size bytes for dst_offset in dst, copied at the start of the next frame. Nothing is
+// queued when the frame's staging memory is full.
+bool renderer_internal_stage(
+  Renderer *renderer, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size);
+
 VkResult renderer_internal_create_render_finished(Renderer *renderer);
 void     renderer_internal_destroy_render_finished(Renderer *renderer);
 
@@ -10,20 +10,26 @@ VkResult renderer_internal_create_framebuffers(Renderer *renderer) {
     return VK_ERROR_INITIALIZATION_FAILED;
   }
 
+  VkResult vk_result
+    = vk_image_create_depth(&renderer->device, renderer->swapchain.extent, RENDERER_DEPTH_FORMAT, &renderer->depth);
+  if(vk_result != VK_SUCCESS) {
+    return vk_result;
+  }
+
   for(u32 i = 0; i < renderer->framebuffer_count; i++) {
-    VkImageView attachments[] = {renderer->swapchain.image_views[i]};
+    VkImageView attachments[] = {renderer->swapchain.image_views[i], renderer->depth.view};
 
     VkFramebufferCreateInfo fb_info = {
       .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
       .renderPass      = renderer->render_pass->render_pass,
-      .attachmentCount = 1,
+      .attachmentCount = 2,
       .pAttachments    = attachments,
       .width           = renderer->swapchain.extent.width,
       .height          = renderer->swapchain.extent.height,
       .layers          = 1,
     };
 
-    VkResult vk_result = vkCreateFramebuffer(renderer->device.device, &fb_info, NULL, &renderer->framebuffers[i]);
+    vk_result = vkCreateFramebuffer(renderer->device.device, &fb_info, NULL, &renderer->framebuffers[i]);
     if(vk_result != VK_SUCCESS) {
       LOG_ERROR("Failed to create framebuffer %u: %d", i, vk_result);
       return vk_result;
@@ -42,6 +48,7 @@ void renderer_internal_destroy_framebuffers(Renderer *renderer) {
   }
 
   renderer->framebuffer_count = 0;
+  vk_image_destroy(renderer->device.device, &renderer->depth);
 }
 
 VkResult renderer_internal_create_render_finished(Renderer *renderer) {
@@ -190,3 +190,50 @@ VkResult vk_buffer_create_index(VkDeviceContext *device, VkCommandPool pool, con
   LOG_DEBUG("Index buffer created");
   return VK_SUCCESS;
 }
+
+VkResult vk_buffer_update(VkDeviceContext *device, VkCommandPool pool, VkBufferContext *ctx, const void *data,
+                          VkDeviceSize size) {
+  // Create staging buffer
+  VkBufferContext staging;
+  VkResult        result = vk_buffer_create(device,
+                                     size,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     &staging);
+  if(result != VK_SUCCESS) {
+    return result;
+  }
+
+  // Copy data to staging buffer
+  result = vk_buffer_copy_data(device->device, &staging, data, size);
+  if(result == VK_SUCCESS) {
+    result = vk_buffer_copy(device, pool, &staging, ctx, size);
+  }
+
+  vk_buffer_destroy(device->device, &staging);
+  return result;
+}
+
+VkResult vk_buffer_create_storage(VkDeviceContext *device, VkCommandPool pool, const void *data, VkDeviceSize size,
+                                  VkBufferContext *ctx) {
+  LOG_DEBUG("Creating storage buffer (%llu bytes)", (unsigned long long)size);
+
+  // Create device local buffer
+  VkResult result = vk_buffer_create(device,
+                                     size,
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     ctx);
+  if(result != VK_SUCCESS) {
+    return result;
+  }
+
+  result = vk_buffer_update(device, pool, ctx, data, size);
+  if(result != VK_SUCCESS) {
+    vk_buffer_destroy(device->device, ctx);
+    return result;
+  }
+
+  LOG_DEBUG("Storage buffer created");
+  return VK_SUCCESS;
+}
@@ -34,4 +34,13 @@ VkResult vk_buffer_create_vertex(VkDeviceContext *device, VkCommandPool pool, co
 VkResult vk_buffer_create_index(VkDeviceContext *device, VkCommandPool pool, const void *data, VkDeviceSize size,
                                 VkBufferContext *ctx);
 
+// Create storage buffer (device local with staging)
+VkResult vk_buffer_create_storage(VkDeviceContext *device, VkCommandPool pool, const void *data, VkDeviceSize size,
+                                  VkBufferContext *ctx);
+
+// Overwrite the start of a device local buffer through a staging buffer. The GPU must not
+// be using the buffer.
+VkResult vk_buffer_update(VkDeviceContext *device, VkCommandPool pool, VkBufferContext *ctx, const void *data,
+                          VkDeviceSize size);
+
 #endif // VK_BUFFER_H
@@ -0,0 +1,98 @@
+#include "vk_image.h"
+#include "core/log.h"
+#include <string.h>
+
+VkResult vk_image_create_depth(VkDeviceContext *device, VkExtent2D extent, VkFormat format, VkImageContext *ctx) {
+  memset(ctx, 0, sizeof(VkImageContext));
+  ctx->format = format;
+
+  // Create image
+  VkImageCreateInfo image_info = {
+    .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .imageType     = VK_IMAGE_TYPE_2D,
+    .format        = format,
+    .extent        = {extent.width, extent.height, 1},
+    .mipLevels     = 1,
+    .arrayLayers   = 1,
+    .samples       = VK_SAMPLE_COUNT_1_BIT,
+    .tiling        = VK_IMAGE_TILING_OPTIMAL,
+    .usage         = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+    .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  VkResult result = vkCreateImage(device->device, &image_info, NULL, &ctx->image);
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create depth image: %d", result);
+    return result;
+  }
+
+  // Allocate and bind memory
+  VkMemoryRequirements mem_requirements;
+  vkGetImageMemoryRequirements(device->device, ctx->image, &mem_requirements);
+
+  VkMemoryAllocateInfo alloc_info = {
+    .sType          = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .allocationSize = mem_requirements.size,
+    .memoryTypeIndex
+    = vk_device_find_memory_type(device, mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+  };
+
+  if(alloc_info.memoryTypeIndex == UINT32_MAX) {
+    vk_image_destroy(device->device, ctx);
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  result = vkAllocateMemory(device->device, &alloc_info, NULL, &ctx->memory);
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to allocate depth image memory: %d", result);
+    vk_image_destroy(device->device, ctx);
+    return result;
+  }
+
+  result = vkBindImageMemory(device->device, ctx->image, ctx->memory, 0);
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to bind depth image memory: %d", result);
+    vk_image_destroy(device->device, ctx);
+    return result;
+  }
+
+  // Create view
+  VkImageViewCreateInfo view_info = {
+    .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .image    = ctx->image,
+    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+    .format   = format,
+    .subresourceRange =
+      {
+        .aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = 1,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+      },
+  };
+
+  result = vkCreateImageView(device->device, &view_info, NULL, &ctx->view);
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create depth image view: %d", result);
+    vk_image_destroy(device->device, ctx);
+    return result;
+  }
+
+  LOG_DEBUG("Depth image created (%ux%u)", extent.width, extent.height);
+  return VK_SUCCESS;
+}
+
+void vk_image_destroy(VkDevice device, VkImageContext *ctx) {
+  if(ctx->view != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, ctx->view, NULL);
+  }
+  if(ctx->image != VK_NULL_HANDLE) {
+    vkDestroyImage(device, ctx->image, NULL);
+  }
+  if(ctx->memory != VK_NULL_HANDLE) {
+    vkFreeMemory(device, ctx->memory, NULL);
+  }
+  memset(ctx, 0, sizeof(VkImageContext));
+}
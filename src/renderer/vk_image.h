@@ -0,0 +1,22 @@
+#ifndef VK_IMAGE_H
+#define VK_IMAGE_H
+
+#include <vulkan/vulkan.h>
+#include "utils/types.h"
+#include "renderer/vk_device.h"
+
+// Image context
+typedef struct VkImageContext {
+  VkImage        image;
+  VkDeviceMemory memory;
+  VkImageView    view;
+  VkFormat       format;
+} VkImageContext;
+
+// Create a device local depth attachment covering extent
+VkResult vk_image_create_depth(VkDeviceContext *device, VkExtent2D extent, VkFormat format, VkImageContext *ctx);
+
+// Destroy an image and its view
+void vk_image_destroy(VkDevice device, VkImageContext *ctx);
+
+#endif // VK_IMAGE_H
@@ -2,6 +2,7 @@
 #include "vk_shader.h"
 #include "core/log.h"
 #include "geometry/vertex.h"
+#include "utils/macros.h"
 #include <stddef.h>
 #include <string.h>
 
@@ -33,21 +34,86 @@ static void get_vertex_attribute_descriptions(VkVertexInputAttributeDescription
   };
 }
 
-VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2D extent, VkPipelineContext *ctx) {
-  (void)extent; // Currently unused, will be used for non-dynamic viewport
-  LOG_INFO("Creating graphics pipeline");
+// Get terrain vertex binding description
+static VkVertexInputBindingDescription get_terrain_vertex_binding_description(void) {
+  return VkVertexInputBindingDescription{
+    .binding   = 0,
+    .stride    = sizeof(TerrainVertex),
+    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+}
 
-  memset(ctx, 0, sizeof(VkPipelineContext));
+// Get terrain vertex attribute descriptions
+static void get_terrain_vertex_attribute_descriptions(VkVertexInputAttributeDescription *attrs) {
+  // Quantized height
+  attrs[0] = VkVertexInputAttributeDescription{
+    .binding  = 0,
+    .location = 0,
+    .format   = VK_FORMAT_R16_UNORM,
+    .offset   = offsetof(TerrainVertex, height),
+  };
+
+  // Octahedral normal
+  attrs[1] = VkVertexInputAttributeDescription{
+    .binding  = 0,
+    .location = 1,
+    .format   = VK_FORMAT_R8G8_SNORM,
+    .offset   = offsetof(TerrainVertex, normal),
+  };
 
+  // Grid position
+  attrs[2] = VkVertexInputAttributeDescription{
+    .binding  = 0,
+    .location = 2,
+    .format   = VK_FORMAT_R8G8_UINT,
+    .offset   = offsetof(TerrainVertex, grid),
+  };
+
+  // Material
+  attrs[3] = VkVertexInputAttributeDescription{
+    .binding  = 0,
+    .location = 3,
+    .format   = VK_FORMAT_R8_UINT,
+    .offset   = offsetof(TerrainVertex, material),
+  };
+}
+
+// Get grid vertex binding description
+static VkVertexInputBindingDescription get_grid_vertex_binding_description(void) {
+  return VkVertexInputBindingDescription{
+    .binding   = 0,
+    .stride    = sizeof(GridVertex),
+    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+}
+
+// Get grid vertex attribute description
+static VkVertexInputAttributeDescription get_grid_vertex_attribute_description(void) {
+  return VkVertexInputAttributeDescription{
+    .binding  = 0,
+    .location = 0,
+    .format   = VK_FORMAT_R16G16_UINT,
+    .offset   = offsetof(GridVertex, grid),
+  };
+}
+
+// Create one graphics pipeline with the shared fixed-function state
+static VkResult vk_pipeline_create_graphics(VkDevice                                    device,
+                                            VkRenderPass                                render_pass,
+                                            VkPipelineLayout                            layout,
+                                            const char                                 *vert_path,
+                                            const char                                 *frag_path,
+                                            const VkPipelineVertexInputStateCreateInfo *vertex_input_info,
+                                            VkPipeline                                 *out_pipeline) {
   // Load shaders
   VkShaderModule vert_module, frag_module;
 
-  VkResult result = vk_shader_load(device, "shaders/basic.vert.spv", &vert_module);
+  VkResult result = vk_shader_load(device, vert_path, &vert_module);
   if(result != VK_SUCCESS) {
     return result;
   }
 
-  result = vk_shader_load(device, "shaders/basic.frag.spv", &frag_module);
+  result = vk_shader_load(device, frag_path, &frag_module);
   if(result != VK_SUCCESS) {
     vk_shader_destroy(device, vert_module);
     return result;
@@ -59,19 +125,6 @@ VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2
     vk_shader_stage_info(VK_SHADER_STAGE_FRAGMENT_BIT, frag_module),
   };
 
-  // Vertex input
-  VkVertexInputBindingDescription   binding_desc = get_vertex_binding_description();
-  VkVertexInputAttributeDescription attr_descs[2];
-  get_vertex_attribute_descriptions(attr_descs);
-
-  VkPipelineVertexInputStateCreateInfo vertex_input_info = {
-    .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-    .vertexBindingDescriptionCount   = 1,
-    .pVertexBindingDescriptions      = &binding_desc,
-    .vertexAttributeDescriptionCount = 2,
-    .pVertexAttributeDescriptions    = attr_descs,
-  };
-
   // Input assembly
   VkPipelineInputAssemblyStateCreateInfo input_assembly = {
     .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -105,6 +158,16 @@ VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2
     .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
   };
 
+  // Depth testing, nearest surface wins
+  VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+    .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    .depthTestEnable       = VK_TRUE,
+    .depthWriteEnable      = VK_TRUE,
+    .depthCompareOp        = VK_COMPARE_OP_LESS,
+    .depthBoundsTestEnable = VK_FALSE,
+    .stencilTestEnable     = VK_FALSE,
+  };
+
   // Color blending
   VkPipelineColorBlendAttachmentState color_blend_attachment = {
     .colorWriteMask
@@ -131,75 +194,168 @@ VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2
     .pDynamicStates    = dynamic_states,
   };
 
-  VkDescriptorSetLayoutBinding camera_ubo_binding = {
-    .binding            = 0,
-    .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount    = 1,
-    .stageFlags         = VK_SHADER_STAGE_VERTEX_BIT,
-    .pImmutableSamplers = NULL,
+  // Create graphics pipeline
+  VkGraphicsPipelineCreateInfo pipeline_info = {
+    .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+    .stageCount          = 2,
+    .pStages             = shader_stages,
+    .pVertexInputState   = vertex_input_info,
+    .pInputAssemblyState = &input_assembly,
+    .pViewportState      = &viewport_state,
+    .pRasterizationState = &rasterizer,
+    .pMultisampleState   = &multisampling,
+    .pDepthStencilState  = &depth_stencil,
+    .pColorBlendState    = &color_blending,
+    .pDynamicState       = &dynamic_state,
+    .layout              = layout,
+    .renderPass          = render_pass,
+    .subpass             = 0,
+    .basePipelineHandle  = VK_NULL_HANDLE,
+    .basePipelineIndex   = -1,
+  };
+
+  result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, out_pipeline);
+
+  // Cleanup shaders (no longer needed after pipeline creation)
+  vk_shader_destroy(device, vert_module);
+  vk_shader_destroy(device, frag_module);
+
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to create graphics pipeline for %s: %d", vert_path, result);
+  }
+  return result;
+}
+
+VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2D extent, VkPipelineContext *ctx) {
+  (void)extent; // Currently unused, will be used for non-dynamic viewport
+  LOG_INFO("Creating graphics pipeline");
+
+  memset(ctx, 0, sizeof(VkPipelineContext));
+
+  VkDescriptorSetLayoutBinding set_bindings[] = {
+    // Camera
+    {
+      .binding            = 0,
+      .descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount    = 1,
+      .stageFlags         = VK_SHADER_STAGE_VERTEX_BIT,
+      .pImmutableSamplers = NULL,
+    },
+    // Heightfield samples for CDLOD terrain
+    {
+      .binding            = VK_PIPELINE_TERRAIN_HEIGHTS_BINDING,
+      .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount    = 1,
+      .stageFlags         = VK_SHADER_STAGE_VERTEX_BIT,
+      .pImmutableSamplers = NULL,
+    },
   };
 
   VkDescriptorSetLayoutCreateInfo set_layout_info = {
     .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-    .bindingCount = 1,
-    .pBindings    = &camera_ubo_binding,
+    .bindingCount = 2,
+    .pBindings    = set_bindings,
   };
 
-  result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &ctx->global_set_layout);
+  VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &ctx->global_set_layout);
   if(result != VK_SUCCESS) {
     LOG_ERROR("Failed to create descriptor set layout: %d", result);
-    vk_shader_destroy(device, vert_module);
-    vk_shader_destroy(device, frag_module);
     return result;
   }
 
-  // Pipeline layout
+  // Pipeline layout, with the per-draw terrain parameters as push constants
+  VkPushConstantRange terrain_range = {
+    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+    .offset     = 0,
+    .size       = (u32)MAX(sizeof(TerrainPushConstants), sizeof(CdlodPushConstants)),
+  };
+
   VkPipelineLayoutCreateInfo layout_info = {
     .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
     .setLayoutCount         = 1,
     .pSetLayouts            = &ctx->global_set_layout,
-    .pushConstantRangeCount = 0,
+    .pushConstantRangeCount = 1,
+    .pPushConstantRanges    = &terrain_range,
   };
 
   result = vkCreatePipelineLayout(device, &layout_info, NULL, &ctx->layout);
   if(result != VK_SUCCESS) {
     LOG_ERROR("Failed to create pipeline layout: %d", result);
-    vk_shader_destroy(device, vert_module);
-    vk_shader_destroy(device, frag_module);
-    vkDestroyDescriptorSetLayout(device, ctx->global_set_layout, NULL);
+    vk_pipeline_destroy(device, ctx);
     return result;
   }
 
-  // Create graphics pipeline
-  VkGraphicsPipelineCreateInfo pipeline_info = {
-    .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-    .stageCount          = 2,
-    .pStages             = shader_stages,
-    .pVertexInputState   = &vertex_input_info,
-    .pInputAssemblyState = &input_assembly,
-    .pViewportState      = &viewport_state,
-    .pRasterizationState = &rasterizer,
-    .pMultisampleState   = &multisampling,
-    .pDepthStencilState  = NULL,
-    .pColorBlendState    = &color_blending,
-    .pDynamicState       = &dynamic_state,
-    .layout              = ctx->layout,
-    .renderPass          = render_pass,
-    .subpass             = 0,
-    .basePipelineHandle  = VK_NULL_HANDLE,
-    .basePipelineIndex   = -1,
+  // Vertex input
+  VkVertexInputBindingDescription   binding_desc = get_vertex_binding_description();
+  VkVertexInputAttributeDescription attr_descs[2];
+  get_vertex_attribute_descriptions(attr_descs);
+
+  VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+    .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount   = 1,
+    .pVertexBindingDescriptions      = &binding_desc,
+    .vertexAttributeDescriptionCount = 2,
+    .pVertexAttributeDescriptions    = attr_descs,
   };
 
-  result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &ctx->pipeline);
+  result = vk_pipeline_create_graphics(device,
+                                       render_pass,
+                                       ctx->layout,
+                                       "shaders/basic.vert.spv",
+                                       "shaders/basic.frag.spv",
+                                       &vertex_input_info,
+                                       &ctx->pipeline);
+  if(result != VK_SUCCESS) {
+    vk_pipeline_destroy(device, ctx);
+    return result;
+  }
 
-  // Cleanup shaders (no longer needed after pipeline creation)
-  vk_shader_destroy(device, vert_module);
-  vk_shader_destroy(device, frag_module);
+  // Terrain vertex input
+  VkVertexInputBindingDescription   terrain_binding_desc = get_terrain_vertex_binding_description();
+  VkVertexInputAttributeDescription terrain_attr_descs[4];
+  get_terrain_vertex_attribute_descriptions(terrain_attr_descs);
 
+  VkPipelineVertexInputStateCreateInfo terrain_input_info = {
+    .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount   = 1,
+    .pVertexBindingDescriptions      = &terrain_binding_desc,
+    .vertexAttributeDescriptionCount = 4,
+    .pVertexAttributeDescriptions    = terrain_attr_descs,
+  };
+
+  result = vk_pipeline_create_graphics(device,
+                                       render_pass,
+                                       ctx->layout,
+                                       "shaders/terrain.vert.spv",
+                                       "shaders/terrain.frag.spv",
+                                       &terrain_input_info,
+                                       &ctx->terrain_pipeline);
   if(result != VK_SUCCESS) {
-    LOG_ERROR("Failed to create graphics pipeline: %d", result);
-    vkDestroyPipelineLayout(device, ctx->layout, NULL);
-    vkDestroyDescriptorSetLayout(device, ctx->global_set_layout, NULL);
+    vk_pipeline_destroy(device, ctx);
+    return result;
+  }
+
+  // CDLOD grid vertex input
+  VkVertexInputBindingDescription   grid_binding_desc = get_grid_vertex_binding_description();
+  VkVertexInputAttributeDescription grid_attr_desc    = get_grid_vertex_attribute_description();
+
+  VkPipelineVertexInputStateCreateInfo grid_input_info = {
+    .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    .vertexBindingDescriptionCount   = 1,
+    .pVertexBindingDescriptions      = &grid_binding_desc,
+    .vertexAttributeDescriptionCount = 1,
+    .pVertexAttributeDescriptions    = &grid_attr_desc,
+  };
+
+  result = vk_pipeline_create_graphics(device,
+                                       render_pass,
+                                       ctx->layout,
+                                       "shaders/cdlod.vert.spv",
+                                       "shaders/terrain.frag.spv",
+                                       &grid_input_info,
+                                       &ctx->cdlod_pipeline);
+  if(result != VK_SUCCESS) {
+    vk_pipeline_destroy(device, ctx);
     return result;
   }
 
@@ -208,6 +364,12 @@ VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2
 }
 
 void vk_pipeline_destroy(VkDevice device, VkPipelineContext *ctx) {
+  if(ctx->cdlod_pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, ctx->cdlod_pipeline, NULL);
+  }
+  if(ctx->terrain_pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, ctx->terrain_pipeline, NULL);
+  }
   if(ctx->pipeline != VK_NULL_HANDLE) {
     vkDestroyPipeline(device, ctx->pipeline, NULL);
   }
@@ -4,14 +4,39 @@
 #include <vulkan/vulkan.h>
 #include "utils/types.h"
 
-// Pipeline context
+// Per-draw decode parameters of a terrain tile, matching the push constant block of terrain.vert
+typedef struct TerrainPushConstants {
+  f32 origin[2];    // World XZ of grid position (0, 0)
+  f32 cell_size;
+  f32 height_min;
+  f32 height_range; // World height of the largest unorm16 value
+} TerrainPushConstants;
+
+// Per-draw parameters of a CDLOD node, matching the push constant block of cdlod.vert
+typedef struct CdlodPushConstants {
+  f32 node_origin[2];    // Heightfield sample of the node's corner
+  f32 node_spacing;      // Samples per grid cell
+  f32 morph_start;       // World distances over which the node morphs into the next LOD
+  f32 morph_end;
+  f32 cell_size;
+  f32 terrain_origin[2]; // World XZ of sample (0, 0)
+  u32 terrain_size[2];   // Samples per row and column of the height buffer
+} CdlodPushConstants;
+
+// Binding of the heightfield storage buffer in the global set
+#define VK_PIPELINE_TERRAIN_HEIGHTS_BINDING 1
+
+// Pipeline context. All pipelines share one layout, so the global set stays bound when
+// switching between them.
 typedef struct VkPipelineContext {
   VkDescriptorSetLayout global_set_layout;
-  VkPipelineLayout layout;
-  VkPipeline       pipeline;
+  VkPipelineLayout      layout;
+  VkPipeline            pipeline;         // Vertex
+  VkPipeline            terrain_pipeline; // TerrainVertex
+  VkPipeline            cdlod_pipeline;   // GridVertex over the heightfield storage buffer
 } VkPipelineContext;
 
-// Create graphics pipeline
+// Create graphics pipelines
 VkResult vk_pipeline_create(VkDevice device, VkRenderPass render_pass, VkExtent2D extent, VkPipelineContext *ctx);
 
 // Destroy pipeline
@@ -2,7 +2,7 @@
 #include "core/log.h"
 #include <string.h>
 
-VkResult vk_renderpass_create(VkDevice device, VkFormat color_format, VkRenderPassContext *ctx) {
+VkResult vk_renderpass_create(VkDevice device, VkFormat color_format, VkFormat depth_format, VkRenderPassContext *ctx) {
   LOG_INFO("Creating render pass");
 
   memset(ctx, 0, sizeof(VkRenderPassContext));
@@ -19,34 +19,55 @@ VkResult vk_renderpass_create(VkDevice device, VkFormat color_format, VkRenderPa
     .finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
   };
 
-  // Attachment reference
+  // Depth attachment, cleared every frame and never read back
+  VkAttachmentDescription depth_attachment = {
+    .format         = depth_format,
+    .samples        = VK_SAMPLE_COUNT_1_BIT,
+    .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+    .storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+    .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+    .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+    .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+    .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+  };
+
+  VkAttachmentDescription attachments[] = {color_attachment, depth_attachment};
+
+  // Attachment references
   VkAttachmentReference color_attachment_ref = {
     .attachment = 0,
     .layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
   };
 
+  VkAttachmentReference depth_attachment_ref = {
+    .attachment = 1,
+    .layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+  };
+
   // Subpass
   VkSubpassDescription subpass = {
-    .pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS,
-    .colorAttachmentCount = 1,
-    .pColorAttachments    = &color_attachment_ref,
+    .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
+    .colorAttachmentCount    = 1,
+    .pColorAttachments       = &color_attachment_ref,
+    .pDepthStencilAttachment = &depth_attachment_ref,
   };
 
-  // Subpass dependency
+  // Subpass dependency. The depth image is shared by the frames in flight, so the previous
+  // frame's depth writes must finish before this frame clears it.
   VkSubpassDependency dependency = {
     .srcSubpass    = VK_SUBPASS_EXTERNAL,
     .dstSubpass    = 0,
-    .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .srcAccessMask = 0,
-    .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+    .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
   };
 
   // Create render pass
   VkRenderPassCreateInfo render_pass_info = {
     .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-    .attachmentCount = 1,
-    .pAttachments    = &color_attachment,
+    .attachmentCount = 2,
+    .pAttachments    = attachments,
     .subpassCount    = 1,
     .pSubpasses      = &subpass,
     .dependencyCount = 1,
@@ -9,8 +9,8 @@ typedef struct VkRenderPassContext {
   VkRenderPass render_pass;
 } VkRenderPassContext;
 
-// Create render pass
-VkResult vk_renderpass_create(VkDevice device, VkFormat color_format, VkRenderPassContext *ctx);
+// Create render pass with a color and a depth attachment
+VkResult vk_renderpass_create(VkDevice device, VkFormat color_format, VkFormat depth_format, VkRenderPassContext *ctx);
 
 // Destroy render pass
 void vk_renderpass_destroy(VkDevice device, VkRenderPassContext *ctx);
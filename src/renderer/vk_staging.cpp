@@ -0,0 +1,97 @@
+#include "vk_staging.h"
+#include "core/log.h"
+#include <string.h>
+
+VkResult vk_staging_create(VkDeviceContext *device, VkDeviceSize region_size, VkStagingContext *ctx) {
+  memset(ctx, 0, sizeof(VkStagingContext));
+
+  VkResult result = vk_buffer_create(device,
+                                     region_size * MAX_FRAMES_IN_FLIGHT,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     &ctx->buffer);
+  if(result != VK_SUCCESS) {
+    return result;
+  }
+
+  void *mapped = NULL;
+  result       = vkMapMemory(device->device, ctx->buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+  if(result != VK_SUCCESS) {
+    LOG_ERROR("Failed to map staging buffer: %d", result);
+    vk_buffer_destroy(device->device, &ctx->buffer);
+    return result;
+  }
+
+  ctx->mapped      = (u8 *)mapped;
+  ctx->region_size = region_size;
+  LOG_DEBUG("Staging buffer created (%llu bytes per frame)", (unsigned long long)region_size);
+  return VK_SUCCESS;
+}
+
+void vk_staging_destroy(VkDevice device, VkStagingContext *ctx) {
+  if(ctx->mapped) {
+    vkUnmapMemory(device, ctx->buffer.memory);
+  }
+  vk_buffer_destroy(device, &ctx->buffer);
+  memset(ctx, 0, sizeof(VkStagingContext));
+}
+
+void vk_staging_begin(VkStagingContext *ctx, u32 region) { ctx->region = region % MAX_FRAMES_IN_FLIGHT; }
+
+VkDeviceSize vk_staging_room(const VkStagingContext *ctx) {
+  if(ctx->copy_count == VK_STAGING_MAX_COPIES) {
+    return 0;
+  }
+  return ctx->region_size - ctx->used;
+}
+
+bool vk_staging_write(
+  VkStagingContext *ctx, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size) {
+  VkDeviceSize aligned = (size + VK_STAGING_ALIGNMENT - 1) & ~(VkDeviceSize)(VK_STAGING_ALIGNMENT - 1);
+  if(!ctx->mapped || ctx->copy_count == VK_STAGING_MAX_COPIES || aligned > ctx->region_size - ctx->used) {
+    return false;
+  }
+
+  VkDeviceSize offset = (VkDeviceSize)ctx->region * ctx->region_size + ctx->used;
+  memcpy(ctx->mapped + offset, data, (size_t)size);
+  ctx->used += aligned;
+
+  ctx->copy_dst[ctx->copy_count] = dst;
+  ctx->copies[ctx->copy_count]   = VkBufferCopy{
+    .srcOffset = offset,
+    .dstOffset = dst_offset,
+    .size      = size,
+  };
+  ctx->copy_count++;
+  return true;
+}
+
+void vk_staging_record(VkStagingContext *ctx, VkCommandBuffer cmd) {
+  if(ctx->copy_count > 0) {
+    // Earlier frames may still be drawing from the destinations: wait for their reads, then
+    // make the copies visible to this frame's vertex input and vertex shader
+    VkPipelineStageFlags readers = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    vkCmdPipelineBarrier(cmd, readers, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+    // Consecutive copies to the same buffer share a command
+    for(u32 first = 0; first < ctx->copy_count;) {
+      u32 end = first + 1;
+      while(end < ctx->copy_count && ctx->copy_dst[end] == ctx->copy_dst[first]) {
+        end++;
+      }
+      vkCmdCopyBuffer(cmd, ctx->buffer.buffer, ctx->copy_dst[first], end - first, &ctx->copies[first]);
+      first = end;
+    }
+
+    VkMemoryBarrier written = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, readers, 0, 1, &written, 0, NULL, 0, NULL);
+  }
+
+  // The next region starts empty, so room is reported before its first write waits for it
+  ctx->copy_count = 0;
+  ctx->used       = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef VK_STAGING_H
+#define VK_STAGING_H
+
+#include <vulkan/vulkan.h>
+#include "utils/types.h"
+#include "renderer/vk_buffer.h"
+#include "renderer/vk_device.h"
+#include "renderer/vk_sync.h"
+
+// Persistently mapped staging memory for uploads that ride along with the frames. The buffer
+// is split into one region per frame in flight; writes fill the region of the frame being
+// prepared and queue copies out of it, which that frame records ahead of its render pass.
+// The caller waits for the frame's fence before starting a region, so a region is only
+// refilled once the GPU has finished copying out of it and nothing waits for the device.
+
+// Copies queued per frame before writes are refused
+#define VK_STAGING_MAX_COPIES 4096
+
+// Each write starts at a multiple of this within its region
+#define VK_STAGING_ALIGNMENT 16
+
+typedef struct VkStagingContext {
+  VkBufferContext buffer;
+  u8             *mapped;
+  VkDeviceSize    region_size; // Bytes per frame in flight
+  VkDeviceSize    used;        // Bytes of the current region written so far
+  u32             region;      // Region of the frame being prepared
+  VkBuffer        copy_dst[VK_STAGING_MAX_COPIES];
+  VkBufferCopy    copies[VK_STAGING_MAX_COPIES];
+  u32             copy_count;
+} VkStagingContext;
+
+VkResult vk_staging_create(VkDeviceContext *device, VkDeviceSize region_size, VkStagingContext *ctx);
+void     vk_staging_destroy(VkDevice device, VkStagingContext *ctx);
+
+// Start filling the region of frame index region. The GPU must be done with its last copies.
+void vk_staging_begin(VkStagingContext *ctx, u32 region);
+
+// Bytes that can still be written for the frame being prepared
+VkDeviceSize vk_staging_room(const VkStagingContext *ctx);
+
+// Copy size bytes into the current region and queue their copy to dst_offset in dst. False,
+// with nothing queued, when the region or the copy list is full.
+bool vk_staging_write(
+  VkStagingContext *ctx, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size);
+
+// Record the queued copies into cmd, outside a render pass. Barriers order them after the
+// vertex and index reads of earlier frames and before this frame's, so buffers in use can
+// be overwritten in place. The region stays in use until cmd completes.
+void vk_staging_record(VkStagingContext *ctx, VkCommandBuffer cmd);
+
+#endif // VK_STAGING_H
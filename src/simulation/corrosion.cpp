@@ -1,7 +1,34 @@
 #include "corrosion.h"
+#include "utils/macros.h"
 
-// Placeholder for corrosion simulation implementation
-// Will be implemented in future phases for:
-// - Material property simulation
-// - Degradation over time
-// - Visual representation of corrosion effects
+void corrosion_apply(const CorrosionParams *params,
+                     const f32             *height_in,
+                     const f32             *water,
+                     f32                   *height_out,
+                     f32                   *degradation,
+                     u32                    width,
+                     u32                    height) {
+  f32 base_rate = params->rate * params->temperature * (1.0f + params->salt_content);
+
+  for(u32 y = 0; y < height; ++y) {
+    u32 up   = y > 0 ? y - 1 : y;
+    u32 down = y + 1 < height ? y + 1 : y;
+
+    for(u32 x = 0; x < width; ++x) {
+      u32    left  = x > 0 ? x - 1 : x;
+      u32    right = x + 1 < width ? x + 1 : x;
+      size_t i     = (size_t)y * width + x;
+
+      f32 h          = height_in[i];
+      f32 horizontal = height_in[(size_t)y * width + left] + height_in[(size_t)y * width + right];
+      f32 vertical   = height_in[(size_t)up * width + x] + height_in[(size_t)down * width + x];
+      f32 exposure   = MAX(h - 0.25f * (horizontal + vertical), 0.0f);
+      f32 wetness    = MIN(params->humidity + (water ? water[i] : 0.0f), 1.0f);
+      f32 damage     = base_rate * wetness;
+
+      // Damage is only carried away where the cell sticks out of its neighbourhood
+      degradation[i] = damage;
+      height_out[i]  = h - MIN(exposure, damage);
+    }
+  }
+}
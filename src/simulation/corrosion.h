@@ -3,8 +3,8 @@
 
 #include "utils/types.h"
 
-// Placeholder for future corrosion simulation
-// This will simulate material degradation over time
+// Chemical weathering of exposed rock. Wet, convex cells degrade fastest and lose
+// height until they are level with their neighbourhood.
 
 typedef struct CorrosionParams {
   f32 rate;         // Corrosion rate
@@ -14,9 +14,19 @@ typedef struct CorrosionParams {
 } CorrosionParams;
 
 typedef struct CorrosionState {
-  f32            *degradation; // Per-vertex degradation values
-  u32             vertex_count;
+  f32            *degradation; // Per-cell degradation values
+  u32             cell_count;
   CorrosionParams params;
 } CorrosionState;
 
+// One weathering pass. Reads height_in and the optional water layer (NULL means dry),
+// writes the corroded heights to height_out and the per-cell damage to degradation.
+void corrosion_apply(const CorrosionParams *params,
+                     const f32             *height_in,
+                     const f32             *water,
+                     f32                   *height_out,
+                     f32                   *degradation,
+                     u32                    width,
+                     u32                    height);
+
 #endif // CORROSION_H
@@ -0,0 +1,166 @@
+#include "diffusion.h"
+#include "core/log.h"
+#include "simulation/stencil.h"
+#include "utils/macros.h"
+#include <math.h>
+#include <string.h>
+
+// One Jacobi sweep of (1 + 4 alpha) u - alpha * sum(neighbours) = rhs. Edge cells see
+// themselves as their missing neighbours, which has the same fixed point as the
+// zero-flux boundary of the multigrid solver.
+struct DiffusionJacobiKernel {
+  static const u32 RADIUS = 1;
+
+  const f32 *rhs;
+  u32        width;
+  f32        alpha;
+  f32        inv_diagonal;
+
+  f32 operator()(const f32 *c, i32 stride, u32 x, u32 y) const {
+    f32 sum = c[-1] + c[1] + c[-stride] + c[stride];
+    return (rhs[(size_t)y * width + x] + alpha * sum) * inv_diagonal;
+  }
+};
+
+// One explicit step u += alpha * (sum(neighbours) - 4u), stable for alpha <= 1/4. Clamped
+// edge reads give the same zero-flux boundary as the implicit solvers.
+struct DiffusionExplicitKernel {
+  static const u32 RADIUS = 1;
+
+  f32 alpha;
+
+  f32 operator()(const f32 *c, i32 stride, u32 x, u32 y) const {
+    UNUSED(x);
+    UNUSED(y);
+    f32 sum = c[-1] + c[1] + c[-stride] + c[stride];
+    return c[0] + alpha * (sum - 4.0f * c[0]);
+  }
+};
+
+// Largest stable alpha for the explicit kernel
+#define DIFFUSION_EXPLICIT_MAX_ALPHA 0.25f
+
+static void diffusion_jacobi(f32 *field, u32 width, u32 height, f32 alpha, u32 iterations) {
+  ArenaTemp temp  = arena_scratch_begin();
+  size_t    count = (size_t)width * height;
+
+  f32 *rhs = ARENA_PUSH_ARRAY(temp.arena, f32, count);
+  if(!rhs) {
+    LOG_ERROR("Failed to allocate Jacobi buffers for %ux%u field", width, height);
+    arena_temp_end(temp);
+    return;
+  }
+  memcpy(rhs, field, count * sizeof(f32));
+
+  DiffusionJacobiKernel kernel = {
+    .rhs          = rhs,
+    .width        = width,
+    .alpha        = alpha,
+    .inv_diagonal = 1.0f / (1.0f + 4.0f * alpha),
+  };
+  if(!stencil_run(kernel, field, width, height, iterations)) {
+    LOG_ERROR("Failed to allocate Jacobi buffers for %ux%u field", width, height);
+  }
+
+  arena_temp_end(temp);
+}
+
+static bool diffusion_multigrid_matches(const MultigridSolver *multigrid, u32 width, u32 height) {
+  return multigrid && multigrid->level_count > 0 && multigrid->levels[0].width == width
+         && multigrid->levels[0].height == height;
+}
+
+void diffusion_step(f32                   *field,
+                    u32                    width,
+                    u32                    height,
+                    const DiffusionParams *params,
+                    f32                    dt,
+                    MultigridSolver       *multigrid) {
+  if(!field || !params || params->rate <= 0.0f || params->iterations == 0) {
+    return;
+  }
+
+  f32 alpha = params->rate * dt;
+
+  if(params->solver == DIFFUSION_SOLVER_MULTIGRID) {
+    if(diffusion_multigrid_matches(multigrid, width, height)) {
+      multigrid_solve_diffusion(multigrid, field, width, height, alpha, params->iterations);
+      return;
+    }
+    LOG_WARN("Multigrid requested without a matching solver, falling back to Jacobi");
+  }
+
+  diffusion_jacobi(field, width, height, alpha, params->iterations);
+}
+
+bool diffusion_step_paged(TileStore *field, TileStore *scratch, const DiffusionParams *params, f32 dt) {
+  if(!field || !params || params->rate <= 0.0f || params->iterations == 0) {
+    return true;
+  }
+
+  f32 alpha = params->rate * dt;
+  u32 steps = MAX(params->iterations, (u32)ceilf(alpha / DIFFUSION_EXPLICIT_MAX_ALPHA));
+
+  DiffusionExplicitKernel kernel = {.alpha = alpha / (f32)steps};
+  if(!stencil_run_paged(kernel, field, scratch, steps)) {
+    LOG_ERROR("Paged diffusion failed on %ux%u field", field->width, field->height);
+    return false;
+  }
+  return true;
+}
+
+u32 diffusion_step_partial(DiffusionTask *task, u32 max_units, bool *step_done) {
+  *step_done       = false;
+  task->written_y0 = 0;
+  task->written_y1 = 0;
+
+  const DiffusionParams *params = task->params;
+  if(!task->field || !params || params->rate <= 0.0f || params->iterations == 0) {
+    *step_done = true;
+    return 0;
+  }
+
+  f32 alpha = params->rate * task->dt;
+
+  if(params->solver != DIFFUSION_SOLVER_MULTIGRID
+     || !diffusion_multigrid_matches(task->multigrid, task->width, task->height)) {
+    diffusion_step(task->field, task->width, task->height, params, task->dt, task->multigrid);
+    task->written_y1 = task->height;
+    *step_done       = true;
+    return 1;
+  }
+
+  if(!task->in_progress) {
+    if(!multigrid_begin(task->multigrid, task->field, task->width, task->height)) {
+      *step_done = true;
+      return 0;
+    }
+    task->in_progress = true;
+    task->cycles_done = 0;
+  }
+
+  u64 budget    = (u64)max_units * DIFFUSION_SLICE_CELLS;
+  u64 processed = 0;
+  while(processed < budget && task->cycles_done < params->iterations) {
+    bool cycle_done = false;
+    processed += multigrid_cycle_partial(task->multigrid, alpha, budget - processed, &cycle_done);
+
+    const MultigridSolver *multigrid = task->multigrid;
+    if(multigrid->field_y1 > 0) {
+      bool first       = task->written_y1 == 0;
+      task->written_y0 = first ? multigrid->field_y0 : MIN(task->written_y0, multigrid->field_y0);
+      task->written_y1 = MAX(task->written_y1, multigrid->field_y1);
+    }
+    if(cycle_done) {
+      task->cycles_done++;
+    }
+  }
+
+  if(task->cycles_done >= params->iterations) {
+    multigrid_end(task->multigrid);
+    task->in_progress = false;
+    *step_done        = true;
+  }
+
+  return (u32)((processed + DIFFUSION_SLICE_CELLS - 1) / DIFFUSION_SLICE_CELLS);
+}
@@ -0,0 +1,59 @@
+#ifndef DIFFUSION_H
+#define DIFFUSION_H
+
+#include "memory/arena.h"
+#include "simulation/multigrid.h"
+#include "simulation/tile_store.h"
+#include "utils/types.h"
+
+// Solver used for the implicit diffusion step
+typedef enum DiffusionSolver {
+  DIFFUSION_SOLVER_JACOBI = 0, // Single-resolution Jacobi sweeps
+  DIFFUSION_SOLVER_MULTIGRID,  // Geometric multigrid V-cycles
+} DiffusionSolver;
+
+// Parameters shared by diffusion-type stages (thermal smoothing, sediment spreading)
+typedef struct DiffusionParams {
+  f32             rate;       // Diffusion coefficient in cells^2 per second
+  DiffusionSolver solver;     // Stages opt into multigrid here
+  u32             iterations; // Jacobi sweeps or multigrid V-cycles per step
+} DiffusionParams;
+
+// Advance a single layer by one implicit diffusion step of length dt.
+// Multigrid requires a solver built for the same dimensions; otherwise Jacobi is used.
+// Jacobi temporaries come from the scratch arena.
+void diffusion_step(f32                   *field,
+                    u32                    width,
+                    u32                    height,
+                    const DiffusionParams *params,
+                    f32                    dt,
+                    MultigridSolver       *multigrid);
+
+// Out-of-core variant of diffusion_step for a paged layer. The implicit solve needs the
+// whole right-hand side resident, so this takes explicit sub-steps instead: at least
+// params->iterations of them, and enough to keep each one stable. scratch must match the
+// field's dimensions.
+bool diffusion_step_paged(TileStore *field, TileStore *scratch, const DiffusionParams *params, f32 dt);
+
+// Cells of multigrid work that make up one time-slice unit
+#define DIFFUSION_SLICE_CELLS 1024
+
+// Resumable diffusion step for time-sliced callers. One unit is DIFFUSION_SLICE_CELLS of
+// multigrid work; the Jacobi path runs its whole step as a single unit.
+typedef struct DiffusionTask {
+  const DiffusionParams *params;
+  MultigridSolver       *multigrid;
+  f32                   *field;
+  u32                    width;
+  u32                    height;
+  f32                    dt;
+  u32                    cycles_done;
+  bool                   in_progress;
+  u32                    written_y0; // Rows [written_y0, written_y1) of the field changed by
+  u32                    written_y1; // the last diffusion_step_partial call
+} DiffusionTask;
+
+// Run up to max_units of the current step; *step_done is set when it completes
+u32 diffusion_step_partial(DiffusionTask *task, u32 max_units, bool *step_done);
+
+#endif // DIFFUSION_H
@@ -0,0 +1,406 @@
+#include "erosion.h"
+#include "core/log.h"
+#include "utils/macros.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct ErosionTileRect {
+  u32 x0;
+  u32 y0;
+  u32 x1;
+  u32 y1;
+} ErosionTileRect;
+
+static ErosionTileRect erosion_tile_rect(const ErosionState *erosion, u32 tile) {
+  u32 tx = tile % erosion->tiles_x;
+  u32 ty = tile / erosion->tiles_x;
+  return ErosionTileRect{
+    .x0 = tx * EROSION_TILE_SIZE,
+    .y0 = ty * EROSION_TILE_SIZE,
+    .x1 = MIN((tx + 1) * EROSION_TILE_SIZE, erosion->width),
+    .y1 = MIN((ty + 1) * EROSION_TILE_SIZE, erosion->height),
+  };
+}
+
+static bool erosion_cell_scheduled(const ErosionState *erosion, u32 x, u32 y) {
+  u32 tile = (y / EROSION_TILE_SIZE) * erosion->tiles_x + x / EROSION_TILE_SIZE;
+  return erosion->tile_scheduled[tile] != 0;
+}
+
+static void erosion_clear_tile_flux(ErosionState *erosion, u32 tile) {
+  ErosionTileRect rect = erosion_tile_rect(erosion, tile);
+  for(u32 d = 0; d < EROSION_FLUX_COUNT; ++d) {
+    for(u32 y = rect.y0; y < rect.y1; ++y) {
+      memset(erosion->flux[d] + (size_t)y * erosion->width + rect.x0, 0, (rect.x1 - rect.x0) * sizeof(f32));
+    }
+  }
+}
+
+// Schedule active tiles plus their 8 neighbours. Tiles leaving the schedule drop their
+// outflow so unscheduled cells never push water into the simulated region.
+static void erosion_build_schedule(ErosionState *erosion) {
+  erosion->schedule_count = 0;
+
+  for(u32 ty = 0; ty < erosion->tiles_y; ++ty) {
+    for(u32 tx = 0; tx < erosion->tiles_x; ++tx) {
+      bool scheduled = false;
+      for(i32 dy = -1; dy <= 1 && !scheduled; ++dy) {
+        for(i32 dx = -1; dx <= 1; ++dx) {
+          i32 nx = (i32)tx + dx;
+          i32 ny = (i32)ty + dy;
+          if(nx < 0 || ny < 0 || nx >= (i32)erosion->tiles_x || ny >= (i32)erosion->tiles_y) {
+            continue;
+          }
+          if(erosion->tile_active[(u32)ny * erosion->tiles_x + (u32)nx]) {
+            scheduled = true;
+            break;
+          }
+        }
+      }
+
+      u32 tile = ty * erosion->tiles_x + tx;
+      if(!scheduled && erosion->tile_scheduled[tile]) {
+        erosion_clear_tile_flux(erosion, tile);
+      }
+      erosion->tile_scheduled[tile] = scheduled ? 1 : 0;
+      if(scheduled) {
+        erosion->schedule[erosion->schedule_count++] = tile;
+      }
+    }
+  }
+}
+
+// Pass 1: update outflow towards lower total height, scaled so no cell drains below zero
+static void erosion_flux_tile(ErosionState *erosion, const Heightfield *heightfield, u32 tile) {
+  const ErosionParams *params = &erosion->params;
+  const f32           *h      = heightfield->layers[HEIGHTFIELD_LAYER_HEIGHT];
+  const f32           *w      = heightfield->layers[HEIGHTFIELD_LAYER_WATER];
+  ErosionTileRect      rect   = erosion_tile_rect(erosion, tile);
+  u32                  width  = erosion->width;
+  f32                  accel  = params->time_step * params->gravity;
+
+  for(u32 y = rect.y0; y < rect.y1; ++y) {
+    for(u32 x = rect.x0; x < rect.x1; ++x) {
+      size_t i     = (size_t)y * width + x;
+      f32    total = h[i] + w[i];
+
+      // Neighbours outside the grid or in unscheduled tiles are closed pipes
+      i64  offsets[EROSION_FLUX_COUNT] = {-1, 1, -(i64)width, (i64)width};
+      bool open[EROSION_FLUX_COUNT]    = {
+        x > 0 && (x > rect.x0 || erosion_cell_scheduled(erosion, x - 1, y)),
+        x + 1 < width && (x + 1 < rect.x1 || erosion_cell_scheduled(erosion, x + 1, y)),
+        y > 0 && (y > rect.y0 || erosion_cell_scheduled(erosion, x, y - 1)),
+        y + 1 < erosion->height && (y + 1 < rect.y1 || erosion_cell_scheduled(erosion, x, y + 1)),
+      };
+
+      f32 out_sum = 0.0f;
+      for(u32 d = 0; d < EROSION_FLUX_COUNT; ++d) {
+        f32 flux = 0.0f;
+        if(open[d]) {
+          size_t n = (size_t)((i64)i + offsets[d]);
+          flux     = MAX(0.0f, erosion->flux[d][i] + accel * (total - h[n] - w[n]));
+        }
+        erosion->flux[d][i] = flux;
+        out_sum += flux;
+      }
+
+      if(out_sum > 0.0f) {
+        f32 scale = MIN(1.0f, w[i] / (out_sum * params->time_step));
+        for(u32 d = 0; d < EROSION_FLUX_COUNT; ++d) {
+          erosion->flux[d][i] *= scale;
+        }
+      }
+    }
+  }
+}
+
+// Pass 2: move water along the pipes and carry suspended sediment with it. Results go to
+// next_water and next_sediment; the heightfield is written, and marked, only in pass 3, so
+// the bed slope is taken here, where no neighbour has eroded yet.
+static void erosion_water_tile(ErosionState *erosion, const Heightfield *heightfield, u32 tile) {
+  const f32      *h     = heightfield->layers[HEIGHTFIELD_LAYER_HEIGHT];
+  const f32      *w     = heightfield->layers[HEIGHTFIELD_LAYER_WATER];
+  const f32      *s     = heightfield->layers[HEIGHTFIELD_LAYER_SEDIMENT];
+  f32           **flux  = erosion->flux;
+  f32             dt    = erosion->params.time_step;
+  ErosionTileRect rect  = erosion_tile_rect(erosion, tile);
+  u32             width = erosion->width;
+
+  for(u32 y = rect.y0; y < rect.y1; ++y) {
+    u32 ya = y > 0 ? y - 1 : y;
+    u32 yb = y + 1 < erosion->height ? y + 1 : y;
+
+    for(u32 x = rect.x0; x < rect.x1; ++x) {
+      size_t i  = (size_t)y * width + x;
+      u32    xa = x > 0 ? x - 1 : x;
+      u32    xb = x + 1 < width ? x + 1 : x;
+
+      f32 dhdx          = (h[(size_t)y * width + xb] - h[(size_t)y * width + xa]) / (f32)MAX(xb - xa, 1u);
+      f32 dhdy          = (h[(size_t)yb * width + x] - h[(size_t)ya * width + x]) / (f32)MAX(yb - ya, 1u);
+      erosion->slope[i] = sqrtf(dhdx * dhdx + dhdy * dhdy);
+
+      f32 outflow = flux[EROSION_FLUX_LEFT][i] + flux[EROSION_FLUX_RIGHT][i] + flux[EROSION_FLUX_UP][i]
+                    + flux[EROSION_FLUX_DOWN][i];
+      f32 inflow          = 0.0f;
+      f32 sediment_inflow = 0.0f;
+
+      // Sediment leaves with the same share of the column as the water does
+      if(x > 0 && w[i - 1] > 0.0f) {
+        f32 in = flux[EROSION_FLUX_RIGHT][i - 1];
+        inflow += in;
+        sediment_inflow += s[i - 1] * in * dt / w[i - 1];
+      }
+      if(x + 1 < width && w[i + 1] > 0.0f) {
+        f32 in = flux[EROSION_FLUX_LEFT][i + 1];
+        inflow += in;
+        sediment_inflow += s[i + 1] * in * dt / w[i + 1];
+      }
+      if(y > 0 && w[i - width] > 0.0f) {
+        f32 in = flux[EROSION_FLUX_DOWN][i - width];
+        inflow += in;
+        sediment_inflow += s[i - width] * in * dt / w[i - width];
+      }
+      if(y + 1 < erosion->height && w[i + width] > 0.0f) {
+        f32 in = flux[EROSION_FLUX_UP][i + width];
+        inflow += in;
+        sediment_inflow += s[i + width] * in * dt / w[i + width];
+      }
+
+      f32 out_share             = w[i] > 0.0f ? MIN(1.0f, outflow * dt / w[i]) : 0.0f;
+      erosion->next_water[i]    = MAX(0.0f, w[i] + (inflow - outflow) * dt);
+      erosion->next_sediment[i] = s[i] * (1.0f - out_share) + sediment_inflow;
+    }
+  }
+}
+
+// Pass 3: exchange material between bed and suspension, then evaporate
+static void erosion_erode_tile(ErosionState *erosion, Heightfield *heightfield, u32 tile) {
+  const ErosionParams *params = &erosion->params;
+  f32                 *h      = heightfield->layers[HEIGHTFIELD_LAYER_HEIGHT];
+  f32                 *w      = heightfield->layers[HEIGHTFIELD_LAYER_WATER];
+  f32                 *s      = heightfield->layers[HEIGHTFIELD_LAYER_SEDIMENT];
+  f32                **flux   = erosion->flux;
+  f32                  dt     = params->time_step;
+  ErosionTileRect      rect   = erosion_tile_rect(erosion, tile);
+  u32                  width  = erosion->width;
+
+  f32 evaporation = MAX(0.0f, 1.0f - params->evaporation * dt);
+
+  f32 max_water  = 0.0f;
+  f32 max_change = 0.0f;
+
+  for(u32 y = rect.y0; y < rect.y1; ++y) {
+    for(u32 x = rect.x0; x < rect.x1; ++x) {
+      size_t i = (size_t)y * width + x;
+
+      f32 water    = erosion->next_water[i];
+      f32 sediment = erosion->next_sediment[i];
+
+      // Net water transported through the cell, per axis
+      f32 in_x      = x > 0 ? flux[EROSION_FLUX_RIGHT][i - 1] : 0.0f;
+      f32 out_x     = x + 1 < width ? flux[EROSION_FLUX_LEFT][i + 1] : 0.0f;
+      f32 in_y      = y > 0 ? flux[EROSION_FLUX_DOWN][i - width] : 0.0f;
+      f32 out_y     = y + 1 < erosion->height ? flux[EROSION_FLUX_UP][i + width] : 0.0f;
+      f32 through_x = in_x - flux[EROSION_FLUX_LEFT][i] + flux[EROSION_FLUX_RIGHT][i] - out_x;
+      f32 through_y = in_y - flux[EROSION_FLUX_UP][i] + flux[EROSION_FLUX_DOWN][i] - out_y;
+
+      f32 mean_water = 0.5f * (w[i] + water);
+      f32 speed      = mean_water > params->water_epsilon
+                       ? 0.5f * sqrtf(through_x * through_x + through_y * through_y) / mean_water
+                       : 0.0f;
+
+      // Slope of the bed as it was before this step's erode pass, so erosion earlier in the
+      // pass does not feed into its neighbours
+      f32 slope    = MAX(erosion->slope[i], params->min_slope);
+      f32 capacity = params->capacity * speed * slope;
+      f32 change   = 0.0f; // Positive deposits onto the bed, negative erodes it
+      if(sediment > capacity) {
+        change = MIN(sediment, params->deposition_rate * dt * (sediment - capacity));
+      } else {
+        change = -params->erosion_rate * dt * (capacity - sediment);
+      }
+
+      water *= evaporation;
+      if(water < params->water_epsilon) {
+        // The column dried up: whatever it carried settles in place
+        change = sediment;
+        water  = 0.0f;
+      }
+
+      h[i] += change;
+      s[i] = sediment - change;
+      w[i] = water;
+
+      max_water  = MAX(max_water, water);
+      max_change = MAX(max_change, fabsf(change));
+    }
+  }
+
+  erosion->tile_max_water[tile]  = max_water;
+  erosion->tile_max_change[tile] = max_change;
+
+  // Published only now that the writes have landed, since a step may span several frames
+  u32 written = HEIGHTFIELD_LAYER_BIT(HEIGHTFIELD_LAYER_HEIGHT) | HEIGHTFIELD_LAYER_BIT(HEIGHTFIELD_LAYER_WATER)
+                | HEIGHTFIELD_LAYER_BIT(HEIGHTFIELD_LAYER_SEDIMENT);
+  heightfield_mark_dirty(heightfield, written, rect.x0, rect.y0, rect.x1, rect.y1);
+}
+
+bool erosion_create(ErosionState *erosion, const ErosionParams *params, u32 width, u32 height, Arena *arena) {
+  memset(erosion, 0, sizeof(ErosionState));
+
+  erosion->params  = *params;
+  erosion->width   = width;
+  erosion->height  = height;
+  erosion->tiles_x = (width + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+  erosion->tiles_y = (height + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+
+  size_t cell_count = (size_t)width * height;
+  u32    tile_count = erosion->tiles_x * erosion->tiles_y;
+
+  for(u32 d = 0; d < EROSION_FLUX_COUNT; ++d) {
+    erosion->flux[d] = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+    if(!erosion->flux[d]) {
+      LOG_ERROR("Failed to allocate erosion flux");
+      return false;
+    }
+    memset(erosion->flux[d], 0, cell_count * sizeof(f32));
+  }
+
+  erosion->next_water      = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+  erosion->next_sediment   = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+  erosion->slope           = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+  erosion->tile_active     = ARENA_PUSH_ARRAY(arena, u8, tile_count);
+  erosion->tile_scheduled  = ARENA_PUSH_ARRAY(arena, u8, tile_count);
+  erosion->schedule        = ARENA_PUSH_ARRAY(arena, u32, tile_count);
+  erosion->tile_max_water  = ARENA_PUSH_ARRAY(arena, f32, tile_count);
+  erosion->tile_max_change = ARENA_PUSH_ARRAY(arena, f32, tile_count);
+  if(!erosion->next_water || !erosion->next_sediment || !erosion->slope || !erosion->tile_active || !erosion->tile_scheduled
+     || !erosion->schedule || !erosion->tile_max_water || !erosion->tile_max_change) {
+    LOG_ERROR("Failed to allocate erosion state");
+    return false;
+  }
+
+  memset(erosion->tile_active, 0, tile_count);
+  memset(erosion->tile_scheduled, 0, tile_count);
+  memset(erosion->tile_max_water, 0, tile_count * sizeof(f32));
+  memset(erosion->tile_max_change, 0, tile_count * sizeof(f32));
+  erosion->stats.total_tiles = tile_count;
+
+  LOG_DEBUG("Erosion state created: %ux%u cells, %ux%u tiles", width, height, erosion->tiles_x, erosion->tiles_y);
+  return true;
+}
+
+void erosion_reset(ErosionState *erosion) {
+  size_t cell_count = (size_t)erosion->width * erosion->height;
+  u32    tile_count = erosion->tiles_x * erosion->tiles_y;
+
+  for(u32 d = 0; d < EROSION_FLUX_COUNT; ++d) {
+    memset(erosion->flux[d], 0, cell_count * sizeof(f32));
+  }
+  memset(erosion->tile_active, 0, tile_count);
+  memset(erosion->tile_scheduled, 0, tile_count);
+  memset(erosion->tile_max_water, 0, tile_count * sizeof(f32));
+  memset(erosion->tile_max_change, 0, tile_count * sizeof(f32));
+
+  erosion->schedule_count    = 0;
+  erosion->phase             = EROSION_PHASE_IDLE;
+  erosion->cursor            = 0;
+  erosion->stats             = ErosionStats{};
+  erosion->stats.total_tiles = tile_count;
+}
+
+void erosion_activate_region(ErosionState *erosion, u32 x0, u32 y0, u32 x1, u32 y1) {
+  x1 = MIN(x1, erosion->width);
+  y1 = MIN(y1, erosion->height);
+  if(x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  for(u32 ty = y0 / EROSION_TILE_SIZE; ty <= (y1 - 1) / EROSION_TILE_SIZE; ++ty) {
+    for(u32 tx = x0 / EROSION_TILE_SIZE; tx <= (x1 - 1) / EROSION_TILE_SIZE; ++tx) {
+      erosion->tile_active[ty * erosion->tiles_x + tx] = 1;
+    }
+  }
+}
+
+void erosion_add_rain(ErosionState *erosion, Heightfield *heightfield, f32 amount) {
+  f32   *water      = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_WATER);
+  size_t cell_count = heightfield_cell_count(heightfield);
+  for(size_t i = 0; i < cell_count; ++i) {
+    water[i] += amount;
+  }
+  heightfield_mark_all_dirty(heightfield, HEIGHTFIELD_LAYER_BIT(HEIGHTFIELD_LAYER_WATER));
+  erosion_activate_region(erosion, 0, 0, erosion->width, erosion->height);
+}
+
+static void erosion_update_activity(ErosionState *erosion) {
+  u32 active_tiles = 0;
+  for(u32 i = 0; i < erosion->schedule_count; ++i) {
+    u32  tile   = erosion->schedule[i];
+    bool active = erosion->tile_max_water[tile] > erosion->params.water_epsilon
+                  || erosion->tile_max_change[tile] > erosion->params.change_threshold;
+    erosion->tile_active[tile] = active ? 1 : 0;
+    active_tiles += active ? 1 : 0;
+  }
+
+  ErosionStats *stats    = &erosion->stats;
+  stats->active_tiles    = active_tiles;
+  stats->scheduled_tiles = erosion->schedule_count;
+  stats->active_fraction = stats->total_tiles > 0 ? (f32)stats->scheduled_tiles / (f32)stats->total_tiles : 0.0f;
+}
+
+u32 erosion_step_partial(ErosionState *erosion, Heightfield *heightfield, u32 max_units, bool *step_done) {
+  *step_done = false;
+
+  if(heightfield->width != erosion->width || heightfield->height != erosion->height) {
+    LOG_ERROR("Erosion state is %ux%u, heightfield is %ux%u",
+              erosion->width,
+              erosion->height,
+              heightfield->width,
+              heightfield->height);
+    *step_done = true;
+    return 0;
+  }
+
+  if(erosion->phase == EROSION_PHASE_IDLE) {
+    erosion_build_schedule(erosion);
+    erosion->phase  = EROSION_PHASE_FLUX;
+    erosion->cursor = 0;
+  }
+
+  // Each pass reads its neighbours' results from the previous pass, so a pass must
+  // cover the whole schedule before the next one starts
+  u32 processed = 0;
+  while(processed < max_units) {
+    if(erosion->cursor == erosion->schedule_count) {
+      if(erosion->phase == EROSION_PHASE_ERODE) {
+        erosion_update_activity(erosion);
+        erosion->phase = EROSION_PHASE_IDLE;
+        *step_done     = true;
+        break;
+      }
+      erosion->phase  = (ErosionPhase)(erosion->phase + 1);
+      erosion->cursor = 0;
+      continue;
+    }
+
+    u32 tile = erosion->schedule[erosion->cursor++];
+    switch(erosion->phase) {
+    case EROSION_PHASE_FLUX: erosion_flux_tile(erosion, heightfield, tile); break;
+    case EROSION_PHASE_WATER: erosion_water_tile(erosion, heightfield, tile); break;
+    case EROSION_PHASE_ERODE: erosion_erode_tile(erosion, heightfield, tile); break;
+    case EROSION_PHASE_IDLE: break;
+    }
+    processed++;
+  }
+
+  return processed;
+}
+
+ErosionStats erosion_step(ErosionState *erosion, Heightfield *heightfield) {
+  bool step_done = false;
+  while(!step_done) {
+    erosion_step_partial(erosion, heightfield, UINT32_MAX, &step_done);
+  }
+  return erosion->stats;
+}
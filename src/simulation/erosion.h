@@ -0,0 +1,89 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include "memory/arena.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Cells per tile side used for activity tracking
+#define EROSION_TILE_SIZE 32
+
+// Outflow directions of the pipe model
+typedef enum ErosionFlux {
+  EROSION_FLUX_LEFT = 0,
+  EROSION_FLUX_RIGHT,
+  EROSION_FLUX_UP,
+  EROSION_FLUX_DOWN,
+  EROSION_FLUX_COUNT
+} ErosionFlux;
+
+typedef struct ErosionParams {
+  f32 time_step;        // Simulated seconds per step
+  f32 gravity;          // Pipe acceleration (pipe area / length folded in)
+  f32 capacity;         // Sediment carried per unit of speed * slope
+  f32 erosion_rate;     // Fraction of missing capacity picked up per second
+  f32 deposition_rate;  // Fraction of excess sediment dropped per second
+  f32 evaporation;      // Fraction of water lost per second
+  f32 min_slope;        // Keeps capacity non-zero on flat ground
+  f32 water_epsilon;    // A tile stays active while any cell holds more water
+  f32 change_threshold; // ... or while any height changed by more than this in a step
+} ErosionParams;
+
+// Pass currently executing in a resumable step
+typedef enum ErosionPhase {
+  EROSION_PHASE_IDLE = 0, // No step in flight; the next call builds a new schedule
+  EROSION_PHASE_FLUX,
+  EROSION_PHASE_WATER,
+  EROSION_PHASE_ERODE,
+} ErosionPhase;
+
+// Per-step activity report
+typedef struct ErosionStats {
+  u32 active_tiles;    // Tiles flagged active after the step
+  u32 scheduled_tiles; // Tiles processed during the step (active tiles and their neighbours)
+  u32 total_tiles;
+  f32 active_fraction; // scheduled_tiles / total_tiles, i.e. the share of a full-grid solve
+} ErosionStats;
+
+// Pipe-model hydraulic erosion that only touches active tiles and their neighbours
+typedef struct ErosionState {
+  ErosionParams params;
+  f32          *flux[EROSION_FLUX_COUNT];
+  f32          *next_water;
+  f32          *next_sediment;
+  f32          *slope; // Bed slope from the heights before this step's erode pass
+  u8           *tile_active;
+  u8           *tile_scheduled;
+  u32          *schedule; // Indices of scheduled tiles for the current step
+  u32           schedule_count;
+  ErosionPhase  phase;
+  u32           cursor; // Next schedule entry for the current phase
+  f32          *tile_max_water;
+  f32          *tile_max_change;
+  u32           tiles_x;
+  u32           tiles_y;
+  u32           width;
+  u32           height;
+  ErosionStats  stats;
+} ErosionState;
+
+bool erosion_create(ErosionState *erosion, const ErosionParams *params, u32 width, u32 height, Arena *arena);
+
+// Drop flux, activity and any partially completed step, e.g. before eroding a new heightfield
+void erosion_reset(ErosionState *erosion);
+
+// Flag every tile overlapping the cell rectangle [x0, x1) x [y0, y1) as active
+void erosion_activate_region(ErosionState *erosion, u32 x0, u32 y0, u32 x1, u32 y1);
+
+// Add water to every cell and wake the whole grid
+void erosion_add_rain(ErosionState *erosion, Heightfield *heightfield, f32 amount);
+
+// Run one step over the scheduled tiles and refresh the activity flags
+ErosionStats erosion_step(ErosionState *erosion, Heightfield *heightfield);
+
+// Resumable stepping for time-sliced callers. Runs up to max_units tile passes (three per
+// scheduled tile) and returns how many ran. *step_done is set once the step completes,
+// at which point erosion->stats holds its report.
+u32 erosion_step_partial(ErosionState *erosion, Heightfield *heightfield, u32 max_units, bool *step_done);
+
+#endif // EROSION_H
@@ -0,0 +1,336 @@
+#include "height_pyramid.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "math/simd.h"
+#include "utils/macros.h"
+#include <string.h>
+
+static_assert(HEIGHTFIELD_TILE_SIZE == 2 * HEIGHT_PYRAMID_BLOCK, "a base block must cover one heightfield tile");
+
+static u32 height_pyramid_round4(u32 value) { return (value + 3) & ~3u; }
+
+bool height_pyramid_create(HeightPyramid *pyramid, const Heightfield *heightfield, Arena *arena) {
+  memset(pyramid, 0, sizeof(*pyramid));
+  pyramid->width      = heightfield->width;
+  pyramid->height     = heightfield->height;
+  pyramid->tile_count = heightfield_tile_count(heightfield);
+
+  u32 width  = (heightfield->width + 1) / 2;
+  u32 height = (heightfield->height + 1) / 2;
+  for(;;) {
+    if(pyramid->level_count == HEIGHT_PYRAMID_MAX_LEVELS) {
+      LOG_ERROR("Height pyramid for %ux%u needs too many levels", heightfield->width, heightfield->height);
+      return false;
+    }
+
+    HeightPyramidLevel *level = &pyramid->levels[pyramid->level_count++];
+    size_t              count = (size_t)width * height;
+    level->width              = width;
+    level->height             = height;
+    level->blocks_x           = (width + HEIGHT_PYRAMID_BLOCK - 1) / HEIGHT_PYRAMID_BLOCK;
+    level->blocks_y           = (height + HEIGHT_PYRAMID_BLOCK - 1) / HEIGHT_PYRAMID_BLOCK;
+    level->min                = ARENA_PUSH_ARRAY(arena, f32, count);
+    level->max                = ARENA_PUSH_ARRAY(arena, f32, count);
+    level->avg                = ARENA_PUSH_ARRAY(arena, f32, count);
+    level->block_dirty        = ARENA_PUSH_ARRAY(arena, u8, level->blocks_x * level->blocks_y);
+    if(!level->min || !level->max || !level->avg || !level->block_dirty) {
+      LOG_ERROR("Failed to allocate height pyramid level %u (%ux%u)", pyramid->level_count - 1, width, height);
+      return false;
+    }
+    memset(level->block_dirty, 0, level->blocks_x * level->blocks_y);
+
+    if(width == 1 && height == 1) {
+      break;
+    }
+    width  = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+
+  const HeightPyramidLevel *base = &pyramid->levels[0];
+  pyramid->tile_version          = ARENA_PUSH_ARRAY(arena, u64, pyramid->tile_count);
+  pyramid->block_list            = ARENA_PUSH_ARRAY(arena, u32, base->blocks_x * base->blocks_y);
+  if(!pyramid->tile_version || !pyramid->block_list) {
+    LOG_ERROR("Failed to allocate height pyramid tables");
+    return false;
+  }
+  memset(pyramid->tile_version, 0, pyramid->tile_count * sizeof(u64));
+  return true;
+}
+
+typedef struct HeightPyramidJob {
+  HeightPyramid *pyramid;
+  const f32     *samples; // Height layer, for the base level
+  u32            level;
+} HeightPyramidJob;
+
+// Output rows are produced 4 nodes at a time from temp rows holding the vertically
+// reduced samples (or child nodes) under them; temp rows are padded by clamping so the
+// vector loops never need a tail.
+
+static void height_pyramid_store(f32 *dst, F32x4 value, u32 count) {
+  if(count >= 4) {
+    f32x4_store(dst, value);
+    return;
+  }
+  f32 lanes[4];
+  f32x4_store(lanes, value);
+  memcpy(dst, lanes, count * sizeof(f32));
+}
+
+// Base block: min/max over samples 2x..2x+2 (3x3, overlapping), avg over 2x..2x+1 (2x2)
+static void height_pyramid_base_block(const HeightPyramidJob *job, u32 block, Arena *scratch) {
+  const HeightPyramid *pyramid = job->pyramid;
+  HeightPyramidLevel  *level   = &job->pyramid->levels[0];
+  const f32           *samples = job->samples;
+
+  u32 bx    = block % level->blocks_x;
+  u32 by    = block / level->blocks_x;
+  u32 x0    = bx * HEIGHT_PYRAMID_BLOCK;
+  u32 y0    = by * HEIGHT_PYRAMID_BLOCK;
+  u32 nodes = MIN((u32)HEIGHT_PYRAMID_BLOCK, level->width - x0);
+  u32 rows  = MIN((u32)HEIGHT_PYRAMID_BLOCK, level->height - y0);
+
+  // Temp column j holds sample column 2 * x0 + j
+  u32  span  = 2 * height_pyramid_round4(nodes) + 2;
+  f32 *t_min = ARENA_PUSH_ARRAY(scratch, f32, span);
+  f32 *t_max = ARENA_PUSH_ARRAY(scratch, f32, span);
+  f32 *t_sum = ARENA_PUSH_ARRAY(scratch, f32, span);
+  if(!t_min || !t_max || !t_sum) {
+    return;
+  }
+
+  const u32 last_x = pyramid->width - 1;
+  const u32 last_y = pyramid->height - 1;
+  const u32 sx0    = 2 * x0;
+  u32       direct = sx0 + span <= pyramid->width ? span : pyramid->width - sx0; // Columns needing no clamp
+
+  for(u32 y = y0; y < y0 + rows; ++y) {
+    const f32 *r0 = samples + (size_t)MIN(2 * y, last_y) * pyramid->width + sx0;
+    const f32 *r1 = samples + (size_t)MIN(2 * y + 1, last_y) * pyramid->width + sx0;
+    const f32 *r2 = samples + (size_t)MIN(2 * y + 2, last_y) * pyramid->width + sx0;
+
+    u32 j = 0;
+    for(; j + 4 <= direct; j += 4) {
+      F32x4 a = f32x4_load(r0 + j);
+      F32x4 b = f32x4_load(r1 + j);
+      F32x4 c = f32x4_load(r2 + j);
+      f32x4_store(t_min + j, f32x4_min(f32x4_min(a, b), c));
+      f32x4_store(t_max + j, f32x4_max(f32x4_max(a, b), c));
+      f32x4_store(t_sum + j, f32x4_add(a, b));
+    }
+    for(; j < span; ++j) {
+      u32 col  = MIN(sx0 + j, last_x) - sx0;
+      f32 a    = r0[col];
+      f32 b    = r1[col];
+      f32 c    = r2[col];
+      t_min[j] = MIN(MIN(a, b), c);
+      t_max[j] = MAX(MAX(a, b), c);
+      t_sum[j] = a + b;
+    }
+
+    size_t row     = (size_t)y * level->width + x0;
+    F32x4  quarter = f32x4_set1(0.25f);
+    for(u32 i = 0; i < nodes; i += 4) {
+      F32x4 even;
+      F32x4 odd;
+      F32x4 next; // Sample 2x + 2: the even lanes shifted by one node
+      F32x4 unused;
+
+      f32x4_deinterleave(f32x4_load(t_min + 2 * i), f32x4_load(t_min + 2 * i + 4), &even, &odd);
+      f32x4_deinterleave(f32x4_load(t_min + 2 * i + 2), f32x4_load(t_min + 2 * i + 6), &next, &unused);
+      height_pyramid_store(level->min + row + i, f32x4_min(f32x4_min(even, odd), next), nodes - i);
+
+      f32x4_deinterleave(f32x4_load(t_max + 2 * i), f32x4_load(t_max + 2 * i + 4), &even, &odd);
+      f32x4_deinterleave(f32x4_load(t_max + 2 * i + 2), f32x4_load(t_max + 2 * i + 6), &next, &unused);
+      height_pyramid_store(level->max + row + i, f32x4_max(f32x4_max(even, odd), next), nodes - i);
+
+      f32x4_deinterleave(f32x4_load(t_sum + 2 * i), f32x4_load(t_sum + 2 * i + 4), &even, &odd);
+      height_pyramid_store(level->avg + row + i, f32x4_mul(f32x4_add(even, odd), quarter), nodes - i);
+    }
+  }
+}
+
+// Upper block: each node combines its 2x2 children; edge nodes repeat the last child
+static void height_pyramid_upper_block(const HeightPyramidJob *job, u32 block, Arena *scratch) {
+  const HeightPyramid      *pyramid = job->pyramid;
+  HeightPyramidLevel       *level   = &job->pyramid->levels[job->level];
+  const HeightPyramidLevel *child   = &pyramid->levels[job->level - 1];
+
+  u32 bx    = block % level->blocks_x;
+  u32 by    = block / level->blocks_x;
+  u32 x0    = bx * HEIGHT_PYRAMID_BLOCK;
+  u32 y0    = by * HEIGHT_PYRAMID_BLOCK;
+  u32 nodes = MIN((u32)HEIGHT_PYRAMID_BLOCK, level->width - x0);
+  u32 rows  = MIN((u32)HEIGHT_PYRAMID_BLOCK, level->height - y0);
+
+  u32  span  = 2 * height_pyramid_round4(nodes);
+  f32 *t_min = ARENA_PUSH_ARRAY(scratch, f32, span);
+  f32 *t_max = ARENA_PUSH_ARRAY(scratch, f32, span);
+  f32 *t_sum = ARENA_PUSH_ARRAY(scratch, f32, span);
+  if(!t_min || !t_max || !t_sum) {
+    return;
+  }
+
+  const u32 last_x = child->width - 1;
+  const u32 last_y = child->height - 1;
+  const u32 cx0    = 2 * x0;
+  u32       direct = cx0 + span <= child->width ? span : child->width - cx0;
+
+  for(u32 y = y0; y < y0 + rows; ++y) {
+    size_t r0 = (size_t)MIN(2 * y, last_y) * child->width + cx0;
+    size_t r1 = (size_t)MIN(2 * y + 1, last_y) * child->width + cx0;
+
+    u32 j = 0;
+    for(; j + 4 <= direct; j += 4) {
+      f32x4_store(t_min + j, f32x4_min(f32x4_load(child->min + r0 + j), f32x4_load(child->min + r1 + j)));
+      f32x4_store(t_max + j, f32x4_max(f32x4_load(child->max + r0 + j), f32x4_load(child->max + r1 + j)));
+      f32x4_store(t_sum + j, f32x4_add(f32x4_load(child->avg + r0 + j), f32x4_load(child->avg + r1 + j)));
+    }
+    for(; j < span; ++j) {
+      u32 col  = MIN(cx0 + j, last_x) - cx0;
+      t_min[j] = MIN(child->min[r0 + col], child->min[r1 + col]);
+      t_max[j] = MAX(child->max[r0 + col], child->max[r1 + col]);
+      t_sum[j] = child->avg[r0 + col] + child->avg[r1 + col];
+    }
+
+    size_t row     = (size_t)y * level->width + x0;
+    F32x4  quarter = f32x4_set1(0.25f);
+    for(u32 i = 0; i < nodes; i += 4) {
+      F32x4 even;
+      F32x4 odd;
+      f32x4_deinterleave(f32x4_load(t_min + 2 * i), f32x4_load(t_min + 2 * i + 4), &even, &odd);
+      height_pyramid_store(level->min + row + i, f32x4_min(even, odd), nodes - i);
+      f32x4_deinterleave(f32x4_load(t_max + 2 * i), f32x4_load(t_max + 2 * i + 4), &even, &odd);
+      height_pyramid_store(level->max + row + i, f32x4_max(even, odd), nodes - i);
+      f32x4_deinterleave(f32x4_load(t_sum + 2 * i), f32x4_load(t_sum + 2 * i + 4), &even, &odd);
+      height_pyramid_store(level->avg + row + i, f32x4_mul(f32x4_add(even, odd), quarter), nodes - i);
+    }
+  }
+}
+
+static void height_pyramid_blocks(void *user, u32 begin, u32 end, u32 worker) {
+  const HeightPyramidJob *job     = (const HeightPyramidJob *)user;
+  Arena                  *scratch = job_worker_scratch(worker);
+
+  for(u32 i = begin; i < end; ++i) {
+    ArenaTemp temp  = arena_temp_begin(scratch);
+    u32       block = job->pyramid->block_list[i];
+    if(job->level == 0) {
+      height_pyramid_base_block(job, block, scratch);
+    } else {
+      height_pyramid_upper_block(job, block, scratch);
+    }
+    arena_temp_end(temp);
+  }
+}
+
+static void height_pyramid_mark_base(HeightPyramid *pyramid, i64 bx, i64 by) {
+  HeightPyramidLevel *base = &pyramid->levels[0];
+  if(bx >= 0 && by >= 0 && bx < base->blocks_x && by < base->blocks_y) {
+    base->block_dirty[by * base->blocks_x + bx] = 1;
+  }
+}
+
+u32 height_pyramid_update(HeightPyramid *pyramid, const Heightfield *heightfield) {
+  if(heightfield->width != pyramid->width || heightfield->height != pyramid->height) {
+    LOG_ERROR("Height pyramid does not match the %ux%u heightfield", heightfield->width, heightfield->height);
+    return 0;
+  }
+
+  HeightPyramidLevel *base     = &pyramid->levels[0];
+  const u64          *versions = heightfield->tile_version[HEIGHTFIELD_LAYER_HEIGHT];
+  if(!pyramid->built || !versions) {
+    memset(base->block_dirty, 1, base->blocks_x * base->blocks_y);
+  }
+  if(versions) {
+    for(u32 tile = 0; tile < pyramid->tile_count; ++tile) {
+      if(versions[tile] == pyramid->tile_version[tile]) {
+        continue;
+      }
+      pyramid->tile_version[tile] = versions[tile];
+
+      // A tile's first row and column are also the far edge of the blocks before it
+      i64 tx = tile % heightfield->tiles_x;
+      i64 ty = tile / heightfield->tiles_x;
+      height_pyramid_mark_base(pyramid, tx, ty);
+      height_pyramid_mark_base(pyramid, tx - 1, ty);
+      height_pyramid_mark_base(pyramid, tx, ty - 1);
+      height_pyramid_mark_base(pyramid, tx - 1, ty - 1);
+    }
+  }
+  pyramid->built = true;
+
+  u32 updated = 0;
+  for(u32 l = 0; l < pyramid->level_count; ++l) {
+    HeightPyramidLevel *level = &pyramid->levels[l];
+    HeightPyramidLevel *above = l + 1 < pyramid->level_count ? &pyramid->levels[l + 1] : NULL;
+
+    u32 count = 0;
+    for(u32 block = 0; block < level->blocks_x * level->blocks_y; ++block) {
+      if(!level->block_dirty[block]) {
+        continue;
+      }
+      level->block_dirty[block]     = 0;
+      pyramid->block_list[count++] = block;
+      if(above) {
+        u32 bx = (block % level->blocks_x) / 2;
+        u32 by = (block / level->blocks_x) / 2;
+        above->block_dirty[by * above->blocks_x + bx] = 1;
+      }
+    }
+    if(count == 0) {
+      break;
+    }
+
+    HeightPyramidJob job = {
+      .pyramid = pyramid,
+      .samples = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT),
+      .level   = l,
+    };
+    job_parallel_for(count, 1, height_pyramid_blocks, &job);
+    updated += count;
+  }
+
+  pyramid->blocks_updated = updated;
+  return updated;
+}
+
+void height_pyramid_node(const HeightPyramid *pyramid, u32 level, u32 x, u32 y, f32 *out_min, f32 *out_max) {
+  const HeightPyramidLevel *l     = &pyramid->levels[level];
+  size_t                    index = (size_t)y * l->width + x;
+  *out_min                        = l->min[index];
+  *out_max                        = l->max[index];
+}
+
+f32 height_pyramid_average(const HeightPyramid *pyramid, u32 level, u32 x, u32 y) {
+  const HeightPyramidLevel *l = &pyramid->levels[level];
+  return l->avg[(size_t)y * l->width + x];
+}
+
+void height_pyramid_bounds(const HeightPyramid *pyramid, u32 x0, u32 y0, u32 x1, u32 y1, f32 *out_min, f32 *out_max) {
+  x1 = MIN(x1, pyramid->width - 1);
+  y1 = MIN(y1, pyramid->height - 1);
+  x0 = MIN(x0, x1);
+  y0 = MIN(y0, y1);
+
+  // Finest level on which the rectangle touches at most two nodes per axis
+  u32 level = 0;
+  while(level + 1 < pyramid->level_count
+        && ((x1 >> (level + 1)) - (x0 >> (level + 1)) > 1 || (y1 >> (level + 1)) - (y0 >> (level + 1)) > 1)) {
+    level++;
+  }
+
+  const HeightPyramidLevel *l  = &pyramid->levels[level];
+  u32                       nx = MIN(x1 >> (level + 1), l->width - 1);
+  u32                       ny = MIN(y1 >> (level + 1), l->height - 1);
+  f32                       lo = l->min[(size_t)(y0 >> (level + 1)) * l->width + (x0 >> (level + 1))];
+  f32                       hi = l->max[(size_t)(y0 >> (level + 1)) * l->width + (x0 >> (level + 1))];
+  for(u32 y = y0 >> (level + 1); y <= ny; ++y) {
+    for(u32 x = x0 >> (level + 1); x <= nx; ++x) {
+      lo = MIN(lo, l->min[(size_t)y * l->width + x]);
+      hi = MAX(hi, l->max[(size_t)y * l->width + x]);
+    }
+  }
+  *out_min = lo;
+  *out_max = hi;
+}
@@ -0,0 +1,59 @@
+#ifndef HEIGHT_PYRAMID_H
+#define HEIGHT_PYRAMID_H
+
+#include "memory/arena.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Hierarchical bounds of the height layer for culling, LOD selection, ray marching and
+// picking. Node (x, y) of level l covers the height samples [x * 2^(l+1), (x + 1) * 2^(l+1)]
+// on both axes, far edge included, so its min and max bound the bilinear surface over
+// that square. avg is the mean of the 2^(l+1) square of samples without the shared edge.
+// Levels halve until a single node remains.
+//
+// Updates rebuild only the blocks under heightfield tiles whose version changed since the
+// previous update, level by level, in parallel on the job system.
+
+#define HEIGHT_PYRAMID_MAX_LEVELS 24
+
+// Nodes per side of the update blocks; one base block covers one heightfield tile
+#define HEIGHT_PYRAMID_BLOCK (HEIGHTFIELD_TILE_SIZE / 2)
+
+typedef struct HeightPyramidLevel {
+  f32 *min;
+  f32 *max;
+  f32 *avg;
+  u32  width;
+  u32  height;
+  u32  blocks_x;
+  u32  blocks_y;
+  u8  *block_dirty;
+} HeightPyramidLevel;
+
+typedef struct HeightPyramid {
+  HeightPyramidLevel levels[HEIGHT_PYRAMID_MAX_LEVELS];
+  u32                level_count;
+  u32                width; // Heightfield dimensions
+  u32                height;
+  u64               *tile_version; // Height layer tile versions the pyramid was built from
+  u32                tile_count;
+  u32               *block_list; // Dirty blocks of the level being rebuilt
+  bool               built;
+  u32                blocks_updated; // Blocks rebuilt by the last update, across all levels
+} HeightPyramid;
+
+bool height_pyramid_create(HeightPyramid *pyramid, const Heightfield *heightfield, Arena *arena);
+
+// Bring the pyramid up to date with the height layer. Returns the number of blocks rebuilt.
+// Heightfields without change tracking are rebuilt in full every time.
+u32 height_pyramid_update(HeightPyramid *pyramid, const Heightfield *heightfield);
+
+// Bounds and mean of one node; level and coordinates must be in range
+void height_pyramid_node(const HeightPyramid *pyramid, u32 level, u32 x, u32 y, f32 *out_min, f32 *out_max);
+f32  height_pyramid_average(const HeightPyramid *pyramid, u32 level, u32 x, u32 y);
+
+// Conservative bounds of the samples in [x0, x1] x [y0, y1] (inclusive): at most 2x2 nodes
+// of the finest level that covers the rectangle, so a few samples around it may count too
+void height_pyramid_bounds(const HeightPyramid *pyramid, u32 x0, u32 y0, u32 x1, u32 y1, f32 *out_min, f32 *out_max);
+
+#endif // HEIGHT_PYRAMID_H
@@ -0,0 +1,112 @@
+#include "heightfield.h"
+#include "core/log.h"
+#include "utils/macros.h"
+#include <string.h>
+
+bool heightfield_create(Heightfield *heightfield, u32 width, u32 height, Arena *arena) {
+  memset(heightfield, 0, sizeof(Heightfield));
+
+  if(width == 0 || height == 0) {
+    LOG_ERROR("Heightfield dimensions must be non-zero (got %ux%u)", width, height);
+    return false;
+  }
+
+  size_t cell_count = (size_t)width * height;
+  for(u32 i = 0; i < HEIGHTFIELD_LAYER_COUNT; ++i) {
+    heightfield->layers[i] = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+    if(!heightfield->layers[i]) {
+      LOG_ERROR("Failed to allocate heightfield layer %u", i);
+      return false;
+    }
+    memset(heightfield->layers[i], 0, cell_count * sizeof(f32));
+  }
+
+  heightfield->width   = width;
+  heightfield->height  = height;
+  heightfield->tiles_x = (width + HEIGHTFIELD_TILE_SIZE - 1) / HEIGHTFIELD_TILE_SIZE;
+  heightfield->tiles_y = (height + HEIGHTFIELD_TILE_SIZE - 1) / HEIGHTFIELD_TILE_SIZE;
+
+  // Nothing has been captured yet, so every tile starts dirty
+  heightfield->tile_dirty = ARENA_PUSH_ARRAY(arena, u8, heightfield_tile_count(heightfield));
+  if(!heightfield->tile_dirty) {
+    LOG_ERROR("Failed to allocate heightfield tile flags");
+    return false;
+  }
+  for(u32 i = 0; i < HEIGHTFIELD_LAYER_COUNT; ++i) {
+    heightfield->tile_version[i] = ARENA_PUSH_ARRAY(arena, u64, heightfield_tile_count(heightfield));
+    if(!heightfield->tile_version[i]) {
+      LOG_ERROR("Failed to allocate heightfield tile versions");
+      return false;
+    }
+  }
+  heightfield_mark_all_dirty(heightfield, HEIGHTFIELD_LAYER_BITS_ALL);
+
+  LOG_DEBUG("Heightfield created: %ux%u, %u layers", width, height, HEIGHTFIELD_LAYER_COUNT);
+  return true;
+}
+
+f32 *heightfield_layer(const Heightfield *heightfield, HeightfieldLayerId id) {
+  if(!heightfield || id >= HEIGHTFIELD_LAYER_COUNT) {
+    return NULL;
+  }
+  return heightfield->layers[id];
+}
+
+size_t heightfield_cell_count(const Heightfield *heightfield) {
+  return (size_t)heightfield->width * heightfield->height;
+}
+
+size_t heightfield_storage_bytes(HeightfieldStorage storage) {
+  return storage == HEIGHTFIELD_STORAGE_F32 ? sizeof(f32) : sizeof(u16);
+}
+
+u32 heightfield_tile_count(const Heightfield *heightfield) { return heightfield->tiles_x * heightfield->tiles_y; }
+
+// Bump version and stamp it on the layers in the mask
+static u64 heightfield_publish(Heightfield *heightfield, u32 layers) {
+  u64 version = ++heightfield->version;
+  for(u32 l = 0; l < HEIGHTFIELD_LAYER_COUNT; ++l) {
+    if(layers & HEIGHTFIELD_LAYER_BIT(l)) {
+      heightfield->layer_version[l] = version;
+    }
+  }
+  return version;
+}
+
+void heightfield_mark_dirty(Heightfield *heightfield, u32 layers, u32 x0, u32 y0, u32 x1, u32 y1) {
+  x1 = MIN(x1, heightfield->width);
+  y1 = MIN(y1, heightfield->height);
+  if(!heightfield->tile_dirty || layers == 0 || x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  u64 version = heightfield_publish(heightfield, layers);
+  for(u32 ty = y0 / HEIGHTFIELD_TILE_SIZE; ty <= (y1 - 1) / HEIGHTFIELD_TILE_SIZE; ++ty) {
+    for(u32 tx = x0 / HEIGHTFIELD_TILE_SIZE; tx <= (x1 - 1) / HEIGHTFIELD_TILE_SIZE; ++tx) {
+      u32 tile                      = ty * heightfield->tiles_x + tx;
+      heightfield->tile_dirty[tile] = 1;
+      for(u32 l = 0; l < HEIGHTFIELD_LAYER_COUNT; ++l) {
+        if(layers & HEIGHTFIELD_LAYER_BIT(l)) {
+          heightfield->tile_version[l][tile] = version;
+        }
+      }
+    }
+  }
+}
+
+void heightfield_mark_all_dirty(Heightfield *heightfield, u32 layers) {
+  heightfield_mark_dirty(heightfield, layers, 0, 0, heightfield->width, heightfield->height);
+}
+
+void heightfield_mark_tile_changed(Heightfield *heightfield, u32 layers, u32 tile) {
+  if(!heightfield->tile_dirty || layers == 0 || tile >= heightfield_tile_count(heightfield)) {
+    return;
+  }
+
+  u64 version = heightfield_publish(heightfield, layers);
+  for(u32 l = 0; l < HEIGHTFIELD_LAYER_COUNT; ++l) {
+    if(layers & HEIGHTFIELD_LAYER_BIT(l)) {
+      heightfield->tile_version[l][tile] = version;
+    }
+  }
+}
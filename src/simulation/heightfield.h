@@ -0,0 +1,77 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include "memory/arena.h"
+#include "utils/types.h"
+
+// Per-cell layers stored by the simulation heightfield
+typedef enum HeightfieldLayerId {
+  HEIGHTFIELD_LAYER_HEIGHT = 0,
+  HEIGHTFIELD_LAYER_WATER,
+  HEIGHTFIELD_LAYER_SEDIMENT,
+  HEIGHTFIELD_LAYER_COUNT
+} HeightfieldLayerId;
+
+// Sets of layers reported by writers
+#define HEIGHTFIELD_LAYER_BIT(id)  (1u << (id))
+#define HEIGHTFIELD_LAYER_BITS_ALL ((1u << HEIGHTFIELD_LAYER_COUNT) - 1)
+
+// Element formats for stored copies of a layer. Live layers are always f32.
+typedef enum HeightfieldStorage {
+  HEIGHTFIELD_STORAGE_F32 = 0,
+  HEIGHTFIELD_STORAGE_F16,     // IEEE half: ~3 significant digits at any magnitude
+  HEIGHTFIELD_STORAGE_UNORM16, // 16-bit fixed point over a per-tile [offset, offset + 65535 * scale] range
+} HeightfieldStorage;
+
+// Cells per side of the tiles used for change tracking and history snapshots
+#define HEIGHTFIELD_TILE_SIZE 64
+
+// Row-major f32 layers sharing the same grid dimensions
+typedef struct Heightfield {
+  f32 *layers[HEIGHTFIELD_LAYER_COUNT];
+  u32  width;
+  u32  height;
+  u8  *tile_dirty;                             // Tiles with any layer written since the last snapshot or restore
+  u64 *tile_version[HEIGHTFIELD_LAYER_COUNT];  // Value of version when each tile of a layer last changed
+  u64  layer_version[HEIGHTFIELD_LAYER_COUNT]; // Value of version when anything in a layer last changed
+  u64  version;                                // Bumped by every change; readers compare the stamps with it
+  u32  tiles_x;
+  u32  tiles_y;
+} Heightfield;
+
+// Where a heightfield sits in the world: sample (x, y) is at
+// (origin_x + x * cell_size, height, origin_z + y * cell_size)
+typedef struct HeightfieldPlacement {
+  f32 origin_x;
+  f32 origin_z;
+  f32 cell_size;
+} HeightfieldPlacement;
+
+// Allocate all layers from the arena and zero them
+bool heightfield_create(Heightfield *heightfield, u32 width, u32 height, Arena *arena);
+
+// Get a layer pointer (NULL for invalid ids)
+f32 *heightfield_layer(const Heightfield *heightfield, HeightfieldLayerId id);
+
+// Number of cells in a single layer
+size_t heightfield_cell_count(const Heightfield *heightfield);
+
+// Bytes per cell for a storage format
+size_t heightfield_storage_bytes(HeightfieldStorage storage);
+
+// Number of change-tracking tiles
+u32 heightfield_tile_count(const Heightfield *heightfield);
+
+// Record that the layers in the HEIGHTFIELD_LAYER_BIT mask changed inside the cell rectangle
+// [x0, x1) x [y0, y1). Every writer of the layers must report its writes for snapshots to
+// stay correct. Marking also publishes the change: version is bumped and the touched tiles
+// of those layers are stamped with it, so readers of one layer skip writes to the others.
+// Views built without tracking (tile_dirty == NULL) ignore marks.
+void heightfield_mark_dirty(Heightfield *heightfield, u32 layers, u32 x0, u32 y0, u32 x1, u32 y1);
+void heightfield_mark_all_dirty(Heightfield *heightfield, u32 layers);
+
+// Publish a tile whose layers changed without making it dirty, e.g. one restored from the
+// snapshot it now matches
+void heightfield_mark_tile_changed(Heightfield *heightfield, u32 layers, u32 tile);
+
+#endif // HEIGHTFIELD_H
@@ -0,0 +1,219 @@
+#include "heightfield_history.h"
+#include "core/log.h"
+#include "math/pack16.h"
+#include "utils/macros.h"
+#include <string.h>
+
+#define HEIGHTFIELD_TILE_CELLS (HEIGHTFIELD_TILE_SIZE * HEIGHTFIELD_TILE_SIZE)
+
+static void *heightfield_tile_layer(const HeightfieldHistory *history, HeightfieldTile *tile, u32 layer) {
+  return (u8 *)(tile + 1) + history->layer_offset[layer];
+}
+
+static void heightfield_tile_retain(HeightfieldTile *tile) {
+  if(tile) {
+    tile->refcount++;
+  }
+}
+
+static void heightfield_tile_release(HeightfieldHistory *history, HeightfieldTile *tile) {
+  if(tile && --tile->refcount == 0) {
+    pool_free(&history->tile_pool, tile);
+  }
+}
+
+typedef struct HeightfieldTileRect {
+  u32 x0;
+  u32 y0;
+  u32 cols;
+  u32 rows;
+} HeightfieldTileRect;
+
+static HeightfieldTileRect heightfield_tile_rect(const Heightfield *heightfield, u32 index) {
+  u32 x0 = (index % heightfield->tiles_x) * HEIGHTFIELD_TILE_SIZE;
+  u32 y0 = (index / heightfield->tiles_x) * HEIGHTFIELD_TILE_SIZE;
+  return HeightfieldTileRect{
+    .x0   = x0,
+    .y0   = y0,
+    .cols = MIN(HEIGHTFIELD_TILE_SIZE, heightfield->width - x0),
+    .rows = MIN(HEIGHTFIELD_TILE_SIZE, heightfield->height - y0),
+  };
+}
+
+// Encode tile `index` of the live layers into a tile
+static void heightfield_tile_capture(const HeightfieldHistory *history,
+                                     const Heightfield        *heightfield,
+                                     u32                       index,
+                                     HeightfieldTile          *tile) {
+  HeightfieldTileRect rect = heightfield_tile_rect(heightfield, index);
+
+  for(u32 layer = 0; layer < HEIGHTFIELD_LAYER_COUNT; ++layer) {
+    const f32 *live   = heightfield->layers[layer] + (size_t)rect.y0 * heightfield->width + rect.x0;
+    void      *stored = heightfield_tile_layer(history, tile, layer);
+
+    tile->offset[layer] = 0.0f;
+    tile->scale[layer]  = 1.0f;
+    if(history->storage[layer] == HEIGHTFIELD_STORAGE_UNORM16) {
+      f32 lo = live[0];
+      f32 hi = live[0];
+      for(u32 y = 0; y < rect.rows; ++y) {
+        f32 row_lo;
+        f32 row_hi;
+        unorm16_range(live + (size_t)y * heightfield->width, rect.cols, &row_lo, &row_hi);
+        lo = MIN(lo, row_lo);
+        hi = MAX(hi, row_hi);
+      }
+      tile->offset[layer] = lo;
+      tile->scale[layer]  = unorm16_scale(lo, hi);
+    }
+
+    for(u32 y = 0; y < rect.rows; ++y) {
+      const f32 *src = live + (size_t)y * heightfield->width;
+      switch(history->storage[layer]) {
+      case HEIGHTFIELD_STORAGE_F32:
+        memcpy((f32 *)stored + y * HEIGHTFIELD_TILE_SIZE, src, rect.cols * sizeof(f32));
+        break;
+      case HEIGHTFIELD_STORAGE_F16: f16_encode(src, (u16 *)stored + y * HEIGHTFIELD_TILE_SIZE, rect.cols); break;
+      case HEIGHTFIELD_STORAGE_UNORM16:
+        unorm16_encode(
+          src, (u16 *)stored + y * HEIGHTFIELD_TILE_SIZE, rect.cols, tile->offset[layer], tile->scale[layer]);
+        break;
+      }
+    }
+  }
+}
+
+// Decode a tile back into tile `index` of the live layers
+static void heightfield_tile_apply(const HeightfieldHistory *history,
+                                   Heightfield              *heightfield,
+                                   u32                       index,
+                                   HeightfieldTile          *tile) {
+  HeightfieldTileRect rect = heightfield_tile_rect(heightfield, index);
+
+  for(u32 layer = 0; layer < HEIGHTFIELD_LAYER_COUNT; ++layer) {
+    f32  *live   = heightfield->layers[layer] + (size_t)rect.y0 * heightfield->width + rect.x0;
+    void *stored = heightfield_tile_layer(history, tile, layer);
+
+    for(u32 y = 0; y < rect.rows; ++y) {
+      f32 *dst = live + (size_t)y * heightfield->width;
+      switch(history->storage[layer]) {
+      case HEIGHTFIELD_STORAGE_F32:
+        memcpy(dst, (f32 *)stored + y * HEIGHTFIELD_TILE_SIZE, rect.cols * sizeof(f32));
+        break;
+      case HEIGHTFIELD_STORAGE_F16: f16_decode((u16 *)stored + y * HEIGHTFIELD_TILE_SIZE, dst, rect.cols); break;
+      case HEIGHTFIELD_STORAGE_UNORM16:
+        unorm16_decode(
+          (u16 *)stored + y * HEIGHTFIELD_TILE_SIZE, dst, rect.cols, tile->offset[layer], tile->scale[layer]);
+        break;
+      }
+    }
+  }
+}
+
+bool heightfield_history_create(HeightfieldHistory       *history,
+                                const Heightfield        *heightfield,
+                                const HeightfieldStorage *storage,
+                                Arena                    *arena) {
+  memset(history, 0, sizeof(HeightfieldHistory));
+  history->tile_count = heightfield_tile_count(heightfield);
+
+  // Layer payloads are packed back to back, each rounded up to keep 16-byte alignment
+  size_t payload_bytes = 0;
+  for(u32 layer = 0; layer < HEIGHTFIELD_LAYER_COUNT; ++layer) {
+    history->storage[layer]      = storage ? storage[layer] : HEIGHTFIELD_STORAGE_F32;
+    history->layer_offset[layer] = payload_bytes;
+    payload_bytes += (HEIGHTFIELD_TILE_CELLS * heightfield_storage_bytes(history->storage[layer]) + 15) & ~(size_t)15;
+  }
+
+  size_t tile_bytes = sizeof(HeightfieldTile) + payload_bytes;
+  pool_init(&history->tile_pool, arena, tile_bytes, 16);
+  pool_init(&history->table_pool, arena, history->tile_count * sizeof(HeightfieldTile *), ALIGNOF_TYPE(void *));
+
+  history->base = ARENA_PUSH_ARRAY(arena, HeightfieldTile *, history->tile_count);
+  if(!history->base) {
+    LOG_ERROR("Failed to allocate heightfield history");
+    return false;
+  }
+  memset(history->base, 0, history->tile_count * sizeof(HeightfieldTile *));
+
+  return true;
+}
+
+bool heightfield_history_snapshot(HeightfieldHistory *history, Heightfield *heightfield, HeightfieldSnapshot *out) {
+  *out = HeightfieldSnapshot{};
+  if(heightfield_tile_count(heightfield) != history->tile_count) {
+    LOG_ERROR("Heightfield history was created for a different grid");
+    return false;
+  }
+
+  HeightfieldTile **tiles = (HeightfieldTile **)pool_alloc(&history->table_pool);
+  if(!tiles) {
+    return false;
+  }
+
+  history->tiles_copied = 0;
+  for(u32 i = 0; i < history->tile_count; ++i) {
+    // Dirty tiles get a fresh copy; the old one stays with whichever snapshots hold it
+    if(heightfield->tile_dirty[i] || !history->base[i]) {
+      HeightfieldTile *tile = (HeightfieldTile *)pool_alloc(&history->tile_pool);
+      if(!tile) {
+        for(u32 j = 0; j < i; ++j) {
+          heightfield_tile_release(history, tiles[j]);
+        }
+        pool_free(&history->table_pool, tiles);
+        return false;
+      }
+
+      tile->refcount = 1;
+      heightfield_tile_capture(history, heightfield, i, tile);
+      heightfield_tile_release(history, history->base[i]);
+      history->base[i]           = tile;
+      heightfield->tile_dirty[i] = 0;
+      history->tiles_copied++;
+    }
+
+    tiles[i] = history->base[i];
+    heightfield_tile_retain(tiles[i]);
+  }
+
+  out->tiles      = tiles;
+  out->tile_count = history->tile_count;
+  return true;
+}
+
+void heightfield_history_restore(HeightfieldHistory        *history,
+                                 Heightfield               *heightfield,
+                                 const HeightfieldSnapshot *snapshot) {
+  if(!snapshot->tiles || snapshot->tile_count != history->tile_count) {
+    LOG_ERROR("Snapshot does not belong to this heightfield history");
+    return;
+  }
+
+  history->tiles_copied = 0;
+  for(u32 i = 0; i < history->tile_count; ++i) {
+    HeightfieldTile *tile = snapshot->tiles[i];
+    if(!heightfield->tile_dirty[i] && history->base[i] == tile) {
+      continue;
+    }
+
+    heightfield_tile_apply(history, heightfield, i, tile);
+    heightfield_tile_retain(tile);
+    heightfield_tile_release(history, history->base[i]);
+    history->base[i]           = tile;
+    heightfield->tile_dirty[i] = 0;
+    heightfield_mark_tile_changed(heightfield, HEIGHTFIELD_LAYER_BITS_ALL, i);
+    history->tiles_copied++;
+  }
+}
+
+void heightfield_history_release(HeightfieldHistory *history, HeightfieldSnapshot *snapshot) {
+  if(!snapshot->tiles) {
+    return;
+  }
+
+  for(u32 i = 0; i < snapshot->tile_count; ++i) {
+    heightfield_tile_release(history, snapshot->tiles[i]);
+  }
+  pool_free(&history->table_pool, snapshot->tiles);
+  *snapshot = HeightfieldSnapshot{};
+}
@@ -0,0 +1,55 @@
+#ifndef HEIGHTFIELD_HISTORY_H
+#define HEIGHTFIELD_HISTORY_H
+
+#include "memory/arena.h"
+#include "memory/pool.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Copy-on-write history of the heightfield layers for undo and branching.
+// Snapshots are tables of reference-counted tiles. A tile that has not been written
+// since the previous snapshot is shared rather than copied, so a snapshot costs one
+// pointer per tile plus a copy of each dirty tile. Tile memory is recycled through a pool.
+// Each layer is stored in its own HeightfieldStorage format, converted on capture and restore.
+
+// Every layer of one HEIGHTFIELD_TILE_SIZE^2 block, layer-major; the data follows the header
+typedef struct HeightfieldTile {
+  u32 refcount;
+  u32 reserved;
+  f32 offset[HEIGHTFIELD_LAYER_COUNT]; // unorm16 layers: value = offset + q * scale
+  f32 scale[HEIGHTFIELD_LAYER_COUNT];
+} HeightfieldTile;
+
+typedef struct HeightfieldSnapshot {
+  HeightfieldTile **tiles;
+  u32               tile_count;
+} HeightfieldSnapshot;
+
+typedef struct HeightfieldHistory {
+  HeightfieldStorage storage[HEIGHTFIELD_LAYER_COUNT];
+  size_t             layer_offset[HEIGHTFIELD_LAYER_COUNT]; // Byte offset of each layer in a tile payload
+  Pool               tile_pool;
+  Pool               table_pool; // Tile tables of snapshots
+  HeightfieldTile  **base;       // Tiles the live layers match wherever they are not dirty
+  u32                tile_count;
+  u32                tiles_copied; // Tiles copied by the last snapshot or restore
+} HeightfieldHistory;
+
+// storage selects the format of each layer; NULL keeps every layer in f32
+bool heightfield_history_create(HeightfieldHistory       *history,
+                                const Heightfield        *heightfield,
+                                const HeightfieldStorage *storage,
+                                Arena                    *arena);
+
+// Capture the live layers and clear the dirty flags
+bool heightfield_history_snapshot(HeightfieldHistory *history, Heightfield *heightfield, HeightfieldSnapshot *out);
+
+// Make the live layers equal to a snapshot, copying only tiles that differ from it
+void heightfield_history_restore(HeightfieldHistory        *history,
+                                 Heightfield               *heightfield,
+                                 const HeightfieldSnapshot *snapshot);
+
+// Drop a snapshot; tiles no other snapshot references return to the pool
+void heightfield_history_release(HeightfieldHistory *history, HeightfieldSnapshot *snapshot);
+
+#endif // HEIGHTFIELD_HISTORY_H
@@ -0,0 +1,236 @@
+#include "heightfield_ray.h"
+#include "core/job.h"
+#include "math/simd.h"
+#include "utils/macros.h"
+#include <math.h>
+
+// Slack on the barycentric tests so rays through shared edges hit one of the triangles
+#define HEIGHTFIELD_RAY_EDGE_EPSILON 1e-5f
+
+// Directions below this per axis are nudged so slab reciprocals stay finite
+#define HEIGHTFIELD_RAY_MIN_DIRECTION 1e-20f
+
+// Pending siblings per level plus the root
+#define HEIGHTFIELD_RAY_STACK_SIZE (3 * HEIGHT_PYRAMID_MAX_LEVELS + 1)
+
+typedef struct HeightfieldRayPacket {
+  F32x4 ox, oy, oz;
+  F32x4 dx, dy, dz;
+  F32x4 inv_x, inv_y, inv_z;
+  F32x4 best; // Nearest hit so far; unused lanes start negative and never hit
+  U32x4 hit;
+} HeightfieldRayPacket;
+
+typedef struct HeightfieldRayNode {
+  u32 level;
+  u32 x;
+  u32 y;
+} HeightfieldRayNode;
+
+typedef struct HeightfieldRayJob {
+  const HeightPyramid  *pyramid;
+  const Heightfield    *heightfield;
+  const HeightfieldRay *rays;
+  u32                   count;
+  HeightfieldHit       *hits;
+} HeightfieldRayJob;
+
+static f32 heightfield_ray_safe_inverse(f32 d) {
+  if(fabsf(d) < HEIGHTFIELD_RAY_MIN_DIRECTION) {
+    d = d < 0.0f ? -HEIGHTFIELD_RAY_MIN_DIRECTION : HEIGHTFIELD_RAY_MIN_DIRECTION;
+  }
+  return 1.0f / d;
+}
+
+// Lanes of the packet that can reach the box before their nearest hit
+static u32 heightfield_ray_box(const HeightfieldRayPacket *packet, f32 x0, f32 y0, f32 z0, f32 x1, f32 y1, f32 z1) {
+  F32x4 tx0 = f32x4_mul(f32x4_sub(f32x4_set1(x0), packet->ox), packet->inv_x);
+  F32x4 tx1 = f32x4_mul(f32x4_sub(f32x4_set1(x1), packet->ox), packet->inv_x);
+  F32x4 ty0 = f32x4_mul(f32x4_sub(f32x4_set1(y0), packet->oy), packet->inv_y);
+  F32x4 ty1 = f32x4_mul(f32x4_sub(f32x4_set1(y1), packet->oy), packet->inv_y);
+  F32x4 tz0 = f32x4_mul(f32x4_sub(f32x4_set1(z0), packet->oz), packet->inv_z);
+  F32x4 tz1 = f32x4_mul(f32x4_sub(f32x4_set1(z1), packet->oz), packet->inv_z);
+
+  F32x4 enter = f32x4_max(f32x4_max(f32x4_min(tx0, tx1), f32x4_min(ty0, ty1)), f32x4_min(tz0, tz1));
+  F32x4 leave = f32x4_min(f32x4_min(f32x4_max(tx0, tx1), f32x4_max(ty0, ty1)), f32x4_max(tz0, tz1));
+  enter       = f32x4_max(enter, f32x4_set1(0.0f));
+  leave       = f32x4_min(leave, packet->best);
+  return u32x4_movemask(f32x4_le(enter, leave));
+}
+
+// Moller-Trumbore against one triangle for all four rays
+static void heightfield_ray_triangle(HeightfieldRayPacket *packet, const f32 a[3], const f32 b[3], const f32 c[3]) {
+  F32x4 e1x = f32x4_set1(b[0] - a[0]);
+  F32x4 e1y = f32x4_set1(b[1] - a[1]);
+  F32x4 e1z = f32x4_set1(b[2] - a[2]);
+  F32x4 e2x = f32x4_set1(c[0] - a[0]);
+  F32x4 e2y = f32x4_set1(c[1] - a[1]);
+  F32x4 e2z = f32x4_set1(c[2] - a[2]);
+
+  F32x4 px  = f32x4_sub(f32x4_mul(packet->dy, e2z), f32x4_mul(packet->dz, e2y));
+  F32x4 py  = f32x4_sub(f32x4_mul(packet->dz, e2x), f32x4_mul(packet->dx, e2z));
+  F32x4 pz  = f32x4_sub(f32x4_mul(packet->dx, e2y), f32x4_mul(packet->dy, e2x));
+  F32x4 det = f32x4_add(f32x4_add(f32x4_mul(e1x, px), f32x4_mul(e1y, py)), f32x4_mul(e1z, pz));
+  F32x4 inv = f32x4_div(f32x4_set1(1.0f), det);
+
+  F32x4 sx = f32x4_sub(packet->ox, f32x4_set1(a[0]));
+  F32x4 sy = f32x4_sub(packet->oy, f32x4_set1(a[1]));
+  F32x4 sz = f32x4_sub(packet->oz, f32x4_set1(a[2]));
+  F32x4 u  = f32x4_mul(f32x4_add(f32x4_add(f32x4_mul(sx, px), f32x4_mul(sy, py)), f32x4_mul(sz, pz)), inv);
+
+  F32x4 qx = f32x4_sub(f32x4_mul(sy, e1z), f32x4_mul(sz, e1y));
+  F32x4 qy = f32x4_sub(f32x4_mul(sz, e1x), f32x4_mul(sx, e1z));
+  F32x4 qz = f32x4_sub(f32x4_mul(sx, e1y), f32x4_mul(sy, e1x));
+  F32x4 v  = f32x4_mul(
+    f32x4_add(f32x4_add(f32x4_mul(packet->dx, qx), f32x4_mul(packet->dy, qy)), f32x4_mul(packet->dz, qz)), inv);
+  F32x4 t  = f32x4_mul(f32x4_add(f32x4_add(f32x4_mul(e2x, qx), f32x4_mul(e2y, qy)), f32x4_mul(e2z, qz)), inv);
+
+  // Rays parallel to the triangle leave inf or NaN behind, which the comparisons reject
+  F32x4 low  = f32x4_set1(-HEIGHTFIELD_RAY_EDGE_EPSILON);
+  U32x4 mask = f32x4_le(low, u);
+  mask       = u32x4_and(mask, f32x4_le(low, v));
+  mask       = u32x4_and(mask, f32x4_le(f32x4_add(u, v), f32x4_set1(1.0f + HEIGHTFIELD_RAY_EDGE_EPSILON)));
+  mask       = u32x4_and(mask, f32x4_le(f32x4_set1(0.0f), t));
+  mask       = u32x4_and(mask, f32x4_lt(t, packet->best));
+  if(u32x4_movemask(mask) == 0) {
+    return;
+  }
+
+  packet->best = u32x4_as_f32x4(u32x4_select(mask, f32x4_as_u32x4(t), f32x4_as_u32x4(packet->best)));
+  packet->hit  = u32x4_or(packet->hit, mask);
+}
+
+// Exact test of the up to 2x2 cells under a level 0 node
+static void heightfield_ray_leaf(HeightfieldRayPacket *packet, const Heightfield *heightfield, u32 x, u32 y) {
+  const f32 *height = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  u32        width  = heightfield->width;
+  u32        cx1    = MIN(2 * x + 1, width - 2);
+  u32        cy1    = MIN(2 * y + 1, heightfield->height - 2);
+
+  for(u32 cy = 2 * y; cy <= cy1; ++cy) {
+    for(u32 cx = 2 * x; cx <= cx1; ++cx) {
+      const f32 *row    = height + (size_t)cy * width + cx;
+      f32        p00[3] = {(f32)cx, (f32)cy, row[0]};
+      f32        p10[3] = {(f32)(cx + 1), (f32)cy, row[1]};
+      f32        p01[3] = {(f32)cx, (f32)(cy + 1), row[width]};
+      f32        p11[3] = {(f32)(cx + 1), (f32)(cy + 1), row[width + 1]};
+      heightfield_ray_triangle(packet, p00, p10, p11);
+      heightfield_ray_triangle(packet, p00, p11, p01);
+    }
+  }
+}
+
+static void heightfield_ray_packet(const HeightfieldRayJob *job, u32 first) {
+  const HeightPyramid *pyramid     = job->pyramid;
+  const Heightfield   *heightfield = job->heightfield;
+  u32                  lanes       = MIN(job->count - first, (u32)SIMD_WIDTH);
+
+  // Unused lanes repeat the first ray with a negative range
+  f32 o[3][4], d[3][4], inv[3][4], best[4];
+  for(u32 i = 0; i < SIMD_WIDTH; ++i) {
+    const HeightfieldRay *ray = &job->rays[first + (i < lanes ? i : 0)];
+    for(u32 axis = 0; axis < 3; ++axis) {
+      o[axis][i]   = ray->origin[axis];
+      d[axis][i]   = ray->direction[axis];
+      inv[axis][i] = heightfield_ray_safe_inverse(ray->direction[axis]);
+    }
+    best[i] = i < lanes ? ray->max_t : -1.0f;
+  }
+
+  HeightfieldRayPacket packet = {
+    .ox    = f32x4_load(o[0]),
+    .oy    = f32x4_load(o[1]),
+    .oz    = f32x4_load(o[2]),
+    .dx    = f32x4_load(d[0]),
+    .dy    = f32x4_load(d[1]),
+    .dz    = f32x4_load(d[2]),
+    .inv_x = f32x4_load(inv[0]),
+    .inv_y = f32x4_load(inv[1]),
+    .inv_z = f32x4_load(inv[2]),
+    .best  = f32x4_load(best),
+    .hit   = u32x4_set1(0),
+  };
+
+  // Children are visited near to far along the first ray's direction
+  bool flip_x = d[0][0] < 0.0f;
+  bool flip_y = d[1][0] < 0.0f;
+
+  HeightfieldRayNode stack[HEIGHTFIELD_RAY_STACK_SIZE];
+  u32                depth = 0;
+  if(heightfield->width >= 2 && heightfield->height >= 2) {
+    stack[depth++] = HeightfieldRayNode{pyramid->level_count - 1, 0, 0};
+  }
+
+  const f32 last_x = (f32)(heightfield->width - 1);
+  const f32 last_y = (f32)(heightfield->height - 1);
+  while(depth > 0) {
+    HeightfieldRayNode        node  = stack[--depth];
+    const HeightPyramidLevel *level = &pyramid->levels[node.level];
+    size_t                    index = (size_t)node.y * level->width + node.x;
+    f32                       span  = (f32)(2u << node.level);
+    f32                       x0    = (f32)node.x * span;
+    f32                       y0    = (f32)node.y * span;
+    if(!heightfield_ray_box(&packet, x0, y0, level->min[index], MIN(x0 + span, last_x), MIN(y0 + span, last_y),
+                            level->max[index])) {
+      continue;
+    }
+
+    if(node.level == 0) {
+      heightfield_ray_leaf(&packet, heightfield, node.x, node.y);
+      continue;
+    }
+
+    // Push far children first so the nearest one is popped next
+    const HeightPyramidLevel *child = &pyramid->levels[node.level - 1];
+    for(u32 j = 0; j < 2; ++j) {
+      u32 cy = 2 * node.y + (flip_y ? j : 1 - j);
+      if(cy >= child->height) {
+        continue;
+      }
+      for(u32 i = 0; i < 2; ++i) {
+        u32 cx = 2 * node.x + (flip_x ? i : 1 - i);
+        if(cx < child->width) {
+          stack[depth++] = HeightfieldRayNode{node.level - 1, cx, cy};
+        }
+      }
+    }
+  }
+
+  u32 hit[4];
+  f32 t[4];
+  u32x4_store(hit, packet.hit);
+  f32x4_store(t, packet.best);
+  for(u32 i = 0; i < lanes; ++i) {
+    HeightfieldHit *out = &job->hits[first + i];
+    out->hit            = hit[i] != 0;
+    out->t              = out->hit ? t[i] : job->rays[first + i].max_t;
+    for(u32 axis = 0; axis < 3; ++axis) {
+      out->position[axis] = o[axis][i] + d[axis][i] * out->t;
+    }
+  }
+}
+
+static void heightfield_ray_packets(void *user, u32 begin, u32 end, u32 worker) {
+  const HeightfieldRayJob *job = (const HeightfieldRayJob *)user;
+  UNUSED(worker);
+
+  for(u32 packet = begin; packet < end; ++packet) {
+    heightfield_ray_packet(job, packet * SIMD_WIDTH);
+  }
+}
+
+void heightfield_ray_cast(const HeightPyramid  *pyramid,
+                          const Heightfield    *heightfield,
+                          const HeightfieldRay *rays,
+                          u32                   count,
+                          HeightfieldHit       *hits) {
+  HeightfieldRayJob job = {
+    .pyramid     = pyramid,
+    .heightfield = heightfield,
+    .rays        = rays,
+    .count       = count,
+    .hits        = hits,
+  };
+  u32 packets = (count + SIMD_WIDTH - 1) / SIMD_WIDTH;
+  job_parallel_for(packets, HEIGHTFIELD_RAY_PACKETS_PER_JOB, heightfield_ray_packets, &job);
+}
@@ -0,0 +1,41 @@
+#ifndef HEIGHTFIELD_RAY_H
+#define HEIGHTFIELD_RAY_H
+
+#include "simulation/height_pyramid.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Ray casts against the height layer for picking and line-of-sight queries. Rays are given
+// in grid space: x and y in samples, z is height. Each cell is two triangles split along
+// the diagonal from sample (x, y) to (x + 1, y + 1).
+//
+// Rays are traced in packets of four down the max pyramid: a node is skipped once no ray
+// of the packet can reach its box before its current nearest hit, and only the cells of
+// surviving leaves are intersected exactly. Packets of nearby, similar rays such as a pick
+// and its neighbours or a fan of sight lines share most of the traversal.
+
+// Packets per job when a batch is split across threads
+#define HEIGHTFIELD_RAY_PACKETS_PER_JOB 16
+
+typedef struct HeightfieldRay {
+  f32 origin[3];
+  f32 direction[3]; // Need not be normalized; t is measured in multiples of it
+  f32 max_t;        // Line of sight from a to b: direction = b - a, max_t = 1
+} HeightfieldRay;
+
+// On a miss t is max_t and position is the end of the ray
+typedef struct HeightfieldHit {
+  f32  position[3];
+  f32  t;
+  bool hit;
+} HeightfieldHit;
+
+// Trace count rays, writing one hit per ray. The pyramid must be up to date with the
+// heightfield. Large batches run on the job system.
+void heightfield_ray_cast(const HeightPyramid  *pyramid,
+                          const Heightfield    *heightfield,
+                          const HeightfieldRay *rays,
+                          u32                   count,
+                          HeightfieldHit       *hits);
+
+#endif // HEIGHTFIELD_RAY_H
@@ -0,0 +1,262 @@
+#include "heightfield_sample.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "math/simd.h"
+#include "utils/macros.h"
+#include <string.h>
+
+// Catmull-Rom tap weights as cubic coefficients, highest power first
+static const f32 HEIGHTFIELD_SAMPLE_CATMULL_ROM[4][4] = {
+  {-0.5f, 1.0f, -0.5f, 0.0f},
+  {1.5f, -2.5f, 0.0f, 1.0f},
+  {-1.5f, 2.0f, 0.5f, 0.0f},
+  {0.5f, -0.5f, 0.0f, 0.0f},
+};
+
+typedef struct HeightfieldSampleJob {
+  const Heightfield        *heightfield;
+  HeightfieldFilter         filter;
+  f32                       inv_cell_size;
+  u32                       tiles_x;
+  const f32                *gx; // Grid coordinates in tile order, clamped to the grid
+  const f32                *gy;
+  const u32                *tile;  // Tile of each sorted query
+  const u32                *order; // Caller's index of each sorted query
+  const HeightfieldSamples *out;
+} HeightfieldSampleJob;
+
+static F32x4 heightfield_sample_madd(F32x4 a, F32x4 b, F32x4 c) { return f32x4_add(f32x4_mul(a, b), c); }
+
+// Tap weights and their derivatives at fraction t
+static u32 heightfield_sample_weights(HeightfieldFilter filter, F32x4 t, F32x4 w[4], F32x4 dw[4]) {
+  if(filter == HEIGHTFIELD_FILTER_BILINEAR) {
+    w[0]  = f32x4_sub(f32x4_set1(1.0f), t);
+    w[1]  = t;
+    dw[0] = f32x4_set1(-1.0f);
+    dw[1] = f32x4_set1(1.0f);
+    return 2;
+  }
+
+  for(u32 k = 0; k < 4; ++k) {
+    const f32 *c = HEIGHTFIELD_SAMPLE_CATMULL_ROM[k];
+    w[k]         = heightfield_sample_madd(f32x4_set1(c[0]), t, f32x4_set1(c[1]));
+    w[k]         = heightfield_sample_madd(w[k], t, f32x4_set1(c[2]));
+    w[k]         = heightfield_sample_madd(w[k], t, f32x4_set1(c[3]));
+    dw[k]        = heightfield_sample_madd(f32x4_set1(3.0f * c[0]), t, f32x4_set1(2.0f * c[1]));
+    dw[k]        = heightfield_sample_madd(dw[k], t, f32x4_set1(c[2]));
+  }
+  return 4;
+}
+
+// Whether every bicubic tap of the tile's cells lies inside the grid
+static bool heightfield_sample_interior(const Heightfield *heightfield, u32 tiles_x, u32 tile) {
+  u32 x0 = (tile % tiles_x) * HEIGHTFIELD_TILE_SIZE;
+  u32 y0 = (tile / tiles_x) * HEIGHTFIELD_TILE_SIZE;
+  return x0 >= 1 && y0 >= 1 && x0 + HEIGHTFIELD_TILE_SIZE + 2 <= heightfield->width
+         && y0 + HEIGHTFIELD_TILE_SIZE + 2 <= heightfield->height;
+}
+
+// Filter up to four sorted queries starting at first; missing lanes repeat the last one
+static void heightfield_sample_group(const HeightfieldSampleJob *job, u32 first, u32 lanes, bool clamp) {
+  const Heightfield *heightfield = job->heightfield;
+  const f32         *height      = heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT);
+  u32                width       = heightfield->width;
+
+  f32 x[4], y[4];
+  u32 ix[4], iy[4];
+  for(u32 i = 0; i < SIMD_WIDTH; ++i) {
+    u32 slot = first + MIN(i, lanes - 1);
+    x[i]     = job->gx[slot];
+    y[i]     = job->gy[slot];
+    ix[i]    = MIN((u32)x[i], width - 2);
+    iy[i]    = MIN((u32)y[i], heightfield->height - 2);
+  }
+
+  F32x4 wx[4], dwx[4], wy[4], dwy[4];
+  F32x4 tx   = f32x4_sub(f32x4_load(x), f32x4_from_u32x4(u32x4_load(ix)));
+  F32x4 ty   = f32x4_sub(f32x4_load(y), f32x4_from_u32x4(u32x4_load(iy)));
+  u32   taps = heightfield_sample_weights(job->filter, tx, wx, dwx);
+  heightfield_sample_weights(job->filter, ty, wy, dwy);
+
+  // Gather the tap footprint lane by lane, tap-major so each tap loads as one vector
+  i32 offset = taps == 4 ? -1 : 0;
+  f32 samples[16][4];
+  for(u32 i = 0; i < SIMD_WIDTH; ++i) {
+    if(!clamp) {
+      const f32 *base = height + ((i64)iy[i] + offset) * width + (i64)ix[i] + offset;
+      for(u32 j = 0; j < taps; ++j) {
+        for(u32 k = 0; k < taps; ++k) {
+          samples[j * taps + k][i] = base[(size_t)j * width + k];
+        }
+      }
+      continue;
+    }
+    for(u32 j = 0; j < taps; ++j) {
+      i64        row  = CLAMP((i64)iy[i] + offset + j, (i64)0, (i64)heightfield->height - 1);
+      const f32 *line = height + row * width;
+      for(u32 k = 0; k < taps; ++k) {
+        samples[j * taps + k][i] = line[CLAMP((i64)ix[i] + offset + k, (i64)0, (i64)width - 1)];
+      }
+    }
+  }
+
+  // Separable filter: each row is filtered along x for the value and its x derivative,
+  // then the rows are combined along y
+  F32x4 h   = f32x4_set1(0.0f);
+  F32x4 dhx = f32x4_set1(0.0f);
+  F32x4 dhy = f32x4_set1(0.0f);
+  for(u32 j = 0; j < taps; ++j) {
+    F32x4 row   = f32x4_set1(0.0f);
+    F32x4 row_d = f32x4_set1(0.0f);
+    for(u32 k = 0; k < taps; ++k) {
+      F32x4 sample = f32x4_load(samples[j * taps + k]);
+      row          = heightfield_sample_madd(wx[k], sample, row);
+      row_d        = heightfield_sample_madd(dwx[k], sample, row_d);
+    }
+    h   = heightfield_sample_madd(wy[j], row, h);
+    dhx = heightfield_sample_madd(wy[j], row_d, dhx);
+    dhy = heightfield_sample_madd(dwy[j], row, dhy);
+  }
+
+  F32x4 inv_cell_size = f32x4_set1(job->inv_cell_size);
+  F32x4 grad_x        = f32x4_mul(dhx, inv_cell_size);
+  F32x4 grad_z        = f32x4_mul(dhy, inv_cell_size);
+  F32x4 grad_2        = heightfield_sample_madd(grad_x, grad_x, f32x4_mul(grad_z, grad_z));
+
+  // Unit normal of y = h(x, z): (-dh/dx, 1, -dh/dz) / sqrt(1 + |grad|^2)
+  F32x4 ny = f32x4_div(f32x4_set1(1.0f), f32x4_sqrt(f32x4_add(f32x4_set1(1.0f), grad_2)));
+  F32x4 nx = f32x4_mul(f32x4_sub(f32x4_set1(0.0f), grad_x), ny);
+  F32x4 nz = f32x4_mul(f32x4_sub(f32x4_set1(0.0f), grad_z), ny);
+
+  f32 out_h[4], out_nx[4], out_ny[4], out_nz[4], out_slope[4];
+  f32x4_store(out_h, h);
+  f32x4_store(out_nx, nx);
+  f32x4_store(out_ny, ny);
+  f32x4_store(out_nz, nz);
+  f32x4_store(out_slope, f32x4_sqrt(grad_2));
+
+  const HeightfieldSamples *out = job->out;
+  for(u32 i = 0; i < lanes; ++i) {
+    u32 index          = job->order[first + i];
+    out->height[index] = out_h[i];
+    if(out->normal) {
+      out->normal[3 * (size_t)index + 0] = out_nx[i];
+      out->normal[3 * (size_t)index + 1] = out_ny[i];
+      out->normal[3 * (size_t)index + 2] = out_nz[i];
+    }
+    if(out->slope) {
+      out->slope[index] = out_slope[i];
+    }
+  }
+}
+
+static void heightfield_sample_range(void *user, u32 begin, u32 end, u32 worker) {
+  const HeightfieldSampleJob *job = (const HeightfieldSampleJob *)user;
+  UNUSED(worker);
+
+  // Runs of one tile share the decision whether taps need clamping
+  for(u32 run = begin; run < end;) {
+    u32 tile    = job->tile[run];
+    u32 run_end = run + 1;
+    while(run_end < end && job->tile[run_end] == tile) {
+      run_end++;
+    }
+
+    bool clamp = job->filter == HEIGHTFIELD_FILTER_BICUBIC
+                 && !heightfield_sample_interior(job->heightfield, job->tiles_x, tile);
+    for(u32 first = run; first < run_end; first += SIMD_WIDTH) {
+      heightfield_sample_group(job, first, MIN(run_end - first, (u32)SIMD_WIDTH), clamp);
+    }
+    run = run_end;
+  }
+}
+
+// Grid coordinates of a world position, clamped to the grid (NaN goes to 0)
+static void heightfield_sample_grid(const HeightfieldPlacement *placement,
+                                    f32                         max_x,
+                                    f32                         max_y,
+                                    f32                         x,
+                                    f32                         z,
+                                    f32                        *out_x,
+                                    f32                        *out_y) {
+  f32 gx = (x - placement->origin_x) / placement->cell_size;
+  f32 gy = (z - placement->origin_z) / placement->cell_size;
+  *out_x = gx > 0.0f ? MIN(gx, max_x) : 0.0f;
+  *out_y = gy > 0.0f ? MIN(gy, max_y) : 0.0f;
+}
+
+bool heightfield_sample(const Heightfield          *heightfield,
+                        const HeightfieldPlacement *placement,
+                        HeightfieldFilter           filter,
+                        const f32                  *x,
+                        const f32                  *z,
+                        u32                         count,
+                        const HeightfieldSamples   *out) {
+  if(count == 0) {
+    return true;
+  }
+  if(!heightfield || !placement || !x || !z || !out || !out->height) {
+    return false;
+  }
+  if(heightfield->width < 2 || heightfield->height < 2 || !(placement->cell_size > 0.0f)) {
+    LOG_ERROR("Cannot sample a %ux%u heightfield with cell size %f", heightfield->width, heightfield->height,
+              placement->cell_size);
+    return false;
+  }
+
+  // Bucket queries by the tile of their cell with a counting sort
+  u32 tiles_x    = (heightfield->width + HEIGHTFIELD_TILE_SIZE - 1) / HEIGHTFIELD_TILE_SIZE;
+  u32 tiles_y    = (heightfield->height + HEIGHTFIELD_TILE_SIZE - 1) / HEIGHTFIELD_TILE_SIZE;
+  u32 tile_count = tiles_x * tiles_y;
+  f32 max_x      = (f32)(heightfield->width - 1);
+  f32 max_y      = (f32)(heightfield->height - 1);
+
+  ArenaTemp temp    = arena_scratch_begin();
+  u32      *offsets = ARENA_PUSH_ARRAY(temp.arena, u32, tile_count + 1);
+  u32      *keys    = ARENA_PUSH_ARRAY(temp.arena, u32, count);
+  u32      *tiles   = ARENA_PUSH_ARRAY(temp.arena, u32, count);
+  u32      *order   = ARENA_PUSH_ARRAY(temp.arena, u32, count);
+  f32      *gx      = ARENA_PUSH_ARRAY(temp.arena, f32, count);
+  f32      *gy      = ARENA_PUSH_ARRAY(temp.arena, f32, count);
+  if(!offsets || !keys || !tiles || !order || !gx || !gy) {
+    LOG_ERROR("Failed to allocate sorting scratch for %u height samples", count);
+    arena_temp_end(temp);
+    return false;
+  }
+
+  memset(offsets, 0, (tile_count + 1) * sizeof(u32));
+  for(u32 i = 0; i < count; ++i) {
+    f32 cx;
+    f32 cy;
+    heightfield_sample_grid(placement, max_x, max_y, x[i], z[i], &cx, &cy);
+    u32 tx  = MIN((u32)cx, heightfield->width - 2) / HEIGHTFIELD_TILE_SIZE;
+    u32 ty  = MIN((u32)cy, heightfield->height - 2) / HEIGHTFIELD_TILE_SIZE;
+    keys[i] = ty * tiles_x + tx;
+    offsets[keys[i] + 1]++;
+  }
+  for(u32 tile = 0; tile < tile_count; ++tile) {
+    offsets[tile + 1] += offsets[tile];
+  }
+  for(u32 i = 0; i < count; ++i) {
+    u32 slot    = offsets[keys[i]]++;
+    order[slot] = i;
+    tiles[slot] = keys[i];
+    heightfield_sample_grid(placement, max_x, max_y, x[i], z[i], &gx[slot], &gy[slot]);
+  }
+
+  HeightfieldSampleJob job = {
+    .heightfield   = heightfield,
+    .filter        = filter,
+    .inv_cell_size = 1.0f / placement->cell_size,
+    .tiles_x       = tiles_x,
+    .gx            = gx,
+    .gy            = gy,
+    .tile          = tiles,
+    .order         = order,
+    .out           = out,
+  };
+  job_parallel_for(count, HEIGHTFIELD_SAMPLE_QUERIES_PER_JOB, heightfield_sample_range, &job);
+
+  arena_temp_end(temp);
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef HEIGHTFIELD_SAMPLE_H
+#define HEIGHTFIELD_SAMPLE_H
+
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+
+// Batched height, normal and slope queries at world-space XZ positions, e.g. for object
+// placement and scatter. Queries are bucketed by heightfield tile so each tile's samples
+// are read while cached, then filtered four at a time. Positions outside the grid clamp
+// to its border.
+
+// Sorted queries per job
+#define HEIGHTFIELD_SAMPLE_QUERIES_PER_JOB 256
+
+typedef enum HeightfieldFilter {
+  HEIGHTFIELD_FILTER_BILINEAR = 0,
+  HEIGHTFIELD_FILTER_BICUBIC, // Catmull-Rom: passes through the samples, slopes continuous across cells
+} HeightfieldFilter;
+
+// Per-query results. height is required; the others may be NULL.
+typedef struct HeightfieldSamples {
+  f32 *height;
+  f32 *normal; // Unit world-space normals as xyz triples, from the filter's analytic gradient
+  f32 *slope;  // Gradient magnitude, rise over run
+} HeightfieldSamples;
+
+// Sample count positions (x[i], z[i]). Returns false if the heightfield is smaller than
+// 2x2 or scratch memory runs out.
+bool heightfield_sample(const Heightfield          *heightfield,
+                        const HeightfieldPlacement *placement,
+                        HeightfieldFilter           filter,
+                        const f32                  *x,
+                        const f32                  *z,
+                        u32                         count,
+                        const HeightfieldSamples   *out);
+
+#endif // HEIGHTFIELD_SAMPLE_H
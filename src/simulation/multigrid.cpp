@@ -0,0 +1,360 @@
+#include "multigrid.h"
+#include "core/log.h"
+#include "utils/macros.h"
+#include <math.h>
+#include <string.h>
+
+// Operator: (A u)_ij = u_ij + alpha * sum over existing neighbours of (u_ij - u_nb).
+// Missing neighbours at the border contribute nothing, which keeps the total mass constant.
+// Every kernel works on a row range so a V-cycle can be split across frames.
+
+// One red-black Gauss-Seidel half sweep over rows [y0, y1)
+static void multigrid_smooth_rows(f32 *u, const f32 *f, u32 width, u32 height, f32 alpha, u32 color, u32 y0, u32 y1) {
+  for(u32 y = y0; y < y1; ++y) {
+    f32       *row  = u + (size_t)y * width;
+    const f32 *up   = y > 0 ? row - width : NULL;
+    const f32 *down = y + 1 < height ? row + width : NULL;
+    const f32 *rhs  = f + (size_t)y * width;
+
+    for(u32 x = (y + color) & 1; x < width; x += 2) {
+      f32 sum   = 0.0f;
+      f32 count = 0.0f;
+      if(x > 0) {
+        sum += row[x - 1];
+        count += 1.0f;
+      }
+      if(x + 1 < width) {
+        sum += row[x + 1];
+        count += 1.0f;
+      }
+      if(up) {
+        sum += up[x];
+        count += 1.0f;
+      }
+      if(down) {
+        sum += down[x];
+        count += 1.0f;
+      }
+      row[x] = (rhs[x] + alpha * sum) / (1.0f + alpha * count);
+    }
+  }
+}
+
+// r = f - A u over rows [y0, y1), returns the sum of squared residuals
+static f64 multigrid_residual_rows(
+  f32 *r, const f32 *u, const f32 *f, u32 width, u32 height, f32 alpha, u32 y0, u32 y1) {
+  f64 sum_sq = 0.0;
+  for(u32 y = y0; y < y1; ++y) {
+    const f32 *row  = u + (size_t)y * width;
+    const f32 *up   = y > 0 ? row - width : NULL;
+    const f32 *down = y + 1 < height ? row + width : NULL;
+
+    for(u32 x = 0; x < width; ++x) {
+      f32 center = row[x];
+      f32 flux   = 0.0f;
+      if(x > 0) {
+        flux += center - row[x - 1];
+      }
+      if(x + 1 < width) {
+        flux += center - row[x + 1];
+      }
+      if(up) {
+        flux += center - up[x];
+      }
+      if(down) {
+        flux += center - down[x];
+      }
+
+      size_t i = (size_t)y * width + x;
+      r[i]     = f[i] - (center + alpha * flux);
+      sum_sq += (f64)r[i] * r[i];
+    }
+  }
+  return sum_sq;
+}
+
+// Cell-centred full weighting: each coarse cell averages its (up to) 2x2 fine children
+static void multigrid_restrict_rows(const MultigridLevel *fine, MultigridLevel *coarse, u32 cy0, u32 cy1) {
+  for(u32 cy = cy0; cy < cy1; ++cy) {
+    u32 y0 = cy * 2;
+    u32 y1 = MIN(y0 + 1, fine->height - 1);
+    for(u32 cx = 0; cx < coarse->width; ++cx) {
+      u32 x0 = cx * 2;
+      u32 x1 = MIN(x0 + 1, fine->width - 1);
+
+      const f32 *r0 = fine->residual + (size_t)y0 * fine->width;
+      const f32 *r1 = fine->residual + (size_t)y1 * fine->width;
+
+      size_t ci            = (size_t)cy * coarse->width + cx;
+      coarse->rhs[ci]      = 0.25f * (r0[x0] + r0[x1] + r1[x0] + r1[x1]);
+      coarse->solution[ci] = 0.0f;
+    }
+  }
+}
+
+// Bilinear interpolation of the coarse correction onto fine rows [y0, y1)
+static void multigrid_prolong_add_rows(const MultigridLevel *coarse, MultigridLevel *fine, u32 y0, u32 y1) {
+  for(u32 y = y0; y < y1; ++y) {
+    // Fine cell centre expressed in coarse cell coordinates
+    f32 cy  = 0.5f * (f32)y - 0.25f;
+    i32 cy0 = (i32)floorf(cy);
+    f32 ty  = cy - (f32)cy0;
+    u32 ya  = (u32)CLAMP(cy0, 0, (i32)coarse->height - 1);
+    u32 yb  = (u32)CLAMP(cy0 + 1, 0, (i32)coarse->height - 1);
+
+    const f32 *row_a = coarse->solution + (size_t)ya * coarse->width;
+    const f32 *row_b = coarse->solution + (size_t)yb * coarse->width;
+    f32       *out   = fine->solution + (size_t)y * fine->width;
+
+    for(u32 x = 0; x < fine->width; ++x) {
+      f32 cx  = 0.5f * (f32)x - 0.25f;
+      i32 cx0 = (i32)floorf(cx);
+      f32 tx  = cx - (f32)cx0;
+      u32 xa  = (u32)CLAMP(cx0, 0, (i32)coarse->width - 1);
+      u32 xb  = (u32)CLAMP(cx0 + 1, 0, (i32)coarse->width - 1);
+
+      f32 top    = row_a[xa] + (row_a[xb] - row_a[xa]) * tx;
+      f32 bottom = row_b[xa] + (row_b[xb] - row_b[xa]) * tx;
+      out[x] += top + (bottom - top) * ty;
+    }
+  }
+}
+
+static bool multigrid_push_op(MultigridSolver *solver, MultigridOpKind kind, u32 level) {
+  if(solver->op_count >= MULTIGRID_MAX_OPS) {
+    return false;
+  }
+  solver->ops[solver->op_count++] = MultigridOp{
+    .kind  = (u8)kind,
+    .level = (u8)level,
+  };
+  return true;
+}
+
+static bool multigrid_push_smooth(MultigridSolver *solver, u32 level, u32 sweeps) {
+  for(u32 sweep = 0; sweep < sweeps; ++sweep) {
+    if(!multigrid_push_op(solver, MULTIGRID_OP_SMOOTH_RED, level)
+       || !multigrid_push_op(solver, MULTIGRID_OP_SMOOTH_BLACK, level)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Unroll the recursive V-cycle into a flat list of row-sliceable operations
+static bool multigrid_build_ops(MultigridSolver *solver) {
+  solver->op_count = 0;
+  u32 coarsest     = solver->level_count - 1;
+
+  for(u32 level = 0; level < coarsest; ++level) {
+    if(!multigrid_push_smooth(solver, level, solver->pre_smooth)
+       || !multigrid_push_op(solver, MULTIGRID_OP_RESIDUAL, level)
+       || !multigrid_push_op(solver, MULTIGRID_OP_RESTRICT, level)) {
+      return false;
+    }
+  }
+
+  if(!multigrid_push_smooth(solver, coarsest, solver->coarse_iterations)) {
+    return false;
+  }
+
+  for(u32 level = coarsest; level-- > 0;) {
+    if(!multigrid_push_op(solver, MULTIGRID_OP_PROLONG, level)
+       || !multigrid_push_smooth(solver, level, solver->post_smooth)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Level whose rows an operation iterates over
+static const MultigridLevel *multigrid_op_target(const MultigridSolver *solver, const MultigridOp *op) {
+  return &solver->levels[op->kind == MULTIGRID_OP_RESTRICT ? op->level + 1u : op->level];
+}
+
+static u32 multigrid_op_rows(const MultigridSolver *solver, const MultigridOp *op) {
+  return multigrid_op_target(solver, op)->height;
+}
+
+static u32 multigrid_op_width(const MultigridSolver *solver, const MultigridOp *op) {
+  return multigrid_op_target(solver, op)->width;
+}
+
+static void multigrid_run_op(MultigridSolver *solver, const MultigridOp *op, f32 alpha, u32 y0, u32 y1) {
+  MultigridLevel *level = &solver->levels[op->level];
+
+  // Grid spacing doubles per level, so the coupling to neighbours drops by 4x
+  f32 level_alpha = ldexpf(alpha, -2 * (i32)op->level);
+
+  switch((MultigridOpKind)op->kind) {
+  case MULTIGRID_OP_SMOOTH_RED:
+  case MULTIGRID_OP_SMOOTH_BLACK:
+    multigrid_smooth_rows(level->solution,
+                          level->rhs,
+                          level->width,
+                          level->height,
+                          level_alpha,
+                          op->kind == MULTIGRID_OP_SMOOTH_RED ? 0 : 1,
+                          y0,
+                          y1);
+    break;
+  case MULTIGRID_OP_RESIDUAL:
+    multigrid_residual_rows(
+      level->residual, level->solution, level->rhs, level->width, level->height, level_alpha, y0, y1);
+    break;
+  case MULTIGRID_OP_RESTRICT: multigrid_restrict_rows(level, &solver->levels[op->level + 1], y0, y1); break;
+  case MULTIGRID_OP_PROLONG: multigrid_prolong_add_rows(&solver->levels[op->level + 1], level, y0, y1); break;
+  }
+}
+
+bool multigrid_create(MultigridSolver *solver, u32 width, u32 height, Arena *arena) {
+  memset(solver, 0, sizeof(MultigridSolver));
+  solver->pre_smooth        = 2;
+  solver->post_smooth       = 2;
+  solver->coarse_iterations = 32;
+
+  u32 level_width  = width;
+  u32 level_height = height;
+
+  while(solver->level_count < MULTIGRID_MAX_LEVELS) {
+    MultigridLevel *level = &solver->levels[solver->level_count];
+    size_t          count = (size_t)level_width * level_height;
+
+    level->width    = level_width;
+    level->height   = level_height;
+    level->rhs      = ARENA_PUSH_ARRAY(arena, f32, count);
+    level->residual = ARENA_PUSH_ARRAY(arena, f32, count);
+    if(!level->rhs || !level->residual) {
+      LOG_ERROR("Failed to allocate multigrid level %u (%ux%u)", solver->level_count, level_width, level_height);
+      return false;
+    }
+
+    // The finest level solves directly into the caller's field
+    if(solver->level_count > 0) {
+      level->solution = ARENA_PUSH_ARRAY(arena, f32, count);
+      if(!level->solution) {
+        LOG_ERROR("Failed to allocate multigrid level %u (%ux%u)", solver->level_count, level_width, level_height);
+        return false;
+      }
+    }
+
+    solver->level_count++;
+
+    if(level_width / 2 < MULTIGRID_MIN_DIMENSION || level_height / 2 < MULTIGRID_MIN_DIMENSION) {
+      break;
+    }
+    level_width  = (level_width + 1) / 2;
+    level_height = (level_height + 1) / 2;
+  }
+
+  LOG_DEBUG("Multigrid solver created: %ux%u, %u levels", width, height, solver->level_count);
+  return true;
+}
+
+bool multigrid_begin(MultigridSolver *solver, f32 *field, u32 width, u32 height) {
+  if(!solver || !field || solver->level_count == 0) {
+    return false;
+  }
+
+  MultigridLevel *finest = &solver->levels[0];
+  if(finest->width != width || finest->height != height) {
+    LOG_ERROR("Multigrid solver is %ux%u, field is %ux%u", finest->width, finest->height, width, height);
+    return false;
+  }
+
+  if(!multigrid_build_ops(solver)) {
+    LOG_ERROR("Multigrid V-cycle exceeds %d operations", MULTIGRID_MAX_OPS);
+    return false;
+  }
+
+  // The current field is both the right-hand side and the initial guess
+  memcpy(finest->rhs, field, (size_t)width * height * sizeof(f32));
+  finest->solution   = field;
+  solver->op_cursor  = 0;
+  solver->row_cursor = 0;
+  return true;
+}
+
+u64 multigrid_cycle_partial(MultigridSolver *solver, f32 alpha, u64 max_cells, bool *cycle_done) {
+  *cycle_done = false;
+  if(!solver->levels[0].solution) {
+    *cycle_done = true;
+    return 0;
+  }
+
+  solver->field_y0 = 0;
+  solver->field_y1 = 0;
+
+  u64 processed = 0;
+  while(processed < max_cells) {
+    const MultigridOp *op    = &solver->ops[solver->op_cursor];
+    u32                rows  = multigrid_op_rows(solver, op);
+    u32                width = multigrid_op_width(solver, op);
+
+    // Take as many rows as fit in what is left of the request, at least one
+    u64 remaining   = max_cells - processed;
+    u64 rows_wanted = remaining / width + (remaining % width != 0 ? 1 : 0);
+    u32 y0          = solver->row_cursor;
+    u32 y1          = (u32)MIN((u64)rows, y0 + MAX(rows_wanted, (u64)1));
+
+    multigrid_run_op(solver, op, alpha, y0, y1);
+    processed += (u64)(y1 - y0) * width;
+    if(op->level == 0 && op->kind != MULTIGRID_OP_RESIDUAL && op->kind != MULTIGRID_OP_RESTRICT) {
+      bool first       = solver->field_y1 == 0;
+      solver->field_y0 = first ? y0 : MIN(solver->field_y0, y0);
+      solver->field_y1 = MAX(solver->field_y1, y1);
+    }
+    solver->row_cursor = y1;
+
+    if(y1 == rows) {
+      solver->row_cursor = 0;
+      solver->op_cursor++;
+      if(solver->op_cursor == solver->op_count) {
+        solver->op_cursor = 0;
+        *cycle_done       = true;
+        break;
+      }
+    }
+  }
+
+  return processed;
+}
+
+void multigrid_cycle(MultigridSolver *solver, f32 alpha) {
+  bool cycle_done = false;
+  while(!cycle_done) {
+    multigrid_cycle_partial(solver, alpha, UINT64_MAX, &cycle_done);
+  }
+}
+
+void multigrid_end(MultigridSolver *solver) {
+  solver->levels[0].solution = NULL;
+  solver->op_cursor          = 0;
+  solver->row_cursor         = 0;
+}
+
+f32 multigrid_residual_rms(MultigridSolver *solver, f32 alpha) {
+  MultigridLevel *finest = &solver->levels[0];
+  if(!finest->solution) {
+    return 0.0f;
+  }
+
+  f64 sum_sq = multigrid_residual_rows(
+    finest->residual, finest->solution, finest->rhs, finest->width, finest->height, alpha, 0, finest->height);
+  return (f32)sqrt(sum_sq / ((f64)finest->width * finest->height));
+}
+
+f32 multigrid_solve_diffusion(MultigridSolver *solver, f32 *field, u32 width, u32 height, f32 alpha, u32 cycles) {
+  if(!multigrid_begin(solver, field, width, height)) {
+    return 0.0f;
+  }
+
+  for(u32 cycle = 0; cycle < cycles; ++cycle) {
+    multigrid_cycle(solver, alpha);
+  }
+
+  f32 residual = multigrid_residual_rms(solver, alpha);
+  multigrid_end(solver);
+  return residual;
+}
@@ -0,0 +1,73 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "memory/arena.h"
+#include "utils/types.h"
+
+#define MULTIGRID_MAX_LEVELS 16
+
+// Coarsening stops once either dimension would drop below this
+#define MULTIGRID_MIN_DIMENSION 4
+
+// Upper bound on the flattened operations of one V-cycle
+#define MULTIGRID_MAX_OPS 512
+
+// One row-sliceable step of a V-cycle
+typedef enum MultigridOpKind {
+  MULTIGRID_OP_SMOOTH_RED = 0,
+  MULTIGRID_OP_SMOOTH_BLACK,
+  MULTIGRID_OP_RESIDUAL,
+  MULTIGRID_OP_RESTRICT, // Rows of level + 1
+  MULTIGRID_OP_PROLONG,  // Rows of level, reading level + 1
+} MultigridOpKind;
+
+typedef struct MultigridOp {
+  u8 kind;
+  u8 level;
+} MultigridOp;
+
+// One resolution level of the grid hierarchy
+typedef struct MultigridLevel {
+  f32 *solution; // Level 0 points at the caller's field during a solve
+  f32 *rhs;
+  f32 *residual;
+  u32  width;
+  u32  height;
+} MultigridLevel;
+
+// Geometric multigrid solver for implicit diffusion, (I - alpha * laplacian) u = f,
+// with zero-flux (Neumann) boundaries. Levels are allocated once and reused.
+typedef struct MultigridSolver {
+  MultigridLevel levels[MULTIGRID_MAX_LEVELS];
+  u32            level_count;
+  u32            pre_smooth;        // Red-black Gauss-Seidel sweeps before restriction
+  u32            post_smooth;       // Sweeps after prolongation
+  u32            coarse_iterations; // Sweeps on the coarsest level
+  MultigridOp    ops[MULTIGRID_MAX_OPS]; // V-cycle flattened by multigrid_begin
+  u32            op_count;
+  u32            op_cursor;  // Resume point of a partially run cycle
+  u32            row_cursor;
+  u32            field_y0; // Rows [field_y0, field_y1) of the field written by the last
+  u32            field_y1; // multigrid_cycle_partial call
+} MultigridSolver;
+
+// Build the level hierarchy for a width x height grid
+bool multigrid_create(MultigridSolver *solver, u32 width, u32 height, Arena *arena);
+
+// Advance `field` by one implicit diffusion step using `cycles` V-cycles.
+// alpha = rate * dt in cell units. Returns the RMS residual after the last cycle.
+f32 multigrid_solve_diffusion(MultigridSolver *solver, f32 *field, u32 width, u32 height, f32 alpha, u32 cycles);
+
+// Resumable form of multigrid_solve_diffusion: begin captures the right-hand side and
+// flattens the V-cycle, cycle_partial runs rows of it until about max_cells cells were
+// touched (returning the count), end releases the field. Only one solve may be in flight
+// per solver.
+bool multigrid_begin(MultigridSolver *solver, f32 *field, u32 width, u32 height);
+u64  multigrid_cycle_partial(MultigridSolver *solver, f32 alpha, u64 max_cells, bool *cycle_done);
+void multigrid_cycle(MultigridSolver *solver, f32 alpha);
+void multigrid_end(MultigridSolver *solver);
+
+// RMS of f - A u on the finest level of the solve in flight
+f32 multigrid_residual_rms(MultigridSolver *solver, f32 alpha);
+
+#endif // MULTIGRID_H
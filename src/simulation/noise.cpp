@@ -0,0 +1,476 @@
+#include "noise.h"
+#include "core/job.h"
+#include "math/rng.h"
+#include "math/simd.h"
+#include "utils/macros.h"
+#include <math.h>
+
+// Integer lattice hash (lowbias32 finalizer over the combined coordinates)
+static inline u32 noise_hash(i32 x, i32 y, u32 seed) {
+  u32 h = (u32)x * 0x8da6b343u ^ (u32)y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+// Quintic fade curve: C2-continuous interpolation between lattice points
+static inline f32 noise_fade(f32 t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+static inline f32 noise_lerp(f32 a, f32 b, f32 t) { return a + (b - a) * t; }
+
+// Map a hash to [-1, 1]
+static inline f32 noise_lattice_value(u32 h) { return (f32)(h >> 8) * (2.0f / 16777215.0f) - 1.0f; }
+
+// Eight gradient directions, looked up rather than switched on so samples do not branch
+static const f32 NOISE_GRADIENT_X[8] = {1.0f, 1.0f, -1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f};
+static const f32 NOISE_GRADIENT_Y[8] = {1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, -1.0f};
+
+// Dot product of (dx, dy) with the gradient selected by the top hash bits
+static inline f32 noise_lattice_gradient(u32 h, f32 dx, f32 dy) {
+  return NOISE_GRADIENT_X[h >> 29] * dx + NOISE_GRADIENT_Y[h >> 29] * dy;
+}
+
+static inline f32 noise_value2_inline(f32 x, f32 y, u32 seed) {
+  f32 fx = floorf(x);
+  f32 fy = floorf(y);
+  i32 ix = (i32)fx;
+  i32 iy = (i32)fy;
+  f32 u  = noise_fade(x - fx);
+  f32 v  = noise_fade(y - fy);
+
+  f32 v00 = noise_lattice_value(noise_hash(ix, iy, seed));
+  f32 v10 = noise_lattice_value(noise_hash(ix + 1, iy, seed));
+  f32 v01 = noise_lattice_value(noise_hash(ix, iy + 1, seed));
+  f32 v11 = noise_lattice_value(noise_hash(ix + 1, iy + 1, seed));
+
+  return noise_lerp(noise_lerp(v00, v10, u), noise_lerp(v01, v11, u), v);
+}
+
+static inline f32 noise_gradient2_inline(f32 x, f32 y, u32 seed) {
+  f32 fx = floorf(x);
+  f32 fy = floorf(y);
+  i32 ix = (i32)fx;
+  i32 iy = (i32)fy;
+  f32 dx = x - fx;
+  f32 dy = y - fy;
+  f32 u  = noise_fade(dx);
+  f32 v  = noise_fade(dy);
+
+  f32 g00 = noise_lattice_gradient(noise_hash(ix, iy, seed), dx, dy);
+  f32 g10 = noise_lattice_gradient(noise_hash(ix + 1, iy, seed), dx - 1.0f, dy);
+  f32 g01 = noise_lattice_gradient(noise_hash(ix, iy + 1, seed), dx, dy - 1.0f);
+  f32 g11 = noise_lattice_gradient(noise_hash(ix + 1, iy + 1, seed), dx - 1.0f, dy - 1.0f);
+
+  return noise_lerp(noise_lerp(g00, g10, u), noise_lerp(g01, g11, u), v);
+}
+
+f32 noise_value2(f32 x, f32 y, u32 seed) { return noise_value2_inline(x, y, seed); }
+
+f32 noise_gradient2(f32 x, f32 y, u32 seed) { return noise_gradient2_inline(x, y, seed); }
+
+// Lattice seed of one octave, drawn from the counter-based RNG keyed by the full 64-bit
+// seed. Each octave gets its own lattice so features do not line up across scales.
+static inline u32 noise_octave_seed(u64 seed, u32 octave) {
+  u32 words[RNG_WORDS_PER_ELEMENT];
+  rng_philox4(RngKey{.seed = seed, .stage = RNG_STAGE_NOISE_OCTAVES}, octave, 0, words);
+  return words[0];
+}
+
+// Per-octave values derived once from NoiseParams. The specialized kernels and the
+// generic path use the same numbers in the same order, so their results are identical.
+typedef struct NoiseOctaves {
+  f32 frequency[NOISE_MAX_SPECIALIZED_OCTAVES];
+  f32 amplitude[NOISE_MAX_SPECIALIZED_OCTAVES];
+  u32 seed[NOISE_MAX_SPECIALIZED_OCTAVES];
+  f32 scale; // params->amplitude
+} NoiseOctaves;
+
+static void noise_octaves_init(NoiseOctaves *octaves, const NoiseParams *params) {
+  f32 frequency = params->frequency;
+  f32 amplitude = 1.0f;
+
+  for(u32 octave = 0; octave < NOISE_MAX_SPECIALIZED_OCTAVES; ++octave) {
+    octaves->seed[octave]      = noise_octave_seed(params->seed, octave);
+    octaves->frequency[octave] = frequency;
+    octaves->amplitude[octave] = amplitude;
+    frequency *= params->lacunarity;
+    amplitude *= params->gain;
+  }
+  octaves->scale = params->amplitude;
+}
+
+template <NoiseType TYPE> static inline f32 noise_sample(f32 x, f32 y, u32 seed) {
+  if constexpr(TYPE == NOISE_TYPE_GRADIENT) {
+    return noise_gradient2_inline(x, y, seed);
+  } else {
+    return noise_value2_inline(x, y, seed);
+  }
+}
+
+// Octave sum unrolled at compile time: OCTAVE counts down to zero
+template <NoiseType TYPE, u32 OCTAVE> struct NoiseFbmUnrolled {
+  static inline f32 sum(const NoiseOctaves *o, f32 x, f32 y, f32 total) {
+    total = NoiseFbmUnrolled<TYPE, OCTAVE - 1>::sum(o, x, y, total);
+    f32 f = o->frequency[OCTAVE - 1];
+    return total + noise_sample<TYPE>(x * f, y * f, o->seed[OCTAVE - 1]) * o->amplitude[OCTAVE - 1];
+  }
+};
+
+template <NoiseType TYPE> struct NoiseFbmUnrolled<TYPE, 0> {
+  static inline f32 sum(const NoiseOctaves *, f32, f32, f32 total) { return total; }
+};
+
+// Fills count cells of row y starting at column x0
+typedef void (*NoiseRowFn)(const NoiseOctaves *octaves, f32 *out, u32 x0, u32 count, f32 y);
+
+template <NoiseType TYPE, u32 OCTAVES>
+static void noise_row(const NoiseOctaves *octaves, f32 *out, u32 x0, u32 count, f32 y) {
+  for(u32 x = 0; x < count; ++x) {
+    out[x] = NoiseFbmUnrolled<TYPE, OCTAVES>::sum(octaves, (f32)(x0 + x), y, 0.0f) * octaves->scale;
+  }
+}
+
+#define NOISE_ROW_KERNELS(TYPE)                                                                                        \
+  {noise_row<TYPE, 1>,                                                                                                 \
+   noise_row<TYPE, 2>,                                                                                                 \
+   noise_row<TYPE, 3>,                                                                                                 \
+   noise_row<TYPE, 4>,                                                                                                 \
+   noise_row<TYPE, 5>,                                                                                                 \
+   noise_row<TYPE, 6>,                                                                                                 \
+   noise_row<TYPE, 7>,                                                                                                 \
+   noise_row<TYPE, 8>}
+
+// Indexed by [type][octaves - 1]
+static const NoiseRowFn NOISE_ROW_TABLE[2][NOISE_MAX_SPECIALIZED_OCTAVES] = {
+  NOISE_ROW_KERNELS(NOISE_TYPE_VALUE),
+  NOISE_ROW_KERNELS(NOISE_TYPE_GRADIENT),
+};
+
+// Seed of an octave, from the table when it covers the octave
+static inline u32 noise_cached_seed(const NoiseParams *params, const NoiseOctaves *octaves, u32 octave) {
+  return octaves && octave < NOISE_MAX_SPECIALIZED_OCTAVES ? octaves->seed[octave]
+                                                           : noise_octave_seed(params->seed, octave);
+}
+
+// noise_fbm reusing the seeds already derived in octaves (may be NULL)
+static f32 noise_fbm_seeded(const NoiseParams *params, const NoiseOctaves *octaves, f32 x, f32 y) {
+  f32 frequency = params->frequency;
+  f32 amplitude = 1.0f;
+  f32 sum       = 0.0f;
+
+  for(u32 octave = 0; octave < params->octaves; ++octave) {
+    u32 octave_seed = noise_cached_seed(params, octaves, octave);
+    f32 fx          = x * frequency;
+    f32 fy          = y * frequency;
+    f32 n           = params->type == NOISE_TYPE_GRADIENT ? noise_gradient2_inline(fx, fy, octave_seed)
+                                                          : noise_value2_inline(fx, fy, octave_seed);
+    sum += n * amplitude;
+    frequency *= params->lacunarity;
+    amplitude *= params->gain;
+  }
+
+  return sum * params->amplitude;
+}
+
+f32 noise_fbm(const NoiseParams *params, f32 x, f32 y) { return noise_fbm_seeded(params, NULL, x, y); }
+
+template <NoiseType TYPE>
+static void noise_accumulate_row(const NoiseParams *params,
+                                 u32                first_octave,
+                                 u32                end_octave,
+                                 f32               *sums,
+                                 u32                x0,
+                                 u32                step,
+                                 u32                count,
+                                 u32                y) {
+  f32 frequency = params->frequency;
+  f32 amplitude = 1.0f;
+
+  for(u32 octave = 0; octave < end_octave; ++octave) {
+    if(octave >= first_octave) {
+      u32 octave_seed = noise_octave_seed(params->seed, octave);
+      f32 fy          = (f32)y * frequency;
+      for(u32 i = 0; i < count; ++i) {
+        sums[i] += noise_sample<TYPE>((f32)(x0 + i * step) * frequency, fy, octave_seed) * amplitude;
+      }
+    }
+    frequency *= params->lacunarity;
+    amplitude *= params->gain;
+  }
+}
+
+void noise_accumulate_octaves(const NoiseParams *params,
+                              u32                first_octave,
+                              u32                end_octave,
+                              f32               *sums,
+                              u32                x0,
+                              u32                step,
+                              u32                count,
+                              u32                y) {
+  if(params->type == NOISE_TYPE_GRADIENT) {
+    noise_accumulate_row<NOISE_TYPE_GRADIENT>(params, first_octave, end_octave, sums, x0, step, count, y);
+  } else {
+    noise_accumulate_row<NOISE_TYPE_VALUE>(params, first_octave, end_octave, sums, x0, step, count, y);
+  }
+}
+
+typedef struct NoiseFillJob {
+  const NoiseParams  *params;
+  const NoiseOctaves *octaves;
+  NoiseRowFn          row_fn; // NULL selects the generic path
+  f32                *out;
+  u32                 width;
+} NoiseFillJob;
+
+static void noise_fill_rows(void *user, u32 begin, u32 end, u32 worker) {
+  const NoiseFillJob *job = (const NoiseFillJob *)user;
+  UNUSED(worker);
+
+  for(u32 y = begin; y < end; ++y) {
+    f32 *row = job->out + (size_t)y * job->width;
+    if(job->row_fn) {
+      job->row_fn(job->octaves, row, 0, job->width, (f32)y);
+    } else {
+      for(u32 x = 0; x < job->width; ++x) {
+        row[x] = noise_fbm_seeded(job->params, job->octaves, (f32)x, (f32)y);
+      }
+    }
+  }
+}
+
+bool noise_has_specialized_kernel(const NoiseParams *params) {
+  return params->octaves >= 1 && params->octaves <= NOISE_MAX_SPECIALIZED_OCTAVES
+         && (params->type == NOISE_TYPE_VALUE || params->type == NOISE_TYPE_GRADIENT);
+}
+
+void noise_fill(const NoiseParams *params, f32 *out, u32 width, u32 height) {
+  NoiseOctaves octaves;
+  noise_octaves_init(&octaves, params);
+
+  // The kernel is picked once for the whole fill; rows then run without per-sample dispatch
+  NoiseFillJob job = {
+    .params  = params,
+    .octaves = &octaves,
+    .row_fn  = noise_has_specialized_kernel(params) ? NOISE_ROW_TABLE[params->type][params->octaves - 1] : NULL,
+    .out     = out,
+    .width   = width,
+  };
+  job_parallel_for(height, NOISE_FILL_ROWS_PER_JOB, noise_fill_rows, &job);
+}
+
+typedef struct NoiseStoreJob {
+  const NoiseParams  *params;
+  const NoiseOctaves *octaves;
+  NoiseRowFn          row_fn;
+  TileStore          *store;
+  SDL_AtomicInt       failed;
+} NoiseStoreJob;
+
+static void noise_fill_store_tiles(void *user, u32 begin, u32 end, u32 worker) {
+  NoiseStoreJob *job   = (NoiseStoreJob *)user;
+  TileStore     *store = job->store;
+  UNUSED(worker);
+
+  for(u32 tile = begin; tile < end; ++tile) {
+    f32 *data = tile_store_acquire(store, tile, TILE_STORE_DISCARD);
+    if(!data) {
+      SDL_SetAtomicInt(&job->failed, 1);
+      continue;
+    }
+
+    u32 x0   = (tile % store->tiles_x) * TILE_STORE_TILE_SIZE;
+    u32 y0   = (tile / store->tiles_x) * TILE_STORE_TILE_SIZE;
+    u32 cols = MIN((u32)TILE_STORE_TILE_SIZE, store->width - x0);
+    u32 rows = MIN((u32)TILE_STORE_TILE_SIZE, store->height - y0);
+    for(u32 y = 0; y < rows; ++y) {
+      f32 *row = data + (size_t)y * TILE_STORE_TILE_SIZE;
+      if(job->row_fn) {
+        job->row_fn(job->octaves, row, x0, cols, (f32)(y0 + y));
+      } else {
+        for(u32 x = 0; x < cols; ++x) {
+          row[x] = noise_fbm_seeded(job->params, job->octaves, (f32)(x0 + x), (f32)(y0 + y));
+        }
+      }
+    }
+
+    tile_store_release(store, tile);
+  }
+}
+
+bool noise_fill_store(const NoiseParams *params, TileStore *store) {
+  NoiseOctaves octaves;
+  noise_octaves_init(&octaves, params);
+
+  NoiseStoreJob job = {};
+  job.params        = params;
+  job.octaves       = &octaves;
+  job.row_fn        = noise_has_specialized_kernel(params) ? NOISE_ROW_TABLE[params->type][params->octaves - 1] : NULL;
+  job.store         = store;
+  SDL_SetAtomicInt(&job.failed, 0);
+
+  // Tiles are generated in file order, one per job, so only a few are pinned at a time
+  job_parallel_for(tile_store_tile_count(store), 1, noise_fill_store_tiles, &job);
+  return SDL_GetAtomicInt(&job.failed) == 0;
+}
+
+// Multi-seed batches: four seeds share one pass over the grid. Lattice coordinates,
+// fade weights and the coordinate half of the hash are computed once per sample; only
+// the seed half of the hash and the lattice values differ per lane.
+
+static inline U32x4 noise_hash4(i32 x, i32 y, U32x4 seed_term) {
+  U32x4 h = u32x4_xor(u32x4_set1((u32)x * 0x8da6b343u ^ (u32)y * 0xd8163841u), seed_term);
+  h       = u32x4_xor(h, u32x4_shr(h, 16));
+  h       = u32x4_mul_lo(h, u32x4_set1(0x7feb352du));
+  h       = u32x4_xor(h, u32x4_shr(h, 15));
+  h       = u32x4_mul_lo(h, u32x4_set1(0x846ca68bu));
+  h       = u32x4_xor(h, u32x4_shr(h, 16));
+  return h;
+}
+
+static inline F32x4 noise_lerp4(F32x4 a, F32x4 b, f32 t) { return f32x4_add(a, f32x4_mul(f32x4_sub(b, a), f32x4_set1(t))); }
+
+static inline F32x4 noise_lattice_value4(U32x4 h) {
+  F32x4 bits = f32x4_from_u32x4(u32x4_shr(h, 8));
+  return f32x4_sub(f32x4_mul(bits, f32x4_set1(2.0f / 16777215.0f)), f32x4_set1(1.0f));
+}
+
+// Same directions as NOISE_GRADIENT_X/Y without a gather: index bit 0 flips the sign of
+// dy (or of the axis), bit 1 flips dx (or picks the y axis), bit 2 picks axes over diagonals
+static inline F32x4 noise_lattice_gradient4(U32x4 h, f32 dx, f32 dy) {
+  U32x4 sign     = u32x4_set1(0x80000000u);
+  U32x4 flip_x   = u32x4_and(u32x4_shl(h, 1), sign);
+  U32x4 flip_y   = u32x4_and(u32x4_shl(h, 2), sign);
+  U32x4 dx_bits  = f32x4_as_u32x4(f32x4_set1(dx));
+  U32x4 dy_bits  = f32x4_as_u32x4(f32x4_set1(dy));
+  F32x4 diagonal = f32x4_add(u32x4_as_f32x4(u32x4_xor(dx_bits, flip_x)), u32x4_as_f32x4(u32x4_xor(dy_bits, flip_y)));
+  U32x4 axis     = u32x4_xor(u32x4_select(u32x4_sign_mask(u32x4_shl(h, 1)), dy_bits, dx_bits), flip_y);
+  return u32x4_as_f32x4(u32x4_select(u32x4_sign_mask(h), axis, f32x4_as_u32x4(diagonal)));
+}
+
+template <NoiseType TYPE> static inline F32x4 noise_sample4(f32 x, f32 y, U32x4 seed_term) {
+  f32 fx = floorf(x);
+  f32 fy = floorf(y);
+  i32 ix = (i32)fx;
+  i32 iy = (i32)fy;
+  f32 dx = x - fx;
+  f32 dy = y - fy;
+  f32 u  = noise_fade(dx);
+  f32 v  = noise_fade(dy);
+
+  U32x4 h00 = noise_hash4(ix, iy, seed_term);
+  U32x4 h10 = noise_hash4(ix + 1, iy, seed_term);
+  U32x4 h01 = noise_hash4(ix, iy + 1, seed_term);
+  U32x4 h11 = noise_hash4(ix + 1, iy + 1, seed_term);
+
+  F32x4 c00;
+  F32x4 c10;
+  F32x4 c01;
+  F32x4 c11;
+  if constexpr(TYPE == NOISE_TYPE_GRADIENT) {
+    c00 = noise_lattice_gradient4(h00, dx, dy);
+    c10 = noise_lattice_gradient4(h10, dx - 1.0f, dy);
+    c01 = noise_lattice_gradient4(h01, dx, dy - 1.0f);
+    c11 = noise_lattice_gradient4(h11, dx - 1.0f, dy - 1.0f);
+  } else {
+    c00 = noise_lattice_value4(h00);
+    c10 = noise_lattice_value4(h10);
+    c01 = noise_lattice_value4(h01);
+    c11 = noise_lattice_value4(h11);
+  }
+
+  return noise_lerp4(noise_lerp4(c00, c10, u), noise_lerp4(c01, c11, u), v);
+}
+
+typedef struct NoiseBatchJob {
+  const NoiseParams *params;
+  const u64         *seeds;
+  u32                seed_count;
+  f32 *const        *outputs;
+  u32                width;
+} NoiseBatchJob;
+
+// Seed half of the hash for one octave of four seeds. Spare lanes repeat the last seed and are discarded.
+static void noise_seed_terms(const NoiseBatchJob *job, u32 first_seed, u32 lanes, u32 octave, u32 out[4]) {
+  for(u32 lane = 0; lane < 4; ++lane) {
+    out[lane] = noise_octave_seed(job->seeds[first_seed + MIN(lane, lanes - 1)], octave) * 0xcb1ab31fu;
+  }
+}
+
+template <NoiseType TYPE> static void noise_batch_row(const NoiseBatchJob *job, u32 first_seed, u32 y) {
+  const NoiseParams *params = job->params;
+  u32                lanes  = MIN(job->seed_count - first_seed, 4u);
+
+  // Seeds are derived once per row; octaves past the table are derived per sample
+  u32 terms[NOISE_MAX_SPECIALIZED_OCTAVES][4];
+  u32 cached = MIN(params->octaves, (u32)NOISE_MAX_SPECIALIZED_OCTAVES);
+  for(u32 octave = 0; octave < cached; ++octave) {
+    noise_seed_terms(job, first_seed, lanes, octave, terms[octave]);
+  }
+
+  f32 *rows[4];
+  for(u32 lane = 0; lane < lanes; ++lane) {
+    rows[lane] = job->outputs[first_seed + lane] + (size_t)y * job->width;
+  }
+
+  for(u32 x = 0; x < job->width; ++x) {
+    f32   frequency = params->frequency;
+    f32   amplitude = 1.0f;
+    F32x4 sum       = f32x4_set1(0.0f);
+
+    for(u32 octave = 0; octave < params->octaves; ++octave) {
+      u32 extra[4];
+      if(octave >= cached) {
+        noise_seed_terms(job, first_seed, lanes, octave, extra);
+      }
+      U32x4 seed_term = u32x4_load(octave < cached ? terms[octave] : extra);
+      F32x4 n         = noise_sample4<TYPE>((f32)x * frequency, (f32)y * frequency, seed_term);
+      sum             = f32x4_add(sum, f32x4_mul(n, f32x4_set1(amplitude)));
+      frequency *= params->lacunarity;
+      amplitude *= params->gain;
+    }
+
+    f32 values[4];
+    f32x4_store(values, f32x4_mul(sum, f32x4_set1(params->amplitude)));
+    for(u32 lane = 0; lane < lanes; ++lane) {
+      rows[lane][x] = values[lane];
+    }
+  }
+}
+
+static void noise_batch_rows(void *user, u32 begin, u32 end, u32 worker) {
+  const NoiseBatchJob *job = (const NoiseBatchJob *)user;
+  UNUSED(worker);
+
+  for(u32 y = begin; y < end; ++y) {
+    for(u32 first = 0; first < job->seed_count; first += 4) {
+      if(job->params->type == NOISE_TYPE_GRADIENT) {
+        noise_batch_row<NOISE_TYPE_GRADIENT>(job, first, y);
+      } else {
+        noise_batch_row<NOISE_TYPE_VALUE>(job, first, y);
+      }
+    }
+  }
+}
+
+void noise_fill_batch(const NoiseParams *params,
+                      const u64         *seeds,
+                      u32                seed_count,
+                      f32 *const        *outputs,
+                      u32                width,
+                      u32                height) {
+  if(seed_count == 0) {
+    return;
+  }
+
+  NoiseBatchJob job = {
+    .params     = params,
+    .seeds      = seeds,
+    .seed_count = seed_count,
+    .outputs    = outputs,
+    .width      = width,
+  };
+  job_parallel_for(height, NOISE_FILL_ROWS_PER_JOB, noise_batch_rows, &job);
+}
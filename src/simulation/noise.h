@@ -0,0 +1,67 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include "simulation/tile_store.h"
+#include "utils/types.h"
+
+// Octave counts with compile-time specialized fBm kernels; other settings use the generic loop
+#define NOISE_MAX_SPECIALIZED_OCTAVES 8
+
+// Rows per job when filling a grid
+#define NOISE_FILL_ROWS_PER_JOB 16
+
+// Lattice noise used to seed the heightfield
+typedef enum NoiseType {
+  NOISE_TYPE_VALUE = 0, // Smoothly interpolated random lattice values
+  NOISE_TYPE_GRADIENT,  // Perlin-style random lattice gradients
+} NoiseType;
+
+typedef struct NoiseParams {
+  u64       seed;
+  NoiseType type;
+  u32       octaves;    // Fractal layers summed by noise_fbm
+  f32       frequency;  // Lattice cells per heightfield cell for the first octave
+  f32       lacunarity; // Frequency multiplier between octaves
+  f32       gain;       // Amplitude multiplier between octaves
+  f32       amplitude;  // Output height scale
+} NoiseParams;
+
+// Single-octave noise in roughly [-1, 1]
+f32 noise_value2(f32 x, f32 y, u32 seed);
+f32 noise_gradient2(f32 x, f32 y, u32 seed);
+
+// Fractal sum of octaves at a heightfield cell position, scaled by amplitude
+f32 noise_fbm(const NoiseParams *params, f32 x, f32 y);
+
+// Add octaves [first_octave, end_octave) of the fBm sum at cells (x0 + i * step, y) to
+// sums[i], before the params->amplitude scale. Accumulating every octave in order and then
+// scaling gives exactly noise_fbm, so a sum can be built up over several passes.
+void noise_accumulate_octaves(const NoiseParams *params,
+                              u32                first_octave,
+                              u32                end_octave,
+                              f32               *sums,
+                              u32                x0,
+                              u32                step,
+                              u32                count,
+                              u32                y);
+
+// Whether noise_fill has an unrolled kernel for these settings
+bool noise_has_specialized_kernel(const NoiseParams *params);
+
+// Evaluate noise_fbm for every cell of a width x height grid across the job system
+void noise_fill(const NoiseParams *params, f32 *out, u32 width, u32 height);
+
+// noise_fill for a paged layer, one store tile per job. Returns false if a tile could not be paged in.
+bool noise_fill_store(const NoiseParams *params, TileStore *store);
+
+// Generate one terrain per seed in a single pass, four seeds per SIMD vector.
+// params->seed is ignored; outputs[i] receives the width x height grid for seeds[i] and
+// matches noise_fill with that seed.
+void noise_fill_batch(const NoiseParams *params,
+                      const u64         *seeds,
+                      u32                seed_count,
+                      f32 *const        *outputs,
+                      u32                width,
+                      u32                height);
+
+#endif // NOISE_H
@@ -0,0 +1,312 @@
+#include "pipeline.h"
+#include "core/log.h"
+#include "utils/hash.h"
+#include "utils/macros.h"
+#include <SDL3/SDL_timer.h>
+#include <math.h>
+#include <string.h>
+
+#define PIPELINE_LAYER_BIT(layer) (1u << (layer))
+
+static const char *PIPELINE_STAGE_NAMES[PIPELINE_STAGE_COUNT] = {"noise", "erosion", "corrosion", "derived"};
+
+static const u32 PIPELINE_STAGE_OUTPUTS[PIPELINE_STAGE_COUNT] = {
+  PIPELINE_LAYER_BIT(PIPELINE_LAYER_HEIGHT),
+  PIPELINE_LAYER_BIT(PIPELINE_LAYER_HEIGHT) | PIPELINE_LAYER_BIT(PIPELINE_LAYER_WATER)
+    | PIPELINE_LAYER_BIT(PIPELINE_LAYER_SEDIMENT),
+  PIPELINE_LAYER_BIT(PIPELINE_LAYER_HEIGHT) | PIPELINE_LAYER_BIT(PIPELINE_LAYER_DEGRADATION),
+  PIPELINE_LAYER_BIT(PIPELINE_LAYER_SLOPE) | PIPELINE_LAYER_BIT(PIPELINE_LAYER_CURVATURE),
+};
+
+// Hash of everything a stage's output depends on besides the upstream key
+static u64 pipeline_stage_hash(const Pipeline *pipeline, PipelineStageId stage, u64 hash) {
+  const PipelineParams *p = &pipeline->params;
+
+  hash = HASH_VALUE(hash, stage);
+  switch(stage) {
+  case PIPELINE_STAGE_NOISE:
+    hash = HASH_VALUE(hash, pipeline->width);
+    hash = HASH_VALUE(hash, pipeline->height);
+    hash = HASH_VALUE(hash, p->noise.seed);
+    hash = HASH_VALUE(hash, p->noise.type);
+    hash = HASH_VALUE(hash, p->noise.octaves);
+    hash = HASH_VALUE(hash, p->noise.frequency);
+    hash = HASH_VALUE(hash, p->noise.lacunarity);
+    hash = HASH_VALUE(hash, p->noise.gain);
+    hash = HASH_VALUE(hash, p->noise.amplitude);
+    break;
+  case PIPELINE_STAGE_EROSION:
+    hash = HASH_VALUE(hash, p->erosion.time_step);
+    hash = HASH_VALUE(hash, p->erosion.gravity);
+    hash = HASH_VALUE(hash, p->erosion.capacity);
+    hash = HASH_VALUE(hash, p->erosion.erosion_rate);
+    hash = HASH_VALUE(hash, p->erosion.deposition_rate);
+    hash = HASH_VALUE(hash, p->erosion.evaporation);
+    hash = HASH_VALUE(hash, p->erosion.min_slope);
+    hash = HASH_VALUE(hash, p->erosion.water_epsilon);
+    hash = HASH_VALUE(hash, p->erosion.change_threshold);
+    hash = HASH_VALUE(hash, p->erosion_rain);
+    hash = HASH_VALUE(hash, p->erosion_steps);
+    break;
+  case PIPELINE_STAGE_CORROSION:
+    hash = HASH_VALUE(hash, p->corrosion.rate);
+    hash = HASH_VALUE(hash, p->corrosion.humidity);
+    hash = HASH_VALUE(hash, p->corrosion.temperature);
+    hash = HASH_VALUE(hash, p->corrosion.salt_content);
+    break;
+  case PIPELINE_STAGE_DERIVED: hash = HASH_VALUE(hash, p->cell_size); break;
+  default: break;
+  }
+
+  return hash;
+}
+
+static void pipeline_run_noise(Pipeline *pipeline, PipelineStage *stage) {
+  noise_fill(&pipeline->params.noise, stage->layers[PIPELINE_LAYER_HEIGHT], pipeline->width, pipeline->height);
+}
+
+// Heightfield view over the erosion stage's own buffers, which it erodes in place
+static Heightfield pipeline_erosion_view(const Pipeline *pipeline, const PipelineStage *stage) {
+  Heightfield view                        = {};
+  view.layers[HEIGHTFIELD_LAYER_HEIGHT]   = stage->layers[PIPELINE_LAYER_HEIGHT];
+  view.layers[HEIGHTFIELD_LAYER_WATER]    = stage->layers[PIPELINE_LAYER_WATER];
+  view.layers[HEIGHTFIELD_LAYER_SEDIMENT] = stage->layers[PIPELINE_LAYER_SEDIMENT];
+  view.width                              = pipeline->width;
+  view.height                             = pipeline->height;
+  return view;
+}
+
+// Start from the noise heights, dry, with rain on every cell
+static void pipeline_begin_erosion(Pipeline *pipeline, PipelineStage *stage) {
+  size_t      cell_count = (size_t)pipeline->width * pipeline->height;
+  Heightfield view       = pipeline_erosion_view(pipeline, stage);
+
+  memcpy(view.layers[HEIGHTFIELD_LAYER_HEIGHT],
+         pipeline_layer(pipeline, PIPELINE_STAGE_NOISE, PIPELINE_LAYER_HEIGHT),
+         cell_count * sizeof(f32));
+  memset(view.layers[HEIGHTFIELD_LAYER_WATER], 0, cell_count * sizeof(f32));
+  memset(view.layers[HEIGHTFIELD_LAYER_SEDIMENT], 0, cell_count * sizeof(f32));
+
+  ErosionState *erosion = &pipeline->erosion;
+  erosion->params       = pipeline->params.erosion;
+  erosion_reset(erosion);
+  erosion_add_rain(erosion, &view, pipeline->params.erosion_rain);
+  pipeline->erosion_steps_done = 0;
+}
+
+// Run up to max_units tile passes of the remaining erosion steps
+static u32 pipeline_continue_erosion(Pipeline *pipeline, PipelineStage *stage, u32 max_units, bool *done) {
+  Heightfield view      = pipeline_erosion_view(pipeline, stage);
+  u32         processed = 0;
+
+  while(pipeline->erosion_steps_done < pipeline->params.erosion_steps && processed < max_units) {
+    bool step_done = false;
+    processed += erosion_step_partial(&pipeline->erosion, &view, max_units - processed, &step_done);
+    if(step_done) {
+      pipeline->erosion_steps_done++;
+    }
+  }
+
+  *done = pipeline->erosion_steps_done >= pipeline->params.erosion_steps;
+  return processed;
+}
+
+static void pipeline_run_erosion(Pipeline *pipeline, PipelineStage *stage) {
+  bool done = false;
+  pipeline_begin_erosion(pipeline, stage);
+  pipeline_continue_erosion(pipeline, stage, UINT32_MAX, &done);
+}
+
+static void pipeline_run_corrosion(Pipeline *pipeline, PipelineStage *stage) {
+  corrosion_apply(&pipeline->params.corrosion,
+                  pipeline_layer(pipeline, PIPELINE_STAGE_EROSION, PIPELINE_LAYER_HEIGHT),
+                  pipeline_layer(pipeline, PIPELINE_STAGE_EROSION, PIPELINE_LAYER_WATER),
+                  stage->layers[PIPELINE_LAYER_HEIGHT],
+                  stage->layers[PIPELINE_LAYER_DEGRADATION],
+                  pipeline->width,
+                  pipeline->height);
+}
+
+// Slope magnitude (rise over run) and Laplacian curvature with clamped borders
+static void pipeline_run_derived(Pipeline *pipeline, PipelineStage *stage) {
+  const f32 *height    = pipeline_layer(pipeline, PIPELINE_STAGE_CORROSION, PIPELINE_LAYER_HEIGHT);
+  f32       *slope     = stage->layers[PIPELINE_LAYER_SLOPE];
+  f32       *curvature = stage->layers[PIPELINE_LAYER_CURVATURE];
+  u32        width     = pipeline->width;
+  u32        rows      = pipeline->height;
+  f32        spacing   = pipeline->params.cell_size > 0.0f ? pipeline->params.cell_size : 1.0f;
+  f32        inv_2dx   = 0.5f / spacing;
+  f32        inv_dx2   = 1.0f / (spacing * spacing);
+
+  for(u32 y = 0; y < rows; ++y) {
+    const f32 *row  = height + (size_t)y * width;
+    const f32 *up   = height + (size_t)(y > 0 ? y - 1 : y) * width;
+    const f32 *down = height + (size_t)(y + 1 < rows ? y + 1 : y) * width;
+
+    for(u32 x = 0; x < width; ++x) {
+      u32 left  = x > 0 ? x - 1 : x;
+      u32 right = x + 1 < width ? x + 1 : x;
+      f32 dx    = (row[right] - row[left]) * inv_2dx;
+      f32 dy    = (down[x] - up[x]) * inv_2dx;
+
+      slope[(size_t)y * width + x]     = sqrtf(dx * dx + dy * dy);
+      curvature[(size_t)y * width + x] = (row[left] + row[right] + up[x] + down[x] - 4.0f * row[x]) * inv_dx2;
+    }
+  }
+}
+
+static void pipeline_run_stage(Pipeline *pipeline, PipelineStageId id) {
+  PipelineStage *stage = &pipeline->stages[id];
+  switch(id) {
+  case PIPELINE_STAGE_NOISE: pipeline_run_noise(pipeline, stage); break;
+  case PIPELINE_STAGE_EROSION: pipeline_run_erosion(pipeline, stage); break;
+  case PIPELINE_STAGE_CORROSION: pipeline_run_corrosion(pipeline, stage); break;
+  case PIPELINE_STAGE_DERIVED: pipeline_run_derived(pipeline, stage); break;
+  default: break;
+  }
+}
+
+bool pipeline_create(Pipeline *pipeline, const PipelineParams *params, u32 width, u32 height, Arena *arena) {
+  memset(pipeline, 0, sizeof(Pipeline));
+  pipeline->params  = *params;
+  pipeline->running = PIPELINE_STAGE_COUNT;
+  pipeline->width   = width;
+  pipeline->height  = height;
+
+  size_t cell_count = (size_t)width * height;
+  for(u32 s = 0; s < PIPELINE_STAGE_COUNT; ++s) {
+    PipelineStage *stage = &pipeline->stages[s];
+    stage->name          = PIPELINE_STAGE_NAMES[s];
+    stage->outputs       = PIPELINE_STAGE_OUTPUTS[s];
+
+    for(u32 layer = 0; layer < PIPELINE_LAYER_COUNT; ++layer) {
+      if(!(stage->outputs & PIPELINE_LAYER_BIT(layer))) {
+        continue;
+      }
+      stage->layers[layer] = ARENA_PUSH_ARRAY(arena, f32, cell_count);
+      if(!stage->layers[layer]) {
+        LOG_ERROR("Failed to allocate pipeline cache for stage %s", stage->name);
+        return false;
+      }
+    }
+  }
+
+  if(!erosion_create(&pipeline->erosion, &params->erosion, width, height, arena)) {
+    LOG_ERROR("Failed to create pipeline erosion state");
+    return false;
+  }
+
+  return true;
+}
+
+void pipeline_set_params(Pipeline *pipeline, const PipelineParams *params) {
+  pipeline->params  = *params;
+  pipeline->running = PIPELINE_STAGE_COUNT;
+}
+
+static void pipeline_finish_stage(PipelineStage *stage, u64 key, u64 elapsed_ns) {
+  stage->key   = key;
+  stage->valid = true;
+  stage->evaluations++;
+  LOG_DEBUG("Pipeline stage %s recomputed in %.2f ms", stage->name, (f64)elapsed_ns / 1e6);
+}
+
+PipelineStageId pipeline_evaluate(Pipeline *pipeline, PipelineStageId target) {
+  PipelineStageId first_dirty = PIPELINE_STAGE_COUNT;
+  u64             key         = HASH_SEED;
+
+  // Running a stage whole overwrites whatever a partial evaluation left in its buffers
+  pipeline->running = PIPELINE_STAGE_COUNT;
+
+  for(u32 s = 0; s <= (u32)target && s < PIPELINE_STAGE_COUNT; ++s) {
+    PipelineStageId id    = (PipelineStageId)s;
+    PipelineStage  *stage = &pipeline->stages[s];
+
+    // Chaining the upstream key makes any upstream change invalidate everything below it
+    key = pipeline_stage_hash(pipeline, id, key);
+    if(stage->valid && stage->key == key) {
+      continue;
+    }
+
+    u64 start_ns = SDL_GetTicksNS();
+    pipeline_run_stage(pipeline, id);
+    pipeline_finish_stage(stage, key, SDL_GetTicksNS() - start_ns);
+    if(first_dirty == PIPELINE_STAGE_COUNT) {
+      first_dirty = id;
+    }
+  }
+
+  return first_dirty;
+}
+
+u32 pipeline_evaluate_partial(Pipeline *pipeline, PipelineStageId target, u32 max_units, bool *done) {
+  u32 processed = 0;
+  u64 key       = HASH_SEED;
+  *done         = false;
+
+  for(u32 s = 0; s <= (u32)target && s < PIPELINE_STAGE_COUNT; ++s) {
+    PipelineStageId id    = (PipelineStageId)s;
+    PipelineStage  *stage = &pipeline->stages[s];
+
+    key = pipeline_stage_hash(pipeline, id, key);
+    if(stage->valid && stage->key == key) {
+      continue;
+    }
+    if(processed >= max_units) {
+      return processed;
+    }
+
+    // The stage's buffers no longer hold its cached output once it starts
+    if(pipeline->running != id) {
+      pipeline->running    = id;
+      pipeline->running_ns = 0;
+      stage->valid         = false;
+      if(id == PIPELINE_STAGE_EROSION) {
+        pipeline_begin_erosion(pipeline, stage);
+      }
+    }
+
+    u64  start_ns   = SDL_GetTicksNS();
+    bool stage_done = true;
+    if(id == PIPELINE_STAGE_EROSION) {
+      processed += pipeline_continue_erosion(pipeline, stage, max_units - processed, &stage_done);
+    } else {
+      pipeline_run_stage(pipeline, id);
+      processed++;
+    }
+    pipeline->running_ns += SDL_GetTicksNS() - start_ns;
+
+    if(!stage_done) {
+      return processed;
+    }
+    pipeline->running = PIPELINE_STAGE_COUNT;
+    pipeline_finish_stage(stage, key, pipeline->running_ns);
+  }
+
+  *done = true;
+  return processed;
+}
+
+void pipeline_adopt_noise(Pipeline *pipeline, const f32 *height) {
+  PipelineStage *stage = &pipeline->stages[PIPELINE_STAGE_NOISE];
+  if(pipeline->running == PIPELINE_STAGE_NOISE) {
+    pipeline->running = PIPELINE_STAGE_COUNT;
+  }
+
+  memcpy(stage->layers[PIPELINE_LAYER_HEIGHT], height, (size_t)pipeline->width * pipeline->height * sizeof(f32));
+  stage->key   = pipeline_stage_hash(pipeline, PIPELINE_STAGE_NOISE, HASH_SEED);
+  stage->valid = true;
+}
+
+const f32 *pipeline_layer(const Pipeline *pipeline, PipelineStageId stage, PipelineLayer layer) {
+  if(stage >= PIPELINE_STAGE_COUNT || layer >= PIPELINE_LAYER_COUNT) {
+    return NULL;
+  }
+
+  for(i32 s = (i32)stage; s >= 0; --s) {
+    if(pipeline->stages[s].layers[layer]) {
+      return pipeline->stages[s].layers[layer];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,86 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "memory/arena.h"
+#include "simulation/corrosion.h"
+#include "simulation/erosion.h"
+#include "simulation/noise.h"
+#include "utils/types.h"
+
+// Terrain generation graph: noise -> erosion -> corrosion -> derived layers.
+// Every stage caches its outputs under a key hashed from its parameters and the key of
+// the stage before it, so changing a parameter only recomputes that stage and the ones
+// downstream of it, and only once something asks for their output.
+
+// Layers passed between stages
+typedef enum PipelineLayer {
+  PIPELINE_LAYER_HEIGHT = 0,
+  PIPELINE_LAYER_WATER,
+  PIPELINE_LAYER_SEDIMENT,
+  PIPELINE_LAYER_DEGRADATION,
+  PIPELINE_LAYER_SLOPE,
+  PIPELINE_LAYER_CURVATURE,
+  PIPELINE_LAYER_COUNT
+} PipelineLayer;
+
+typedef enum PipelineStageId {
+  PIPELINE_STAGE_NOISE = 0,
+  PIPELINE_STAGE_EROSION,
+  PIPELINE_STAGE_CORROSION,
+  PIPELINE_STAGE_DERIVED,
+  PIPELINE_STAGE_COUNT
+} PipelineStageId;
+
+typedef struct PipelineParams {
+  NoiseParams     noise;
+  ErosionParams   erosion;
+  f32             erosion_rain;  // Water added to every cell before eroding
+  u32             erosion_steps; // Full erosion steps run by the stage
+  CorrosionParams corrosion;
+  f32             cell_size;     // Horizontal cell spacing used by the derived slope
+} PipelineParams;
+
+typedef struct PipelineStage {
+  const char *name;
+  u32         outputs;                      // Bitmask of PipelineLayer written by the stage
+  f32        *layers[PIPELINE_LAYER_COUNT]; // Cached outputs, NULL for layers the stage passes through
+  u64         key;                          // Inputs the cache was computed from
+  bool        valid;
+  u32         evaluations; // Times the stage actually ran
+} PipelineStage;
+
+typedef struct Pipeline {
+  PipelineParams  params;
+  PipelineStage   stages[PIPELINE_STAGE_COUNT];
+  ErosionState    erosion;            // Working state for the erosion stage
+  PipelineStageId running;            // Stage a partial evaluation stopped inside, PIPELINE_STAGE_COUNT if none
+  u32             erosion_steps_done; // Of the running erosion stage
+  u64             running_ns;         // Time spent in the running stage so far
+  u32             width;
+  u32             height;
+} Pipeline;
+
+bool pipeline_create(Pipeline *pipeline, const PipelineParams *params, u32 width, u32 height, Arena *arena);
+
+// Replace the parameters. Nothing runs until the next pipeline_evaluate. Abandons a
+// partial evaluation.
+void pipeline_set_params(Pipeline *pipeline, const PipelineParams *params);
+
+// Bring every stage up to and including target up to date. Returns the first stage that
+// had to be recomputed, or PIPELINE_STAGE_COUNT if all of them were cached.
+PipelineStageId pipeline_evaluate(Pipeline *pipeline, PipelineStageId target);
+
+// Resumable pipeline_evaluate for time-sliced callers. A unit is one erosion tile pass (see
+// erosion_step_partial); the noise, corrosion and derived stages each run whole as one unit.
+// Returns the units processed and sets *done once every stage up to target is current.
+u32 pipeline_evaluate_partial(Pipeline *pipeline, PipelineStageId target, u32 max_units, bool *done);
+
+// Install a height layer computed elsewhere, e.g. the finished progressive preview, as the
+// noise stage's output for the current parameters. It must match noise_fill exactly.
+void pipeline_adopt_noise(Pipeline *pipeline, const f32 *height);
+
+// A layer as seen at the output of a stage: the most recent version written by that stage
+// or any stage before it. NULL if no stage up to it writes the layer.
+const f32 *pipeline_layer(const Pipeline *pipeline, PipelineStageId stage, PipelineLayer layer);
+
+#endif // PIPELINE_H
@@ -0,0 +1,189 @@
+#include "progressive.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "utils/macros.h"
+#include <string.h>
+
+bool progressive_create(ProgressiveGenerator *generator, u32 width, u32 height, u32 shift, Arena *arena) {
+  memset(generator, 0, sizeof(*generator));
+  if(width == 0 || height == 0) {
+    return false;
+  }
+
+  // Keep at least two samples per side on the coarsest level
+  while(shift > 0 && ((width - 1) >> shift == 0 || (height - 1) >> shift == 0)) {
+    shift--;
+  }
+  shift = MIN(shift, (u32)PROGRESSIVE_MAX_LEVELS - 1);
+
+  generator->width       = width;
+  generator->height      = height;
+  generator->level_count = shift + 1;
+  for(u32 i = 0; i < generator->level_count; ++i) {
+    ProgressiveLevel *level = &generator->levels[i];
+    level->shift            = shift - i;
+    level->spacing          = 1u << level->shift;
+    level->width            = (width - 1) / level->spacing + 1;
+    level->height           = (height - 1) / level->spacing + 1;
+    level->sums             = ARENA_PUSH_ARRAY(arena, f32, (size_t)level->width * level->height);
+    if(!level->sums) {
+      LOG_ERROR("Failed to allocate progressive level %u (%ux%u)", i, level->width, level->height);
+      return false;
+    }
+  }
+  return true;
+}
+
+void progressive_begin(ProgressiveGenerator *generator, const NoiseParams *params) {
+  generator->params = *params;
+  generator->level  = 0;
+  generator->row    = 0;
+
+  // Octaves are added once the level's grid can resolve them; every level shows at least
+  // the base octave and the last one takes them all
+  f32 frequency = params->frequency;
+  u32 octave    = 0;
+  for(u32 i = 0; i < generator->level_count; ++i) {
+    ProgressiveLevel *level = &generator->levels[i];
+    bool              last  = i + 1 == generator->level_count;
+    while(octave < params->octaves
+          && (last || octave == 0 || frequency * (f32)level->spacing <= PROGRESSIVE_NYQUIST)) {
+      frequency *= params->lacunarity;
+      octave++;
+    }
+    level->octaves = octave;
+  }
+}
+
+typedef struct ProgressiveRowJob {
+  const ProgressiveGenerator *generator;
+  const ProgressiveLevel     *level;
+  const ProgressiveLevel     *coarse; // Previous level, NULL for level 0
+  u32                         first_row;
+} ProgressiveRowJob;
+
+static void progressive_rows(void *user, u32 begin, u32 end, u32 worker) {
+  const ProgressiveRowJob *job     = (const ProgressiveRowJob *)user;
+  const ProgressiveLevel  *level   = job->level;
+  const ProgressiveLevel  *coarse  = job->coarse;
+  const NoiseParams       *params  = &job->generator->params;
+  Arena                   *scratch = job_worker_scratch(worker);
+
+  for(u32 r = begin; r < end; ++r) {
+    u32  y    = job->first_row + r;
+    f32 *sums = level->sums + (size_t)y * level->width;
+    u32  cy   = y * level->spacing;
+
+    if(!coarse || (y & 1) != 0) {
+      memset(sums, 0, level->width * sizeof(f32));
+      noise_accumulate_octaves(params, 0, level->octaves, sums, 0, level->spacing, level->width, cy);
+      continue;
+    }
+
+    // Even row: even samples continue the coarse sums, odd samples start from zero. Both
+    // then add the octaves new at this level, keeping the summation order of noise_fbm.
+    const f32 *inherited = coarse->sums + (size_t)(y / 2) * coarse->width;
+    for(u32 x = 0; x < level->width; x += 2) {
+      sums[x] = inherited[x / 2];
+    }
+
+    u32       odd_count = level->width / 2;
+    ArenaTemp temp      = arena_temp_begin(scratch);
+    f32      *odd       = ARENA_PUSH_ARRAY(scratch, f32, MAX(odd_count, 1u));
+    if(odd) {
+      memset(odd, 0, odd_count * sizeof(f32));
+      noise_accumulate_octaves(params, 0, coarse->octaves, odd, level->spacing, 2 * level->spacing, odd_count, cy);
+      for(u32 i = 0; i < odd_count; ++i) {
+        sums[2 * i + 1] = odd[i];
+      }
+    }
+    arena_temp_end(temp);
+
+    noise_accumulate_octaves(params, coarse->octaves, level->octaves, sums, 0, level->spacing, level->width, cy);
+  }
+}
+
+bool progressive_refine(ProgressiveGenerator *generator, u32 max_rows) {
+  if(progressive_done(generator) || max_rows == 0) {
+    return false;
+  }
+
+  const ProgressiveLevel *level = &generator->levels[generator->level];
+  u32                     rows  = MIN(max_rows, level->height - generator->row);
+
+  ProgressiveRowJob job = {
+    .generator = generator,
+    .level     = level,
+    .coarse    = generator->level > 0 ? &generator->levels[generator->level - 1] : NULL,
+    .first_row = generator->row,
+  };
+  job_parallel_for(rows, PROGRESSIVE_ROWS_PER_JOB, progressive_rows, &job);
+
+  generator->row += rows;
+  if(generator->row < level->height) {
+    return false;
+  }
+
+  generator->level++;
+  generator->row = 0;
+  return true;
+}
+
+bool progressive_done(const ProgressiveGenerator *generator) { return generator->level >= generator->level_count; }
+
+typedef struct ProgressiveResolveJob {
+  const ProgressiveLevel *level;
+  f32                    *out;
+  u32                     width;
+  f32                     amplitude;
+} ProgressiveResolveJob;
+
+static void progressive_resolve_rows(void *user, u32 begin, u32 end, u32 worker) {
+  const ProgressiveResolveJob *job   = (const ProgressiveResolveJob *)user;
+  const ProgressiveLevel      *level = job->level;
+  f32                          inv   = 1.0f / (f32)level->spacing;
+  UNUSED(worker);
+
+  for(u32 y = begin; y < end; ++y) {
+    f32 *out = job->out + (size_t)y * job->width;
+    if(level->spacing == 1) {
+      const f32 *sums = level->sums + (size_t)y * level->width;
+      for(u32 x = 0; x < job->width; ++x) {
+        out[x] = sums[x] * job->amplitude;
+      }
+      continue;
+    }
+
+    u32        mask = level->spacing - 1;
+    u32        sy0  = y >> level->shift;
+    u32        sy1  = MIN(sy0 + 1, level->height - 1);
+    f32        ty   = (f32)(y & mask) * inv;
+    const f32 *r0   = level->sums + (size_t)sy0 * level->width;
+    const f32 *r1   = level->sums + (size_t)sy1 * level->width;
+    for(u32 sx = 0; sx < level->width; ++sx) {
+      // Vertically interpolated column pair, then a run of cells between them
+      u32 sx1   = MIN(sx + 1, level->width - 1);
+      f32 left  = (r0[sx] + (r1[sx] - r0[sx]) * ty) * job->amplitude;
+      f32 right = (r0[sx1] + (r1[sx1] - r0[sx1]) * ty) * job->amplitude;
+      u32 x0    = sx << level->shift;
+      u32 x1    = MIN(x0 + level->spacing, job->width);
+      for(u32 x = x0; x < x1; ++x) {
+        out[x] = left + (right - left) * ((f32)(x & mask) * inv);
+      }
+    }
+  }
+}
+
+void progressive_resolve(const ProgressiveGenerator *generator, f32 *out) {
+  if(generator->level == 0) {
+    return;
+  }
+
+  ProgressiveResolveJob job = {
+    .level     = &generator->levels[generator->level - 1],
+    .out       = out,
+    .width     = generator->width,
+    .amplitude = generator->params.amplitude,
+  };
+  job_parallel_for(generator->height, PROGRESSIVE_ROWS_PER_JOB, progressive_resolve_rows, &job);
+}
@@ -0,0 +1,56 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include "memory/arena.h"
+#include "simulation/noise.h"
+#include "utils/types.h"
+
+// Coarse-to-fine noise generation for previews. Level 0 samples every 2^shift-th cell with
+// only the octaves that grid can resolve; each following level halves the spacing. Its
+// even samples are the previous level's samples plus the newly resolvable octaves, and the
+// rest are computed directly. The final level has spacing 1 and every octave, and matches
+// noise_fill exactly.
+
+#define PROGRESSIVE_MAX_LEVELS 8
+
+// Highest octave frequency, in lattice cells per sample, a level includes
+#define PROGRESSIVE_NYQUIST 0.5f
+
+// Rows of a level per job
+#define PROGRESSIVE_ROWS_PER_JOB 8
+
+typedef struct ProgressiveLevel {
+  f32 *sums; // Octave sums before the amplitude scale
+  u32  width;
+  u32  height;
+  u32  spacing; // Heightfield cells between samples, 1 << shift
+  u32  shift;
+  u32  octaves; // Octaves summed at this level
+} ProgressiveLevel;
+
+typedef struct ProgressiveGenerator {
+  NoiseParams      params;
+  ProgressiveLevel levels[PROGRESSIVE_MAX_LEVELS];
+  u32              level_count;
+  u32              width;
+  u32              height;
+  u32              level; // Level being computed, which is also the number of finished levels
+  u32              row;   // Next row of that level
+} ProgressiveGenerator;
+
+// Allocate levels for a width x height grid whose coarsest level is 1 / 2^shift resolution
+bool progressive_create(ProgressiveGenerator *generator, u32 width, u32 height, u32 shift, Arena *arena);
+
+// Start over with new parameters
+void progressive_begin(ProgressiveGenerator *generator, const NoiseParams *params);
+
+// Compute up to max_rows rows of the current level. Returns true if a level was completed.
+bool progressive_refine(ProgressiveGenerator *generator, u32 max_rows);
+
+bool progressive_done(const ProgressiveGenerator *generator);
+
+// Upsample the finest complete level to a full-resolution height layer. No-op if no level
+// has completed yet.
+void progressive_resolve(const ProgressiveGenerator *generator, f32 *out);
+
+#endif // PROGRESSIVE_H
@@ -2,16 +2,300 @@
 
 #include "core/log.h"
 #include "utils/macros.h"
+#include <SDL3/SDL_timer.h>
+#include <math.h>
+#include <string.h>
 
-Result simulation_init(SimulationState *simulation, Arena *arena) {
-  if(!simulation) {
+// Preview rows computed between budget checks
+#define SIMULATION_PREVIEW_ROWS_PER_SLICE 16
+
+// Generation pipeline units (erosion tile passes) run between budget checks
+#define SIMULATION_GENERATION_UNITS_PER_SLICE 32
+
+SimulationConfig simulation_config_default(void) {
+  SimulationConfig config = SimulationConfig{
+    .width           = 512,
+    .height          = 512,
+    .frame_budget_ms = 4.0,
+    .erosion =
+      {
+        .time_step        = 0.05f,
+        .gravity          = 9.81f,
+        .capacity         = 1.0f,
+        .erosion_rate     = 0.5f,
+        .deposition_rate  = 1.0f,
+        .evaporation      = 0.2f,
+        .min_slope        = 0.01f,
+        .water_epsilon    = 1e-4f,
+        .change_threshold = 1e-5f,
+      },
+    .thermal =
+      {
+        .rate       = 0.5f,
+        .solver     = DIFFUSION_SOLVER_MULTIGRID,
+        .iterations = 2,
+      },
+    // alpha = rate * time_step is only 0.1 here, so four Jacobi sweeps converge; the stencil
+    // executor fuses them into a single pass over the layer
+    .sediment =
+      {
+        .rate       = 2.0f,
+        .solver     = DIFFUSION_SOLVER_JACOBI,
+        .iterations = 4,
+      },
+    .generation =
+      {
+        .noise =
+          {
+            .seed       = 1337,
+            .type       = NOISE_TYPE_GRADIENT,
+            .octaves    = 6,
+            .frequency  = 1.0f / 128.0f,
+            .lacunarity = 2.0f,
+            .gain       = 0.5f,
+            .amplitude  = 32.0f,
+          },
+        .erosion       = {}, // Filled in from the live erosion parameters below
+        .erosion_rain  = 0.5f,
+        .erosion_steps = 16,
+        .corrosion =
+          {
+            .rate         = 0.01f,
+            .humidity     = 0.5f,
+            .temperature  = 1.0f,
+            .salt_content = 0.0f,
+          },
+        .cell_size = 1.0f,
+      },
+    // Height stays exact so undo is lossless; water and sediment tolerate 16-bit copies
+    .history_storage = {HEIGHTFIELD_STORAGE_F32, HEIGHTFIELD_STORAGE_F16, HEIGHTFIELD_STORAGE_UNORM16},
+    .preview_shift   = 4,
+  };
+
+  // Generation erodes with the same model the live simulation runs
+  config.generation.erosion = config.erosion;
+  return config;
+}
+
+static bool simulation_uses_multigrid(const SimulationConfig *config) {
+  return config->thermal.solver == DIFFUSION_SOLVER_MULTIGRID
+         || config->sediment.solver == DIFFUSION_SOLVER_MULTIGRID;
+}
+
+static u32 simulation_erosion_slice(void *user, u32 max_units, bool *done) {
+  SimulationState *simulation = (SimulationState *)user;
+  u32              processed  = erosion_step_partial(&simulation->erosion, &simulation->heightfield, max_units, done);
+
+  if(*done) {
+    const ErosionStats *stats = &simulation->erosion.stats;
+    if(simulation->step_count % 120 == 0) {
+      LOG_DEBUG("Erosion step %llu: %u/%u tiles active, %.1f%% of the grid simulated",
+                (unsigned long long)simulation->step_count,
+                stats->active_tiles,
+                stats->total_tiles,
+                stats->active_fraction * 100.0f);
+    }
+    simulation->step_count++;
+  }
+
+  return processed;
+}
+
+static u32 simulation_diffusion_slice(SimulationState   *simulation,
+                                      DiffusionTask     *task,
+                                      HeightfieldLayerId layer,
+                                      u32                max_units,
+                                      bool              *done) {
+  // Only the rows this slice wrote change, and only in the diffused layer
+  u32 processed = diffusion_step_partial(task, max_units, done);
+  heightfield_mark_dirty(&simulation->heightfield,
+                         HEIGHTFIELD_LAYER_BIT(layer),
+                         0,
+                         task->written_y0,
+                         simulation->heightfield.width,
+                         task->written_y1);
+  return processed;
+}
+
+static u32 simulation_thermal_slice(void *user, u32 max_units, bool *done) {
+  SimulationState *simulation = (SimulationState *)user;
+  return simulation_diffusion_slice(simulation, &simulation->thermal_task, HEIGHTFIELD_LAYER_HEIGHT, max_units, done);
+}
+
+static u32 simulation_sediment_slice(void *user, u32 max_units, bool *done) {
+  SimulationState *simulation = (SimulationState *)user;
+  return simulation_diffusion_slice(
+    simulation, &simulation->sediment_task, HEIGHTFIELD_LAYER_SEDIMENT, max_units, done);
+}
+
+static DiffusionTask
+simulation_diffusion_task(SimulationState *simulation, const DiffusionParams *params, HeightfieldLayerId layer) {
+  return DiffusionTask{
+    .params      = params,
+    .multigrid   = &simulation->multigrid,
+    .field       = heightfield_layer(&simulation->heightfield, layer),
+    .width       = simulation->heightfield.width,
+    .height      = simulation->heightfield.height,
+    .dt          = simulation->config.erosion.time_step,
+    .cycles_done = 0,
+    .in_progress = false,
+    .written_y0  = 0,
+    .written_y1  = 0,
+  };
+}
+
+// Abandon partially completed steps after the heightfield was replaced underneath them
+static void simulation_restart_stages(SimulationState *simulation) {
+  DiffusionTask *tasks[] = {&simulation->thermal_task, &simulation->sediment_task};
+  for(u32 i = 0; i < ARRAY_SIZE(tasks); ++i) {
+    if(tasks[i]->in_progress) {
+      multigrid_end(tasks[i]->multigrid);
+      tasks[i]->in_progress = false;
+    }
+  }
+
+  erosion_reset(&simulation->erosion);
+  erosion_activate_region(&simulation->erosion, 0, 0, simulation->heightfield.width, simulation->heightfield.height);
+}
+
+// Copy the generated terrain into the live heightfield and restart every stage on it
+static void simulation_reseed(SimulationState *simulation) {
+  Pipeline *pipeline = &simulation->pipeline;
+  pipeline_evaluate(pipeline, PIPELINE_STAGE_DERIVED);
+
+  Heightfield *heightfield = &simulation->heightfield;
+  size_t       bytes       = heightfield_cell_count(heightfield) * sizeof(f32);
+  memcpy(heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT),
+         pipeline_layer(pipeline, PIPELINE_STAGE_DERIVED, PIPELINE_LAYER_HEIGHT),
+         bytes);
+  memcpy(heightfield_layer(heightfield, HEIGHTFIELD_LAYER_WATER),
+         pipeline_layer(pipeline, PIPELINE_STAGE_DERIVED, PIPELINE_LAYER_WATER),
+         bytes);
+  memcpy(heightfield_layer(heightfield, HEIGHTFIELD_LAYER_SEDIMENT),
+         pipeline_layer(pipeline, PIPELINE_STAGE_DERIVED, PIPELINE_LAYER_SEDIMENT),
+         bytes);
+  heightfield_mark_all_dirty(heightfield, HEIGHTFIELD_LAYER_BITS_ALL);
+
+  simulation_restart_stages(simulation);
+}
+
+// Show the finest finished preview level: noise only, no water or sediment yet
+static void simulation_publish_preview(SimulationState *simulation) {
+  Heightfield *heightfield = &simulation->heightfield;
+  size_t       bytes       = heightfield_cell_count(heightfield) * sizeof(f32);
+  progressive_resolve(&simulation->preview, heightfield_layer(heightfield, HEIGHTFIELD_LAYER_HEIGHT));
+  memset(heightfield_layer(heightfield, HEIGHTFIELD_LAYER_WATER), 0, bytes);
+  memset(heightfield_layer(heightfield, HEIGHTFIELD_LAYER_SEDIMENT), 0, bytes);
+  heightfield_mark_all_dirty(heightfield, HEIGHTFIELD_LAYER_BITS_ALL);
+}
+
+// Refine the preview within the frame budget, publishing each finished level, then run the
+// generation pipeline in slices under the same budget. The heightfield is reseeded once the
+// whole pipeline is current.
+static void simulation_preview_update(SimulationState *simulation) {
+  ProgressiveGenerator *preview   = &simulation->preview;
+  Heightfield          *hf        = &simulation->heightfield;
+  u64                   budget_ns = (u64)(simulation->config.frame_budget_ms * 1e6);
+  u64                   start_ns  = SDL_GetTicksNS();
+  bool                  done      = false;
+
+  while(!done && SDL_GetTicksNS() - start_ns < budget_ns) {
+    if(simulation->config.preview_shift > 0 && !progressive_done(preview)) {
+      if(progressive_refine(preview, SIMULATION_PREVIEW_ROWS_PER_SLICE)) {
+        simulation_publish_preview(simulation);
+        LOG_DEBUG("Preview level %u/%u published", preview->level, preview->level_count);
+
+        // The finished preview matches noise_fill, so the pipeline starts at erosion
+        if(progressive_done(preview)) {
+          pipeline_adopt_noise(&simulation->pipeline, heightfield_layer(hf, HEIGHTFIELD_LAYER_HEIGHT));
+        }
+      }
+      continue;
+    }
+
+    pipeline_evaluate_partial(
+      &simulation->pipeline, PIPELINE_STAGE_DERIVED, SIMULATION_GENERATION_UNITS_PER_SLICE, &done);
+  }
+
+  if(done) {
+    simulation->previewing = false;
+    simulation_reseed(simulation);
+  }
+}
+
+// Generate terrain for the current parameters without stalling a frame: show the coarsest
+// preview level now and leave the rest to simulation_preview_update
+static void simulation_begin_generation(SimulationState *simulation) {
+  if(simulation->config.preview_shift > 0) {
+    // The coarsest level is a tiny fraction of the grid, so it is shown within this call
+    progressive_begin(&simulation->preview, &simulation->config.generation.noise);
+    progressive_refine(&simulation->preview, simulation->preview.levels[0].height);
+    simulation_publish_preview(simulation);
+  }
+  simulation->previewing = true;
+}
+
+Result simulation_init(SimulationState *simulation, const SimulationConfig *config, Arena *arena) {
+  if(!simulation || !config || !arena) {
     return RESULT_ERROR_GENERIC;
   }
 
-  UNUSED(arena);
+  *simulation        = SimulationState{};
+  simulation->config = *config;
+
+  if(!heightfield_create(&simulation->heightfield, config->width, config->height, arena)) {
+    LOG_ERROR("Failed to create simulation heightfield");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  if(!erosion_create(&simulation->erosion, &config->erosion, config->width, config->height, arena)) {
+    LOG_ERROR("Failed to create erosion state");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  if(simulation_uses_multigrid(config)) {
+    if(!multigrid_create(&simulation->multigrid, config->width, config->height, arena)) {
+      LOG_ERROR("Failed to create multigrid solver");
+      return RESULT_ERROR_OUT_OF_MEMORY;
+    }
+  }
+
+  if(!heightfield_history_create(&simulation->history, &simulation->heightfield, config->history_storage, arena)) {
+    LOG_ERROR("Failed to create heightfield history");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  if(!pipeline_create(&simulation->pipeline, &config->generation, config->width, config->height, arena)) {
+    LOG_ERROR("Failed to create generation pipeline");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  if(config->preview_shift > 0
+     && !progressive_create(&simulation->preview, config->width, config->height, config->preview_shift, arena)) {
+    LOG_ERROR("Failed to create generation preview");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  if(!height_pyramid_create(&simulation->pyramid, &simulation->heightfield, arena)) {
+    LOG_ERROR("Failed to create height pyramid");
+    return RESULT_ERROR_OUT_OF_MEMORY;
+  }
+
+  simulation->thermal_task
+    = simulation_diffusion_task(simulation, &simulation->config.thermal, HEIGHTFIELD_LAYER_HEIGHT);
+  simulation->sediment_task
+    = simulation_diffusion_task(simulation, &simulation->config.sediment, HEIGHTFIELD_LAYER_SEDIMENT);
+
+  time_slice_init(&simulation->scheduler, config->frame_budget_ms);
+  time_slice_add_task(&simulation->scheduler, "erosion", simulation_erosion_slice, simulation);
+  time_slice_add_task(&simulation->scheduler, "thermal", simulation_thermal_slice, simulation);
+  time_slice_add_task(&simulation->scheduler, "sediment", simulation_sediment_slice, simulation);
+
+  simulation_begin_generation(simulation);
+  height_pyramid_update(&simulation->pyramid, &simulation->heightfield);
 
   simulation->initialized = true;
-  LOG_INFO("Simulation initialized");
+  LOG_INFO("Simulation initialized (%ux%u)", config->width, config->height);
   return RESULT_SUCCESS;
 }
 
@@ -24,10 +308,109 @@ void simulation_shutdown(SimulationState *simulation) {
   LOG_INFO("Simulation shutdown");
 }
 
+void simulation_set_generation_params(SimulationState *simulation, const PipelineParams *params) {
+  if(!simulation || !simulation->initialized || !params) {
+    return;
+  }
+
+  simulation->config.generation = *params;
+  pipeline_set_params(&simulation->pipeline, params);
+  simulation_begin_generation(simulation);
+}
+
+bool simulation_snapshot(SimulationState *simulation, HeightfieldSnapshot *out) {
+  if(!simulation || !simulation->initialized || !out) {
+    return false;
+  }
+
+  if(!heightfield_history_snapshot(&simulation->history, &simulation->heightfield, out)) {
+    LOG_ERROR("Failed to snapshot the heightfield");
+    return false;
+  }
+
+  LOG_DEBUG("Snapshot taken: %u/%u tiles copied", simulation->history.tiles_copied, simulation->history.tile_count);
+  return true;
+}
+
+void simulation_restore(SimulationState *simulation, const HeightfieldSnapshot *snapshot) {
+  if(!simulation || !simulation->initialized || !snapshot) {
+    return;
+  }
+
+  heightfield_history_restore(&simulation->history, &simulation->heightfield, snapshot);
+  simulation->previewing = false;
+  simulation_restart_stages(simulation);
+  LOG_DEBUG("Snapshot restored: %u/%u tiles copied", simulation->history.tiles_copied, simulation->history.tile_count);
+}
+
+void simulation_release_snapshot(SimulationState *simulation, HeightfieldSnapshot *snapshot) {
+  if(!simulation || !simulation->initialized || !snapshot) {
+    return;
+  }
+
+  heightfield_history_release(&simulation->history, snapshot);
+}
+
+HeightfieldPlacement simulation_placement(const SimulationState *simulation) {
+  f32 cell_size = simulation->config.generation.cell_size;
+  return HeightfieldPlacement{
+    .origin_x  = -0.5f * (f32)(simulation->heightfield.width - 1) * cell_size,
+    .origin_z  = -0.5f * (f32)(simulation->heightfield.height - 1) * cell_size,
+    .cell_size = cell_size,
+  };
+}
+
+bool simulation_pick(const SimulationState *simulation,
+                     const f32              origin[3],
+                     const f32              direction[3],
+                     f32                    max_distance,
+                     f32                    out_position[3]) {
+  if(!simulation || !simulation->initialized) {
+    return false;
+  }
+
+  HeightfieldPlacement placement = simulation_placement(simulation);
+  f32                  length    = sqrtf(direction[0] * direction[0] + direction[1] * direction[1]
+                                         + direction[2] * direction[2]);
+  if(length <= 0.0f || placement.cell_size <= 0.0f) {
+    return false;
+  }
+
+  // Grid space keeps the ray parameter, so the hit maps back along the world ray
+  HeightfieldRay ray = {
+    .origin    = {(origin[0] - placement.origin_x) / placement.cell_size,
+                  (origin[2] - placement.origin_z) / placement.cell_size, origin[1]},
+    .direction = {direction[0] / placement.cell_size, direction[2] / placement.cell_size, direction[1]},
+    .max_t     = max_distance / length,
+  };
+
+  HeightfieldHit hit = {};
+  heightfield_ray_cast(&simulation->pyramid, &simulation->heightfield, &ray, 1, &hit);
+  if(!hit.hit) {
+    return false;
+  }
+
+  for(u32 axis = 0; axis < 3; ++axis) {
+    out_position[axis] = origin[axis] + direction[axis] * hit.t;
+  }
+  return true;
+}
+
 void simulation_update(SimulationState *simulation, f64 delta_time) {
   if(!simulation || !simulation->initialized) {
     return;
   }
 
+  // Steps have a fixed length; the frame time only matters through the budget
   UNUSED(delta_time);
+
+  // Nothing is simulated on preview terrain
+  if(simulation->previewing) {
+    simulation_preview_update(simulation);
+  } else {
+    time_slice_run_frame(&simulation->scheduler);
+  }
+
+  // Covers restores and parameter changes made since the last update too
+  height_pyramid_update(&simulation->pyramid, &simulation->heightfield);
 }
@@ -3,14 +3,73 @@
 
 #include "foundation/result.h"
 #include "memory/arena.h"
+#include "simulation/diffusion.h"
+#include "simulation/erosion.h"
+#include "simulation/height_pyramid.h"
+#include "simulation/heightfield.h"
+#include "simulation/heightfield_ray.h"
+#include "simulation/heightfield_sample.h"
+#include "simulation/heightfield_history.h"
+#include "simulation/multigrid.h"
+#include "simulation/pipeline.h"
+#include "simulation/progressive.h"
+#include "simulation/time_slice.h"
 #include "utils/types.h"
 
+typedef struct SimulationConfig {
+  u32                width;
+  u32                height;
+  f64                frame_budget_ms; // Wall-clock time simulation_update may spend per frame
+  ErosionParams      erosion;
+  DiffusionParams    thermal;    // Smoothing of the height layer
+  DiffusionParams    sediment;   // Spreading of suspended sediment
+  PipelineParams     generation; // Stage graph producing the initial terrain
+  HeightfieldStorage history_storage[HEIGHTFIELD_LAYER_COUNT]; // Snapshot format per heightfield layer
+  // New generation parameters are previewed from 1 / 2^preview_shift resolution up; 0 disables previews
+  u32                preview_shift;
+} SimulationConfig;
+
 typedef struct SimulationState {
-  bool initialized;
+  SimulationConfig     config;
+  Heightfield          heightfield;
+  HeightfieldHistory   history;    // Copy-on-write snapshots of the heightfield for undo and branching
+  HeightPyramid        pyramid;    // Min/max/average mips of the height layer, refreshed every update
+  Pipeline             pipeline;   // Cached generation stages the heightfield is seeded from
+  ProgressiveGenerator preview;    // Coarse-to-fine noise shown while new parameters generate
+  bool                 previewing; // Generation in flight: preview levels, then pipeline slices
+  MultigridSolver      multigrid;  // Shared by every stage that opts into multigrid
+  ErosionState         erosion;
+  DiffusionTask        thermal_task;
+  DiffusionTask        sediment_task;
+  TimeSliceScheduler   scheduler; // Runs erosion -> thermal -> sediment in resumable slices
+  u64                  step_count;
+  bool                 initialized;
 } SimulationState;
 
-Result simulation_init(SimulationState *simulation, Arena *arena);
+SimulationConfig simulation_config_default(void);
+
+Result simulation_init(SimulationState *simulation, const SimulationConfig *config, Arena *arena);
 void   simulation_shutdown(SimulationState *simulation);
+// Change generation parameters and reseed the heightfield. Only the stages whose inputs
+// changed are recomputed, in slices under the frame budget of later updates; nothing is
+// simulated meanwhile. With previews enabled the coarse noise level is published right
+// away and refined before the pipeline runs. simulation_init starts generation the same way.
+void   simulation_set_generation_params(SimulationState *simulation, const PipelineParams *params);
+// Capture the heightfield for undo or branching. Unchanged tiles are shared with earlier
+// snapshots. Solver state is not captured; restoring restarts erosion over the whole grid.
+bool   simulation_snapshot(SimulationState *simulation, HeightfieldSnapshot *out);
+void   simulation_restore(SimulationState *simulation, const HeightfieldSnapshot *snapshot);
+void   simulation_release_snapshot(SimulationState *simulation, HeightfieldSnapshot *snapshot);
+// Cast a world-space ray at the terrain and return the first hit within max_distance
+bool   simulation_pick(const SimulationState *simulation,
+                       const f32              origin[3],
+                       const f32              direction[3],
+                       f32                    max_distance,
+                       f32                    out_position[3]);
+// Advance the simulation by as many fixed steps (or partial steps) as fit in the frame budget
 void   simulation_update(SimulationState *simulation, f64 delta_time);
 
+// World placement of the terrain: centered on the origin, samples generation.cell_size apart
+HeightfieldPlacement simulation_placement(const SimulationState *simulation);
+
 #endif // SIMULATION_H
@@ -0,0 +1,315 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include "core/job.h"
+#include "memory/arena.h"
+#include "simulation/tile_store.h"
+#include "utils/types.h"
+#include <string.h>
+
+// Cache-blocked executor for explicit 2D stencils over a single f32 layer.
+//
+// The grid is cut into tiles that run in parallel on the job system. Each tile is loaded
+// with a halo of RADIUS * STENCIL_TEMPORAL_STEPS cells into a worker-local buffer and
+// advanced several steps there before being written back, so a block of steps costs one
+// pass over main memory instead of one per step. The halo shrinks by RADIUS per step.
+//
+// A kernel is a functor providing
+//   static const u32 RADIUS;
+//   f32 operator()(const f32 *center, i32 stride, u32 x, u32 y) const;
+// which returns the new value of cell (x, y), reading neighbours as center[dx + dy * stride]
+// for |dx|, |dy| <= RADIUS. Cells outside the grid read as the nearest edge cell.
+//
+// stencil_run_paged runs the same kernels over a TileStore. Halos are read through the
+// store, so they cross paged tile boundaries, and results go to a second store.
+
+#define STENCIL_TILE_SIZE      64
+#define STENCIL_TEMPORAL_STEPS 4
+
+template <typename Kernel> struct StencilBlock {
+  const Kernel *kernel;
+  const f32    *src;
+  f32          *dst;
+  u32           width;
+  u32           height;
+  u32           tiles_x;
+  u32           steps; // Steps fused into this block
+};
+
+static inline i64 stencil_clamp(i64 value, i64 limit) { return value < 0 ? 0 : (value >= limit ? limit - 1 : value); }
+
+// Advance a tile loaded with `steps * RADIUS` cells of halo by `steps` steps. cur and next
+// are stride x rows buffers whose (0, 0) is global (ox, oy); the tile is tw x th cells.
+// Returns the buffer holding the result.
+template <typename Kernel>
+static f32 *stencil_advance(const Kernel &kernel,
+                            f32          *cur,
+                            f32          *next,
+                            i64           ox,
+                            i64           oy,
+                            i64           stride,
+                            i64           tw,
+                            i64           th,
+                            i64           width,
+                            i64           height,
+                            u32           steps) {
+  const i64 radius = Kernel::RADIUS;
+  const i64 halo   = radius * steps;
+
+  for(u32 step = 1; step <= steps; ++step) {
+    // Cells still valid after this step: the tile grown by the remaining halo
+    i64 margin = halo - radius * step;
+    i64 lx0    = halo - margin;
+    i64 lx1    = halo + tw + margin;
+    i64 ly0    = halo - margin;
+    i64 ly1    = halo + th + margin;
+
+    // Only cells inside the grid are computed; the rest are re-clamped below so the next
+    // step sees the same edge values a single-step sweep would
+    i64 gx0 = lx0 + ox < 0 ? -ox : lx0;
+    i64 gx1 = lx1 + ox > width ? width - ox : lx1;
+    i64 gy0 = ly0 + oy < 0 ? -oy : ly0;
+    i64 gy1 = ly1 + oy > height ? height - oy : ly1;
+
+    for(i64 ly = gy0; ly < gy1; ++ly) {
+      const f32 *in  = cur + ly * stride;
+      f32       *out = next + ly * stride;
+      for(i64 lx = gx0; lx < gx1; ++lx) {
+        out[lx] = kernel(in + lx, (i32)stride, (u32)(ox + lx), (u32)(oy + ly));
+      }
+      for(i64 lx = lx0; lx < gx0; ++lx) {
+        out[lx] = out[gx0];
+      }
+      for(i64 lx = gx1; lx < lx1; ++lx) {
+        out[lx] = out[gx1 - 1];
+      }
+    }
+    for(i64 ly = ly0; ly < gy0; ++ly) {
+      memcpy(next + ly * stride + lx0, next + gy0 * stride + lx0, (size_t)(lx1 - lx0) * sizeof(f32));
+    }
+    for(i64 ly = gy1; ly < ly1; ++ly) {
+      memcpy(next + ly * stride + lx0, next + (gy1 - 1) * stride + lx0, (size_t)(lx1 - lx0) * sizeof(f32));
+    }
+
+    f32 *swap = cur;
+    cur       = next;
+    next      = swap;
+  }
+  return cur;
+}
+
+template <typename Kernel> static void stencil_tile(const StencilBlock<Kernel> *block, u32 tile, Arena *scratch) {
+  const i64 halo   = (i64)Kernel::RADIUS * block->steps;
+  const i64 width  = block->width;
+  const i64 height = block->height;
+
+  i64 tx0 = (i64)(tile % block->tiles_x) * STENCIL_TILE_SIZE;
+  i64 ty0 = (i64)(tile / block->tiles_x) * STENCIL_TILE_SIZE;
+  i64 tw  = width - tx0 < STENCIL_TILE_SIZE ? width - tx0 : STENCIL_TILE_SIZE;
+  i64 th  = height - ty0 < STENCIL_TILE_SIZE ? height - ty0 : STENCIL_TILE_SIZE;
+
+  // Local buffers cover the tile plus halo; local (0, 0) is global (ox, oy)
+  i64  ox     = tx0 - halo;
+  i64  oy     = ty0 - halo;
+  i64  stride = tw + 2 * halo;
+  i64  rows   = th + 2 * halo;
+  f32 *cur    = ARENA_PUSH_ARRAY(scratch, f32, (size_t)(stride * rows));
+  f32 *next   = ARENA_PUSH_ARRAY(scratch, f32, (size_t)(stride * rows));
+  if(!cur || !next) {
+    return;
+  }
+
+  for(i64 ly = 0; ly < rows; ++ly) {
+    const f32 *src_row = block->src + stencil_clamp(oy + ly, height) * width;
+    f32       *dst_row = cur + ly * stride;
+    for(i64 lx = 0; lx < stride; ++lx) {
+      dst_row[lx] = src_row[stencil_clamp(ox + lx, width)];
+    }
+  }
+
+  cur = stencil_advance(*block->kernel, cur, next, ox, oy, stride, tw, th, width, height, block->steps);
+
+  for(i64 y = 0; y < th; ++y) {
+    memcpy(block->dst + (ty0 + y) * width + tx0, cur + (halo + y) * stride + halo, (size_t)tw * sizeof(f32));
+  }
+}
+
+template <typename Kernel> static void stencil_tile_job(void *user, u32 begin, u32 end, u32 worker) {
+  const StencilBlock<Kernel> *block   = (const StencilBlock<Kernel> *)user;
+  Arena                      *scratch = job_worker_scratch(worker);
+
+  for(u32 tile = begin; tile < end; ++tile) {
+    ArenaTemp temp = arena_temp_begin(scratch);
+    stencil_tile(block, tile, scratch);
+    arena_temp_end(temp);
+  }
+}
+
+// Apply `steps` Jacobi-style steps of the kernel to field in place. Each step reads only
+// the previous step's values. The ping-pong buffer comes from the global scratch arena.
+template <typename Kernel> bool stencil_run(const Kernel &kernel, f32 *field, u32 width, u32 height, u32 steps) {
+  if(!field || width == 0 || height == 0 || steps == 0) {
+    return true;
+  }
+
+  ArenaTemp temp  = arena_scratch_begin();
+  size_t    count = (size_t)width * height;
+  f32      *other = ARENA_PUSH_ARRAY(temp.arena, f32, count);
+  if(!other) {
+    arena_temp_end(temp);
+    return false;
+  }
+
+  u32 tiles_x = (width + STENCIL_TILE_SIZE - 1) / STENCIL_TILE_SIZE;
+  u32 tiles_y = (height + STENCIL_TILE_SIZE - 1) / STENCIL_TILE_SIZE;
+
+  f32 *src = field;
+  f32 *dst = other;
+  for(u32 done = 0; done < steps;) {
+    StencilBlock<Kernel> block = {
+      .kernel  = &kernel,
+      .src     = src,
+      .dst     = dst,
+      .width   = width,
+      .height  = height,
+      .tiles_x = tiles_x,
+      .steps   = steps - done < STENCIL_TEMPORAL_STEPS ? steps - done : STENCIL_TEMPORAL_STEPS,
+    };
+    job_parallel_for(tiles_x * tiles_y, 1, stencil_tile_job<Kernel>, &block);
+
+    done += block.steps;
+    f32 *swap = src;
+    src       = dst;
+    dst       = swap;
+  }
+
+  if(src != field) {
+    memcpy(field, src, count * sizeof(f32));
+  }
+
+  arena_temp_end(temp);
+  return true;
+}
+
+template <typename Kernel> struct StencilPagedBlock {
+  const Kernel *kernel;
+  TileStore    *src;
+  TileStore    *dst;
+  u32           band; // Row of store tiles being computed
+  u32           steps;
+  SDL_AtomicInt failed;
+};
+
+// Compute one store tile: each STENCIL_TILE_SIZE sub-tile is read with its halo from the
+// source store and written into the pinned destination tile.
+template <typename Kernel> static void stencil_paged_tile_job(void *user, u32 begin, u32 end, u32 worker) {
+  StencilPagedBlock<Kernel> *block   = (StencilPagedBlock<Kernel> *)user;
+  Arena                     *scratch = job_worker_scratch(worker);
+  const i64                  halo    = (i64)Kernel::RADIUS * block->steps;
+  const i64                  width   = block->src->width;
+  const i64                  height  = block->src->height;
+
+  for(u32 tx = begin; tx < end; ++tx) {
+    u32  tile = block->band * block->src->tiles_x + tx;
+    f32 *out  = tile_store_acquire(block->dst, tile, TILE_STORE_DISCARD);
+    if(!out) {
+      SDL_SetAtomicInt(&block->failed, 1);
+      continue;
+    }
+
+    i64 gx0 = (i64)tx * TILE_STORE_TILE_SIZE;
+    i64 gy0 = (i64)block->band * TILE_STORE_TILE_SIZE;
+    i64 gx1 = width - gx0 < TILE_STORE_TILE_SIZE ? width : gx0 + TILE_STORE_TILE_SIZE;
+    i64 gy1 = height - gy0 < TILE_STORE_TILE_SIZE ? height : gy0 + TILE_STORE_TILE_SIZE;
+
+    for(i64 ty0 = gy0; ty0 < gy1; ty0 += STENCIL_TILE_SIZE) {
+      for(i64 tx0 = gx0; tx0 < gx1; tx0 += STENCIL_TILE_SIZE) {
+        i64 tw = gx1 - tx0 < STENCIL_TILE_SIZE ? gx1 - tx0 : STENCIL_TILE_SIZE;
+        i64 th = gy1 - ty0 < STENCIL_TILE_SIZE ? gy1 - ty0 : STENCIL_TILE_SIZE;
+
+        ArenaTemp temp   = arena_temp_begin(scratch);
+        i64       ox     = tx0 - halo;
+        i64       oy     = ty0 - halo;
+        i64       stride = tw + 2 * halo;
+        i64       rows   = th + 2 * halo;
+        f32      *cur    = ARENA_PUSH_ARRAY(scratch, f32, (size_t)(stride * rows));
+        f32      *next   = ARENA_PUSH_ARRAY(scratch, f32, (size_t)(stride * rows));
+        if(!cur || !next || !tile_store_read(block->src, ox, oy, (u32)stride, (u32)rows, cur)) {
+          SDL_SetAtomicInt(&block->failed, 1);
+          arena_temp_end(temp);
+          continue;
+        }
+
+        cur = stencil_advance(*block->kernel, cur, next, ox, oy, stride, tw, th, width, height, block->steps);
+
+        for(i64 y = 0; y < th; ++y) {
+          memcpy(out + (ty0 - gy0 + y) * TILE_STORE_TILE_SIZE + (tx0 - gx0),
+                 cur + (halo + y) * stride + halo,
+                 (size_t)tw * sizeof(f32));
+        }
+        arena_temp_end(temp);
+      }
+    }
+
+    tile_store_release(block->dst, tile);
+  }
+}
+
+// Apply `steps` steps of the kernel to a paged layer. Store tiles are swept a row at a
+// time, blocks of STENCIL_TEMPORAL_STEPS steps costing one read and one write of the
+// layer, while the next tiles in sweep order are prefetched. scratch must have the same
+// dimensions; its contents are overwritten.
+template <typename Kernel> bool stencil_run_paged(const Kernel &kernel, TileStore *field, TileStore *scratch, u32 steps) {
+  if(!field || !scratch || field->width != scratch->width || field->height != scratch->height) {
+    return false;
+  }
+
+  TileStore *src   = field;
+  TileStore *dst   = scratch;
+  bool       ok    = true;
+  u32        ahead = src->page_count / 4 > 0 ? src->page_count / 4 : 1;
+
+  for(u32 done = 0; done < steps && ok;) {
+    StencilPagedBlock<Kernel> block = {};
+    block.kernel                    = &kernel;
+    block.src                       = src;
+    block.dst                       = dst;
+    block.steps                     = steps - done < STENCIL_TEMPORAL_STEPS ? steps - done : STENCIL_TEMPORAL_STEPS;
+    SDL_SetAtomicInt(&block.failed, 0);
+
+    for(u32 band = 0; band < src->tiles_y; ++band) {
+      // The band below also supplies this band's lower halo, so it is the next thing read
+      u32 next  = (band + 1) * src->tiles_x;
+      u32 count = tile_store_tile_count(src);
+      for(u32 tile = next; tile < next + ahead && tile < count; ++tile) {
+        tile_store_prefetch(src, tile);
+      }
+
+      block.band = band;
+      job_parallel_for(src->tiles_x, 1, stencil_paged_tile_job<Kernel>, &block);
+    }
+    ok = SDL_GetAtomicInt(&block.failed) == 0;
+
+    done += block.steps;
+    TileStore *swap = src;
+    src             = dst;
+    dst             = swap;
+  }
+
+  // An odd number of blocks leaves the result in scratch
+  for(u32 tile = 0; ok && src != field && tile < tile_store_tile_count(field); ++tile) {
+    const f32 *from = tile_store_acquire(src, tile, TILE_STORE_READ);
+    f32       *to   = from ? tile_store_acquire(field, tile, TILE_STORE_DISCARD) : NULL;
+    if(to) {
+      memcpy(to, from, (size_t)TILE_STORE_TILE_SIZE * TILE_STORE_TILE_SIZE * sizeof(f32));
+      tile_store_release(field, tile);
+    }
+    if(from) {
+      tile_store_release(src, tile);
+    }
+    ok = to != NULL;
+  }
+  return ok;
+}
+
+#endif // STENCIL_H
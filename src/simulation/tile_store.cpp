@@ -0,0 +1,508 @@
+#include "tile_store.h"
+#include "core/log.h"
+#include "math/pack16.h"
+#include "utils/macros.h"
+#include <string.h>
+
+#define TILE_STORE_TILE_CELLS ((size_t)TILE_STORE_TILE_SIZE * TILE_STORE_TILE_SIZE)
+
+static bool tile_store_seek(FILE *file, u64 offset) {
+#if defined(_WIN32)
+  return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static i64 tile_store_clamp(i64 value, i64 limit) { return value < 0 ? 0 : (value >= limit ? limit - 1 : value); }
+
+// Valid cells of a tile; the rest of the page is padding
+static void tile_store_tile_extent(const TileStore *store, u32 tile, u32 *cols, u32 *rows) {
+  u32 x0 = (tile % store->tiles_x) * TILE_STORE_TILE_SIZE;
+  u32 y0 = (tile / store->tiles_x) * TILE_STORE_TILE_SIZE;
+  *cols  = MIN((u32)TILE_STORE_TILE_SIZE, store->width - x0);
+  *rows  = MIN((u32)TILE_STORE_TILE_SIZE, store->height - y0);
+}
+
+// Encode a page and write it as `tile`. Caller holds io_mutex.
+static bool tile_store_write_tile(TileStore *store, u32 tile, const f32 *data) {
+  void *encoded = (void *)data;
+  switch(store->storage) {
+  case HEIGHTFIELD_STORAGE_F32: break;
+  case HEIGHTFIELD_STORAGE_F16:
+    f16_encode(data, (u16 *)store->io_buffer, TILE_STORE_TILE_CELLS);
+    encoded = store->io_buffer;
+    break;
+  case HEIGHTFIELD_STORAGE_UNORM16: {
+    u32 cols;
+    u32 rows;
+    tile_store_tile_extent(store, tile, &cols, &rows);
+
+    f32 lo = data[0];
+    f32 hi = data[0];
+    for(u32 y = 0; y < rows; ++y) {
+      f32 row_lo;
+      f32 row_hi;
+      unorm16_range(data + (size_t)y * TILE_STORE_TILE_SIZE, cols, &row_lo, &row_hi);
+      lo = MIN(lo, row_lo);
+      hi = MAX(hi, row_hi);
+    }
+    store->tile_offset[tile] = lo;
+    store->tile_scale[tile]  = unorm16_scale(lo, hi);
+    unorm16_encode(
+      data, (u16 *)store->io_buffer, TILE_STORE_TILE_CELLS, store->tile_offset[tile], store->tile_scale[tile]);
+    encoded = store->io_buffer;
+  } break;
+  }
+
+  if(!tile_store_seek(store->file, (u64)tile * store->tile_bytes)
+     || fwrite(encoded, 1, store->tile_bytes, store->file) != store->tile_bytes) {
+    LOG_ERROR("Failed to write tile %u to tile store", tile);
+    return false;
+  }
+  store->tile_stored[tile] = 1;
+  return true;
+}
+
+// Read `tile` into a page, or zero it if the tile was never written. Caller holds io_mutex.
+static bool tile_store_read_tile(TileStore *store, u32 tile, f32 *data) {
+  if(!store->tile_stored[tile]) {
+    memset(data, 0, TILE_STORE_TILE_CELLS * sizeof(f32));
+    return true;
+  }
+
+  void *encoded = store->storage == HEIGHTFIELD_STORAGE_F32 ? (void *)data : store->io_buffer;
+  if(!tile_store_seek(store->file, (u64)tile * store->tile_bytes)
+     || fread(encoded, 1, store->tile_bytes, store->file) != store->tile_bytes) {
+    LOG_ERROR("Failed to read tile %u from tile store", tile);
+    return false;
+  }
+
+  switch(store->storage) {
+  case HEIGHTFIELD_STORAGE_F32: break;
+  case HEIGHTFIELD_STORAGE_F16: f16_decode((const u16 *)encoded, data, TILE_STORE_TILE_CELLS); break;
+  case HEIGHTFIELD_STORAGE_UNORM16:
+    unorm16_decode(
+      (const u16 *)encoded, data, TILE_STORE_TILE_CELLS, store->tile_offset[tile], store->tile_scale[tile]);
+    break;
+  }
+  return true;
+}
+
+static bool tile_store_evicting(const TileStore *store, u32 tile) {
+  for(u32 i = 0; i < store->page_count; ++i) {
+    if(store->pages[i].evicting == tile) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool tile_store_any_loading(const TileStore *store) {
+  for(u32 i = 0; i < store->page_count; ++i) {
+    if(store->pages[i].loading) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Map `tile` onto the least recently used unpinned page and flag it loading.
+// Caller holds mutex and must finish with tile_store_page_io.
+static u32 tile_store_claim(TileStore *store, u32 tile) {
+  u32 victim = TILE_STORE_NO_PAGE;
+  for(u32 i = 0; i < store->page_count; ++i) {
+    const TileStorePage *page = &store->pages[i];
+    if(page->pins == 0 && !page->loading
+       && (victim == TILE_STORE_NO_PAGE || page->last_use < store->pages[victim].last_use)) {
+      victim = i;
+    }
+  }
+  if(victim == TILE_STORE_NO_PAGE) {
+    return TILE_STORE_NO_PAGE;
+  }
+
+  TileStorePage *page = &store->pages[victim];
+  if(page->tile != TILE_STORE_NO_TILE) {
+    store->tile_page[page->tile] = TILE_STORE_NO_PAGE;
+    if(page->dirty) {
+      page->evicting = page->tile;
+    }
+    store->stats.evictions++;
+  }
+  page->tile             = tile;
+  page->loading          = true;
+  page->dirty            = false;
+  store->tile_page[tile] = victim;
+  return victim;
+}
+
+// Write back the evicted tile and read the claimed one without holding the page-table lock.
+// On failure the tile is unmapped again.
+static bool tile_store_page_io(TileStore *store, u32 index, bool read) {
+  TileStorePage *page = &store->pages[index];
+  bool           ok   = true;
+
+  SDL_LockMutex(store->io_mutex);
+  size_t written = 0;
+  size_t loaded  = 0;
+  if(page->evicting != TILE_STORE_NO_TILE) {
+    ok      = tile_store_write_tile(store, page->evicting, page->data);
+    written = store->tile_bytes;
+  }
+  if(ok) {
+    if(read) {
+      loaded = store->tile_stored[page->tile] ? store->tile_bytes : 0;
+      ok     = tile_store_read_tile(store, page->tile, page->data);
+    } else {
+      memset(page->data, 0, TILE_STORE_TILE_CELLS * sizeof(f32));
+    }
+  }
+  SDL_UnlockMutex(store->io_mutex);
+
+  SDL_LockMutex(store->mutex);
+  page->loading  = false;
+  page->evicting = TILE_STORE_NO_TILE;
+  page->last_use = ++store->clock;
+  store->stats.bytes_written += written;
+  store->stats.bytes_read += loaded;
+  if(!ok) {
+    store->tile_page[page->tile] = TILE_STORE_NO_PAGE;
+    page->tile                   = TILE_STORE_NO_TILE;
+    page->pins                   = 0;
+    page->last_use               = 0;
+  }
+  SDL_BroadcastCondition(store->page_ready);
+  SDL_UnlockMutex(store->mutex);
+  return ok;
+}
+
+bool tile_store_open(TileStore *store, const TileStoreConfig *config, Arena *arena) {
+  if(!store || !config || !arena || config->width == 0 || config->height == 0) {
+    return false;
+  }
+
+  memset(store, 0, sizeof(*store));
+  store->storage    = config->storage;
+  store->width      = config->width;
+  store->height     = config->height;
+  store->tiles_x    = (config->width + TILE_STORE_TILE_SIZE - 1) / TILE_STORE_TILE_SIZE;
+  store->tiles_y    = (config->height + TILE_STORE_TILE_SIZE - 1) / TILE_STORE_TILE_SIZE;
+  store->tile_bytes = TILE_STORE_TILE_CELLS * heightfield_storage_bytes(config->storage);
+
+  // Every thread may pin a source and a destination tile at once, and prefetch keeps
+  // some headroom on top of that
+  size_t page_bytes = TILE_STORE_TILE_CELLS * sizeof(f32);
+  u32    min_pages  = MAX((u32)TILE_STORE_MIN_PAGES, 4 * job_thread_count());
+  u32    tile_count = store->tiles_x * store->tiles_y;
+  store->page_count = (u32)MIN((size_t)tile_count, MAX((size_t)min_pages, config->resident_bytes / page_bytes));
+
+  store->pages       = ARENA_PUSH_ARRAY(arena, TileStorePage, store->page_count);
+  store->tile_page   = ARENA_PUSH_ARRAY(arena, u32, tile_count);
+  store->tile_stored = ARENA_PUSH_ARRAY(arena, u8, tile_count);
+  store->tile_offset = ARENA_PUSH_ARRAY(arena, f32, tile_count);
+  store->tile_scale  = ARENA_PUSH_ARRAY(arena, f32, tile_count);
+  store->io_buffer   = arena_alloc_aligned(arena, store->tile_bytes, 16);
+  if(!store->pages || !store->tile_page || !store->tile_stored || !store->tile_offset || !store->tile_scale
+     || !store->io_buffer) {
+    LOG_ERROR("Failed to allocate tile store tables for %ux%u grid", config->width, config->height);
+    return false;
+  }
+
+  for(u32 i = 0; i < store->page_count; ++i) {
+    TileStorePage *page = &store->pages[i];
+    page->data          = (f32 *)arena_alloc_aligned(arena, page_bytes, 16);
+    page->tile          = TILE_STORE_NO_TILE;
+    page->evicting      = TILE_STORE_NO_TILE;
+    page->pins          = 0;
+    page->loading       = false;
+    page->dirty         = false;
+    page->last_use      = 0;
+    if(!page->data) {
+      LOG_ERROR("Failed to allocate %u resident tiles", store->page_count);
+      return false;
+    }
+  }
+  memset(store->tile_page, 0xff, tile_count * sizeof(u32));
+  memset(store->tile_stored, 0, tile_count);
+
+  // Without a path the store lives in an anonymous temporary file
+  store->file = config->path ? fopen(config->path, "w+b") : tmpfile();
+  if(!store->file) {
+    LOG_ERROR("Failed to open tile store file: %s", config->path ? config->path : "(temporary)");
+    return false;
+  }
+
+  store->mutex      = SDL_CreateMutex();
+  store->io_mutex   = SDL_CreateMutex();
+  store->page_ready = SDL_CreateCondition();
+  if(!store->mutex || !store->io_mutex || !store->page_ready) {
+    LOG_ERROR("Failed to create tile store locks");
+    tile_store_close(store);
+    return false;
+  }
+  SDL_SetAtomicInt(&store->prefetch.pending, 0);
+
+  LOG_INFO("Tile store %ux%u: %u tiles, %u resident (%zu MB)",
+           store->width,
+           store->height,
+           tile_count,
+           store->page_count,
+           (size_t)store->page_count * page_bytes / (1024 * 1024));
+  return true;
+}
+
+void tile_store_close(TileStore *store) {
+  if(!store) {
+    return;
+  }
+  if(store->file && store->mutex) {
+    tile_store_flush(store);
+  }
+  if(store->file) {
+    fclose(store->file);
+    store->file = NULL;
+  }
+  if(store->page_ready) {
+    SDL_DestroyCondition(store->page_ready);
+    store->page_ready = NULL;
+  }
+  if(store->io_mutex) {
+    SDL_DestroyMutex(store->io_mutex);
+    store->io_mutex = NULL;
+  }
+  if(store->mutex) {
+    SDL_DestroyMutex(store->mutex);
+    store->mutex = NULL;
+  }
+}
+
+bool tile_store_flush(TileStore *store) {
+  job_wait(&store->prefetch);
+
+  bool ok = true;
+  SDL_LockMutex(store->mutex);
+  SDL_LockMutex(store->io_mutex);
+  for(u32 i = 0; i < store->page_count; ++i) {
+    TileStorePage *page = &store->pages[i];
+    if(page->dirty && page->tile != TILE_STORE_NO_TILE && !page->loading) {
+      if(tile_store_write_tile(store, page->tile, page->data)) {
+        page->dirty = false;
+        store->stats.bytes_written += store->tile_bytes;
+      } else {
+        ok = false;
+      }
+    }
+  }
+  if(fflush(store->file) != 0) {
+    ok = false;
+  }
+  SDL_UnlockMutex(store->io_mutex);
+  SDL_UnlockMutex(store->mutex);
+  return ok;
+}
+
+u32 tile_store_tile_count(const TileStore *store) { return store->tiles_x * store->tiles_y; }
+
+f32 *tile_store_acquire(TileStore *store, u32 tile, TileStoreAccess access) {
+  if(tile >= tile_store_tile_count(store)) {
+    return NULL;
+  }
+
+  SDL_LockMutex(store->mutex);
+  for(;;) {
+    u32 index = store->tile_page[tile];
+    if(index != TILE_STORE_NO_PAGE) {
+      TileStorePage *page = &store->pages[index];
+      if(page->loading) {
+        SDL_WaitCondition(store->page_ready, store->mutex);
+        continue;
+      }
+      page->pins++;
+      page->last_use = ++store->clock;
+      page->dirty    = page->dirty || access != TILE_STORE_READ;
+      store->stats.hits++;
+      SDL_UnlockMutex(store->mutex);
+      return page->data;
+    }
+
+    // A dirty copy of the tile may still be on its way to disk
+    if(tile_store_evicting(store, tile)) {
+      SDL_WaitCondition(store->page_ready, store->mutex);
+      continue;
+    }
+
+    index = tile_store_claim(store, tile);
+    if(index == TILE_STORE_NO_PAGE) {
+      if(tile_store_any_loading(store)) {
+        SDL_WaitCondition(store->page_ready, store->mutex);
+        continue;
+      }
+      SDL_UnlockMutex(store->mutex);
+      LOG_ERROR("Tile store has no unpinned page for tile %u (%u resident)", tile, store->page_count);
+      return NULL;
+    }
+
+    TileStorePage *page = &store->pages[index];
+    page->pins          = 1;
+    store->stats.misses++;
+    SDL_UnlockMutex(store->mutex);
+
+    if(!tile_store_page_io(store, index, access != TILE_STORE_DISCARD)) {
+      return NULL;
+    }
+
+    // Another thread may have pinned the page for writing while the tile was read in
+    SDL_LockMutex(store->mutex);
+    page->dirty = page->dirty || access != TILE_STORE_READ;
+    SDL_UnlockMutex(store->mutex);
+    return page->data;
+  }
+}
+
+void tile_store_release(TileStore *store, u32 tile) {
+  SDL_LockMutex(store->mutex);
+  u32 index = tile < tile_store_tile_count(store) ? store->tile_page[tile] : TILE_STORE_NO_PAGE;
+  if(index != TILE_STORE_NO_PAGE && store->pages[index].pins > 0) {
+    store->pages[index].pins--;
+  } else {
+    LOG_WARN("Released tile %u that is not pinned", tile);
+  }
+  SDL_UnlockMutex(store->mutex);
+}
+
+static void tile_store_prefetch_job(void *user, u32 begin, u32 end, u32 worker) {
+  TileStore *store = (TileStore *)user;
+  UNUSED(end);
+  UNUSED(worker);
+
+  SDL_LockMutex(store->mutex);
+  u32 resident = store->tile_page[begin];
+  if(resident != TILE_STORE_NO_PAGE) {
+    store->pages[resident].last_use = ++store->clock;
+    SDL_UnlockMutex(store->mutex);
+    return;
+  }
+
+  u32 free_pages = 0;
+  for(u32 i = 0; i < store->page_count; ++i) {
+    free_pages += store->pages[i].pins == 0 && !store->pages[i].loading;
+  }
+  if(free_pages <= 2 * job_thread_count() || tile_store_evicting(store, begin)) {
+    SDL_UnlockMutex(store->mutex);
+    return;
+  }
+
+  u32 index = tile_store_claim(store, begin);
+  if(index != TILE_STORE_NO_PAGE) {
+    store->stats.prefetches++;
+  }
+  SDL_UnlockMutex(store->mutex);
+
+  if(index != TILE_STORE_NO_PAGE) {
+    tile_store_page_io(store, index, true);
+  }
+}
+
+void tile_store_prefetch(TileStore *store, u32 tile) {
+  if(tile < tile_store_tile_count(store)) {
+    job_submit(tile_store_prefetch_job, store, tile, tile + 1, &store->prefetch);
+  }
+}
+
+bool tile_store_read(TileStore *store, i64 x0, i64 y0, u32 w, u32 h, f32 *dst) {
+  if(w == 0 || h == 0) {
+    return true;
+  }
+
+  const i64 width  = store->width;
+  const i64 height = store->height;
+  const i64 size   = TILE_STORE_TILE_SIZE;
+
+  i64 tx0 = tile_store_clamp(x0, width) / size;
+  i64 tx1 = tile_store_clamp(x0 + w - 1, width) / size;
+  i64 ty0 = tile_store_clamp(y0, height) / size;
+  i64 ty1 = tile_store_clamp(y0 + h - 1, height) / size;
+
+  for(i64 ty = ty0; ty <= ty1; ++ty) {
+    for(i64 tx = tx0; tx <= tx1; ++tx) {
+      u32  tile = (u32)(ty * store->tiles_x + tx);
+      f32 *data = tile_store_acquire(store, tile, TILE_STORE_READ);
+      if(!data) {
+        return false;
+      }
+
+      // Destination cells whose clamped source lies in this tile. Edge tiles also own the
+      // cells past the grid on their side.
+      i64 gx0 = tx * size;
+      i64 gx1 = MIN(gx0 + size, width);
+      i64 gy0 = ty * size;
+      i64 gy1 = MIN(gy0 + size, height);
+      i64 lx0 = tx == 0 ? 0 : CLAMP(gx0 - x0, (i64)0, (i64)w);
+      i64 lx1 = gx1 == width ? (i64)w : CLAMP(gx1 - x0, (i64)0, (i64)w);
+      i64 ly0 = ty == 0 ? 0 : CLAMP(gy0 - y0, (i64)0, (i64)h);
+      i64 ly1 = gy1 == height ? (i64)h : CLAMP(gy1 - y0, (i64)0, (i64)h);
+
+      // Columns that map one-to-one onto the tile
+      i64 ix0 = CLAMP(gx0 - x0, lx0, lx1);
+      i64 ix1 = CLAMP(gx1 - x0, ix0, lx1);
+
+      for(i64 ly = ly0; ly < ly1; ++ly) {
+        const f32 *src = data + (tile_store_clamp(y0 + ly, height) - gy0) * size;
+        f32       *out = dst + ly * w;
+        for(i64 lx = lx0; lx < ix0; ++lx) {
+          out[lx] = src[0];
+        }
+        if(ix1 > ix0) {
+          memcpy(out + ix0, src + (x0 + ix0 - gx0), (size_t)(ix1 - ix0) * sizeof(f32));
+        }
+        for(i64 lx = ix1; lx < lx1; ++lx) {
+          out[lx] = src[gx1 - 1 - gx0];
+        }
+      }
+
+      tile_store_release(store, tile);
+    }
+  }
+  return true;
+}
+
+bool tile_store_write(TileStore *store, u32 x0, u32 y0, u32 w, u32 h, const f32 *src, u32 src_stride) {
+  if(w == 0 || h == 0) {
+    return true;
+  }
+  if((u64)x0 + w > store->width || (u64)y0 + h > store->height) {
+    LOG_ERROR("Tile store write outside the %ux%u grid", store->width, store->height);
+    return false;
+  }
+
+  for(u32 ty = y0 / TILE_STORE_TILE_SIZE; ty <= (y0 + h - 1) / TILE_STORE_TILE_SIZE; ++ty) {
+    for(u32 tx = x0 / TILE_STORE_TILE_SIZE; tx <= (x0 + w - 1) / TILE_STORE_TILE_SIZE; ++tx) {
+      u32 tile = ty * store->tiles_x + tx;
+      u32 gx0  = tx * TILE_STORE_TILE_SIZE;
+      u32 gy0  = ty * TILE_STORE_TILE_SIZE;
+      u32 cx0  = MAX(x0, gx0);
+      u32 cy0  = MAX(y0, gy0);
+      u32 cx1  = MIN(x0 + w, gx0 + TILE_STORE_TILE_SIZE);
+      u32 cy1  = MIN(y0 + h, gy0 + TILE_STORE_TILE_SIZE);
+
+      // Covering every valid cell of the tile makes its old contents irrelevant
+      u32  cols;
+      u32  rows;
+      tile_store_tile_extent(store, tile, &cols, &rows);
+      bool whole = cx0 == gx0 && cy0 == gy0 && cx1 - gx0 == cols && cy1 - gy0 == rows;
+
+      f32 *data = tile_store_acquire(store, tile, whole ? TILE_STORE_DISCARD : TILE_STORE_WRITE);
+      if(!data) {
+        return false;
+      }
+      for(u32 y = cy0; y < cy1; ++y) {
+        memcpy(data + (size_t)(y - gy0) * TILE_STORE_TILE_SIZE + (cx0 - gx0),
+               src + (size_t)(y - y0) * src_stride + (cx0 - x0),
+               (cx1 - cx0) * sizeof(f32));
+      }
+      tile_store_release(store, tile);
+    }
+  }
+  return true;
+}
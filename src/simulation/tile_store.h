@@ -0,0 +1,117 @@
+#ifndef TILE_STORE_H
+#define TILE_STORE_H
+
+#include "core/job.h"
+#include "memory/arena.h"
+#include "simulation/heightfield.h"
+#include "utils/types.h"
+#include <SDL3/SDL_mutex.h>
+#include <stdio.h>
+
+// Out-of-core f32 layer for grids larger than memory. The layer is cut into square tiles
+// kept in a file, tile-major, in a HeightfieldStorage format. A fixed number of pages hold
+// resident tiles; misses evict the least recently used unpinned page, writing it back
+// first if it changed. Tiles that were never written read as zero without touching disk.
+//
+// All calls are thread-safe. File I/O runs without the page-table lock held, so workers
+// computing on pinned tiles are not stalled by another thread's miss or prefetch.
+//
+// Consumers are noise_fill_store, diffusion_step_paged and stencil_run_paged. The live
+// simulation keeps its layers resident and does not page them.
+
+// Cells per side of a paged tile
+#define TILE_STORE_TILE_SIZE 256
+
+// Fewest resident pages a store is created with
+#define TILE_STORE_MIN_PAGES 8
+
+#define TILE_STORE_NO_PAGE 0xffffffffu
+#define TILE_STORE_NO_TILE 0xffffffffu
+
+typedef enum TileStoreAccess {
+  TILE_STORE_READ = 0,
+  TILE_STORE_WRITE,   // Read the tile and mark it for write-back
+  TILE_STORE_DISCARD, // Caller overwrites every cell: a miss skips the read
+} TileStoreAccess;
+
+typedef struct TileStoreConfig {
+  const char        *path;           // Backing file, created or truncated; NULL for an anonymous temporary file
+  u32                width;
+  u32                height;
+  HeightfieldStorage storage;        // On-disk format; pages are always f32
+  size_t             resident_bytes; // Memory budget for resident pages
+} TileStoreConfig;
+
+typedef struct TileStoreStats {
+  u64 hits;
+  u64 misses;
+  u64 prefetches; // Tiles loaded ahead of use by tile_store_prefetch
+  u64 evictions;
+  u64 bytes_read;
+  u64 bytes_written;
+} TileStoreStats;
+
+typedef struct TileStorePage {
+  f32 *data;
+  u32  tile;     // Resident tile, TILE_STORE_NO_TILE when free
+  u32  evicting; // Tile being written back from this page, TILE_STORE_NO_TILE otherwise
+  u32  pins;
+  bool loading; // I/O in flight; data is not valid yet
+  bool dirty;
+  u64  last_use;
+} TileStorePage;
+
+typedef struct TileStore {
+  FILE              *file;
+  SDL_Mutex         *mutex;    // Page table, LRU clock and stats
+  SDL_Mutex         *io_mutex; // File position and io_buffer
+  SDL_Condition     *page_ready;
+  HeightfieldStorage storage;
+  u32                width;
+  u32                height;
+  u32                tiles_x;
+  u32                tiles_y;
+  size_t             tile_bytes; // Encoded size of one tile in the file
+  TileStorePage     *pages;
+  u32                page_count;
+  u32               *tile_page;   // Page holding each tile, TILE_STORE_NO_PAGE if not resident
+  u8                *tile_stored; // Tiles that have been written to the file
+  f32               *tile_offset; // unorm16 range of each stored tile
+  f32               *tile_scale;
+  void              *io_buffer;
+  u64                clock;
+  JobCounter         prefetch; // Outstanding prefetch jobs
+  TileStoreStats     stats;
+} TileStore;
+
+// Open the backing file and allocate pages and tables from the arena
+bool tile_store_open(TileStore *store, const TileStoreConfig *config, Arena *arena);
+
+// Write back dirty pages and close the file. Every tile must have been released.
+void tile_store_close(TileStore *store);
+
+// Write back dirty pages, keeping them resident
+bool tile_store_flush(TileStore *store);
+
+u32 tile_store_tile_count(const TileStore *store);
+
+// Pin a tile in memory and return its TILE_STORE_TILE_SIZE^2 cells (row stride
+// TILE_STORE_TILE_SIZE). Cells past the grid edge are padding. Returns NULL if the file
+// cannot be read or every page is pinned.
+f32 *tile_store_acquire(TileStore *store, u32 tile, TileStoreAccess access);
+void tile_store_release(TileStore *store, u32 tile);
+
+// Start loading a tile on the job system so a later acquire hits. Skipped when few pages
+// are free, so prefetching never evicts tiles that are about to be pinned.
+void tile_store_prefetch(TileStore *store, u32 tile);
+
+// Copy the w x h rectangle at (x0, y0) into dst (row stride w). The rectangle may extend
+// past the grid; outside cells read as the nearest edge cell, which is how the stencil
+// executor reads halos across tile boundaries.
+bool tile_store_read(TileStore *store, i64 x0, i64 y0, u32 w, u32 h, f32 *dst);
+
+// Copy a w x h rectangle (row stride src_stride) into the grid at (x0, y0). The rectangle
+// must lie inside the grid.
+bool tile_store_write(TileStore *store, u32 x0, u32 y0, u32 w, u32 h, const f32 *src, u32 src_stride);
+
+#endif // TILE_STORE_H
@@ -0,0 +1,99 @@
+#include "time_slice.h"
+#include "core/log.h"
+#include <SDL3/SDL_timer.h>
+#include <string.h>
+
+// Weight of the newest timing sample in the per-unit cost estimate
+static const f64 TIME_SLICE_SMOOTHING = 0.25;
+
+// Share of the remaining budget a slice is sized for, leaving room for estimate error
+static const f64 TIME_SLICE_HEADROOM = 0.8;
+
+static u32 time_slice_units_for(const TimeSliceTask *task, u64 remaining_ns) {
+  // Unknown cost: probe with a single unit
+  if(task->ns_per_unit <= 0.0) {
+    return 1;
+  }
+
+  f64 units = ((f64)remaining_ns * TIME_SLICE_HEADROOM) / task->ns_per_unit;
+  if(units < 1.0) {
+    return 1;
+  }
+  if(units > (f64)TIME_SLICE_MAX_UNITS) {
+    return TIME_SLICE_MAX_UNITS;
+  }
+  return (u32)units;
+}
+
+void time_slice_init(TimeSliceScheduler *scheduler, f64 budget_ms) {
+  memset(scheduler, 0, sizeof(TimeSliceScheduler));
+  scheduler->budget_ns = (u64)(budget_ms * 1000000.0);
+}
+
+bool time_slice_add_task(TimeSliceScheduler *scheduler, const char *name, TimeSliceFn run, void *user) {
+  if(!run || scheduler->task_count >= TIME_SLICE_MAX_TASKS) {
+    LOG_ERROR("Cannot add time-sliced task '%s'", name ? name : "(null)");
+    return false;
+  }
+
+  scheduler->tasks[scheduler->task_count++] = TimeSliceTask{
+    .name        = name,
+    .run         = run,
+    .user        = user,
+    .ns_per_unit = 0.0,
+    .total_units = 0,
+  };
+  return true;
+}
+
+TimeSliceFrameStats time_slice_run_frame(TimeSliceScheduler *scheduler) {
+  TimeSliceFrameStats stats = {};
+  u64                 start = SDL_GetTicksNS();
+  u32                 idle  = 0;
+
+  while(scheduler->task_count > 0) {
+    u64 now     = SDL_GetTicksNS();
+    u64 elapsed = now - start;
+    if(elapsed >= scheduler->budget_ns) {
+      break;
+    }
+
+    TimeSliceTask *task  = &scheduler->tasks[scheduler->current];
+    u32            units = time_slice_units_for(task, scheduler->budget_ns - elapsed);
+    bool           done  = false;
+
+    u32 processed = task->run(task->user, units, &done);
+    u64 slice_ns  = SDL_GetTicksNS() - now;
+
+    if(processed > 0) {
+      f64 sample        = (f64)slice_ns / (f64)processed;
+      task->ns_per_unit = task->ns_per_unit <= 0.0
+                          ? sample
+                          : task->ns_per_unit + (sample - task->ns_per_unit) * TIME_SLICE_SMOOTHING;
+      task->total_units += processed;
+      idle = 0;
+    } else {
+      idle++;
+    }
+
+    stats.slices++;
+    stats.units += processed;
+
+    if(done) {
+      scheduler->current = (scheduler->current + 1) % scheduler->task_count;
+      if(scheduler->current == 0) {
+        scheduler->cycles_completed++;
+        stats.cycles_completed++;
+      }
+    }
+
+    // A full lap without progress means there is nothing left to do this frame
+    if(idle >= scheduler->task_count) {
+      break;
+    }
+  }
+
+  stats.elapsed_ns      = SDL_GetTicksNS() - start;
+  scheduler->last_frame = stats;
+  return stats;
+}
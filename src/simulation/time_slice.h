@@ -0,0 +1,47 @@
+#ifndef TIME_SLICE_H
+#define TIME_SLICE_H
+
+#include "utils/types.h"
+
+#define TIME_SLICE_MAX_TASKS 8
+
+// Upper bound on units handed to a task in one slice
+#define TIME_SLICE_MAX_UNITS 65536
+
+// Run up to max_units of resumable work and return how many were processed.
+// Set *done when the task finished its share of the current simulation step.
+typedef u32 (*TimeSliceFn)(void *user, u32 max_units, bool *done);
+
+typedef struct TimeSliceTask {
+  const char *name;
+  TimeSliceFn run;
+  void       *user;
+  f64         ns_per_unit; // Smoothed cost of one unit, used to size the next slice
+  u64         total_units;
+} TimeSliceTask;
+
+typedef struct TimeSliceFrameStats {
+  u64 elapsed_ns;
+  u32 slices;
+  u32 units;
+  u32 cycles_completed; // Full passes over the task list finished this frame
+} TimeSliceFrameStats;
+
+// Cooperative scheduler that runs tasks in order under a per-frame time budget.
+// Tasks form a cycle: when the last task is done, the first one starts again.
+typedef struct TimeSliceScheduler {
+  TimeSliceTask       tasks[TIME_SLICE_MAX_TASKS];
+  u32                 task_count;
+  u32                 current; // Task resumed by the next slice
+  u64                 budget_ns;
+  u64                 cycles_completed;
+  TimeSliceFrameStats last_frame;
+} TimeSliceScheduler;
+
+void time_slice_init(TimeSliceScheduler *scheduler, f64 budget_ms);
+bool time_slice_add_task(TimeSliceScheduler *scheduler, const char *name, TimeSliceFn run, void *user);
+
+// Run slices until the frame budget is spent or every task reports no work
+TimeSliceFrameStats time_slice_run_frame(TimeSliceScheduler *scheduler);
+
+#endif // TIME_SLICE_H
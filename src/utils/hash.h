@@ -0,0 +1,22 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "utils/types.h"
+
+// 64-bit FNV-1a, used to key cached results by their inputs
+#define HASH_SEED  0xcbf29ce484222325ull
+#define HASH_PRIME 0x100000001b3ull
+
+static inline u64 hash_bytes(u64 hash, const void *data, size_t size) {
+  const u8 *bytes = (const u8 *)data;
+  for(size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= HASH_PRIME;
+  }
+  return hash;
+}
+
+// Hash a single field; never hash whole structs, their padding is unspecified
+#define HASH_VALUE(hash, value) hash_bytes((hash), &(value), sizeof(value))
+
+#endif // HASH_H